@@ -8,6 +8,7 @@
 
 #define NIC_SENDQ_LIMIT_DEFAULT  4096
 #define NIC_BUFFER_LIMIT_DEFAULT 4096
+#define NIC_NAPI_BUDGET_DEFAULT  64
 
 namespace hw {
 
@@ -25,6 +26,9 @@ namespace hw {
     /** Maximum number of packets that can be created during RX-ring refill **/
     static constexpr uint32_t buffer_limit_default = NIC_BUFFER_LIMIT_DEFAULT;
 
+    /** Maximum number of packets taken from the RX-ring per round of polling **/
+    static constexpr int napi_budget_default = NIC_NAPI_BUDGET_DEFAULT;
+
     enum class Proto {ETH, IEEE802111};
 
     virtual Proto proto() const = 0;
@@ -106,6 +110,12 @@ namespace hw {
     }
     uint32_t sendq_limit() const noexcept { return m_sendq_limit; }
 
+    /** Set the most packets to receive per round of polling, at least 1 **/
+    void set_napi_budget(int budget) {
+      this->m_napi_budget = (budget > 0) ? budget : 1;
+    }
+    int napi_budget() const noexcept { return m_napi_budget; }
+
     virtual void add_vlan([[maybe_unused]] const int id){}
 
   protected:
@@ -150,10 +160,37 @@ namespace hw {
       return this->sendq_limit() == 0 || size < this->sendq_limit();
     }
 
+    /**
+     *  Interrupt mitigation, as NAPI in Linux
+     *
+     *  The driver calls napi_schedule() on an RX interrupt, which masks it
+     *  and leaves the work to an event. Each round of that event receives at
+     *  most the budget of packets; a full budget means there are more, so
+     *  the event triggers itself again, after the other pending events have
+     *  had their turn. Once a round empties the ring, the interrupt is
+     *  unmasked, and the ring checked again for packets that came meanwhile.
+     */
+    void napi_schedule();
+
+    /** Receive at most @budget packets, returning how many */
+    virtual int napi_rx(int /*budget*/) { return 0; }
+
+    /** Mask or unmask the RX interrupt */
+    virtual void napi_irq(bool /*enable*/) {}
+
+    /** Whether the RX-ring has packets waiting */
+    virtual bool napi_pending() { return false; }
+
   private:
+    void napi_poll();
+
     int N;
     uint32_t m_buffer_limit = buffer_limit_default;
     uint32_t m_sendq_limit = sendq_limit_default;
+    int  m_napi_budget = napi_budget_default;
+    int  m_napi_event  = -1;
+    int  m_napi_cpu    = -1;
+    bool m_napi_scheduled = false;
     friend class Devices;
   };
 
@@ -0,0 +1,319 @@
+
+#pragma once
+#ifndef KERNEL_COROUTINE_HPP
+#define KERNEL_COROUTINE_HPP
+
+#if !defined(__cpp_impl_coroutine)
+#error "Coroutines need C++20 (-std=c++20) in the service"
+#endif
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+#include <smp>
+#include <hw/block_device.hpp>
+#include <kernel/timers.hpp>
+
+/**
+ * Stackless coroutines, as an alternative to callbacks and Fibers:
+ *
+ *   os::coro::Task<size_t> copy(hw::Block_device& dev) {
+ *     auto buf = co_await os::coro::read(dev, 0);
+ *     co_await os::coro::sleep(std::chrono::milliseconds(10));
+ *     co_return buf->size();
+ *   }
+ *   os::coro::spawn(copy(dev));
+ *
+ * The frames come from per-CPU pools, and waiting on an operation
+ * needs no allocation, as its callback only holds the awaiter.
+ **/
+namespace os::coro
+{
+
+  /** Free lists of coroutine frames, by size in steps of 64 bytes */
+  class alignas(SMP_ALIGN) Frame_pool {
+  public:
+    static constexpr size_t granularity = 64;
+    static constexpr size_t classes     = 16;
+    static constexpr size_t max_size    = granularity * classes;
+    // the most frames of one size kept for reuse
+    static constexpr int    max_cached  = 64;
+
+    void* allocate(size_t size)
+    {
+      if (size > max_size) return ::operator new(size);
+      auto& list = lists_[size_class(size)];
+      if (list.head != nullptr) {
+        auto* frame = list.head;
+        list.head = frame->next;
+        list.count--;
+        return frame;
+      }
+      return ::operator new(class_size(size));
+    }
+
+    void deallocate(void* ptr, size_t size) noexcept
+    {
+      if (size > max_size) return ::operator delete(ptr);
+      auto& list = lists_[size_class(size)];
+      if (list.count >= max_cached) return ::operator delete(ptr);
+      auto* frame = static_cast<Free_frame*>(ptr);
+      frame->next = list.head;
+      list.head = frame;
+      list.count++;
+    }
+
+    /** The number of frames of @size kept for reuse */
+    int cached(size_t size) const noexcept
+    { return lists_[size_class(size)].count; }
+
+    /** The pool of this CPU */
+    static Frame_pool& get() noexcept
+    {
+      static SMP::Array<Frame_pool> pools;
+      return PER_CPU(pools);
+    }
+
+    ~Frame_pool()
+    {
+      for (auto& list : lists_)
+        while (list.head) {
+          auto* next = list.head->next;
+          ::operator delete(list.head);
+          list.head = next;
+        }
+    }
+
+  private:
+    static constexpr size_t size_class(size_t size) noexcept
+    { return (size - 1) / granularity; }
+    static constexpr size_t class_size(size_t size) noexcept
+    { return (size_class(size) + 1) * granularity; }
+
+    struct Free_frame { Free_frame* next; };
+    struct Free_list {
+      Free_frame* head = nullptr;
+      int count = 0;
+    };
+    std::array<Free_list, classes> lists_ {};
+  };
+
+  /** Base of promises with frames from the pool of the current CPU */
+  struct Pooled_frame {
+    static void* operator new(size_t size)
+    { return Frame_pool::get().allocate(size); }
+    static void operator delete(void* ptr, size_t size) noexcept
+    { Frame_pool::get().deallocate(ptr, size); }
+  };
+
+  template <typename T> class Task;
+
+  namespace detail
+  {
+    /** Resumes whoever awaits the finished task */
+    struct Final_awaiter {
+      bool await_ready() const noexcept { return false; }
+      template <typename Promise>
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+      {
+        auto next = h.promise().continuation;
+        return next ? next : std::noop_coroutine();
+      }
+      void await_resume() const noexcept {}
+    };
+
+    struct Promise_base : Pooled_frame {
+      std::coroutine_handle<> continuation = nullptr;
+      std::exception_ptr error = nullptr;
+
+      std::suspend_always initial_suspend() const noexcept { return {}; }
+      Final_awaiter final_suspend() const noexcept { return {}; }
+      void unhandled_exception() noexcept
+      { error = std::current_exception(); }
+      void rethrow_if_failed() const
+      { if (error) std::rethrow_exception(error); }
+    };
+
+    template <typename T>
+    struct Promise : Promise_base {
+      std::optional<T> value;
+
+      Task<T> get_return_object() noexcept;
+      template <typename U>
+      void return_value(U&& val)
+      { value.emplace(std::forward<U>(val)); }
+      T result()
+      {
+        rethrow_if_failed();
+        return std::move(*value);
+      }
+    };
+
+    template <>
+    struct Promise<void> : Promise_base {
+      Task<void> get_return_object() noexcept;
+      void return_void() const noexcept {}
+      void result() const
+      { rethrow_if_failed(); }
+    };
+  }
+
+  /**
+   * A coroutine returning T, starting when awaited (or spawned), and
+   * resuming its awaiter when done
+   **/
+  template <typename T = void>
+  class [[nodiscard]] Task {
+  public:
+    using promise_type = detail::Promise<T>;
+    using handle_t     = std::coroutine_handle<promise_type>;
+
+    Task(Task&& other) noexcept
+      : handle_{std::exchange(other.handle_, nullptr)} {}
+    Task& operator=(Task&& other) noexcept
+    {
+      if (this != &other) {
+        if (handle_) handle_.destroy();
+        handle_ = std::exchange(other.handle_, nullptr);
+      }
+      return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+      if (handle_) handle_.destroy();
+    }
+
+    bool done() const noexcept
+    { return handle_ == nullptr || handle_.done(); }
+
+    bool await_ready() const noexcept
+    { return done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+      handle_.promise().continuation = awaiter;
+      return handle_;
+    }
+
+    T await_resume()
+    { return handle_.promise().result(); }
+
+  private:
+    friend promise_type;
+    explicit Task(handle_t handle) noexcept : handle_{handle} {}
+    handle_t handle_;
+  };
+
+  template <typename T>
+  inline Task<T> detail::Promise<T>::get_return_object() noexcept
+  { return Task<T>{Task<T>::handle_t::from_promise(*this)}; }
+
+  inline Task<void> detail::Promise<void>::get_return_object() noexcept
+  { return Task<void>{Task<void>::handle_t::from_promise(*this)}; }
+
+  namespace detail
+  {
+    /** A coroutine that starts at once and frees itself when done */
+    struct Detached {
+      struct promise_type : Pooled_frame {
+        Detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        // no one to tell, so let it propagate out of resume()
+        void unhandled_exception() const { throw; }
+      };
+    };
+  }
+
+  /** Run @task until its first wait, and let it finish on its own */
+  template <typename T>
+  void spawn(Task<T> task)
+  {
+    [] (Task<T> t) -> detail::Detached {
+      co_await t;
+    }(std::move(task));
+  }
+
+  /**
+   * Awaits an operation completing through a callback, which may also
+   * happen right away, before the coroutine suspends. Operations derive
+   * from this, starting in start() and calling complete() when done.
+   **/
+  template <typename Derived, typename T>
+  class Completion {
+  public:
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      handle_ = handle;
+      static_cast<Derived*>(this)->start();
+      // suspend unless already done
+      suspended_ = not done_;
+      return suspended_;
+    }
+
+    T await_resume()
+    { return std::move(result_); }
+
+  protected:
+    void complete(T result)
+    {
+      result_ = std::move(result);
+      done_ = true;
+      if (suspended_) handle_.resume();
+    }
+
+  private:
+    std::coroutine_handle<> handle_ = nullptr;
+    T    result_ {};
+    bool done_      = false;
+    bool suspended_ = false;
+  };
+
+  /** Wait for @duration */
+  inline auto sleep(Timers::duration_t duration)
+  {
+    struct Sleep {
+      Timers::duration_t duration;
+      bool await_ready() const noexcept { return duration.count() <= 0; }
+      void await_suspend(std::coroutine_handle<> handle)
+      {
+        Timers::oneshot(duration,
+          [handle] (Timers::id_t) { handle.resume(); });
+      }
+      void await_resume() const noexcept {}
+    };
+    return Sleep{duration};
+  }
+
+  /** Read @count blocks from @blk, giving a nullptr buffer on errors */
+  inline auto read(hw::Block_device& device, hw::Block_device::block_t blk,
+                   size_t count = 1)
+  {
+    struct Read : Completion<Read, hw::Block_device::buffer_t> {
+      hw::Block_device& device;
+      hw::Block_device::block_t blk;
+      size_t count;
+      Read(hw::Block_device& d, hw::Block_device::block_t b, size_t c)
+        : device{d}, blk{b}, count{c} {}
+
+      void start()
+      { device.read(blk, count, {this, &Read::done}); }
+      void done(hw::Block_device::buffer_t buffer)
+      { this->complete(std::move(buffer)); }
+    };
+    return Read{device, blk, count};
+  }
+
+} // os::coro
+
+#endif
@@ -3,9 +3,10 @@
 #define KERNEL_EVENTS_HPP
 
 #include <delegate>
+#include <arch.hpp>
 #include <array>
+#include <atomic>
 #include <common>
-#include <deque>
 #include <smp>
 
 #define IRQ_BASE    32
@@ -18,8 +19,20 @@ public:
 
   static const int  NUM_EVENTS = 128;
 
-  uint8_t subscribe(event_callback);
-  void subscribe(uint8_t evt, event_callback);
+  /**
+   * Each round of processing handles the pending events of higher
+   * priority first. An event triggered again while being handled
+   * waits for the next round, after the lower priorities.
+   */
+  enum Priority : uint8_t {
+    PRIO_HIGH,    // device interrupts, like NIC RX
+    PRIO_NORMAL,  // timers, and everything else
+    PRIO_LOW,     // deferred work
+  };
+  static const int  NUM_PRIORITIES = 3;
+
+  uint8_t subscribe(event_callback, Priority = PRIO_NORMAL);
+  void subscribe(uint8_t evt, event_callback, Priority = PRIO_NORMAL);
   void unsubscribe(uint8_t evt);
 
   // register event for deferred processing
@@ -34,8 +47,8 @@ public:
   static Events& get();
   static Events& get(int cpu);
 
-  /** process all pending events */
-  void process_events();
+  /** process all pending events, returning whether there were any */
+  bool process_events();
 
   /** array of received events */
   auto& get_received_array() const noexcept
@@ -45,6 +58,17 @@ public:
   auto& get_handled_array() const noexcept
   { return handled_array; }
 
+  /**
+   * Each event also counts in Statman, as cpuN.events.E.count, along with
+   * the total cycles from being triggered to being handled (.latency) and
+   * spent in the handler (.cycles)
+   */
+  struct Stats {
+    uint64_t* count   = nullptr;
+    uint64_t* latency = nullptr;
+    uint64_t* cycles  = nullptr;
+  };
+
   void init_local();
   Events() = default;
 
@@ -54,30 +78,41 @@ private:
   Events& operator=(Events&&) = delete;
   Events& operator=(Events&) = delete;
 
+  static const int WORDS = NUM_EVENTS / 64;
+  using bitmap_t = std::array<uint64_t, WORDS>;
+
+  bool is_subscribed(uint8_t evt) const noexcept
+  { return event_subs[evt / 64] & (1ull << (evt % 64)); }
+  int  process_priority(Priority);
+  void create_stats(uint8_t evt);
+
   event_callback callbacks[NUM_EVENTS];
   std::array<uint64_t, NUM_EVENTS> received_array;
   std::array<uint64_t, NUM_EVENTS> handled_array;
-
-  std::array<bool, NUM_EVENTS>  event_subs;
-  std::array<bool, NUM_EVENTS>  event_pend;
-  // using deque because vector resize causes invalidation of ranged for
-  // when something subscribes during processing of events
-  std::deque<uint8_t> sublist;
+  std::array<uint64_t, NUM_EVENTS> triggered_at;
+  std::array<Priority, NUM_EVENTS> priority {};
+  std::array<Stats, NUM_EVENTS>    stats;
+
+  // taken, and having a handler
+  bitmap_t event_taken {};
+  bitmap_t event_subs {};
+  // set by interrupts, so only changed atomically
+  std::array<std::atomic<uint64_t>, WORDS> event_pend[NUM_PRIORITIES] {};
 };
 
 inline void Events::trigger_event(const uint8_t evt)
 {
 #ifdef DEBUG_ALL_INTERRUPTS
-  bool is_subbed = false;
-  for (auto intr : sublist) {
-    if (intr == evt) { is_subbed = true; break; }
-  }
-  if (UNLIKELY(is_subbed == false)) {
+  if (UNLIKELY(evt < NUM_EVENTS && is_subscribed(evt) == false)) {
     printf("! Unhandled interrupt: %u\n", evt);
   }
 #endif
   if (LIKELY(evt < NUM_EVENTS)) {
-    event_pend[evt] = true;
+    const uint64_t bit = 1ull << (evt % 64);
+    auto& pend = event_pend[priority[evt]][evt / 64];
+    // time the wait from the first trigger
+    if ((pend.fetch_or(bit, std::memory_order_relaxed) & bit) == 0)
+      triggered_at[evt] = os::Arch::cpu_cycles();
     // increment events received
     received_array[evt]++;
   }
@@ -12,6 +12,7 @@
 #endif
 
 class Fiber;
+class Fiber_pool;
 
 /** Bottom C++ stack frame for all fibers */
 extern "C" void fiber_jumpstarter(Fiber* f);
@@ -34,7 +35,13 @@ public:
   using R_t = void*;
   using P_t = void*;
   using init_func = void*(*)(void*);
-  using Stack_ptr = std::unique_ptr<char[]>;
+
+  /** Frees a stack, or gives it back to the pool it came from (if any) */
+  struct Stack_deleter {
+    Fiber_pool* pool;
+    void operator()(char* stack) const;
+  };
+  using Stack_ptr = std::unique_ptr<char[], Stack_deleter>;
 
   static constexpr int default_stack_size = 0x10000;
 
@@ -46,7 +53,7 @@ public:
   Fiber(int stack_size, R(*func)(P), void* arg)
     : id_{next_id_++},
       stack_size_{stack_size},
-      stack_{Stack_ptr(new char[16 + stack_size_], std::default_delete<char[]> ())},
+      stack_{Stack_ptr(new char[16 + stack_size_])},
       stack_loc_{(void*)(uintptr_t(stack_.get() + stack_size_ ) &  ~ (uintptr_t)0xf)},
       type_return_{typeid(R)},
       type_param_{typeid(P)},
@@ -78,7 +85,7 @@ public:
   Fiber(int stack_size, void(*func)())
     : id_{next_id_++},
       stack_size_{stack_size},
-      stack_{Stack_ptr(new char[16 + stack_size_], std::default_delete<char[]> ())},
+      stack_{Stack_ptr(new char[16 + stack_size_])},
       stack_loc_{(void*)(uintptr_t(stack_.get() + stack_size_ ) &  ~ (uintptr_t)0xf)},
       type_return_{typeid(void)},
       type_param_{typeid(void)},
@@ -99,7 +106,7 @@ public:
   Fiber(int stack_size, void(*func)(P), P par)
     : id_{next_id_++},
       stack_size_{stack_size},
-      stack_{Stack_ptr(new char[16 + stack_size_], std::default_delete<char[]> ())},
+      stack_{Stack_ptr(new char[16 + stack_size_])},
       stack_loc_{(void*)(uintptr_t(stack_.get() + stack_size_ ) &  ~ (uintptr_t)0xf)},
       type_return_{typeid(void)},
       type_param_{typeid(P)},
@@ -120,7 +127,7 @@ public:
   Fiber(int stack_size, R(*func)())
     : id_{next_id_++},
       stack_size_{stack_size},
-      stack_{Stack_ptr(new char[16 + stack_size_], std::default_delete<char[]> ())},
+      stack_{Stack_ptr(new char[16 + stack_size_])},
       stack_loc_{(void*)(uintptr_t(stack_.get() + stack_size_ ) &  ~ (uintptr_t)0xf)},
       type_return_{typeid(R)},
       type_param_{typeid(void)},
@@ -200,6 +207,19 @@ public:
 
 
 private:
+  /** Fiber on a stack from a Fiber_pool */
+  Fiber(Stack_ptr stack, int stack_size, const std::type_info& ret,
+        const std::type_info& param, init_func func, void* arg)
+    : id_{next_id_++},
+      stack_size_{stack_size},
+      stack_{std::move(stack)},
+      stack_loc_{(void*)(uintptr_t(stack_.get() + stack_size_ ) &  ~ (uintptr_t)0xf)},
+      type_return_{ret},
+      type_param_{param},
+      func_{func},
+      param_{arg}
+  {}
+
 #ifdef INCLUDEOS_SMP_ENABLE
   static std::atomic<int> next_id_;
 #else
@@ -236,7 +256,12 @@ private:
   bool done_ { false };
   bool running_ { false };
 
+  // scheduling state, when run by a Fiber_pool
+  Fiber_pool* pool_ = nullptr;
+  bool queued_ { false };
+
   friend void ::fiber_jumpstarter(Fiber* f);
+  friend class Fiber_pool;
 };
 
 #endif
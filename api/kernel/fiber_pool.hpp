@@ -0,0 +1,112 @@
+
+#pragma once
+#ifndef KERNEL_FIBER_POOL_HPP
+#define KERNEL_FIBER_POOL_HPP
+
+#include <kernel/fiber.hpp>
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Runs fibers round-robin, on stacks reused from one fiber to the next.
+ *
+ * On x86_64 stacks are mapped in an area of their own, each with an
+ * unmapped guard page below it, so that overflowing it faults instead
+ * of corrupting the heap. The guard takes no memory, and a stack size
+ * of a power of two takes just that from the heap. Stacks are mapped
+ * once, and kept for reuse when their fiber is done, up to max_cached
+ * of them.
+ *
+ * A fiber gives up the CPU with Fiber::yield(), queueing it again after
+ * the other ready fibers, or with Fiber_pool::park(), leaving it out
+ * until someone calls wake() - e.g. from a network callback:
+ *
+ *   auto& fiber = pool.spawn(serve, conn.get()); // parks for data
+ *   conn->on_read(1024, [&pool, &fiber] (auto buf) {
+ *     ...
+ *     pool.wake(fiber);
+ *   });
+ *
+ * Woken fibers run from the event loop. Deleting the pool deletes the
+ * fibers not yet done, without unwinding their stacks. The pool belongs
+ * to the CPU creating it, and is not safe to use from others.
+ **/
+class Fiber_pool {
+public:
+  static constexpr size_t default_max_cached = 1024;
+  static constexpr size_t guard_size = 4096;
+
+  explicit Fiber_pool(int stack_size = Fiber::default_stack_size,
+                      size_t max_cached = default_max_cached);
+  ~Fiber_pool();
+  Fiber_pool(const Fiber_pool&) = delete;
+  Fiber_pool& operator=(const Fiber_pool&) = delete;
+
+  /** Queue a fiber running @func. It is deleted when done */
+  Fiber& spawn(void(*func)())
+  {
+    return add(new Fiber(get_stack(), stack_size_, typeid(void), typeid(void),
+                         reinterpret_cast<Fiber::init_func>(func), nullptr));
+  }
+
+  /** Queue a fiber running @func(par). P must be storable in a void* */
+  template<typename P>
+  Fiber& spawn(void(*func)(P), P par)
+  {
+    static_assert(sizeof(P) <= sizeof(void*), "Invalid parameter size");
+    return add(new Fiber(get_stack(), stack_size_, typeid(void), typeid(P),
+                         reinterpret_cast<Fiber::init_func>(func),
+                         reinterpret_cast<void*>(par)));
+  }
+
+  /** Suspend the current fiber until woken. Only from a fiber of a pool */
+  static void park();
+
+  /** Queue a parked fiber to run again */
+  void wake(Fiber& fiber);
+
+  /**
+   * Run the fibers queued by now, in turn, once each. Those still ready
+   * after, having yielded, run again from the event loop.
+   */
+  void run();
+
+  /** Stack for a new fiber, reusing a cached one if any */
+  Fiber::Stack_ptr get_stack();
+
+  /** Number of fibers ready to run */
+  size_t ready() const noexcept
+  { return queue_.size(); }
+
+  /** Number of fibers not yet done, ready or parked */
+  size_t live() const noexcept
+  { return fibers_.size(); }
+
+  /** Number of stacks kept for reuse */
+  size_t cached() const noexcept
+  { return free_.size(); }
+
+  int stack_size() const noexcept
+  { return stack_size_; }
+
+private:
+  Fiber& add(Fiber* fiber);
+  void release(char* stack);
+  void free_stack(char* stack);
+  void enqueue(Fiber& fiber);
+  static void* schedule(void* pool);
+
+  const int    stack_size_;
+  const size_t max_cached_;
+  std::vector<char*>         free_;
+  std::deque<Fiber*>         queue_;
+  std::unordered_set<Fiber*> fibers_;
+  Fiber* scheduler_ = nullptr;
+  bool   parking_   = false;
+  int    event_     = -1;
+
+  friend struct Fiber::Stack_deleter;
+};
+
+#endif
@@ -1,6 +1,8 @@
 #pragma once
 #include <array>
 #include <vector>
+#include <smp>
+#include <chrono>
 
 //#define THREADS_DEBUG 1
 #ifdef THREADS_DEBUG
@@ -9,8 +11,29 @@
 #define THPRINT(fmt, ...) /* fmt */
 #endif
 
+extern "C" void __thread_suspend_and_yield(void* next_instr, void* stack);
+
 namespace kernel
 {
+  struct thread_t;
+
+  /**
+   * FIFO of threads, linked through the threads themselves, so adding,
+   * taking the first and removing any thread are all O(1).
+   * Used as run queue (ready threads) and wait queue (blocked threads).
+   **/
+  struct Thread_queue {
+    spinlock_t lock = 0;
+    thread_t*  head = nullptr;
+    thread_t*  tail = nullptr;
+    size_t     size = 0;
+
+    bool empty() const noexcept { return head == nullptr; }
+    void push_back(thread_t*) noexcept;
+    thread_t* pop_front() noexcept;
+    void remove(thread_t*) noexcept;
+  };
+
   struct thread_t {
     thread_t* self;
     thread_t* parent = nullptr;
@@ -21,10 +44,27 @@ namespace kernel
     void*    stored_stack = nullptr;
     void*    stored_nexti = nullptr;
     bool     yielded = false;
+    // its stack is in use, until switched away from
+    bool     on_cpu = true;
     // address zeroed when exiting
     void*    clear_tid = nullptr;
     // children, detached when exited
     std::vector<thread_t*> children;
+    // the CPU running it, or whose run queue it goes to
+    int      cpu = 0;
+    // the run queue or wait queue it is on, if any
+    Thread_queue* queue = nullptr;
+    thread_t* q_next = nullptr;
+    thread_t* q_prev = nullptr;
+    // the futex it waits on, while blocked
+    struct {
+      int*     addr   = nullptr;
+      uint32_t bitset = 0;
+      int32_t  timer  = -1;
+      // the CPU whose Timers the timer is on
+      int      timer_cpu = 0;
+      bool     timed_out = false;
+    } futex;
 
     void init(int tid);
     void yield();
@@ -32,9 +72,13 @@ namespace kernel
     void suspend(void* ret_instr, void* ret_stack);
     void activate(void* newtls);
     void resume();
+    /** Run on @cpu from now on, once it is switched out (or if ready) */
+    void migrate(int cpu);
   private:
+    void resume_from(bool* prev_on_cpu);
     void store_return(void* ret_instr, void* ret_stack);
     void libc_store_this();
+    friend void ::__thread_suspend_and_yield(void*, void*);
   };
 
   inline thread_t* get_thread()
@@ -61,6 +105,38 @@ namespace kernel
   thread_t* thread_create(thread_t* parent, int flags, void* ctid, void* stack) noexcept;
 
   void setup_main_thread() noexcept;
+
+  /**
+   * Block the current thread on @queue, running other threads until woken.
+   * The caller holds queue.lock, e.g. after checking a futex value, and it
+   * is released once the thread is queued. With no other thread to run,
+   * it waits for events in place.
+   **/
+  void thread_block(Thread_queue& queue);
+
+  /** Wake a thread blocked on its queue, with the queue locked by the caller */
+  void thread_wake(thread_t* thread);
+
+  /** The wait queue of the futex at @addr, shared with other addresses */
+  Thread_queue& futex_queue(const int* addr);
+
+  /**
+   * Block until woken through @addr, unless it no longer holds @val.
+   * Returns 0, -EAGAIN, -ETIMEDOUT or -EINVAL. While the timeout is
+   * pending the thread stays on its CPU, whose Timers it is on
+   **/
+  int futex_wait(int* addr, int val, uint32_t bitset,
+                 const std::chrono::nanoseconds* timeout = nullptr);
+
+  /** Wake threads waiting on the futex at @addr. Returns the number woken */
+  int futex_wake(int* addr, int count, uint32_t bitset = ~0u);
+
+  /** Wake @count waiters on @addr, and move up to @requeue others to @addr2 */
+  int futex_requeue(int* addr, int count, int* addr2, int requeue,
+                    const int* cmpval = nullptr);
+
+  /** Cancel the futex timeout of @thread, if on this CPU (or it fires unused) */
+  void futex_stop_timer(thread_t* thread);
 }
 
 extern "C" {
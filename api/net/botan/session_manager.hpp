@@ -0,0 +1,77 @@
+
+#pragma once
+#ifndef NET_TLS_SESSION_MANAGER_HPP
+#define NET_TLS_SESSION_MANAGER_HPP
+
+#include <botan/tls_session_manager.h>
+#include <net/https/session_cache.hpp>
+
+namespace net
+{
+namespace botan
+{
+/**
+ * Botan sessions, kept in a http::Session_cache shared by the
+ * connections of a server.
+ */
+class Session_manager : public Botan::TLS::Session_Manager
+{
+public:
+  explicit Session_manager(http::Session_cache& cache)
+    : m_cache{cache}
+  {}
+
+  bool load_from_session_id(const std::vector<uint8_t>& session_id,
+                            Botan::TLS::Session& session) override
+  {
+    const auto* blob = m_cache.find(session_id.data(), session_id.size());
+    if (blob == nullptr) return false;
+    try {
+      session = Botan::TLS::Session(blob->data(), blob->size());
+    }
+    catch (const std::exception&) {
+      m_cache.remove(session_id.data(), session_id.size());
+      return false;
+    }
+    // Botan doesn't tell if a handshake was resumed, so count it here
+    m_cache.count_resumption();
+    return true;
+  }
+
+  // client side only
+  bool load_from_server_info(const Botan::TLS::Server_Information&,
+                             Botan::TLS::Session&) override
+  { return false; }
+
+  void remove_entry(const std::vector<uint8_t>& session_id) override
+  {
+    m_cache.remove(session_id.data(), session_id.size());
+  }
+
+  size_t remove_all() override
+  {
+    const size_t count = m_cache.size();
+    m_cache.clear();
+    return count;
+  }
+
+  void save(const Botan::TLS::Session& session) override
+  {
+    const auto der = session.DER_encode();
+    const auto& id = session.session_id();
+    m_cache.store(id.data(), id.size(), {der.begin(), der.end()});
+  }
+
+  std::chrono::seconds session_lifetime() const override
+  {
+    return std::chrono::seconds(m_cache.lifetime());
+  }
+
+private:
+  http::Session_cache& m_cache;
+};
+
+} // botan
+} // net
+
+#endif
@@ -19,10 +19,11 @@ class Server : public Botan::TLS::Callbacks, public net::Stream
 public:
   Server(net::Stream_ptr remote,
          Botan::RandomNumberGenerator& rng,
-         Botan::Credentials_Manager& credman)
+         Botan::Credentials_Manager& credman,
+         Botan::TLS::Session_Manager* sessions = nullptr)
   : m_creds{credman},
     m_session_manager{},
-    m_tls{*this, m_session_manager, m_creds, m_policy, rng},
+    m_tls{*this, (sessions) ? *sessions : m_session_manager, m_creds, m_policy, rng},
     m_transport{std::move(remote)}
   {
     assert(m_transport->is_connected());
@@ -0,0 +1,250 @@
+
+#pragma once
+#ifndef NET_COROUTINE_HPP
+#define NET_COROUTINE_HPP
+
+#include <kernel/coroutine.hpp>
+#include <net/inet.hpp>
+#include <net/stream.hpp>
+#include <net/tcp/tcp.hpp>
+#include <deque>
+
+/**
+ * Awaitable network operations, see kernel/coroutine.hpp:
+ *
+ *   os::coro::Task<> echo(net::Stream& stream) {
+ *     net::coro::Reader reader{stream};
+ *     while (auto buf = co_await reader.read())
+ *       co_await reader.write(buf);
+ *   }
+ **/
+namespace net::coro
+{
+  using os::coro::Completion;
+
+  class Write;
+
+  /**
+   * Reads a stream from a coroutine. Data arriving while no one reads
+   * is kept for the next read.
+   * The stream must outlive the reader, unless closed first.
+   **/
+  class Reader {
+  public:
+    using buffer_t = Stream::buffer_t;
+
+    explicit Reader(Stream& stream, size_t n = 0)
+      : stream_{stream}
+    {
+      stream_.on_read(n, {this, &Reader::receive});
+      stream_.on_close({this, &Reader::closed});
+    }
+    ~Reader()
+    {
+      if (not closed_) {
+        stream_.on_read(0, nullptr);
+        stream_.on_close(nullptr);
+      }
+    }
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    /** The next data, or a nullptr buffer once the stream is closed */
+    auto read()
+    {
+      struct Read {
+        Reader& reader;
+        bool await_ready() const noexcept
+        { return not reader.queue_.empty() or reader.closed_; }
+        void await_suspend(std::coroutine_handle<> handle) noexcept
+        { reader.waiting_ = handle; }
+        buffer_t await_resume()
+        {
+          if (reader.queue_.empty()) return nullptr;
+          auto buf = std::move(reader.queue_.front());
+          reader.queue_.pop_front();
+          return buf;
+        }
+      };
+      return Read{*this};
+    }
+
+    bool is_closed() const noexcept
+    { return closed_; }
+
+    /** Write @buf to the stream, see coro::write() */
+    inline Write write(buffer_t buf);
+
+  private:
+    friend class Write;
+
+    void receive(buffer_t buf)
+    {
+      queue_.push_back(std::move(buf));
+      wake();
+    }
+    inline void closed();
+    void wake()
+    {
+      if (waiting_) std::exchange(waiting_, nullptr).resume();
+    }
+
+    Stream& stream_;
+    std::deque<buffer_t> queue_;
+    std::coroutine_handle<> waiting_ = nullptr;
+    Write* writing_ = nullptr;
+    bool closed_ = false;
+  };
+
+  /**
+   * Writes a buffer, giving the bytes written once all of them are, or
+   * fewer if the stream closes first (none if it isn't writable).
+   * The close callback of the stream is taken while writing, unless
+   * the stream is read by a Reader, which passes the close on.
+   **/
+  class Write : public Completion<Write, size_t> {
+  public:
+    Write(Stream& s, Stream::buffer_t b, Reader* r = nullptr)
+      : stream_{s}, buf_{std::move(b)}, reader_{r} {}
+
+    void start()
+    {
+      if (not stream_.is_writable() or (reader_ and reader_->closed_)) {
+        this->complete(0);
+        return;
+      }
+      if (reader_) reader_->writing_ = this;
+      else stream_.on_close({this, &Write::closed});
+      stream_.on_write({this, &Write::wrote});
+      stream_.write(buf_);
+    }
+
+  private:
+    friend class Reader;
+
+    void wrote(size_t n)
+    {
+      written_ += n;
+      if (written_ >= buf_->size()) finish();
+    }
+    void closed()
+    { finish(); }
+    void finish()
+    {
+      stream_.on_write(nullptr);
+      if (reader_ == nullptr) stream_.on_close(nullptr);
+      else if (reader_->writing_ == this) reader_->writing_ = nullptr;
+      this->complete(written_);
+    }
+
+    Stream& stream_;
+    Stream::buffer_t buf_;
+    Reader* reader_;
+    size_t written_ = 0;
+  };
+
+  inline Write Reader::write(buffer_t buf)
+  { return Write{stream_, std::move(buf), this}; }
+
+  inline void Reader::closed()
+  {
+    closed_ = true;
+    // either may end the coroutine owning the reader
+    auto* writing = std::exchange(writing_, nullptr);
+    auto waiting  = std::exchange(waiting_, nullptr);
+    if (writing) writing->closed();
+    if (waiting) waiting.resume();
+  }
+
+  /** Write @buf to a stream no Reader reads, see Write */
+  inline Write write(Stream& stream, Stream::buffer_t buf)
+  { return Write{stream, std::move(buf)}; }
+
+  /** Connect to @remote, giving a nullptr connection on failure */
+  inline auto connect(TCP& tcp, Socket remote)
+  {
+    struct Connect : Completion<Connect, tcp::Connection_ptr> {
+      TCP& tcp;
+      Socket remote;
+      Connect(TCP& t, Socket r) : tcp{t}, remote{r} {}
+
+      void start()
+      { tcp.connect(remote, {this, &Connect::done}); }
+      void done(tcp::Connection_ptr conn)
+      { this->complete(std::move(conn)); }
+    };
+    return Connect{tcp, remote};
+  }
+
+  /**
+   * Accepts the connections of a listener, one at a time. Connections
+   * arriving while no one accepts are kept for the next accept.
+   **/
+  class Acceptor {
+  public:
+    explicit Acceptor(tcp::Listener& listener)
+      : listener_{listener}
+    {
+      listener_.on_connect({this, &Acceptor::incoming});
+    }
+    ~Acceptor()
+    {
+      listener_.on_connect(nullptr);
+    }
+    Acceptor(const Acceptor&) = delete;
+    Acceptor& operator=(const Acceptor&) = delete;
+
+    auto accept()
+    {
+      struct Accept {
+        Acceptor& acceptor;
+        bool await_ready() const noexcept
+        { return not acceptor.queue_.empty(); }
+        void await_suspend(std::coroutine_handle<> handle) noexcept
+        { acceptor.waiting_ = handle; }
+        tcp::Connection_ptr await_resume()
+        {
+          auto conn = std::move(acceptor.queue_.front());
+          acceptor.queue_.pop_front();
+          return conn;
+        }
+      };
+      return Accept{*this};
+    }
+
+  private:
+    void incoming(tcp::Connection_ptr conn)
+    {
+      queue_.push_back(std::move(conn));
+      if (waiting_) std::exchange(waiting_, nullptr).resume();
+    }
+
+    tcp::Listener& listener_;
+    std::deque<tcp::Connection_ptr> queue_;
+    std::coroutine_handle<> waiting_ = nullptr;
+  };
+
+  /** Resolve @hostname, giving a 0-address when not found */
+  inline auto resolve(Inet& inet, std::string hostname)
+  {
+    struct Resolve : Completion<Resolve, Addr> {
+      Inet& inet;
+      std::string hostname;
+      Resolve(Inet& i, std::string h) : inet{i}, hostname{std::move(h)} {}
+
+      void start()
+      { inet.resolve(hostname, {this, &Resolve::done}); }
+      void done(dns::Response_ptr res, const Error& err)
+      {
+        if (res == nullptr or err)
+          this->complete(Addr{});
+        else
+          this->complete(res->get_first_addr());
+      }
+    };
+    return Resolve{inet, std::move(hostname)};
+  }
+
+} // net::coro
+
+#endif
@@ -0,0 +1,141 @@
+
+#pragma once
+#ifndef NET_DNS_CACHE_HPP
+#define NET_DNS_CACHE_HPP
+
+#include "response.hpp"
+#include <net/addr.hpp>
+#include <kernel/rtc.hpp>
+#include <unordered_map>
+
+namespace net::dns {
+
+  /**
+   * @brief      A cache of resolved addresses, by hostname and record type.
+   *
+   *             Entries live as long as the TTL of their records (capped by
+   *             the max TTL). Names that don't exist, or have no address of
+   *             the type, are cached as negative entries for the TTL given
+   *             by the SOA record of the answer (RFC 2308).
+   *
+   *             The addresses of an entry are packed into one buffer,
+   *             4 bytes for A records and 16 for AAAA.
+   */
+  class Cache
+  {
+  public:
+    using Hostname    = std::string;
+    using timestamp_t = RTC::timestamp_t;
+
+    static constexpr uint32_t DEFAULT_MAX_TTL          = 86400; // seconds
+    static constexpr uint32_t DEFAULT_MAX_NEGATIVE_TTL = 900;   // seconds
+
+    struct Entry
+    {
+      timestamp_t   expires;
+      uint32_t      ttl;   // when cached
+      uint32_t      hits;  // since cached
+      Record_type   rtype;
+      Response_code rcode;
+      std::vector<uint8_t> rdata;
+
+      /** Whether the name doesn't exist, or has no address of the type */
+      bool negative() const noexcept
+      { return rdata.empty(); }
+
+      size_t count() const noexcept
+      { return rdata.size() / addr_len(); }
+
+      net::Addr address(size_t i) const;
+
+      uint32_t ttl_left(timestamp_t now) const noexcept
+      { return (expires > now) ? expires - now : 0; }
+
+      size_t addr_len() const noexcept
+      { return (rtype == Record_type::AAAA) ? sizeof(ip6::Addr) : sizeof(ip4::Addr); }
+    };
+
+    /**
+     * @brief      Find an unexpired entry, counting the hit
+     *
+     * @param[in]  now   Seconds since boot
+     *
+     * @return     The entry, or nullptr
+     */
+    const Entry* lookup(const Hostname&, Record_type, timestamp_t now);
+
+    /**
+     * @brief      Cache the answer to a query
+     *
+     * @param[in]  hostname  The name asked for
+     * @param[in]  rtype     The type asked for (A or AAAA)
+     * @param[in]  res       The response
+     * @param[in]  now       Seconds since boot
+     *
+     * @return     The entry, or nullptr if the answer can't be cached
+     *             (server failure, or a negative answer without SOA)
+     */
+    const Entry* insert(const Hostname& hostname, Record_type rtype,
+                        const Response& res, timestamp_t now);
+
+    /**
+     * @brief      Whether an entry is hit close to expiring (the last tenth
+     *             of its TTL), and should be refreshed before it does.
+     */
+    static bool should_prefetch(const Entry& entry, timestamp_t now) noexcept
+    { return entry.hits > 1 and entry.ttl_left(now) * 10 <= entry.ttl; }
+
+    /**
+     * @brief      A response made from an entry, with its remaining TTL
+     */
+    static Response_ptr make_response(const Hostname&, const Entry&, timestamp_t now);
+
+    /** Remove the expired entries */
+    void flush_expired(timestamp_t now);
+
+    void clear()
+    { entries_.clear(); }
+
+    size_t size() const noexcept
+    { return entries_.size(); }
+
+    bool empty() const noexcept
+    { return entries_.empty(); }
+
+    void set_max_ttl(uint32_t seconds) noexcept
+    { max_ttl_ = seconds; }
+
+    uint32_t max_ttl() const noexcept
+    { return max_ttl_; }
+
+    void set_max_negative_ttl(uint32_t seconds) noexcept
+    { max_negative_ttl_ = seconds; }
+
+    uint32_t max_negative_ttl() const noexcept
+    { return max_negative_ttl_; }
+
+  private:
+    struct Key
+    {
+      Hostname    name; // lower case
+      Record_type rtype;
+
+      bool operator==(const Key& other) const noexcept
+      { return rtype == other.rtype and name == other.name; }
+    };
+    struct Key_hash
+    {
+      size_t operator()(const Key& key) const noexcept
+      { return std::hash<Hostname>{}(key.name) ^ static_cast<size_t>(key.rtype); }
+    };
+
+    std::unordered_map<Key, Entry, Key_hash> entries_;
+    uint32_t max_ttl_          = DEFAULT_MAX_TTL;
+    uint32_t max_negative_ttl_ = DEFAULT_MAX_NEGATIVE_TTL;
+
+    static Key make_key(const Hostname&, Record_type);
+  };
+
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include <util/timer.hpp>
 #include <map>
 #include <unordered_map>
+#include "cache.hpp"
 #include "query.hpp"
 #include "response.hpp"
 
@@ -17,11 +18,17 @@ namespace net
 }
 namespace net::dns {
   /**
-   * @brief      A simple DNS client which is able to resolve hostnames
+   * @brief      A DNS client which is able to resolve hostnames
    *             and locally cache them.
    *
-   * @note       A entry can stay longer than TTL due to flush timer granularity.
-   *             Max_TTL = TTL + FLUSH_INTERVAL (90s default)
+   *             Answers are cached for the TTL of their records, and names
+   *             not found for the TTL of the SOA record (negative caching).
+   *             Entries still asked for when about to expire are refreshed
+   *             in the background (prefetch).
+   *
+   *             Concurrent requests for the same name share one query.
+   *             With more nameservers, the one answering the fastest is
+   *             asked first, and the next ones when it doesn't answer.
    */
   class Client
   {
@@ -31,24 +38,29 @@ namespace net::dns {
     using Address         = net::Addr;
     using Hostname        = std::string;
     using timestamp_t     = RTC::timestamp_t;
+    using Cache           = dns::Cache;
+
     /**
-     * @brief      A simple cache entry containing the resolved IP address
-     *             and a timestamp when it expires (based on uptime)
+     * @brief      A nameserver, and how fast it has answered
      */
-    struct Cache_entry
+    struct Nameserver
     {
-      Address     address;
-      timestamp_t expires;
+      Address  address;
+      // smoothed response time, zero until measured
+      std::chrono::microseconds srtt{0};
+      uint32_t timeouts = 0;
 
-      Cache_entry(Address addr, const timestamp_t exp) noexcept
-        : address{std::move(addr)}, expires{exp}
+      Nameserver(Address addr) noexcept
+        : address{std::move(addr)}
       {}
     };
-    using Cache           = std::unordered_map<Hostname, Cache_entry>;
+    using Nameservers     = std::vector<Nameserver>;
 
     static Timer::duration_t DEFAULT_RESOLVE_TIMEOUT; // 5s, client.cpp
-    static Timer::duration_t DEFAULT_FLUSH_INTERVAL; // 60s, client.cpp
-    static std::chrono::seconds DEFAULT_CACHE_TTL; // 60s, client.cpp
+    static Timer::duration_t DEFAULT_FLUSH_INTERVAL; // 30s, client.cpp
+    static std::chrono::seconds DEFAULT_CACHE_TTL; // 1 day, client.cpp
+    /** Nameservers asked for one name before giving up */
+    static constexpr size_t MAX_ATTEMPTS = 3;
 
     /**
      * @brief      Construct a DNS client on a given interface (stack),
@@ -89,6 +101,41 @@ namespace net::dns {
       resolve(dns_server, std::move(hostname), std::move(handler), DEFAULT_RESOLVE_TIMEOUT, force);
     }
 
+    /**
+     * @brief      Resolve a hostname for addresses of a type (A or AAAA),
+     *             asking the added nameservers, the fastest first.
+     *
+     * @param[in]  hostname  The hostname to resolve
+     * @param[in]  rtype     The record type
+     * @param[in]  handler   The resolve handler
+     * @param[in]  timeout   The time before the request times out
+     * @param[in]  force     Wether to force the resolve, ignoring the cache
+     */
+    void resolve(Hostname           hostname,
+                 Record_type        rtype,
+                 Resolve_handler    handler,
+                 Timer::duration_t  timeout,
+                 bool               force = false);
+
+    void resolve(Hostname           hostname,
+                 Record_type        rtype,
+                 Resolve_handler    handler,
+                 bool               force = false)
+    {
+      resolve(std::move(hostname), rtype, std::move(handler), DEFAULT_RESOLVE_TIMEOUT, force);
+    }
+
+    /**
+     * @brief      Add a nameserver to ask, when resolving without a server
+     */
+    void add_nameserver(Address server);
+
+    void clear_nameservers()
+    { nameservers_.clear(); }
+
+    const Nameservers& nameservers() const noexcept
+    { return nameservers_; }
+
     /**
      * @brief      Flush the cache, removing all entries.
      */
@@ -103,7 +150,7 @@ namespace net::dns {
     { return cache_; }
 
     /**
-     * @brief      Returns the time to live value of an entry in the cache.
+     * @brief      Returns the max time to live of an entry in the cache.
      *
      * @return     Time to live in seconds
      */
@@ -111,13 +158,17 @@ namespace net::dns {
     { return cache_ttl_; }
 
     /**
-     * @brief      Sets the time to live for a cache entry
+     * @brief      Sets the max time to live for a cache entry, shortening
+     *             the TTL of records living longer.
      *             A value of zero means caching is disabled.
      *
      * @param[in]  ttl   The ttl in seconds
      */
     void set_cache_ttl(std::chrono::seconds ttl)
-    { cache_ttl_ = ttl; }
+    {
+      cache_ttl_ = ttl;
+      cache_.set_max_ttl(ttl.count());
+    }
 
     /**
      * @brief      Disables caching
@@ -128,11 +179,17 @@ namespace net::dns {
     /**
      * @brief      Enables caching
      *
-     * @param[in]  ttl   The ttl for a cache entry (optional)
+     * @param[in]  ttl   The max ttl for a cache entry (optional)
      */
     void enable_cache(std::chrono::seconds ttl = DEFAULT_CACHE_TTL)
     { set_cache_ttl(ttl); }
 
+    /**
+     * @brief      Whether to refresh cache entries in use before they expire
+     */
+    void set_prefetch(bool enabled) noexcept
+    { prefetch_ = enabled; }
+
     static bool is_FQDN(const std::string& hostname)
     { return hostname.find('.') != std::string::npos; }
 
@@ -141,26 +198,42 @@ namespace net::dns {
     Cache                 cache_;
     std::chrono::seconds  cache_ttl_;
     Timer                 flush_timer_;
+    Nameservers           nameservers_;
+    bool                  prefetch_ = true;
+
+    bool caching() const noexcept
+    { return cache_ttl_ > std::chrono::seconds::zero(); }
 
     /**
-     * @brief      Receive a UDP message with a (hopefully) DNS response
-     *             to one of our requests.
+     * @brief      Answer from the cache, or join or send a request
      *
-     * @param[in]  <unnamed>  From whom address
-     * @param[in]  <unnamed>  From whom port
-     * @param[in]  data       The raw data containing the msg
-     * @param[in]  <unnamed>  Size of the data
+     * @param[in]  servers  The servers to ask, in order
      */
-    void receive_response(Address, udp::port_t, const char* data, size_t);
+    void query(Hostname hostname, Record_type rtype, std::vector<Address> servers,
+               Resolve_handler handler, Timer::duration_t timeout, bool force);
 
     /**
-     * @brief      Adds a cache entry.
-     *
-     * @param[in]  hostname  The hostname
-     * @param[in]  addr      The address
-     * @param[in]  ttl       The ttl
+     * @brief      Send a request, unless one for the name is pending.
+     *             Without a handler, only the cache is updated.
+     */
+    void send_request(Hostname hostname, Record_type rtype, std::vector<Address> servers,
+                      Resolve_handler handler, Timer::duration_t timeout);
+
+    /**
+     * @brief      The nameservers to ask, the fastest first.
      */
-    void add_cache_entry(const Hostname& hostname, Address addr, std::chrono::seconds ttl);
+    std::vector<Address> fastest_nameservers() const;
+
+    /**
+     * @brief      Update the response time of a nameserver
+     */
+    void nameserver_answered(const Address& server, std::chrono::microseconds rtt);
+    void nameserver_timed_out(const Address& server, Timer::duration_t timeout);
+
+    /**
+     * @brief      Cache the response to a request
+     */
+    void add_cache_entry(const Hostname& hostname, Record_type rtype, const Response& res);
 
     /**
      * @brief      Flush all expired cache entries.
@@ -178,7 +251,7 @@ namespace net::dns {
 
     /**
      * @brief      An internal client request. Contains the DNS request itself,
-     *             the callback to be called when resolved (or timedout) and
+     *             the callbacks to be called when resolved (or timedout) and
      *             a timeout timer.
      */
     struct Request
@@ -191,12 +264,20 @@ namespace net::dns {
 
       udp::Socket&    socket;
 
-      Resolve_handler callback;
+      // everyone waiting for the name, none when prefetching
+      std::vector<Resolve_handler> callbacks;
       Timer           timer;
 
-      Request(Client& cli, udp::Socket& sock, dns::Query q, Resolve_handler cb);
+      // the servers to ask, one after another on timeout
+      std::vector<Address> servers;
+      size_t            attempt = 0;
+      Timer::duration_t attempt_timeout;
+      RTC::timestamp_t  sent = 0;
 
-      void resolve(Address server, Timer::duration_t timeout);
+      Request(Client& cli, udp::Socket& sock, dns::Query q,
+              std::vector<Address> servers, Timer::duration_t timeout);
+
+      void resolve();
 
       ~Request();
 
@@ -208,7 +289,7 @@ namespace net::dns {
 
       /**
        * @brief      Finish the request with a no error,
-       *             invoking the resolve handler (callback)
+       *             invoking the resolve handlers (callbacks)
        */
       void finish(const Error& err);
 
@@ -219,6 +300,10 @@ namespace net::dns {
     using Requests = std::unordered_map<dns::id_t, Request>;
     /** Pending requests (not yet resolved) */
     Requests requests_;
+    /** Pending requests by name and type, for joining them */
+    std::unordered_map<std::string, dns::id_t> pending_;
+
+    static std::string pending_key(const Hostname&, Record_type);
   };
 }
 
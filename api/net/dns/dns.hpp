@@ -71,6 +71,7 @@ namespace net::dns {
     A     = 1,
     NS    = 2,
     ALIAS = 5,
+    SOA   = 6,
     AAAA  = 28
   };
 
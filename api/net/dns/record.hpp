@@ -29,5 +29,8 @@ namespace net::dns {
 
     bool is_addr() const
     { return rtype == Record_type::A or rtype == Record_type::AAAA; }
+
+    /** The MINIMUM field of a SOA record, the TTL of negative answers (RFC 2308) */
+    uint32_t soa_minimum() const;
   };
 }
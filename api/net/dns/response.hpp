@@ -18,6 +18,7 @@ namespace net::dns {
     std::vector<Record> answers;
     std::vector<Record> auth;
     std::vector<Record> addit;
+    Response_code rcode = Response_code::NO_ERROR;
 
     ip4::Addr get_first_ipv4() const;
     ip6::Addr get_first_ipv6() const;
@@ -10,8 +10,6 @@ namespace net {
 namespace ethernet {
 /**
  * @brief      IEEE 802.1Q header
- *
- *             Currently no support for Double tagging.
  */
 struct VLAN_header {
   MAC::Addr dest;
@@ -28,6 +26,33 @@ struct VLAN_header {
 
 }__attribute__((packed));
 
+/**
+ * @brief      IEEE 802.1ad (QinQ) header, a service tag (S-tag)
+ *             followed by a customer tag (C-tag).
+ */
+struct QinQ_header {
+  MAC::Addr dest;
+  MAC::Addr src;
+  uint16_t  s_tpid;
+  uint16_t  s_tci;
+  uint16_t  c_tpid;
+  uint16_t  c_tci;
+  Ethertype type;
+
+  int svid() const
+  { return ntohs(this->s_tci) & 0xFFF; }
+
+  int cvid() const
+  { return ntohs(this->c_tci) & 0xFFF; }
+
+  void set_svid(int id)
+  { s_tci = htons(id & 0xFFF); }
+
+  void set_cvid(int id)
+  { c_tci = htons(id & 0xFFF); }
+
+}__attribute__((packed));
+
 } // < namespace ethernet
 
 /**
@@ -45,19 +70,27 @@ public:
    *
    * @param[in]  phys_down  The physical down
    * @param[in]  mac        The mac addr
-   * @param[in]  id         The VLAN id
+   * @param[in]  id         The VLAN id (C-VID when double tagged)
+   * @param[in]  outer_id   The service VLAN id (S-VID) for 802.1ad,
+   *                        0 for a single tagged interface
    */
-  explicit Ethernet_8021Q(downstream phys_down, const addr& mac, const int id) noexcept;
+  explicit Ethernet_8021Q(downstream phys_down, const addr& mac,
+                          const int id, const int outer_id = 0) noexcept;
 
   void receive(Packet_ptr pkt);
 
   void transmit(Packet_ptr pkt, addr dest, Ethertype type);
 
-  static constexpr uint16_t header_size() noexcept
-  { return sizeof(ethernet::VLAN_header); }
+  /** Size of the header, with one tag or two when double tagged */
+  uint16_t header_size() const noexcept
+  { return outer_id_ ? sizeof(ethernet::QinQ_header) : sizeof(ethernet::VLAN_header); }
+
+  int outer_id() const noexcept
+  { return outer_id_; }
 
 private:
   const int id_;
+  const int outer_id_;
 };
 
 } // < namespace net
@@ -16,6 +16,7 @@ namespace net {
     FLOW          = 0x888,
     JUMBO         = 0x7088,
     VLAN          = 0x81,
+    QINQ          = 0xa888,   // IEEE 802.1ad Service VLAN tag
     TRAILER_NEGO  = 0x0010,   // RFC 893 Trailer negotiation
     TRAILER_FIRST = 0x0110,   // RFC 893, 1122 Trailer encapsulation
     TRAILER_LAST  = 0x0f10
@@ -8,8 +8,11 @@
 
 #include <net/tcp/tcp.hpp>
 #include <net/inet>
+#include <rtc>
+#include <deque>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 namespace http {
 
@@ -28,13 +31,25 @@ namespace http {
     struct Options;
     using Request_handler     = delegate<void(Request&, Options&, const Host)>;
 
+    /** Connections are pooled by host and port, and whether they are secured */
+    struct Origin {
+      Host host;
+      bool secure;
+
+      bool operator<(const Origin& other) const noexcept
+      { return host < other.host or (host == other.host and secure < other.secure); }
+    };
+
     using Connection_set      = std::vector<std::unique_ptr<Client_connection>>;
-    using Connection_mapset   = std::map<Host, Connection_set>;
+    using Connection_mapset   = std::map<Origin, Connection_set>;
 
     using timeout_duration    = Client_connection::timeout_duration;
 
     const static timeout_duration     DEFAULT_TIMEOUT; // client.cpp, 5s
+    const static timeout_duration     DEFAULT_IDLE_TIMEOUT; // 30s
+    const static std::chrono::seconds DEFAULT_DNS_TTL; // 60s
     static int                        default_follow_redirect; // 0
+    static size_t                     default_max_connections; // 6
 
     /* Client Options */
     // aggregate initialization would make this pretty (c++20):
@@ -49,6 +64,7 @@ namespace http {
 
   private:
     using ResolveCallback = net::Inet::resolve_func;
+    using Resolve_handler = delegate<void(net::Addr)>;
 
   public:
     explicit Basic_client(TCP& tcp, Request_handler on_send = nullptr);
@@ -175,6 +191,82 @@ namespace http {
     std::string origin() const
     { return tcp_.stack().ip_addr().to_string(); }
 
+    /**
+     * @brief      Whether connections are kept open and reused after
+     *             a response (default). If not, every request is sent
+     *             on a new connection with "Connection: close".
+     *
+     * @param[in]  keep_alive  Keep connections open
+     */
+    void set_keep_alive(const bool keep_alive) noexcept
+    { keep_alive_ = keep_alive; }
+
+    bool keep_alive() const noexcept
+    { return keep_alive_; }
+
+    /**
+     * @brief      Set the max number of connections open to the same host.
+     *             Requests sent while all of them are busy are queued,
+     *             and sent on the first connection to become available.
+     *             The request timeout includes the time spent waiting.
+     *
+     * @param[in]  max   The max number of connections per host (> 0)
+     */
+    void set_max_connections(const size_t max)
+    {
+      Expects(max > 0);
+      max_conns_ = max;
+    }
+
+    /**
+     * @brief      Set how long a connection is kept open waiting for a
+     *             new request, zero meaning until the server closes it.
+     *
+     * @param[in]  timeout  The idle timeout
+     */
+    void set_idle_timeout(const timeout_duration timeout) noexcept
+    { idle_timeout_ = timeout; }
+
+    /**
+     * @brief      Set for how long a resolved address is reused. Shorter
+     *             TTLs from the DNS records are respected. Zero disables
+     *             the cache.
+     *
+     * @param[in]  ttl   The max time to live for a cache entry
+     */
+    void set_dns_ttl(const std::chrono::seconds ttl) noexcept
+    { dns_ttl_ = ttl; }
+
+    /**
+     * @brief      Remove all resolved addresses from the cache.
+     */
+    void flush_dns_cache()
+    { dns_cache_.clear(); }
+
+    /**
+     * @brief      Returns the number of connections open to a host
+     *
+     * @param[in]  host    The host
+     * @param[in]  secure  Whether to count secured connections
+     */
+    size_t connection_count(const Host host, const bool secure = false) const
+    {
+      auto it = conns_.find({host, secure});
+      return (it != conns_.end()) ? it->second.size() : 0;
+    }
+
+    /**
+     * @brief      Returns the number of requests waiting for a connection to a host
+     *
+     * @param[in]  host    The host
+     * @param[in]  secure  Whether to count requests waiting for a secured connection
+     */
+    size_t queued_count(const Host host, const bool secure = false) const
+    {
+      auto it = queued_.find({host, secure});
+      return (it != queued_.end()) ? it->second.size() : 0;
+    }
+
     virtual ~Basic_client() = default;
 
   protected:
@@ -183,15 +275,48 @@ namespace http {
 
     explicit Basic_client(TCP& tcp, Request_handler on_send, const bool https_supported);
 
-    virtual Client_connection& get_secure_connection(const Host host);
+    /**
+     * @brief      Open a secured stream to the host.
+     */
+    virtual Connection::Stream_ptr connect_secure(const Host host);
+
+    /**
+     * @brief      Called when a response has been received on a connection,
+     *             before it's reused. Lets a TLS client keep the session
+     *             to resume it on new connections.
+     */
+    virtual void store_session(Client_connection&) {}
 
   private:
     friend class Client_connection;
+
+    /** A request waiting for a connection */
+    struct Queued_request {
+      Request_ptr       req;
+      Response_handler  cb;
+      Options           options;
+      uint64_t          expires; // nanoseconds since boot, 0 for never
+    };
+    using Request_queue = std::deque<Queued_request>;
+
+    /** A resolved address, and the time since boot it expires */
+    struct Dns_entry {
+      net::Addr         addr;
+      RTC::timestamp_t  expires;
+    };
+
     Request_handler   on_send_;
-    bool              keep_alive_ = false;
+    bool              keep_alive_ = true;
     const bool        supports_https;
+    size_t            max_conns_;
+    timeout_duration  idle_timeout_;
+    std::chrono::seconds  dns_ttl_;
+    std::map<Origin, Request_queue>             queued_;
+    Timer                                       queue_timer_;
+    std::unordered_map<std::string, Dns_entry>  dns_cache_;
 
-    void resolve(const std::string& host, ResolveCallback);
+    /** Resolve host, using the cache if possible. Called with addr_any if not found */
+    void resolve(const std::string& host, Resolve_handler);
 
     void set_connection_header(Request& req) const
     {
@@ -205,7 +330,25 @@ namespace http {
     /** Add data and content length */
     void add_data(Request&, const std::string& data);
 
-    Client_connection& get_connection(const Host host);
+    /**
+     * @brief      Get a connection to the host which isn't busy, opening a
+     *             new one if there are less than max connections.
+     *
+     * @return     The connection, or nullptr if the request has to wait
+     */
+    Client_connection* get_connection(const Host host, const bool secure);
+
+    /** Send queued requests to the host on available connections */
+    void send_queued(const Origin& origin);
+
+    /** Fail queued requests which have waited for too long */
+    void timeout_queued();
+
+    /** Time out the queued request which expires first */
+    void arm_queue_timer();
+
+    /** A response has been received on a connection kept alive */
+    void reuse(Client_connection&);
 
     void close(Client_connection&);
 
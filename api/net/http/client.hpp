@@ -4,7 +4,7 @@
 #define NET_HTTP_CLIENT_HPP
 
 #include <net/http/basic_client.hpp>
-#include <openssl/ossl_typ.h>
+#include <openssl/ssl.h>
 
 namespace http {
 
@@ -12,10 +12,16 @@ namespace http {
   public:
     explicit Client(TCP& tcp, SSL_CTX* ssl_ctx, Request_handler on_send = nullptr);
 
+    ~Client();
+
   private:
     SSL_CTX* ssl_context;
+    /** The last session with each host, resumed by new connections */
+    std::map<Host, SSL_SESSION*> sessions_;
+
+    virtual Connection::Stream_ptr connect_secure(const Host host) override;
 
-    virtual Client_connection& get_secure_connection(const Host host) override;
+    virtual void store_session(Client_connection&) override;
 
   }; // < class Client
 
@@ -20,16 +20,28 @@ namespace http {
     using timeout_duration  = std::chrono::milliseconds;
 
   public:
-    explicit Client_connection(Basic_client&, Stream_ptr);
+    explicit Client_connection(Basic_client&, Stream_ptr, bool secure = false);
+
+    /** Whether the stream is secured, as requested when opened */
+    bool secure() const noexcept
+    { return secure_; }
 
     bool available() const
-    { return on_response_ == nullptr && keep_alive_; }
+    { return on_response_ == nullptr && keep_alive_ && !released() && !stream_->is_closing(); }
 
     bool occupied() const
     { return !available(); }
 
     void send(Request_ptr, Response_handler, int redirects, timeout_duration = timeout_duration::zero());
 
+    /**
+     * @brief      Wait for a new request, shutting down the connection
+     *             if none is sent within the timeout.
+     *
+     * @param[in]  timeout  The idle timeout, zero to wait forever
+     */
+    void idle(timeout_duration timeout);
+
   private:
     Basic_client&     client_;
     Request_ptr       req_;
@@ -38,6 +50,7 @@ namespace http {
     Timer             timer_;
     timeout_duration  timeout_dur_;
     int               redirect_;
+    const bool        secure_;
 
     void send_request();
 
@@ -46,7 +59,12 @@ namespace http {
     void end_response(Error err = Error::NONE);
 
     void timeout_request()
-    { end_response(Error::TIMEOUT); }
+    {
+      if(on_response_ != nullptr)
+        end_response(Error::TIMEOUT);
+      else // idle for too long
+        shutdown();
+    }
 
     bool can_redirect(const Response_ptr&) const;
 
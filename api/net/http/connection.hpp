@@ -73,6 +73,67 @@ namespace http {
 
     void end();
 
+    /**
+     * @brief      Reserve a place in the order responses are sent in.
+     *             Connections serving pipelined requests hand out
+     *             increasing numbers, one per response.
+     *
+     * @return     The sequence number of the response
+     */
+    virtual uint32_t begin_response()
+    { return 0; }
+
+    /**
+     * @brief      Write (part of) a response. May be held back until
+     *             the responses before it have been ended.
+     *
+     * @param[in]  seq   The sequence number from begin_response
+     * @param[in]  buf   The data
+     */
+    virtual void write_response(uint32_t, buffer_t buf)
+    { stream_->write(std::move(buf)); }
+
+    /**
+     * @brief      Write the status line and header of a response, followed
+     *             by the start of its body (if any) in the same write.
+     *
+     * @param[in]  seq   The sequence number from begin_response
+     * @param[in]  res   The response
+     * @param[in]  body  The start of the body
+     * @param[in]  len   The length of the body part
+     */
+    inline virtual void write_response_head(uint32_t seq, const Response& res,
+                                            const uint8_t* body, size_t len);
+
+    /** Returns false once it no longer wants to be called */
+    using Written_handler = delegate<bool(size_t)>;
+
+    /**
+     * @brief      Have a handler called with the number of bytes written by
+     *             the stream, to write a large body a part at a time instead
+     *             of queueing it all at once. It is called until it returns
+     *             false, or the connection is closed.
+     *
+     * @param[in]  handler  The handler
+     */
+    virtual void on_written(Written_handler handler)
+    {
+      // the only one, as the stream takes a single callback
+      auto ptr = std::make_shared<Written_handler>(std::move(handler));
+      stream_->on_write([ptr] (size_t n) {
+        if(*ptr and not (*ptr)(n))
+          *ptr = nullptr;
+      });
+    }
+
+    /**
+     * @brief      Mark a response as complete.
+     *
+     * @param[in]  seq   The sequence number from begin_response
+     */
+    virtual void end_response(uint32_t)
+    { end(); }
+
     /* Delete copy constructor */
     Connection(const Connection&)             = delete;
 
@@ -132,6 +193,32 @@ namespace http {
     return copy;
   }
 
+  inline void Connection::write_response_head(uint32_t seq, const Response& res,
+                                              const uint8_t* body, size_t len)
+  {
+    const auto status = res.status_line();
+    size_t size = status.size() + 4 + len;
+    for(const auto& field : res.header())
+      size += field.first.size() + field.second.size() + 4;
+
+    auto buf = Stream::construct_buffer();
+    buf->reserve(size);
+    buf->insert(buf->end(), status.begin(), status.end());
+    buf->insert(buf->end(), {'\r', '\n'});
+    for(const auto& field : res.header())
+    {
+      buf->insert(buf->end(), field.first.begin(), field.first.end());
+      buf->insert(buf->end(), {':', ' '});
+      buf->insert(buf->end(), field.second.begin(), field.second.end());
+      buf->insert(buf->end(), {'\r', '\n'});
+    }
+    if(not res.header().is_empty())
+      buf->insert(buf->end(), {'\r', '\n'});
+    if(len)
+      buf->insert(buf->end(), body, body + len);
+    write_response(seq, std::move(buf));
+  }
+
   inline void Connection::end()
   {
     if(released())
@@ -5,11 +5,13 @@
 #include <algorithm>
 #include <cctype>
 #include <cstring>
+#include <iterator>
 #include <ostream>
 #include <type_traits>
 
 #include "common.hpp"
 #include "header_fields.hpp"
+#include "request_parser.hpp"
 
 #include "../../util/detail/string_view"
 
@@ -166,12 +168,97 @@ public:
   ///
   bool set_content_length(const size_t len);
 
+  ///
+  /// Refer to fields parsed out of a message head instead of
+  /// copying each of them
+  ///
+  /// The fields are copied into the set on the first change
+  ///
+  /// @param head   The parsed data the fields refer into, kept
+  /// alive by the header
+  /// @param fields The fields
+  ///
+  void borrow(std::shared_ptr<const std::string> head,
+              std::vector<Field_view> fields) noexcept;
+
+  ///
+  /// Iterator over the fields, giving views of the name and value
+  /// of each, whether borrowed or not
+  ///
+  class Const_field_iterator {
+  public:
+    using value_type        = std::pair<util::sview, util::sview>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = void;
+    using reference         = value_type;
+    using iterator_category = std::forward_iterator_tag;
+
+    Const_field_iterator(const Header& header, const std::size_t index) noexcept
+      : header_{&header}, index_{index}
+    {}
+
+    value_type operator*() const noexcept {
+      const auto& borrowed = header_->borrowed_;
+      if (index_ < borrowed.size())
+        return {borrowed[index_].name, borrowed[index_].value};
+      const auto& field = header_->fields_[index_ - borrowed.size()];
+      return {field.first, field.second};
+    }
+
+    Const_field_iterator& operator++() noexcept
+    { ++index_; return *this; }
+
+    Const_field_iterator operator++(int) noexcept
+    { auto it = *this; ++index_; return it; }
+
+    bool operator==(const Const_field_iterator& other) const noexcept
+    { return index_ == other.index_; }
+
+    bool operator!=(const Const_field_iterator& other) const noexcept
+    { return index_ != other.index_; }
+
+  private:
+    const Header* header_;
+    std::size_t   index_;
+  };
+
+  ///
+  /// Iterate over the fields in the order they were added, reading
+  /// borrowed fields in place
+  ///
+  Const_field_iterator begin() const noexcept
+  { return {*this, 0}; }
+
+  Const_field_iterator end() const noexcept
+  { return {*this, size()}; }
+
 private:
   ///
   /// Class data members
   ///
   Header_set fields_;
 
+  ///
+  /// Borrowed fields, views into {head_}. Only one of {fields_}
+  /// and {borrowed_} holds fields at a time
+  ///
+  std::shared_ptr<const std::string> head_;
+  std::vector<Field_view>            borrowed_;
+
+  ///
+  /// Copy the borrowed fields into the set
+  ///
+  void own();
+
+  ///
+  /// Find a borrowed field
+  ///
+  /// @param field The field name to locate
+  ///
+  /// @return Pointer to the field, nullptr if absent
+  ///
+  const Field_view* find_borrowed(util::csview field) const noexcept;
+
   ///
   /// Find the location of a field within the set
   ///
@@ -196,7 +283,11 @@ private:
 template<typename Char, typename Char_traits>
 std::basic_ostream<Char, Char_traits>& operator<<(std::basic_ostream<Char, Char_traits>& output_device, const Header& header) {
   if (not header.is_empty()) {
-    for (const auto field : header.fields_) {
+    for (const auto& field : header.borrowed_) {
+      output_device << field.name  << ": "
+                    << field.value << "\r\n";
+    }
+    for (const auto& field : header.fields_) {
       output_device << field.first  << ": "
                     << field.second << "\r\n";
     }
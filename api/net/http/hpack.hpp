@@ -0,0 +1,212 @@
+
+#ifndef HTTP_HPACK_HPP
+#define HTTP_HPACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../util/detail/string_view"
+
+namespace http {
+namespace hpack {
+
+///
+/// A header field as stored by the tables (lowercase name, value)
+///
+using Field = std::pair<std::string, std::string>;
+
+///
+/// Default SETTINGS_HEADER_TABLE_SIZE (RFC 7540 6.5.2)
+///
+static constexpr std::size_t DEFAULT_TABLE_SIZE = 4096;
+
+///
+/// The dynamic table of RFC 7541 2.3.2
+///
+/// Newest entry first. Entries are evicted from the end
+/// when the size (RFC 7541 4.1) would exceed the max size
+///
+class Dynamic_table {
+public:
+  explicit Dynamic_table(const std::size_t max_size = DEFAULT_TABLE_SIZE)
+    : max_size_{max_size}
+  {}
+
+  ///
+  /// Add an entry, evicting old ones to make room
+  ///
+  void insert(std::string name, std::string value);
+
+  ///
+  /// Get an entry
+  ///
+  /// @param index 0 for the newest entry
+  ///
+  const Field& at(const std::size_t index) const
+  { return entries_.at(index); }
+
+  ///
+  /// Change the max size, evicting entries not fitting
+  ///
+  void set_max_size(const std::size_t max_size);
+
+  std::size_t count() const noexcept
+  { return entries_.size(); }
+
+  std::size_t size() const noexcept
+  { return size_; }
+
+  std::size_t max_size() const noexcept
+  { return max_size_; }
+
+  ///
+  /// The size an entry counts as (RFC 7541 4.1)
+  ///
+  static std::size_t entry_size(util::csview name, util::csview value) noexcept
+  { return name.size() + value.size() + 32; }
+
+private:
+  std::deque<Field> entries_;
+  std::size_t       size_ {0};
+  std::size_t       max_size_;
+
+  void evict(const std::size_t max) noexcept;
+}; //< class Dynamic_table
+
+///
+/// Decodes header blocks (RFC 7541 3)
+///
+/// One decoder per connection, as the dynamic table is
+/// shared by all header blocks received on it
+///
+class Decoder {
+public:
+  ///
+  /// Constructor
+  ///
+  /// @param max_table_size The table size advertised in our SETTINGS
+  /// @param max_list_size  Max decoded size of a header list
+  ///
+  explicit Decoder(const std::size_t max_table_size = DEFAULT_TABLE_SIZE,
+                   const std::size_t max_list_size  = 16384)
+    : table_{max_table_size},
+      max_table_size_{max_table_size},
+      max_list_size_{max_list_size}
+  {}
+
+  ///
+  /// Decode a complete header block
+  ///
+  /// @param block  The header block (all fragments of it)
+  /// @param fields Where the decoded fields are appended
+  ///
+  /// @return false on a decoding error, which is a connection
+  /// error (COMPRESSION_ERROR)
+  ///
+  bool decode(util::csview block, std::vector<Field>& fields);
+
+  const Dynamic_table& table() const noexcept
+  { return table_; }
+
+private:
+  Dynamic_table     table_;
+  const std::size_t max_table_size_;
+  const std::size_t max_list_size_;
+
+  bool lookup(const uint64_t index, util::sview& name, util::sview& value) const noexcept;
+}; //< class Decoder
+
+///
+/// Encodes header blocks (RFC 7541 6)
+///
+/// Fields found in the static or dynamic table are sent as an index,
+/// others are added to the dynamic table unless sensitive or large
+///
+class Encoder {
+public:
+  explicit Encoder(const std::size_t max_table_size = DEFAULT_TABLE_SIZE)
+    : table_{max_table_size}
+  {}
+
+  ///
+  /// Encode a field, appending it to a header block
+  ///
+  /// @param name  The name, must be lowercase
+  /// @param value The value
+  /// @param out   The header block
+  ///
+  void encode(util::csview name, util::csview value, std::string& out);
+
+  ///
+  /// Apply the table size from the peer's SETTINGS. The change is
+  /// signalled at the start of the next header block
+  ///
+  void set_max_table_size(const std::size_t size);
+
+  const Dynamic_table& table() const noexcept
+  { return table_; }
+
+private:
+  Dynamic_table table_;
+  bool          size_update_ {false};
+}; //< class Encoder
+
+///
+/// Encode an integer with an N-bit prefix (RFC 7541 5.1)
+///
+/// @param value  The integer
+/// @param prefix The number of bits in the prefix
+/// @param flags  The bits preceding the prefix in the first octet
+/// @param out    Where it is appended
+///
+void encode_integer(uint64_t value, const int prefix, const uint8_t flags, std::string& out);
+
+///
+/// Decode an integer with an N-bit prefix (RFC 7541 5.1)
+///
+/// @return false if malformed or incomplete
+///
+bool decode_integer(const uint8_t*& p, const uint8_t* end, const int prefix, uint64_t& value) noexcept;
+
+///
+/// Encode a string literal (RFC 7541 5.2), Huffman coded if shorter
+///
+void encode_string(util::csview str, std::string& out);
+
+///
+/// Decode a string literal (RFC 7541 5.2)
+///
+/// @return false if malformed or incomplete
+///
+bool decode_string(const uint8_t*& p, const uint8_t* end, std::string& str);
+
+namespace huffman {
+
+///
+/// The length of a string once Huffman coded
+///
+std::size_t encoded_length(util::csview str) noexcept;
+
+///
+/// Huffman code a string (RFC 7541 5.2, Appendix B)
+///
+void encode(util::csview str, std::string& out);
+
+///
+/// Decode a Huffman coded string
+///
+/// @return false if malformed: EOS in the string, or padding
+/// longer than 7 bits or not all ones
+///
+bool decode(const uint8_t* data, const std::size_t len, std::string& out);
+
+} //< namespace huffman
+
+} //< namespace hpack
+} //< namespace http
+
+#endif //< HTTP_HPACK_HPP
@@ -0,0 +1,298 @@
+
+#ifndef HTTP_HTTP2_HPP
+#define HTTP_HTTP2_HPP
+
+#include <cstdint>
+#include <delegate>
+#include <map>
+#include <string>
+
+#include <net/stream.hpp>
+
+#include "hpack.hpp"
+#include "request.hpp"
+#include "response.hpp"
+
+namespace http {
+namespace h2 {
+
+///
+/// The connection preface sent by clients (RFC 7540 3.5)
+///
+static constexpr util::csview PREFACE {"PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24};
+
+///
+/// The protocol identifier negotiated with ALPN over TLS
+///
+static constexpr util::csview ALPN_ID {"h2"};
+
+///
+/// Check if data starts with the connection preface
+///
+/// @return 1 if it does, 0 if data is a (too short) prefix
+/// of it, -1 otherwise
+///
+int match_preface(util::csview data) noexcept;
+
+enum class Frame_type : uint8_t {
+  DATA          = 0x0,
+  HEADERS       = 0x1,
+  PRIORITY      = 0x2,
+  RST_STREAM    = 0x3,
+  SETTINGS      = 0x4,
+  PUSH_PROMISE  = 0x5,
+  PING          = 0x6,
+  GOAWAY        = 0x7,
+  WINDOW_UPDATE = 0x8,
+  CONTINUATION  = 0x9
+};
+
+namespace flag {
+  static constexpr uint8_t END_STREAM  = 0x1;
+  static constexpr uint8_t ACK         = 0x1;
+  static constexpr uint8_t END_HEADERS = 0x4;
+  static constexpr uint8_t PADDED      = 0x8;
+  static constexpr uint8_t PRIORITY    = 0x20;
+}
+
+enum class Error_code : uint32_t {
+  NO_ERROR            = 0x0,
+  PROTOCOL_ERROR      = 0x1,
+  INTERNAL_ERROR      = 0x2,
+  FLOW_CONTROL_ERROR  = 0x3,
+  SETTINGS_TIMEOUT    = 0x4,
+  STREAM_CLOSED       = 0x5,
+  FRAME_SIZE_ERROR    = 0x6,
+  REFUSED_STREAM      = 0x7,
+  CANCEL              = 0x8,
+  COMPRESSION_ERROR   = 0x9,
+  CONNECT_ERROR       = 0xa,
+  ENHANCE_YOUR_CALM   = 0xb,
+  INADEQUATE_SECURITY = 0xc,
+  HTTP_1_1_REQUIRED   = 0xd
+};
+
+///
+/// The header of every frame (RFC 7540 4.1)
+///
+struct Frame_header {
+  static constexpr std::size_t SIZE = 9;
+
+  uint32_t   length;
+  Frame_type type;
+  uint8_t    flags;
+  uint32_t   stream_id;
+
+  static Frame_header parse(const uint8_t* data) noexcept;
+
+  void serialize(uint8_t* data) const noexcept;
+};
+
+///
+/// SETTINGS parameters (RFC 7540 6.5.2)
+///
+struct Settings {
+  enum Id : uint16_t {
+    HEADER_TABLE_SIZE      = 0x1,
+    ENABLE_PUSH            = 0x2,
+    MAX_CONCURRENT_STREAMS = 0x3,
+    INITIAL_WINDOW_SIZE    = 0x4,
+    MAX_FRAME_SIZE         = 0x5,
+    MAX_HEADER_LIST_SIZE   = 0x6
+  };
+
+  static constexpr uint32_t DEFAULT_WINDOW_SIZE = 65535;
+  static constexpr uint32_t MIN_FRAME_SIZE      = 16384;
+  static constexpr uint32_t MAX_WINDOW_SIZE     = 0x7fffffff;
+
+  uint32_t header_table_size      = 4096;
+  uint32_t enable_push            = 0;
+  uint32_t max_concurrent_streams = 100;
+  uint32_t initial_window_size    = DEFAULT_WINDOW_SIZE;
+  uint32_t max_frame_size         = MIN_FRAME_SIZE;
+  uint32_t max_header_list_size   = 16384;
+};
+
+///
+/// Server side of a HTTP/2 connection (RFC 7540)
+///
+/// Turns received bytes into requests, and responses into frames.
+/// It doesn't know about the transport: output is handed to a
+/// delegate, which makes it usable over any net::Stream (TLS with
+/// ALPN "h2", or cleartext with prior knowledge)
+///
+/// Flow control is applied to response bodies, queueing DATA until
+/// the peer opens its windows. Queued data is sent in weighted round
+/// robin over the streams, by the weight from HEADERS and PRIORITY,
+/// and a stream waits for the stream it depends on to be drained
+///
+/// Frames produced while handling received data are collected
+/// and handed over in a single write
+///
+class Session {
+public:
+  using buffer_t        = net::Stream::buffer_t;
+  using Write_handler   = delegate<void(buffer_t)>;
+  using Request_handler = delegate<void(uint32_t stream_id, Request_ptr)>;
+
+  ///
+  /// Constructor. Queues the server preface (our SETTINGS), and opens
+/// the connection window as wide as the initial window of a stream
+  ///
+  /// @param on_write   Called with data to send to the client
+  /// @param on_request Called when a request is complete
+  /// @param settings   Our settings
+  ///
+  Session(Write_handler on_write, Request_handler on_request,
+          const Settings& settings = {});
+
+  ///
+  /// Process data received, starting with the client preface
+  ///
+  /// @return false if the connection failed and must be closed.
+  /// A GOAWAY has been sent
+  ///
+  bool receive(util::csview data);
+
+  ///
+  /// Send the status and header of a response
+  ///
+  /// @param end_stream Whether the response is complete, without a body.
+  /// Otherwise the stream ends when a body of the Content-Length has
+  /// been sent, or on end_stream()
+  ///
+  void send_headers(const uint32_t stream_id, const Response& res,
+                    const bool end_stream = false);
+
+  ///
+  /// Send (part of) the body of a response. What the flow control
+  /// windows allow is framed at once, only the rest is copied
+  ///
+  void send_data(const uint32_t stream_id, const uint8_t* data, std::size_t len);
+
+  ///
+  /// End a response, if not already ended by its body
+  ///
+  void end_stream(const uint32_t stream_id);
+
+  ///
+  /// Gracefully close the connection, letting open streams finish
+  ///
+  void shutdown();
+
+  ///
+  /// The highest stream id received
+  ///
+  uint32_t last_stream_id() const noexcept
+  { return last_stream_id_; }
+
+  ///
+  /// Number of streams not closed
+  ///
+  std::size_t open_streams() const noexcept
+  { return streams_.size(); }
+
+  ///
+  /// Whether the connection failed or a GOAWAY has been exchanged
+  ///
+  bool closing() const noexcept
+  { return goaway_sent_ or goaway_received_; }
+
+  const Settings& peer_settings() const noexcept
+  { return peer_; }
+
+  ///
+  /// Connection level send window
+  ///
+  int64_t send_window() const noexcept
+  { return send_window_; }
+
+private:
+  struct Stream {
+    Request_ptr request;
+    std::string pending;          // body waiting for flow control
+    std::size_t content_left {0}; // of the Content-Length, if any
+    int64_t     send_window;
+    uint32_t    recv_consumed {0};
+    uint32_t    depends_on {0};
+    int32_t     deficit {0};
+    uint16_t    weight {16};
+    bool        remote_closed {false};
+    bool        local_closed {false};
+    bool        end_pending {false};
+    bool        has_length {false};
+  };
+
+  Write_handler   on_write_;
+  Request_handler on_request_;
+  const Settings  local_;
+  Settings        peer_;
+
+  hpack::Decoder  decoder_;
+  hpack::Encoder  encoder_;
+
+  std::map<uint32_t, Stream> streams_;
+  std::string     in_;            // partial frame
+  buffer_t        out_;           // frames not yet written
+  std::string     header_block_;  // HEADERS + CONTINUATION fragments
+  uint32_t        header_stream_ {0};
+  uint8_t         header_flags_ {0};
+
+  uint32_t        last_stream_id_ {0};
+  int64_t         send_window_ {Settings::DEFAULT_WINDOW_SIZE};
+  const uint32_t  recv_window_;   // connection level, as large as a stream's
+  uint32_t        recv_consumed_ {0};
+  bool            preface_received_ {false};
+  bool            settings_received_ {false};
+  bool            goaway_sent_ {false};
+  bool            goaway_received_ {false};
+  bool            failed_ {false};
+  bool            receiving_ {false};
+
+  /** Handle one frame, returns false on connection error */
+  bool handle_frame(const Frame_header&, const uint8_t* payload);
+
+  bool handle_data(const Frame_header&, const uint8_t* payload);
+  bool handle_headers(const Frame_header&, const uint8_t* payload);
+  bool handle_continuation(const Frame_header&, const uint8_t* payload);
+  bool handle_priority(const Frame_header&, const uint8_t* payload);
+  bool handle_rst_stream(const Frame_header&, const uint8_t* payload);
+  bool handle_settings(const Frame_header&, const uint8_t* payload);
+  bool handle_ping(const Frame_header&, const uint8_t* payload);
+  bool handle_goaway(const Frame_header&, const uint8_t* payload);
+  bool handle_window_update(const Frame_header&, const uint8_t* payload);
+
+  /** Decode a complete header block */
+  bool end_headers();
+
+  /** Build a request from decoded fields, nullptr if malformed */
+  static Request_ptr make_request(std::vector<hpack::Field>& fields);
+
+  void set_priority(const uint32_t stream_id, const uint8_t* data) noexcept;
+
+  /** Send queued response bodies the flow control windows allow */
+  void send_pending();
+
+  /** Whether a stream it depends on, however far up, has data to send first */
+  bool blocked(const Stream&) const noexcept;
+
+  void send_frame(Frame_type, uint8_t flags, uint32_t stream_id,
+                  const void* payload, std::size_t len);
+  void send_settings();
+  void send_window_update(const uint32_t stream_id, const uint32_t increment);
+  void reset_stream(const uint32_t stream_id, const Error_code);
+
+  /** Connection error: send GOAWAY, always returns false */
+  bool connection_error(const Error_code);
+
+  /** Close the local end of a stream, removing it if both are closed */
+  void close_local(std::map<uint32_t, Stream>::iterator);
+
+  /** Hand the frames produced over to the transport */
+  void flush();
+}; //< class Session
+
+} //< namespace h2
+} //< namespace http
+
+#endif //< HTTP_HTTP2_HPP
@@ -6,6 +6,7 @@
 
 #include "message.hpp"
 #include "methods.hpp"
+#include "request_parser.hpp"
 #include "version.hpp"
 
 namespace http {
@@ -45,6 +46,20 @@ public:
   ///
   explicit Request(std::string request, const std::size_t limit = 25, const bool parse = true);
 
+  ///
+  /// Constructor to construct a request message from
+  /// a request head parsed by {Request_parser}
+  ///
+  /// The fields are copied in one block, which the header refers
+  /// into, so the request outlives the parsed data
+  ///
+  /// @param head The parsed request-line and header fields
+  ///
+  /// @param limit Capacity of how many fields can
+  /// be added
+  ///
+  explicit Request(const Request_view& head, const std::size_t limit = 25);
+
   ///
   /// Default copy constructor
   ///
@@ -0,0 +1,192 @@
+
+#ifndef HTTP_REQUEST_PARSER_HPP
+#define HTTP_REQUEST_PARSER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include "../../util/detail/string_view"
+
+namespace http {
+
+///
+/// Bump allocator holding everything parsed out of one message
+///
+/// Owned by a connection and reset for every new message, so
+/// parsing does not touch the heap once the arena is created
+///
+class Arena {
+public:
+  ///
+  /// Constructor to specify the size of the arena
+  ///
+  /// @param size The amount of bytes available
+  ///
+  explicit Arena(const std::size_t size = 4096);
+
+  Arena(const Arena&) = delete;
+  Arena& operator = (const Arena&) = delete;
+
+  ///
+  /// Allocate uninitialized memory from the arena
+  ///
+  /// @param size  The amount of bytes
+  /// @param align The alignment
+  ///
+  /// @return Pointer to the memory, nullptr if the arena is exhausted
+  ///
+  void* allocate(const std::size_t size, const std::size_t align) noexcept;
+
+  ///
+  /// Allocate an uninitialized array of trivial objects
+  ///
+  /// @param n The number of objects
+  ///
+  /// @return Pointer to the first object, nullptr if the arena is exhausted
+  ///
+  template <typename T>
+  T* make_array(const std::size_t n) noexcept;
+
+  ///
+  /// Release everything allocated from the arena
+  ///
+  void reset() noexcept
+  { used_ = 0; }
+
+  ///
+  /// Release everything allocated after a previous call to {used}
+  ///
+  /// @param mark The amount of bytes used to go back to
+  ///
+  void rewind(const std::size_t mark) noexcept
+  { if (mark < used_) used_ = mark; }
+
+  std::size_t used() const noexcept
+  { return used_; }
+
+  std::size_t capacity() const noexcept
+  { return size_; }
+
+private:
+  std::unique_ptr<char[]> data_;
+  const std::size_t       size_;
+  std::size_t             used_ {0};
+}; //< class Arena
+
+///
+/// A header field referring into the parsed data
+///
+struct Field_view {
+  util::sview name;
+  util::sview value;
+};
+
+///
+/// A parsed request head. Every view refers into the data given
+/// to the parser, and the fields into the arena, so both must
+/// outlive it
+///
+struct Request_view {
+  util::sview  method;
+  util::sview  target;
+  uint8_t      major {1};
+  uint8_t      minor {1};
+  Field_view*  fields {nullptr};
+  std::size_t  num_fields {0};
+  ///
+  /// Length of the request-line and header section, including
+  /// the empty line ending it. The body (if any) starts here
+  ///
+  std::size_t  header_length {0};
+  std::size_t  content_length {0};
+  bool         chunked {false};
+  bool         keep_alive {true};
+
+  ///
+  /// Get the value of a field (case-insensitive lookup)
+  ///
+  /// @param name The field name
+  ///
+  /// @return The value of the first field with the name, empty
+  /// view otherwise
+  ///
+  util::sview value(util::csview name) const noexcept;
+
+  const Field_view* begin() const noexcept
+  { return fields; }
+
+  const Field_view* end() const noexcept
+  { return fields + num_fields; }
+}; //< struct Request_view
+
+///
+/// Zero-copy HTTP/1.x request head parser
+///
+/// Parses the request-line and header fields in a single pass,
+/// scanning for delimiters with SIMD where available. Nothing is
+/// copied: the result is a set of views into the input
+///
+class Request_parser {
+public:
+  ///
+  /// The header section is not complete yet, call again with more data
+  ///
+  static constexpr int incomplete = -2;
+
+  ///
+  /// The request is malformed
+  ///
+  static constexpr int invalid = -1;
+
+  ///
+  /// Constructor
+  ///
+  /// @param arena      Where parsed fields are stored
+  /// @param max_fields Max number of header fields accepted
+  ///
+  explicit Request_parser(Arena& arena, const std::size_t max_fields = 64) noexcept
+    : arena_{arena}, max_fields_{max_fields}
+  {}
+
+  ///
+  /// Parse a request head found at the start of data
+  ///
+  /// The arena is not reset, allowing several requests to be
+  /// parsed into it (pipelining)
+  ///
+  /// @param data    The received data
+  /// @param request The parsed request
+  ///
+  /// @return The length of the head (Request_view::header_length),
+  /// or {incomplete} / {invalid}
+  ///
+  int parse(util::csview data, Request_view& request) noexcept;
+
+private:
+  Arena&            arena_;
+  const std::size_t max_fields_;
+
+  int parse_head(util::csview data, Request_view& request) noexcept;
+}; //< class Request_parser
+
+///
+/// Case-insensitive comparison of header field names
+///
+bool field_equals(util::csview a, util::csview b) noexcept;
+
+/**--v----------- Implementation Details -----------v--**/
+
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline T* Arena::make_array(const std::size_t n) noexcept {
+  static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+  return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+}
+
+/**--^----------- Implementation Details -----------^--**/
+
+} //< namespace http
+
+#endif //< HTTP_REQUEST_PARSER_HPP
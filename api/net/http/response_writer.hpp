@@ -22,11 +22,18 @@ namespace http {
 
   /**
    * @brief      Helper for writing a HTTP Response on a connection.
+   *
+   *             The status line and header are sent together with the
+   *             first part of the body in a single write, so a small
+   *             response leaves in one segment.
    */
   class Response_writer {
   public:
     using buffer_t  = net::tcp::buffer_t;
 
+    /** Max size of a shared buffer copied in behind the header */
+    static constexpr size_t COALESCE_LIMIT = 8192;
+
   public:
     Response_writer(Response_ptr res, Connection&);
 
@@ -53,6 +60,17 @@ namespace http {
      */
     void write(net::tcp::buffer_t buffer);
 
+    /**
+     * @brief      Writes the status line + header with the given code,
+     *             together with the first chunk of the body.
+     *
+     * @throws     Response_writer_error when the header is already sent
+     *
+     * @param[in]  code    The code
+     * @param[in]  buffer  The first chunk of shared data
+     */
+    void write(status_t code, net::tcp::buffer_t buffer);
+
     /**
      * @brief      Writes the status line + header to the underlying connection
      *
@@ -94,7 +112,9 @@ namespace http {
   private:
     Response_ptr  response_;
     Connection&   connection_;
+    uint32_t      seq_;
     bool          header_sent_{false};
+    bool          ended_{false};
 
     /**
      * @brief      Preprocessing of a write
@@ -105,6 +125,20 @@ namespace http {
      */
     void pre_write(size_t len);
 
+    /**
+     * @brief      Write the status line + header, followed by the start of the body
+     *
+     * @throws     Response_writer_error when trying to do it more than once
+     *
+     * @param[in]  code  The code
+     * @param[in]  body  The start of the body
+     * @param[in]  len   The length of the body part
+     */
+    void write_head(status_t code, const uint8_t* body, size_t len);
+
+    void send(buffer_t buf)
+    { connection_.write_response(seq_, std::move(buf)); }
+
   }; // < class Response_writer
 
 } // < namespace http
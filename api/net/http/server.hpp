@@ -18,6 +18,9 @@ namespace http {
   // Used in HTTP server - invoked when a Request is received
   using Request_handler   = delegate<void(Request_ptr, Response_writer_ptr)>;
 
+  // Used in HTTP server - invoked with the parsed head of a Request without a body
+  using Request_view_handler = delegate<void(const Request_view&, Response_writer_ptr)>;
+
   /**
    * @brief      A simple HTTP server.
    */
@@ -61,6 +64,17 @@ namespace http {
     void on_request(Request_handler handler)
     { on_request_ = std::move(handler); }
 
+    /**
+     * @brief      Setup handler for requests without a body, given the head
+     *             as parsed, in place: nothing is copied or allocated for it.
+     *             The view is only valid during the call, construct a Request
+     *             from it to keep it. Requests with a body still go to on_request.
+     *
+     * @param[in]  handler    A Request_view_handler
+     */
+    void on_request_view(Request_view_handler handler)
+    { on_request_view_ = std::move(handler); }
+
     /**
      * @brief      Returns number of connected clients
      *
@@ -117,6 +131,7 @@ namespace http {
     friend class Server_connection;
 
     Request_handler on_request_;
+    Request_view_handler on_request_view_;
     Connection_set  connections_;
     Index_set       free_idx_;
     bool            keep_alive_;
@@ -152,6 +167,14 @@ namespace http {
      */
     void receive(Request_ptr, status_t code, Server_connection&);
 
+    /**
+     * @brief      Receive the parsed head of a request without a body,
+     *             if there is a handler for it
+     *
+     * @return     false if it is to be made a Request for on_request
+     */
+    bool receive(const Request_view&, Server_connection&);
+
   }; // < class Server
 
   /**
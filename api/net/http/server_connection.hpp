@@ -5,22 +5,61 @@
 
 // http
 #include "connection.hpp"
+#include "http2.hpp"
+#include "request_parser.hpp"
 
 #include <rtc>
+#include <deque>
+#include <vector>
 
 namespace http {
 
   class Server;
 
+  /**
+   * @brief      A connection accepted by a Server.
+   *
+   *             Requests pipelined by the client (RFC 7230 6.3.2) are parsed
+   *             out of a read one after another. Their responses may be
+   *             written in any order, but are held back until the ones
+   *             before them have ended, so they leave in request order.
+   *
+   *             A connection starting with the HTTP/2 preface (negotiated
+   *             with ALPN over TLS, or by prior knowledge) is handed to a
+   *             h2::Session, and its requests are multiplexed as streams.
+   */
   class Server_connection : public Connection {
   public:
     static constexpr size_t DEFAULT_BUFSIZE = 1460;
+    /** Max size of a request-line and header section */
+    static constexpr size_t MAX_HEAD_SIZE   = 8192;
+    /** Size of the arena holding the parsed header fields */
+    static constexpr size_t ARENA_SIZE      = 2048;
 
   public:
     explicit Server_connection(Server&, Stream_ptr, size_t idx, const size_t bufsize = DEFAULT_BUFSIZE);
 
     void send(Response_ptr res);
 
+    uint32_t begin_response() override;
+
+    void write_response(uint32_t seq, buffer_t buf) override;
+
+    void end_response(uint32_t seq) override;
+
+    void write_response_head(uint32_t seq, const Response& res,
+                             const uint8_t* body, size_t len) override;
+
+    void on_written(Written_handler handler) override;
+
+    /** Whether the connection speaks HTTP/2 */
+    bool is_http2() const noexcept
+    { return h2_ != nullptr; }
+
+    /** Number of responses not yet ended */
+    size_t pending_responses() const noexcept
+    { return pending_.size(); }
+
     size_t idx() const noexcept
     { return idx_; }
 
@@ -32,11 +71,58 @@ namespace http {
     Request_ptr       req_;
     size_t            idx_;
     RTC::timestamp_t  idle_since_;
+    Arena             arena_;
+    std::string       head_; // partial request head
+    size_t            body_left_ {0};
+
+    /** A response waiting for the ones before it */
+    struct Pending {
+      std::vector<buffer_t> bufs;
+      bool                  ended {false};
+    };
+    std::deque<Pending> pending_;
+    uint32_t            first_seq_ {0}; // seq of pending_.front()
+    bool                receiving_ {false}; // handling a read
+    bool                close_pending_ {false};
+    bool                failed_ {false}; // a request couldn't be parsed
+
+    /** Handlers of written bytes, done ones removed when not called back */
+    struct Written {
+      Written_handler handler;
+      bool            done {false};
+    };
+    std::vector<Written> written_;
+    int                 written_depth_ {0}; // calls to written() in progress
+
+    std::unique_ptr<h2::Session> h2_;
+    uint32_t            h2_stream_ {0}; // stream of the request being handled
 
     void recv_request(buffer_t);
 
+    /** Pass received data to HTTP/2, or parse requests out of it */
+    void receive_data(util::sview data);
+
+    /** Parse as many requests as there are in data */
+    void parse_requests(util::sview data);
+
+    /** Send the responses at the front which have ended */
+    void flush_responses();
+
+    /** Switch to HTTP/2, data starting with the preface */
+    void start_http2(util::csview data);
+
+    void h2_write(buffer_t buf);
+
+    /** The stream has written @n bytes */
+    void written(size_t n);
+
+    void h2_request(uint32_t stream_id, Request_ptr req);
+
     void end_request(status_t code = http::OK);
 
+    /** Answer a request that couldn't be parsed, and stop parsing */
+    void bad_request();
+
     void close() override;
 
     void update_idle()
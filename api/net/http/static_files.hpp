@@ -0,0 +1,203 @@
+
+#pragma once
+#ifndef HTTP_STATIC_FILES_HPP
+#define HTTP_STATIC_FILES_HPP
+
+// http
+#include "request.hpp"
+#include "response_writer.hpp"
+
+#include <fs/dirent.hpp>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace http {
+
+  /**
+   * @brief      Serves files below a directory (FAT, memdisk, ...).
+   *
+   *             Files are read once and kept as ready-to-send buffers,
+   *             together with the header fields derived from them (ETag,
+   *             Content-Type and Content-Length), so a request only costs
+   *             a lookup: the buffers are handed to the connection as they
+   *             are, without being copied.
+   *
+   *             A file is kept in chunks of CHUNK_SIZE, which lets a range
+   *             be sent mostly from shared chunks as well. The least recently
+   *             requested files are dropped to make room for new ones. Files
+   *             larger than the file limit, or the cache, are read from the
+   *             file system on every request, a part at a time as the
+   *             connection writes the parts before it.
+   *
+   *             Precompressed variants next to a file (index.html.br and
+   *             index.html.gz) are sent to clients accepting them.
+   *             Conditional requests (If-None-Match) and single byte
+   *             ranges (Range, If-Range) are supported.
+   */
+  class Static_files {
+  public:
+    using buffer_t = net::tcp::buffer_t;
+
+    static constexpr size_t CHUNK_SIZE          = 64 * 1024;
+    static constexpr size_t DEFAULT_CACHE_LIMIT = 16 * 1024 * 1024;
+    static constexpr size_t DEFAULT_FILE_LIMIT  = 1024 * 1024;
+    /** Parts of a file read from disk, queued on a connection at most */
+    static constexpr size_t READS_IN_FLIGHT     = 4;
+
+    /** A byte range [first, last] */
+    struct Byte_range {
+      uint64_t first;
+      uint64_t last;
+
+      uint64_t length() const noexcept
+      { return last - first + 1; }
+    };
+
+    /** Content codings of precompressed variants, by preference */
+    enum Encoding : uint8_t {
+      BROTLI,
+      GZIP,
+      IDENTITY
+    };
+
+  public:
+    /**
+     * @brief      Construct a file server for a directory
+     *
+     * @param[in]  root         The directory served as "/"
+     * @param[in]  cache_limit  Max memory used, by the files and what is
+     *                          known about them
+     * @param[in]  file_limit   Max size of a single file kept in memory
+     */
+    explicit Static_files(fs::Dirent root,
+                          size_t cache_limit = DEFAULT_CACHE_LIMIT,
+                          size_t file_limit  = DEFAULT_FILE_LIMIT);
+
+    /**
+     * @brief      Serve the file at the path of a GET or HEAD request.
+     *             A path ending in '/' serves index.html in that directory.
+     *
+     * @param[in]  req   The request
+     * @param      res   The response writer, untouched if false is returned.
+     *                   Taken while a file is read from disk.
+     *
+     * @return     false if there is no such file, or the method isn't GET or HEAD
+     */
+    bool serve(const Request& req, Response_writer_ptr& res);
+
+    /**
+     * @brief      Read all files below the root into the cache, until it's full.
+     */
+    void preload();
+
+    /**
+     * @brief      Forget everything known about the files, to be used
+     *             when they have changed.
+     */
+    void clear()
+    {
+      files_.clear();
+      lru_.clear();
+      cached_bytes_ = 0;
+      used_bytes_   = 0;
+    }
+
+    /**
+     * @brief      Total size of the files kept in memory
+     */
+    size_t cached_bytes() const noexcept
+    { return cached_bytes_; }
+
+    /**
+     * @brief      Memory used by the cache, counted against its limit
+     */
+    size_t used_bytes() const noexcept
+    { return used_bytes_; }
+
+    /**
+     * @brief      Size of the parts a file is read from disk in
+     *             (CHUNK_SIZE by default)
+     */
+    void set_read_size(size_t bytes)
+    { Expects(bytes > 0); read_size_ = bytes; }
+
+    /**
+     * @brief      Parse the value of a Range header for a file of a given size.
+     *             Only a single range is understood.
+     *
+     * @param[in]  value  The value of the Range header
+     * @param[in]  size   The size of the file
+     * @param      range  The range, limited to the size of the file
+     *
+     * @return     1 if a valid range, 0 if it should be ignored (serve the whole file),
+     *             -1 if not satisfiable
+     */
+    static int parse_range(util::csview value, uint64_t size, Byte_range& range) noexcept;
+
+    /**
+     * @brief      Check if an entity tag is in the value of If-None-Match.
+     *             Uses weak comparison.
+     */
+    static bool etag_matches(util::csview value, util::csview etag) noexcept;
+
+    /**
+     * @brief      Whether a content coding is accepted by the value of Accept-Encoding
+     *             (not listed, or listed with q=0, means not accepted)
+     */
+    static bool accepts_encoding(util::csview value, util::csview coding) noexcept;
+
+  private:
+    /** A file on disk, and its content if kept in memory */
+    struct File {
+      fs::Dirent            dirent;
+      std::string           etag;
+      std::string           length;     // Content-Length
+      std::vector<buffer_t> chunks;     // empty if not cached
+
+      explicit File(fs::Dirent ent);
+    };
+
+    /** A path served, the file and its precompressed variants */
+    struct Entry {
+      std::optional<File>   variants[IDENTITY + 1];
+      util::sview           mime;
+      std::list<std::string>::iterator lru; // its path in lru_
+      size_t                bytes {0};      // counted in used_bytes_
+    };
+
+    /** A file read from disk, as the connection writes it */
+    struct Transfer;
+
+    fs::Dirent    root_;
+    const size_t  cache_limit_;
+    const size_t  file_limit_;
+    size_t        read_size_    {CHUNK_SIZE};
+    size_t        cached_bytes_ {0};
+    size_t        used_bytes_   {0};
+    std::unordered_map<std::string, Entry> files_;
+    std::list<std::string> lru_; // most recently used first
+
+    /**
+     * Get the entry for a path, stat'ing the file the first time.
+     * With make_room, less recently used entries are dropped for it
+     */
+    Entry* lookup(const std::string& path, bool make_room = true);
+
+    /** Keep the content of a file in memory, if it fits */
+    void load(File&, bool make_room);
+
+    /** Drop the least recently used entry */
+    void evict();
+
+    /** Write part of a file, from the cached chunks or from disk */
+    void write_range(Response_writer_ptr&, File&, status_t code, Byte_range);
+
+    void preload(const std::string& path, fs::Dirent dir);
+
+  }; // < class Static_files
+
+} // < namespace http
+
+#endif // < HTTP_STATIC_FILES_HPP
@@ -6,6 +6,7 @@
 #include <net/http/server.hpp>
 #include <fs/dirent.hpp>
 #include <net/botan/tls_server.hpp>
+#include <net/botan/session_manager.hpp>
 
 namespace http {
 
@@ -67,9 +68,20 @@ public:
       fs::Dirent& ca_cert,
       fs::Dirent& server_key);
 
+  /**
+   * @brief      The TLS sessions shared by all connections, for clients
+   *             to resume. Serialize it to keep them over LiveUpdate.
+   *             Session tickets are protected by the "session-ticket" PSK
+   *             of the credentials manager.
+   */
+  Session_cache& session_cache() noexcept
+  { return sessions_; }
+
 private:
   Botan::RandomNumberGenerator& rng;
   std::unique_ptr<Botan::Credentials_Manager> credman;
+  Session_cache sessions_;
+  net::botan::Session_manager session_manager_;
 
   /**
    * @brief      Binds TCP to pass all new connections to this on_connect.
@@ -103,7 +115,9 @@ inline Botan_server::Botan_server(
     net::TCP&   tcp,
     Server_args&&... server_args)
   : Server{tcp, std::forward<Server>(server_args)...},
-    rng(get_rng())
+    rng(get_rng()),
+    sessions_{tcp.stack().ifname() + ".https_server"},
+    session_manager_{sessions_}
 {
   load_credentials(name, ca_key, ca_cert, server_key);
 }
@@ -115,7 +129,9 @@ inline Botan_server::Botan_server(
     net::TCP& tcp,
     Server_args&&... server_args)
   : Server{tcp, std::forward(server_args)...},
-    rng(in_rng), credman(in_credman)
+    rng(in_rng), credman(in_credman),
+    sessions_{tcp.stack().ifname() + ".https_server"},
+    session_manager_{sessions_}
 {
   assert(credman != nullptr);
 }
@@ -4,6 +4,7 @@
 #define NET_HTTP_OPENSSL_SERVER_HPP
 
 #include <net/http/server.hpp>
+#include <net/https/session_cache.hpp>
 
 namespace http {
 
@@ -32,7 +33,25 @@ public:
 
   virtual ~OpenSSL_server();
 
+  /**
+   * @brief      The TLS sessions (and ticket keys) shared by all connections,
+   *             for clients to resume. Serialize it to keep them over LiveUpdate.
+   */
+  Session_cache& session_cache() noexcept
+  { return sessions_; }
+
+  /**
+   * @brief      Run the handshakes of new connections on the other CPUs
+   *             (SMP), leaving this one to process packets. Off by default,
+   *             as the handshakes then share the CPUs with the services
+   *             running there.
+   */
+  void offload_handshakes(bool enabled) noexcept
+  { offload_handshakes_ = enabled; }
+
 private:
+  Session_cache sessions_;
+  bool offload_handshakes_ = false;
   void* m_ctx = nullptr;
 
   void openssl_initialize(const std::string&, const std::string&);
@@ -46,7 +65,8 @@ inline OpenSSL_server::OpenSSL_server(
     const std::string& ca_cert,
     net::TCP&  tcp,
     Args&&...  server_args)
-  : Server{tcp, std::forward<Server>(server_args)...}
+  : Server{tcp, std::forward<Server>(server_args)...},
+    sessions_{tcp.stack().ifname() + ".https_server"}
 {
   openssl_initialize(ca_key, ca_cert);
 }
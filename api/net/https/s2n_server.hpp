@@ -4,6 +4,7 @@
 #define NET_HTTP_S2N_SERVER_HPP
 
 #include <net/http/server.hpp>
+#include <net/https/session_cache.hpp>
 
 namespace http {
 
@@ -22,10 +23,19 @@ public:
 
   virtual ~S2N_server();
 
+  /**
+   * @brief      The TLS sessions (and ticket keys) shared by all connections,
+   *             for clients to resume. Serialize it to keep them over LiveUpdate.
+   */
+  Session_cache& session_cache() noexcept
+  { return sessions_; }
+
 private:
+  Session_cache sessions_;
   void* m_config = nullptr;
 
   void initialize(const std::string&, const std::string&);
+  void add_ticket_key(const Session_cache::Ticket_key&);
   void bind(const uint16_t port) override;
   void on_connect(TCP_conn conn) override;
 };
@@ -36,7 +46,8 @@ inline S2N_server::S2N_server(
     const std::string& ca_cert,
     net::TCP&  tcp,
     Args&&...  server_args)
-  : Server{tcp, std::forward<Server>(server_args)...}
+  : Server{tcp, std::forward<Server>(server_args)...},
+    sessions_{tcp.stack().ifname() + ".https_server"}
 {
   this->initialize(ca_key, ca_cert);
 }
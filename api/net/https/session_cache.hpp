@@ -0,0 +1,181 @@
+
+#pragma once
+#ifndef NET_HTTPS_SESSION_CACHE_HPP
+#define NET_HTTPS_SESSION_CACHE_HPP
+
+#include <util/delegate.hpp>
+#include <util/statman.hpp>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace http {
+
+/**
+ * @brief      A bounded cache of TLS sessions, shared by the connections of
+ *             a HTTPS server, letting returning clients resume their session
+ *             instead of doing a full handshake.
+ *
+ *             Sessions are kept serialized by the TLS library (OpenSSL, s2n
+ *             or Botan), by session id, and are evicted least recently used
+ *             first when the cache is full, or when they expire.
+ *
+ *             The cache also holds the keys protecting session tickets.
+ *             A new key is made every ticket key lifetime, and the previous
+ *             one is kept for decrypting tickets issued with it.
+ *
+ *             Everything can be serialized, for sessions to survive LiveUpdate.
+ */
+class Session_cache {
+public:
+  using Blob = std::vector<uint8_t>;
+
+  static constexpr size_t   DEFAULT_CAPACITY        = 4096;
+  static constexpr uint32_t DEFAULT_LIFETIME        = 300;  // seconds
+  static constexpr uint32_t DEFAULT_TICKET_LIFETIME = 3600; // seconds
+
+  /** A session ticket key (RFC 5077, 4) */
+  struct Ticket_key {
+    uint8_t  name[16];
+    uint8_t  aes_key[32];
+    uint8_t  hmac_key[32];
+    uint64_t created;
+  };
+
+  /** Called with a new ticket key, for libraries keeping their own list */
+  using Ticket_key_handler = delegate<void(const Ticket_key&)>;
+
+  /**
+   * @brief      Construct a session cache
+   *
+   * @param[in]  name      Prefix of the statistics (Statman) of the cache
+   * @param[in]  capacity  Max number of sessions kept
+   * @param[in]  lifetime  Seconds a session can be resumed
+   */
+  explicit Session_cache(const std::string& name,
+                         size_t   capacity = DEFAULT_CAPACITY,
+                         uint32_t lifetime = DEFAULT_LIFETIME);
+
+  /**
+   * @brief      Store a session, replacing any with the same id
+   *
+   * @param[in]  id       The session id
+   * @param[in]  len      The length of the session id
+   * @param[in]  session  The serialized session
+   */
+  void store(const uint8_t* id, size_t len, Blob session);
+
+  /**
+   * @brief      Find the session with an id, if not expired
+   *
+   * @return     The serialized session, or nullptr
+   */
+  const Blob* find(const uint8_t* id, size_t len);
+
+  void remove(const uint8_t* id, size_t len);
+
+  void clear()
+  {
+    lru_.clear();
+    index_.clear();
+    stat_sessions_ = 0;
+  }
+
+  size_t size() const noexcept
+  { return index_.size(); }
+
+  size_t capacity() const noexcept
+  { return capacity_; }
+
+  uint32_t lifetime() const noexcept
+  { return lifetime_; }
+
+  /**
+   * @brief      The key for encrypting new tickets, made anew when
+   *             older than the ticket lifetime
+   */
+  const Ticket_key& ticket_key();
+
+  /**
+   * @brief      Find the key a ticket was encrypted with
+   *
+   * @param[in]  name  The key name from the ticket (16 bytes)
+   *
+   * @return     The key, or nullptr if unknown or too old
+   */
+  const Ticket_key* find_ticket_key(const uint8_t* name);
+
+  /** Whether a key is the one used for new tickets */
+  bool is_current(const Ticket_key& key) const noexcept
+  { return not keys_.empty() and &key == &keys_.back(); }
+
+  /** Make a new key for encrypting tickets */
+  void rotate_ticket_key();
+
+  uint32_t ticket_lifetime() const noexcept
+  { return ticket_lifetime_; }
+
+  void set_ticket_lifetime(uint32_t seconds) noexcept
+  { ticket_lifetime_ = seconds; }
+
+  void on_ticket_key(Ticket_key_handler handler)
+  { on_ticket_key_ = std::move(handler); }
+
+  /** The ticket keys, oldest first */
+  const std::vector<Ticket_key>& ticket_keys() const noexcept
+  { return keys_; }
+
+  /** Count a completed handshake, and the ones resuming a session */
+  void count_handshake() noexcept
+  { ++stat_handshakes_; }
+  void count_resumption() noexcept
+  { ++stat_resumed_; }
+
+  size_t serialized_size() const noexcept;
+
+  /**
+   * @brief      Serialize the sessions and ticket keys
+   *
+   * @return     The number of bytes written
+   */
+  size_t serialize_to(void* addr, size_t size) const;
+
+  /**
+   * @brief      Add sessions and ticket keys from serialize_to,
+   *             dropping the expired ones
+   */
+  void deserialize_from(const void* addr, size_t size);
+
+private:
+  struct Entry {
+    std::string id;
+    Blob        session;
+    uint64_t    expires;
+  };
+  using List = std::list<Entry>;
+
+  List lru_; // most recently used first
+  std::unordered_map<std::string, List::iterator> index_;
+  std::vector<Ticket_key> keys_;
+  Ticket_key_handler on_ticket_key_ = nullptr;
+  const size_t capacity_;
+  const uint32_t lifetime_;
+  uint32_t ticket_lifetime_ = DEFAULT_TICKET_LIFETIME;
+
+  uint64_t& stat_handshakes_;
+  uint64_t& stat_resumed_;
+  uint64_t& stat_hits_;
+  uint64_t& stat_misses_;
+  uint32_t& stat_sessions_;
+
+  void erase(List::iterator);
+  void insert(std::string id, Blob session, uint64_t expires);
+  void add_ticket_key(const Ticket_key&);
+
+}; // < class Session_cache
+
+} // < namespace http
+
+#endif
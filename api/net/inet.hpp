@@ -11,6 +11,7 @@
 #include <map>
 #include <net/port_util.hpp>
 #include "conntrack.hpp"
+#include "qdisc.hpp"
 
 #include "ip4/ip4.hpp"
 #include "ip4/icmp4.hpp"
@@ -118,6 +119,9 @@ namespace net {
     /** Get the UDP-object belonging to this stack */
     UDP& udp() { return udp_; }
 
+    /** Get the DNS client belonging to this stack */
+    dns::Client& dns_client() { return dns_; }
+
     /** Get the ICMP-object belonging to this stack */
     ICMPv4& icmp() { return icmp_; }
 
@@ -238,6 +242,7 @@ namespace net {
     /**
      * @func  a delegate that provides a hostname and its address, which is 0 if the
      * name @hostname was not found. Note: Test with INADDR_ANY for a 0-address.
+     * Asks the nameservers added to the DNS client, if any, else the DNS server.
      **/
     void resolve(const std::string& hostname,
                  resolve_func       func,
@@ -350,9 +355,25 @@ namespace net {
     }
 
     size_t transmit_queue_available() {
-      return nic_.transmit_queue_available();
+      if (qdisc_ == nullptr)
+        return nic_.transmit_queue_available();
+      const auto used = qdisc_->size();
+      const auto room = qdisc_->limit() > used ? qdisc_->limit() - used : 0;
+      return std::min(room, nic_.transmit_queue_available());
     }
 
+    /**
+     * @brief      Install a queueing discipline for all outgoing packets
+     *             on this stack. nullptr removes it, sending the packets
+     *             left in the old qdisc.
+     *
+     * @param[in]  qdisc  The qdisc
+     */
+    void set_qdisc(std::unique_ptr<Qdisc> qdisc);
+
+    Qdisc* qdisc() noexcept
+    { return qdisc_.get(); }
+
     void force_start_send_queues();
 
     void move_to_this_cpu();
@@ -465,6 +486,12 @@ namespace net {
   private:
 
     void process_sendq(size_t);
+
+    void qdisc_transmit(Packet_ptr, MAC::Addr, Ethertype);
+    // move packets from the qdisc to the NIC while there is room
+    void qdisc_run();
+    void qdisc_timeout();
+    void set_link_out(downstream_link link);
     // delegates registered to get signalled about free packets
     std::vector<transmit_avail_delg> tqa;
 
@@ -491,6 +518,10 @@ namespace net {
 
     std::shared_ptr<Conntrack> conntrack_;
 
+    downstream_link        link_out_;
+    std::unique_ptr<Qdisc> qdisc_;
+    Timer                  qdisc_timer_;
+
     // we need this to store the cache per-stack
     dns::Client dns_;
     std::string domain_name_;
@@ -6,6 +6,7 @@
 #include <rtc>
 #include <unordered_map>
 #include <util/timer.hpp>
+#include <net/neighbour_table.hpp>
 #include "ip4.hpp"
 
 using namespace std::chrono_literals;
@@ -97,9 +98,6 @@ namespace net {
       Cache_entry(MAC::Addr mac) noexcept
       : mac_(mac), timestamp_(RTC::time_since_boot()) {}
 
-      Cache_entry(const Cache_entry& cpy) noexcept
-      : mac_(cpy.mac_), timestamp_(cpy.timestamp_) {}
-
       void update() noexcept { timestamp_ = RTC::time_since_boot(); }
 
       bool expired() const noexcept
@@ -128,7 +126,7 @@ namespace net {
       {}
     };
 
-    using Cache       = std::unordered_map<ip4::Addr, Cache_entry>;
+    using Cache       = Neighbour_table<ip4::Addr, Cache_entry>;
     using PacketQueue = std::unordered_map<ip4::Addr, Queue_entry>;
 
 
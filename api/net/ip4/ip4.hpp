@@ -8,6 +8,7 @@
 #include "packet_ip4.hpp"
 #include <common>
 #include <net/netfilter.hpp>
+#include <net/reassembly.hpp>
 #include <net/port_util.hpp>
 #include <rtc>
 #include <util/timer.hpp>
@@ -24,7 +25,7 @@ namespace net {
 
     enum class Drop_reason
     { None, Bad_source, Bad_length, Bad_destination,
-      Wrong_version, Wrong_checksum, Unknown_proto, TTL0 };
+      Wrong_version, Wrong_checksum, Unknown_proto, TTL0, No_buffers };
 
     enum class Direction
     { Upstream, Downstream };
@@ -209,9 +210,18 @@ namespace net {
     /**  Drop outgoing packets invalid according to RFC */
     IP_packet_ptr drop_invalid_out(IP_packet_ptr packet);
 
-    /**  Reassemble fragments into a coherent heap-allocated packet **/
+    /**  Reassemble fragments into a coherent packet of the reassembly pool **/
     IP_packet_ptr reassemble(IP_packet_ptr packet);
 
+    /**
+     *  Configure the reassembly of fragments, including the size of its pool.
+     *  Takes effect when the first fragment arrives, so set it before.
+     **/
+    void set_reassembly_config(const Reassembly::Config& config);
+
+    const Reassembly::Config& reassembly_config() const noexcept
+    { return reassembly_config_; }
+
     /**
      *  Path MTU Discovery (and Packetization Layered Path MTU Discovery) related methods
      */
@@ -495,6 +505,11 @@ namespace net {
     /** All dropped packets go here */
     drop_handler drop_handler_;
 
+    /** Fragment reassembly, created on the first fragment */
+    Reassembly::Config reassembly_config_;
+    std::unique_ptr<Reassembly> reassembly_;
+    Reassembly& reassembly();
+
     /** Drop a packet, calling drop handler if set */
     IP_packet_ptr drop(IP_packet_ptr ptr, Direction direction, Drop_reason reason);
 
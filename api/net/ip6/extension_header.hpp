@@ -28,6 +28,34 @@ namespace net::ip6 {
     }
   } __attribute__((packed));
 
+  /** RFC 8200 4.5 Fragment Header */
+  struct Fragment_header
+  {
+    uint8_t  next_header;
+    uint8_t  reserved;
+    uint16_t offs_flags;
+    uint32_t id;
+
+    Protocol proto() const
+    {
+      return static_cast<Protocol>(next_header);
+    }
+    /** Fragment offset in bytes */
+    uint32_t offset() const
+    {
+      return ntohs(offs_flags) & 0xfff8;
+    }
+    /** More fragments */
+    bool more() const
+    {
+      return ntohs(offs_flags) & 0x1;
+    }
+    uint32_t ident() const
+    {
+      return ntohl(id);
+    }
+  } __attribute__((packed));
+
   /**
    * @brief      Parse the upper layer protocol (TCP/UDP/ICMPv6).
    *             If none, IPv6_NONXT is returned.
@@ -9,6 +9,7 @@
 
 #include <common>
 #include <net/netfilter.hpp>
+#include <net/reassembly.hpp>
 #include <net/conntrack.hpp>
 
 namespace net
@@ -22,7 +23,7 @@ namespace net
   public:
     enum class Drop_reason
     { None, Bad_source, Bad_destination, Wrong_version,
-        Unknown_proto };
+        Unknown_proto, Bad_length, No_buffers };
 
     enum class Direction
     { Upstream, Downstream };
@@ -174,6 +175,21 @@ namespace net
     /**  Drop outgoing packets invalid according to RFC */
     IP_packet_ptr drop_invalid_out(IP_packet_ptr packet);
 
+    /**
+     *  Reassemble fragments into a coherent packet of the reassembly pool.
+     *  Packets without a fragment header are returned untouched.
+     **/
+    IP_packet_ptr reassemble(IP_packet_ptr packet);
+
+    /**
+     *  Configure the reassembly of fragments, including the size of its pool.
+     *  Takes effect when the first fragment arrives, so set it before.
+     **/
+    void set_reassembly_config(const Reassembly::Config& config);
+
+    const Reassembly::Config& reassembly_config() const noexcept
+    { return reassembly_config_; }
+
   private:
     Stack& stack_;
 
@@ -204,6 +220,11 @@ namespace net
     /** All dropped packets go here */
     drop_handler drop_handler_;
 
+    /** Fragment reassembly, created on the first fragment */
+    Reassembly::Config reassembly_config_;
+    std::unique_ptr<Reassembly> reassembly_;
+    Reassembly& reassembly();
+
     /** Drop a packet, calling drop handler if set */
     IP_packet_ptr drop(IP_packet_ptr ptr, Direction direction, Drop_reason reason);
 
@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include <deque>
 #include <util/timer.hpp>
+#include <net/neighbour_table.hpp>
 #include "packet_icmp6.hpp"
 #include "packet_ndp.hpp"
 #include "stateful_addr.hpp"
@@ -179,10 +180,6 @@ namespace net {
           set_state(state);
       }
 
-      Neighbour_Cache_entry(const Neighbour_Cache_entry& cpy) noexcept
-      : mac_(cpy.mac_), state_(cpy.state_),
-        timestamp_(cpy.timestamp_), flags_(cpy.flags_) {}
-
       void update() noexcept { timestamp_ = RTC::time_since_boot(); }
 
       bool expired() const noexcept
@@ -237,6 +234,8 @@ namespace net {
     }; //< struct Neighbour_Cache_entry
 
     struct Destination_Cache_entry {
+      Destination_Cache_entry() noexcept = default;
+
       Destination_Cache_entry(ip6::Addr next_hop)
         : next_hop_{next_hop} {}
 
@@ -261,8 +260,8 @@ namespace net {
       int tries_remaining = MAX_MULTICAST_SOLICIT;
     };
 
-    using Cache       = std::unordered_map<ip6::Addr, Neighbour_Cache_entry>;
-    using DestCache   = std::unordered_map<ip6::Addr, Destination_Cache_entry>;
+    using Cache       = Neighbour_table<ip6::Addr, Neighbour_Cache_entry>;
+    using DestCache   = Neighbour_table<ip6::Addr, Destination_Cache_entry>;
     using PacketQueue = std::unordered_map<ip6::Addr, Queue_entry>;
     using PrefixList  = std::deque<ip6::Stateful_addr>;
     using RouterList  = std::deque<ndp::Router_entry>;
@@ -48,7 +48,7 @@ public:
 
   /** Number of bytes in a frame needed by the linklayer **/
   size_t frame_offset_link() const noexcept override
-  { return Protocol::header_size(); }
+  { return link_.header_size(); }
 
   hw::Nic::Proto proto() const override
   { return Protocol::proto(); }
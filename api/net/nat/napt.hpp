@@ -3,8 +3,8 @@
 #ifndef NET_NAT_NAPT_HPP
 #define NET_NAT_NAPT_HPP
 
-#include <map>
-#include <net/port_util.hpp>
+#include <unordered_map>
+#include <net/nat/port_pool.hpp>
 #include <net/conntrack.hpp>
 #include <net/ip4/ip4.hpp>
 
@@ -49,18 +49,44 @@ public:
   void snat(IP4::IP_packet& pkt, Conntrack::Entry_ptr);
 
 private:
+  /** Port pools of a protocol, by public address */
+  using Port_pools = std::unordered_map<ip4::Addr, Port_pool>;
+
   std::shared_ptr<Conntrack> conntrack;
+  // shared with the close handlers of the entries, which may outlive them
+  std::shared_ptr<Port_pools> tcp_pools;
+  std::shared_ptr<Port_pools> udp_pools;
+  uint32_t&  tcp_exhausted;
+  uint32_t&  udp_exhausted;
+
+  /**
+   * @brief      Get (or create) the port pool on top of the given ports.
+   *
+   * @param      pools      The pools for the protocol
+   * @param[in]  addr       The address
+   * @param      ports      The ports of the address
+   * @param      exhausted  The exhaustion counter for the protocol
+   *
+   * @return     The port pool
+   */
+  static Port_pool& pool(Port_pools& pools, const ip4::Addr addr,
+                         Port_util& ports, uint32_t& exhausted);
 
   /**
-   * @brief      If not already updated, bind to a ephemeral port and update the entry.
+   * @brief      If not already updated, acquire a port towards the destination
+   *             and update the entry.
    *
-   * @param[in]  entry  The entry
-   * @param[in]  addr   The address
-   * @param      ports  The ports
+   * @param[in]  entry      The entry
+   * @param[in]  addr       The address
+   * @param[in]  pools      The pools for the protocol
+   * @param      ports      The ports of the address
+   * @param      exhausted  The exhaustion counter for the protocol
    *
    * @return     The socket used for SNAT
    */
-  Socket masq(Conntrack::Entry_ptr entry, const ip4::Addr addr, Port_util& ports);
+  Socket masq(Conntrack::Entry_ptr entry, const ip4::Addr addr,
+              const std::shared_ptr<Port_pools>& pools,
+              Port_util& ports, uint32_t& exhausted);
 
 }; // < class NAPT
 
@@ -0,0 +1,104 @@
+
+#pragma once
+#ifndef NET_NAT_PORT_POOL_HPP
+#define NET_NAT_PORT_POOL_HPP
+
+#include <net/port_util.hpp>
+#include <net/socket.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace net {
+namespace nat {
+
+/**
+ * @brief      Endpoint-dependent port allocator for NAPT.
+ *
+ *             Hands out ephemeral ports per remote endpoint, so the same
+ *             public port can be reused towards different destinations.
+ *             Each destination has its own free list, making both
+ *             acquire and release O(1).
+ *
+ *             Ports in use are reference counted and bound in the
+ *             underlying Port_util, so the local stack will not pick
+ *             a port currently used for masquerading.
+ */
+class Port_pool {
+public:
+  /**
+   * @brief      Construct a port pool on top of the given port util.
+   *
+   * @param      ports      The ports of the public address
+   * @param      exhausted  Counter incremented every time a destination
+   *                        runs out of ports
+   */
+  Port_pool(Port_util& ports, uint32_t& exhausted);
+
+  /**
+   * @brief      Acquire a port for traffic towards the remote endpoint.
+   *             Throws Port_error if there are no free ports left
+   *             for this destination.
+   *
+   * @param[in]  remote  The remote endpoint
+   *
+   * @return     A port unique for the given remote
+   */
+  uint16_t acquire(const Socket& remote);
+
+  /**
+   * @brief      Release a port previously acquired for the remote endpoint.
+   *
+   * @param[in]  remote  The remote endpoint
+   * @param[in]  port    The port
+   */
+  void release(const Socket& remote, const uint16_t port) noexcept;
+
+  /**
+   * @brief      Number of destinations with at least one port in use.
+   */
+  size_t destinations() const noexcept
+  { return dests_.size(); }
+
+  /**
+   * @brief      Number of times a port is in use (over all destinations).
+   *
+   * @param[in]  port  The port
+   */
+  uint16_t use_count(const uint16_t port) const noexcept
+  { return port_ranges::is_dynamic(port) ? refs_[index(port)] : 0; }
+
+private:
+  /** Per destination allocation state */
+  struct Dest {
+    std::vector<uint16_t> free;  // released ports, ready for reuse
+    uint16_t cursor;             // next never handed out port
+    uint16_t remaining;          // ports not yet passed by the cursor
+    uint16_t in_use = 0;
+
+    Dest(uint16_t start) noexcept
+      : cursor{start},
+        remaining{static_cast<uint16_t>(Port_util::size())}
+    {}
+  };
+
+  Port_util&                        ports_;
+  std::unordered_map<Socket, Dest>  dests_;
+  std::vector<uint16_t>             refs_;
+  uint32_t&                         exhausted_;
+
+  static constexpr int index(const uint16_t port) noexcept
+  { return port - port_ranges::DYNAMIC_START; }
+
+  /** Returns true if the port is bound by someone else than this pool */
+  bool taken(const uint16_t port) const noexcept
+  { return refs_[index(port)] == 0 and ports_.is_bound(port); }
+
+  void ref(const uint16_t port) noexcept;
+  void unref(const uint16_t port) noexcept;
+
+}; // < class Port_pool
+
+} // < namespace nat
+} // < namespace net
+
+#endif
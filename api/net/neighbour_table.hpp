@@ -0,0 +1,228 @@
+
+#pragma once
+#ifndef NET_NEIGHBOUR_TABLE_HPP
+#define NET_NEIGHBOUR_TABLE_HPP
+
+#include <common>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace net {
+
+  /**
+   * @brief      Compact open-addressed table for link layer neighbours
+   *             (ARP and NDP caches).
+   *
+   *             Entries live in one flat array with linear probing and
+   *             backward-shift deletion (no tombstones). The slot of the
+   *             last successful lookup is remembered, so the common case of
+   *             sending everything to the same next hop (the gateway) is a
+   *             key compare and a dereference.
+   *
+   *             A table is owned by a single network stack, which is only
+   *             ever touched from the CPU it runs on, so no locking is done.
+   *
+   * @tparam     Key    The protocol address type
+   * @tparam     Entry  The cache entry type (must be default constructible)
+   */
+  template <typename Key, typename Entry>
+  class Neighbour_table {
+  public:
+    static constexpr size_t min_capacity = 16;
+
+    explicit Neighbour_table(size_t capacity = min_capacity)
+    {
+      size_t cap = min_capacity;
+      while (cap < capacity) cap <<= 1;
+      rehash(cap);
+    }
+
+    /** Number of neighbours in the table */
+    size_t size() const noexcept
+    { return count_; }
+
+    bool empty() const noexcept
+    { return count_ == 0; }
+
+    /** Number of slots, always a power of two */
+    size_t capacity() const noexcept
+    { return slots_.size(); }
+
+    /**
+     * @brief      Find the entry for the given address.
+     *
+     * @return     Pointer to the entry, or nullptr if not present.
+     *             Only valid until the table is modified.
+     */
+    Entry* find(const Key& key) noexcept
+    {
+      const auto i = lookup(key);
+      return i != npos ? &slots_[i].value : nullptr;
+    }
+
+    const Entry* find(const Key& key) const noexcept
+    {
+      const auto i = lookup(key);
+      return i != npos ? &slots_[i].value : nullptr;
+    }
+
+    bool contains(const Key& key) const noexcept
+    { return find(key) != nullptr; }
+
+    /**
+     * @brief      Insert or replace the entry for the given address.
+     *
+     * @return     Reference to the stored entry
+     */
+    Entry& assign(const Key& key, Entry value)
+    {
+      // keep load factor below 3/4
+      if (UNLIKELY((count_ + 1) * 4 > capacity() * 3))
+        rehash(capacity() * 2);
+
+      size_t i = index(key);
+      for (; slots_[i].used; i = next(i))
+      {
+        if (slots_[i].key == key) {
+          slots_[i].value = std::move(value);
+          return slots_[i].value;
+        }
+      }
+      slots_[i].used  = true;
+      slots_[i].key   = key;
+      slots_[i].value = std::move(value);
+      ++count_;
+      return slots_[i].value;
+    }
+
+    /** Remove the entry for the given address, returns true if found */
+    bool erase(const Key& key) noexcept
+    {
+      for (size_t i = index(key); slots_[i].used; i = next(i))
+      {
+        if (slots_[i].key == key) {
+          erase_slot(i);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /** Remove every entry matching the predicate */
+    template <typename Pred>
+    size_t erase_if(Pred&& pred)
+    {
+      size_t removed = 0;
+      for (size_t i = 0; i < capacity(); )
+      {
+        auto& slot = slots_[i];
+        // after a removal, the slot may be refilled by a shifted entry
+        if (slot.used and pred(static_cast<const Key&>(slot.key), slot.value)) {
+          erase_slot(i);
+          ++removed;
+        }
+        else {
+          ++i;
+        }
+      }
+      return removed;
+    }
+
+    /** Call func(key, entry) for every entry */
+    template <typename Func>
+    void for_each(Func&& func) const
+    {
+      for (const auto& slot : slots_)
+        if (slot.used) func(slot.key, slot.value);
+    }
+
+    void clear() noexcept
+    {
+      for (auto& slot : slots_)
+        slot.used = false;
+      count_ = 0;
+      hint_  = 0;
+    }
+
+  private:
+    struct Slot {
+      Key   key {};
+      Entry value {};
+      bool  used = false;
+    };
+
+    std::vector<Slot> slots_;
+    size_t            mask_  = 0;
+    size_t            count_ = 0;
+    mutable size_t    hint_  = 0;
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    size_t lookup(const Key& key) const noexcept
+    {
+      const auto& hint = slots_[hint_];
+      if (LIKELY(hint.used and hint.key == key))
+        return hint_;
+
+      for (size_t i = index(key); slots_[i].used; i = next(i))
+      {
+        if (slots_[i].key == key) {
+          hint_ = i;
+          return i;
+        }
+      }
+      return npos;
+    }
+
+    size_t index(const Key& key) const noexcept
+    {
+      // Fibonacci hashing spreads addresses differing only in high bits
+      const uint64_t h = std::hash<Key>{}(key) * 0x9E3779B97F4A7C15ull;
+      return (h ^ (h >> 32)) & mask_;
+    }
+
+    size_t next(size_t i) const noexcept
+    { return (i + 1) & mask_; }
+
+    /** Backward-shift deletion, keeps probe sequences intact */
+    void erase_slot(size_t i) noexcept
+    {
+      size_t j = i;
+      while (true)
+      {
+        j = next(j);
+        if (not slots_[j].used)
+          break;
+        const size_t home = index(slots_[j].key);
+        // move j into the hole at i if its home isn't cyclically in (i, j]
+        if ((j > i and (home <= i or home > j)) or
+            (j < i and (home <= i and home > j)))
+        {
+          slots_[i] = std::move(slots_[j]);
+          i = j;
+        }
+      }
+      slots_[i].used = false;
+      --count_;
+      hint_ = 0;
+    }
+
+    void rehash(size_t capacity)
+    {
+      Expects((capacity & (capacity - 1)) == 0);
+      std::vector<Slot> old;
+      old.swap(slots_);
+      slots_.resize(capacity);
+      mask_  = capacity - 1;
+      count_ = 0;
+      hint_  = 0;
+      for (auto& slot : old)
+        if (slot.used) assign(slot.key, std::move(slot.value));
+    }
+
+  }; //< class Neighbour_table
+
+} //< namespace net
+
+#endif //< NET_NEIGHBOUR_TABLE_HPP
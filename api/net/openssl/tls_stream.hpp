@@ -3,6 +3,8 @@
 #include <openssl/pem.h>
 #include <openssl/ssl.h>
 #include <net/stream_buffer.hpp>
+#include <deque>
+#include <memory>
 
 //#define VERBOSE_OPENSSL 1
 #ifdef VERBOSE_OPENSSL
@@ -17,8 +19,8 @@ namespace openssl
   {
     using Stream_ptr = net::Stream_ptr;
 
-    TLS_stream(SSL_CTX* ctx, Stream_ptr, bool outgoing = false);
-    TLS_stream(Stream_ptr, SSL* ctx, BIO*, BIO*);
+    TLS_stream(SSL_CTX* ctx, Stream_ptr, bool outgoing = false, SSL_SESSION* session = nullptr);
+    TLS_stream(Stream_ptr, SSL* ssl);
     virtual ~TLS_stream();
 
     void write(buffer_t buffer) override;
@@ -60,12 +62,29 @@ namespace openssl
       return m_transport.get();
     }
 
+    /** A new reference to the session, for resuming it on another stream */
+    SSL_SESSION* get1_session() const noexcept {
+      return SSL_get1_session(m_ssl);
+    }
+
+    /**
+     * @brief      Run the handshake on other CPUs, for the key exchange
+     *             not to hold up this one. The stream resumes here when
+     *             each step is done. Only with SMP, and more than one CPU.
+     */
+    void offload_handshake(bool enabled) noexcept {
+      m_offload = enabled;
+    }
+
     void handle_read_congestion() override;
     void handle_write_congestion() override;
 
   private:
+    struct Handshake_job;
+    using Handshake_ptr = std::shared_ptr<Handshake_job>;
+
     void handle_data();
-    int  decrypt(const void *data,int size);
+    int  decrypt(buffer_t);
     int  send_decrypted();
     bool tls_read(buffer_t);
     int  tls_perform_stream_write();
@@ -79,12 +98,32 @@ namespace openssl
       STATUS_FAIL
     };
     status_t status(int n) const noexcept;
+
+    int  handshake_step(int ret, status_t);
+    bool offload_handshake_step();
+    static void resume_handshake(Handshake_ptr);
+
+    // OpenSSL reads and writes records through a BIO of the stream,
+    // straight from the received buffers and into the buffer sent
+    static BIO* create_bio(TLS_stream*);
+    static int  bio_read(BIO*, char*, int);
+    static int  bio_write(BIO*, const char*, int);
+    static long bio_ctrl(BIO*, int, long, void*);
+
     Stream_ptr m_transport = nullptr;
     SSL*   m_ssl    = nullptr;
-    BIO*   m_bio_rd = nullptr;
-    BIO*   m_bio_wr = nullptr;
+    // received, not yet read by OpenSSL (from m_rd_offset in the first buffer)
+    std::deque<buffer_t> m_rd_queue;
+    size_t m_rd_offset = 0;
+    // records written by OpenSSL, not yet sent
+    buffer_t m_wr_buffer = nullptr;
+    // a handshake step running on another CPU, owning the SSL object
+    // and the buffers above until resumed, and what was received meanwhile
+    Handshake_ptr m_handshake = nullptr;
+    std::deque<buffer_t> m_rd_pending;
     int8_t m_busy = 0;
     bool   m_deferred_close = false;
+    bool   m_offload = false;
   };
 
 } // openssl
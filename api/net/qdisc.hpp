@@ -0,0 +1,325 @@
+
+#pragma once
+#ifndef NET_QDISC_HPP
+#define NET_QDISC_HPP
+
+#include <net/packet.hpp>
+#include <net/iana.hpp>
+#include <net/ethernet/ethertype.hpp>
+#include <hw/mac_addr.hpp>
+#include <array>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace net {
+
+  /**
+   * @brief      Queueing discipline for outgoing packets.
+   *
+   *             A qdisc sits between the network layer and the link layer
+   *             of a stack (see Inet::set_qdisc). Packets are enqueued as
+   *             they are sent, and dequeued by the stack whenever the NIC
+   *             has room in its transmit queue.
+   *
+   *             Time is passed in explicitly (nanoseconds), every qdisc
+   *             is owned by a single stack and never locked.
+   *
+   *             Drops, ECN marks and queueing delay are published to Statman
+   *             under the name given on construction.
+   */
+  class Qdisc {
+  public:
+    /** A packet waiting for the link layer */
+    struct Entry {
+      Packet_ptr packet;
+      MAC::Addr  dest;
+      Ethertype  type;
+      uint64_t   enqueued = 0; // nanoseconds, set by the qdisc
+
+      size_t size() const noexcept
+      { return packet->size(); }
+    };
+
+    explicit Qdisc(const std::string& name);
+    virtual ~Qdisc() = default;
+
+    /**
+     * @brief      Queue a packet for transmission.
+     *
+     * @param[in]  entry  The packet and its link layer destination
+     * @param[in]  now    The current time in nanoseconds
+     *
+     * @return     False if the packet (or another one) had to be dropped
+     */
+    virtual bool enqueue(Entry entry, uint64_t now) = 0;
+
+    /**
+     * @brief      Take the next packet allowed to leave.
+     *
+     * @param[in]  now   The current time in nanoseconds
+     *
+     * @return     The entry, with a null packet if there is nothing to send
+     *             right now
+     */
+    virtual Entry dequeue(uint64_t now) = 0;
+
+    /** Number of packets queued */
+    virtual size_t size() const noexcept = 0;
+
+    /** Max number of packets queued */
+    virtual size_t limit() const noexcept = 0;
+
+    /**
+     * @brief      When packets are held back by a shaper, the time (ns)
+     *             the next one may leave. 0 if nothing is held back.
+     */
+    virtual uint64_t next_event() const noexcept
+    { return 0; }
+
+    bool empty() const noexcept
+    { return size() == 0; }
+
+    const std::string& name() const noexcept
+    { return name_; }
+
+    uint64_t dropped() const noexcept
+    { return dropped_; }
+
+    uint64_t marked() const noexcept
+    { return marked_; }
+
+    /** Queueing delay of the last dequeued packet, in microseconds */
+    uint32_t delay_us() const noexcept
+    { return delay_us_; }
+
+    /**
+     * @brief      Get the DSCP of an IPv4 or IPv6 packet.
+     *             Other packets (ARP, NDP over ICMPv6 included) are CS0.
+     */
+    static DSCP dscp(const Entry& entry) noexcept;
+
+    /** Hash of the flow (addresses, protocol and ports) a packet belongs to */
+    static uint32_t flow_hash(const Entry& entry) noexcept;
+
+    /**
+     * @brief      Set Congestion Experienced on an ECN capable packet.
+     *
+     * @return     False if the transport is not ECN capable
+     */
+    static bool set_ce(Entry& entry) noexcept;
+
+  protected:
+    /** Count and free a dropped packet */
+    void drop(Entry& entry) noexcept;
+
+    /** Mark the packet with CE if ECN capable, otherwise drop it */
+    bool mark_or_drop(Entry& entry) noexcept;
+
+    /** Record the queueing delay of a packet leaving the qdisc */
+    void sojourn(const Entry& entry, uint64_t now) noexcept
+    { delay_us_ = (now - entry.enqueued) / 1000; }
+
+  private:
+    std::string name_;
+    uint64_t&   dropped_;
+    uint64_t&   marked_;
+    uint32_t&   delay_us_;
+
+  }; //< class Qdisc
+
+  /**
+   * @brief      Tail drop first-in first-out queue.
+   */
+  class Fifo : public Qdisc {
+  public:
+    Fifo(const std::string& name, size_t limit = 1024)
+      : Qdisc{name}, limit_{limit}
+    {}
+
+    bool enqueue(Entry entry, uint64_t now) override;
+    Entry dequeue(uint64_t now) override;
+
+    size_t size() const noexcept override
+    { return queue_.size(); }
+
+    size_t limit() const noexcept override
+    { return limit_; }
+
+  private:
+    std::deque<Entry> queue_;
+    const size_t      limit_;
+  };
+
+  /**
+   * @brief      Strict priority between bands, selected by DSCP.
+   *
+   *             Band 0: network control and expedited forwarding
+   *                     (CS5-CS7, EF, VOICE-ADMIT) and non-IP traffic
+   *             Band 1: everything else
+   *             Band 2: lower effort (CS1)
+   *
+   *             A lower band is only served when all higher ones are empty.
+   */
+  class Prio : public Qdisc {
+  public:
+    static constexpr size_t bands = 3;
+
+    /** Priority queues with a Fifo in each band */
+    Prio(const std::string& name, size_t band_limit = 1024);
+
+    /** Replace the qdisc of a band */
+    void set_band(size_t band, std::unique_ptr<Qdisc> qdisc);
+
+    Qdisc& band(size_t band)
+    { return *bands_.at(band); }
+
+    /** The band a packet is queued in */
+    static size_t classify(const Entry& entry) noexcept;
+
+    bool enqueue(Entry entry, uint64_t now) override;
+    Entry dequeue(uint64_t now) override;
+    size_t size() const noexcept override;
+    /** The limit of a band, as every packet may end up in the same one */
+    size_t limit() const noexcept override;
+    uint64_t next_event() const noexcept override;
+
+  private:
+    std::array<std::unique_ptr<Qdisc>, bands> bands_;
+  };
+
+  /**
+   * @brief      Token bucket shaper, limiting the rate of a child qdisc.
+   *
+   *             Tokens are kept as transmission time in nanoseconds,
+   *             refilled at the configured rate up to the burst size.
+   *             A packet taken from the child which doesn't fit the bucket
+   *             is held until enough tokens have accumulated.
+   */
+  class Token_bucket : public Qdisc {
+  public:
+    struct Config {
+      /** Rate in bytes per second */
+      uint64_t rate  = 125'000'000;
+      /** Bucket size in bytes */
+      uint32_t burst = 64 * 1024;
+    };
+
+    Token_bucket(const std::string& name, Config config,
+                 std::unique_ptr<Qdisc> child);
+
+    /** Shape a Fifo */
+    Token_bucket(const std::string& name, Config config);
+
+    bool enqueue(Entry entry, uint64_t now) override;
+    Entry dequeue(uint64_t now) override;
+
+    size_t size() const noexcept override
+    { return child_->size() + (held_.packet != nullptr); }
+
+    size_t limit() const noexcept override
+    { return child_->limit(); }
+
+    uint64_t next_event() const noexcept override
+    { return held_.packet != nullptr ? ready_ : child_->next_event(); }
+
+    const Config& config() const noexcept
+    { return config_; }
+
+    Qdisc& child()
+    { return *child_; }
+
+  private:
+    const Config           config_;
+    std::unique_ptr<Qdisc> child_;
+    Entry                  held_;
+    const uint64_t         burst_ns_;
+    uint64_t               tokens_; // ns
+    uint64_t               last_  = 0;
+    uint64_t               ready_ = 0;
+
+    uint64_t cost(size_t bytes) const noexcept
+    { return bytes * 1'000'000'000ull / config_.rate; }
+  };
+
+  /**
+   * @brief      Flow queueing with CoDel active queue management (RFC 8290).
+   *
+   *             Packets are hashed into flow queues served by deficit round
+   *             robin, with new (sparse) flows served ahead of old ones.
+   *             Each flow runs CoDel (RFC 8289), dropping or ECN marking
+   *             packets when the queueing delay stays above target for a
+   *             whole interval. When the limit is reached, packets are
+   *             dropped from the flow with the largest backlog.
+   */
+  class Fq_codel : public Qdisc {
+  public:
+    struct Config {
+      /** Number of flow queues */
+      uint32_t flows    = 1024;
+      /** Max number of packets queued over all flows */
+      uint32_t limit    = 10240;
+      /** Bytes a flow may send per round */
+      uint32_t quantum  = 1514;
+      /** Acceptable standing queue delay (ns) */
+      uint64_t target   = 5'000'000;
+      /** Sliding window to detect a standing queue (ns) */
+      uint64_t interval = 100'000'000;
+      /** Mark ECN capable packets instead of dropping them */
+      bool     ecn      = true;
+    };
+
+    Fq_codel(const std::string& name, Config config);
+
+    explicit Fq_codel(const std::string& name)
+      : Fq_codel(name, Config{})
+    {}
+
+    bool enqueue(Entry entry, uint64_t now) override;
+    Entry dequeue(uint64_t now) override;
+
+    size_t size() const noexcept override
+    { return packets_; }
+
+    size_t limit() const noexcept override
+    { return config_.limit; }
+
+    const Config& config() const noexcept
+    { return config_; }
+
+    /** Number of flows currently holding packets */
+    size_t active_flows() const noexcept
+    { return new_flows_.size() + old_flows_.size(); }
+
+  private:
+    struct Flow {
+      std::deque<Entry> queue;
+      size_t   bytes = 0;
+      int32_t  deficit = 0;
+      bool     active = false;
+      // CoDel state
+      uint64_t first_above_time = 0;
+      uint64_t drop_next = 0;
+      uint32_t count = 0;
+      uint32_t lastcount = 0;
+      bool     dropping = false;
+    };
+
+    const Config          config_;
+    std::vector<Flow>     flows_;
+    std::deque<uint32_t>  new_flows_;
+    std::deque<uint32_t>  old_flows_;
+    size_t                packets_ = 0;
+
+    Entry codel_dequeue(Flow& flow, uint64_t now);
+    Entry pop(Flow& flow, uint64_t now, bool& ok_to_drop);
+    uint64_t control_law(uint64_t t, uint32_t count) const noexcept;
+    /** Signal congestion, returns true if the packet was marked and may be sent */
+    bool congested(Entry& entry) noexcept;
+    void drop_from_fattest();
+  };
+
+} //< namespace net
+
+#endif //< NET_QDISC_HPP
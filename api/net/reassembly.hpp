@@ -0,0 +1,182 @@
+#pragma once
+#ifndef NET_REASSEMBLY_HPP
+#define NET_REASSEMBLY_HPP
+
+#include <net/addr.hpp>
+#include <net/buffer_store.hpp>
+#include <net/packet.hpp>
+#include <rtc>
+#include <timers>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace net {
+
+  /**
+   * @brief      Protocol independent fragment reassembly engine,
+   *             shared by IPv4 and IPv6.
+   *
+   *             Datagrams are looked up by hash. Each datagram is assembled
+   *             in place, in a buffer of a memory pool dedicated to
+   *             reassembly, with room for the largest datagram allowed.
+   *             The data of each fragment is copied straight to its offset,
+   *             so that the receive buffers of the NIC are released at once
+   *             and reassembly can never starve the driver, and the buffer
+   *             becomes the packet once the datagram is complete.
+   *             The pool is the hard byte budget: the oldest datagrams are
+   *             evicted to make room, and a timer drops datagrams not
+   *             completed in time.
+   */
+  class Reassembly {
+  public:
+    /** Identifies a datagram being reassembled */
+    struct Key {
+      Addr     src;
+      Addr     dst;
+      uint32_t id;
+      uint8_t  proto;
+
+      bool operator==(const Key& other) const noexcept
+      {
+        return id == other.id and proto == other.proto
+          and src == other.src and dst == other.dst;
+      }
+    };
+
+    struct Key_hasher {
+      size_t operator()(const Key& key) const noexcept
+      {
+        const auto h1 = std::hash<ip6::Addr>{}(key.src.v6());
+        const auto h2 = std::hash<ip6::Addr>{}(key.dst.v6());
+        return h1 ^ (h2 << 1) ^ (size_t(key.id) << 8) ^ key.proto;
+      }
+    };
+
+    /**
+     * A received fragment. The header of the first fragment is kept
+     * to head the reassembled datagram.
+     */
+    struct Fragment {
+      uint32_t       offset;     // offset of data in the datagram
+      uint32_t       length;     // bytes of data
+      const uint8_t* data;       // start of data inside packet
+      const uint8_t* header;     // start of header inside packet
+      uint32_t       header_len; // bytes of header to keep
+    };
+
+    struct Config {
+      /** Max number of datagrams in reassembly */
+      size_t max_entries = 256;
+      /** Size of the memory pool, one buffer per datagram */
+      size_t byte_budget = 4 * 1024 * 1024;
+      /** Seconds before an incomplete datagram is dropped */
+      RTC::timestamp_t timeout = 15;
+      /** Largest datagram allowed, not counting the header */
+      uint32_t max_datagram = 65535;
+      /** Largest header kept from the first fragment */
+      uint32_t max_header = 256;
+
+      /** Size of each buffer of the pool */
+      size_t buffer_size() const noexcept
+      { return sizeof(Packet) + max_header + max_datagram; }
+    };
+
+    struct Stats {
+      uint64_t fragments = 0;
+      uint64_t reassembled = 0;
+      uint64_t timeouts = 0;
+      uint64_t evicted = 0;
+      uint64_t dropped = 0;
+      uint64_t no_buffers = 0;
+    };
+
+    Reassembly() : Reassembly(Config{}) {}
+
+    explicit Reassembly(Config cfg);
+    ~Reassembly();
+
+    Reassembly(const Reassembly&) = delete;
+    Reassembly& operator=(const Reassembly&) = delete;
+
+    /**
+     * @brief      Add a fragment to the datagram identified by the key.
+     *             The data is copied, so the packet holding it can be
+     *             released once this returns.
+     *
+     * @param[in]  key   The datagram key
+     * @param[in]  frag  The fragment
+     * @param[in]  more  Whether more fragments follow (MF bit)
+     *
+     * @return     The datagram once complete, with layer_begin at the
+     *             header of the first fragment followed by all the data,
+     *             otherwise nullptr. The packet holds a buffer of the
+     *             pool until it is released.
+     */
+    Packet_ptr insert(const Key& key, const Fragment& frag, bool more);
+
+    /** Drop datagrams older than the timeout */
+    void expire(RTC::timestamp_t now);
+
+    /** Number of datagrams being reassembled */
+    size_t entries() const noexcept
+    { return entries_.size(); }
+
+    /** Number of bytes of the pool held by datagrams in reassembly */
+    size_t bytes_held() const noexcept
+    { return entries_.size() * pool_->bufsize(); }
+
+    const Stats& stats() const noexcept
+    { return stats_; }
+
+    const Config& config() const noexcept
+    { return config_; }
+
+  private:
+    using Age_list = std::list<Key>;
+
+    /** The data of a fragment, already in the buffer */
+    struct Piece {
+      uint32_t offset;
+      uint32_t length;
+    };
+    using Pieces = std::vector<Piece>;
+
+    struct Entry {
+      Pieces             pieces;
+      uint8_t*           buffer = nullptr;
+      uint32_t           header_len = 0;
+      uint32_t           received = 0;
+      uint32_t           total = 0; // 0 until the last fragment is seen
+      RTC::timestamp_t   created;
+      Age_list::iterator age;
+    };
+
+    using Entries = std::unordered_map<Key, Entry, Key_hasher>;
+
+    Config   config_;
+    Stats    stats_;
+    Entries  entries_;
+    Age_list age_;    // oldest datagram first
+    std::unique_ptr<BufferStore> pool_;
+    Timers::id_t timer_ = Timers::UNUSED_ID;
+
+    static uint32_t end_of(const Pieces& pieces) noexcept
+    { return pieces.back().offset + pieces.back().length; }
+
+    /** Where the data starts in a buffer, after the packet and header */
+    uint32_t data_offset() const noexcept
+    { return sizeof(Packet) + config_.max_header; }
+
+    Packet_ptr complete(Entries::iterator it);
+    void erase(Entries::iterator it);
+    bool make_room();
+    void arm_timer();
+    void on_timeout(Timers::id_t);
+
+  }; //< class Reassembly
+
+} //< namespace net
+
+#endif //< NET_REASSEMBLY_HPP
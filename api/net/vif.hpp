@@ -15,14 +15,18 @@ class Vif : public Link_layer<Protocol> {
 public:
   using Linklayer  = Link_layer<Protocol>;
 
-  Vif(hw::Nic& link, const int id)
-    : Linklayer(Protocol{{this, &Vif<Protocol>::transmit}, link.mac(), id}),
-      link_{link}, id_{id}, phys_down_{link_.create_physical_downstream()}
+  Vif(hw::Nic& link, const int id, const int outer_id = 0)
+    : Linklayer(Protocol{{this, &Vif<Protocol>::transmit}, link.mac(), id, outer_id}),
+      link_{link}, id_{id}, outer_id_{outer_id},
+      phys_down_{link_.create_physical_downstream()}
   {}
 
   int id() const noexcept
   { return id_; }
 
+  int outer_id() const noexcept
+  { return outer_id_; }
+
   void set_physical_downstream(net::downstream phys_down)
   { phys_down_ = phys_down; }
 
@@ -43,7 +47,11 @@ public:
   { return "Virtual Interface"; }
 
   std::string device_name() const override
-  { return link_.device_name() + "." + std::to_string(id_); }
+  {
+    if (outer_id_)
+      return link_.device_name() + "." + std::to_string(outer_id_) + "." + std::to_string(id_);
+    return link_.device_name() + "." + std::to_string(id_);
+  }
 
   const MAC::Addr& mac() const noexcept override
   { return link_.mac(); }
@@ -75,6 +83,7 @@ public:
 private:
   hw::Nic& link_;
   const int id_;
+  const int outer_id_;
   net::downstream phys_down_ = nullptr;
 
 };
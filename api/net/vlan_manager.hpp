@@ -5,6 +5,8 @@
 
 #include "vif.hpp"
 #include <net/ethernet/ethernet_8021q.hpp>
+#include <array>
+#include <memory>
 
 namespace net {
 
@@ -17,6 +19,9 @@ class VLAN_manager {
 public:
   using VLAN_interface = Vif<Ethernet_8021Q>;
 
+  /** Number of VLAN IDs (12 bit VID) */
+  static constexpr int num_ids = 4096;
+
   /**
    * @brief      Returns a VLAN manager with the given index.
    *             Construct it if it do not already exist.
@@ -38,8 +43,32 @@ public:
    */
   VLAN_interface& add(hw::Nic& link, const int id);
 
+  /**
+   * @brief      Add a double tagged (802.1ad QinQ) VLAN interface on the
+   *             given (physical) link.
+   *
+   * @param      link      The link
+   * @param[in]  outer_id  The service VLAN identifier (S-VID)
+   * @param[in]  id        The customer VLAN identifier (C-VID)
+   *
+   * @return     A newly created VLAN interface
+   */
+  VLAN_interface& add(hw::Nic& link, const int outer_id, const int id);
+
+  /**
+   * @brief      Get the interface for a VLAN ID (and optionally S-VID).
+   *
+   * @return     The interface, or nullptr if none
+   */
+  VLAN_interface* find(const int id, const int outer_id = 0) const noexcept;
+
 private:
-  std::map<int, VLAN_interface*> links_;
+  /** Direct indexed by VLAN ID */
+  using Table = std::array<VLAN_interface*, num_ids>;
+
+  Table links_ {};
+  /** Inner tables for QinQ, indexed by S-VID, allocated on demand */
+  std::array<std::unique_ptr<Table>, num_ids> qinq_ {};
 
   VLAN_manager() = default;
 
@@ -50,6 +79,8 @@ private:
    */
   void receive(Packet_ptr pkt);
 
+  VLAN_interface& insert(hw::Nic& link, const int outer_id, const int id);
+
   /**
    * @brief      Set the vlan upstream on the physical Nic
    *             to point on this manager
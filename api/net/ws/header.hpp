@@ -116,13 +116,17 @@ namespace net {
     }
     void masking_algorithm(char* ptr)
     {
-      const char* mask = keymask();
-      for (size_t i = 0; i < data_length(); i++)
-      {
-        ptr[i] = ptr[i] xor mask[i & 3];
-      }
+      apply_mask(ptr, data_length(), keymask());
     }
 
+    /**
+     * XOR len bytes of data with a 4-byte masking key, vectorized
+     * where the CPU allows it. Offset is the position of data in the
+     * payload, so that a payload can be (un)masked piece by piece.
+     */
+    static void apply_mask(char* data, size_t len, const char* key,
+                           size_t offset = 0) noexcept;
+
     char vla[0];
   } __attribute__((packed)); // < class ws_header
 
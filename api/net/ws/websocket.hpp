@@ -23,39 +23,40 @@ public:
   class Message {
   public:
     using Data     = std::vector<uint8_t>;
-    using Data_it  = Data::iterator;
-    using Data_cit = Data::const_iterator;
+    using Data_it  = uint8_t*;
+    using Data_cit = const uint8_t*;
 
-    auto extract_vector() noexcept {
+    Data extract_vector() {
+      if (buf_ != nullptr) return Data(cbegin(), cend());
       return std::move(data_);
     }
     auto extract_shared_vector() {
-      return std::make_shared<std::vector<uint8_t>> (std::move(data_));
+      return std::make_shared<std::vector<uint8_t>> (extract_vector());
     }
 
     std::string to_string() const
     { return std::string(data(), size()); }
 
     size_t size() const noexcept
-    { return data_.size(); }
+    { return (buf_ != nullptr) ? length_ : data_.size(); }
 
     Data_it begin() noexcept
-    { return data_.begin(); }
+    { return (Data_it) data(); }
 
     Data_it end() noexcept
-    { return data_.end(); }
+    { return begin() + size(); }
 
     Data_cit cbegin() const noexcept
-    { return data_.begin(); }
+    { return (Data_cit) data(); }
 
     Data_cit cend() const noexcept
-    { return data_.end(); }
+    { return cbegin() + size(); }
 
     const char* data() const noexcept
-    { return (const char*) data_.data(); }
+    { return (const char*) ((buf_ != nullptr) ? buf_->data() + offset_ : data_.data()); }
 
     char* data() noexcept
-    { return (char*) data_.data(); }
+    { return (char*) ((buf_ != nullptr) ? buf_->data() + offset_ : data_.data()); }
 
     Message(const uint8_t* data, size_t len)
     {
@@ -74,10 +75,18 @@ public:
       this->append(data, len);
     }
 
+    /**
+     * @brief      A complete frame at @offset in a received buffer.
+     *             The payload is unmasked in place and kept in the
+     *             buffer, which the message holds on to.
+     */
+    Message(net::Stream::buffer_t buf, size_t offset);
+
+    // appends payload (or the rest of the header), unmasking it on the way
     size_t append(const uint8_t* data, size_t len);
 
     bool is_complete() const noexcept
-    { return header_complete() && data_.size() == header().data_length(); }
+    { return header_complete() && size() == header().data_length(); }
 
     const ws_header& header() const noexcept
     { return *(ws_header*) header_.data(); }
@@ -85,14 +94,12 @@ public:
     op_code opcode() const noexcept
     { return header().opcode(); }
 
-    void unmask() noexcept
-    {
-      if (header().is_masked())
-          writable_header().masking_algorithm(this->data());
-    }
-
   private:
     Data data_;
+    // the received buffer holding the payload, when not copied
+    net::Stream::buffer_t buf_ = nullptr;
+    size_t offset_ = 0;
+    size_t length_ = 0;
     std::array<uint8_t, 15> header_;
     uint8_t header_length = 0;
 
@@ -100,9 +107,6 @@ public:
       return header_length >= 2 && header_length >= header().header_length();
     }
 
-    ws_header& writable_header()
-    { return *(ws_header*) header_.data(); }
-
   }; // < class Message
 
   using Message_ptr     = std::unique_ptr<Message>;
@@ -202,6 +206,37 @@ public:
     write((char *)data->data(),data->size());
   }
 
+  /**
+   * @brief      Send the same message to many WebSockets. The frame is
+   *             created once, and the same shared buffer is written to every
+   *             server side socket. Client side sockets have to mask what
+   *             they send, and get a frame of their own.
+   *             Sockets that are closed, or not writable, are skipped.
+   *
+   * @param[in]  sockets  A range of (smart) pointers to WebSockets
+   * @param[in]  data     The message
+   * @param[in]  len      The message length
+   * @param[in]  code     TEXT or BINARY
+   *
+   * @return     The number of sockets written to
+   */
+  template <typename Range>
+  static size_t broadcast(const Range& sockets, const char* data, size_t len,
+                          op_code code = op_code::TEXT)
+  {
+    const auto frame = create_frame(data, len, code);
+    size_t count = 0;
+    for (const auto& ws : sockets)
+      count += ws->write_frame(frame, data, len, code);
+    return count;
+  }
+
+  template <typename Range>
+  static size_t broadcast(const Range& sockets, const std::string& text)
+  {
+    return broadcast(sockets, text.data(), text.size(), op_code::TEXT);
+  }
+
   bool ping(const char* buffer, size_t len, Timer::duration_t timeout)
   {
     ping_timer.start(timeout);
@@ -278,9 +313,11 @@ private:
   WebSocket& operator= (WebSocket&&) = delete;
   void read_data(Stream::buffer_t);
   bool write_opcode(op_code code, const char*, size_t);
+  bool write_frame(const Stream::buffer_t& frame, const char*, size_t, op_code);
+  static Stream::buffer_t create_frame(const char*, size_t, op_code);
   void failure(const std::string&);
   void close_callback_once();
-  size_t create_message(const uint8_t*, size_t len);
+  size_t create_message(const Stream::buffer_t&, const uint8_t*, size_t len);
   void finalize_message();
 
   bool default_on_ping(const char*, size_t)
@@ -0,0 +1,464 @@
+// -*-C++-*-
+
+#pragma once
+#ifndef UTIL_ALLOC_PCPU_HPP
+#define UTIL_ALLOC_PCPU_HPP
+
+#include <common>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+/**
+ * A per-CPU size-class allocator
+ *
+ * Small allocations (up to 8 KiB) are carved out of 64 KiB spans, each
+ * holding objects of one size class and owned by one CPU. Every CPU
+ * allocates from its own spans without locking. Objects freed by
+ * another CPU go onto a lock-free remote list of their span, which the
+ * owner takes back when it runs out of objects. A span left with no free
+ * objects is parked until a remote free makes the freeing CPU hand it
+ * back to the owner.
+ *
+ * Spans, and larger allocations, come from a Source, which must be
+ * thread safe and hand out blocks of a power-of-two size aligned to their
+ * size relative to a page aligned addr_begin() - as the buddy allocator
+ * does. A large allocation is the whole block, with no header in it: the
+ * size of the block is kept in a map with a byte for every page of the
+ * source. The map costs 1/4096 of the heap up front, where a header in
+ * the block would double the memory taken by every allocation of a power
+ * of two.
+ **/
+namespace os::mem::pcpu {
+
+  using Addr_t = uintptr_t;
+  using Size_t = size_t;
+
+  static constexpr Size_t span_size    = 64 * 1024;
+  static constexpr Size_t span_header  = 64;
+  static constexpr Size_t max_small    = 8192;
+  static constexpr Size_t min_align    = 16;
+  static constexpr Size_t page_size    = 4096;
+  static constexpr Size_t max_large    = Size_t(1) << 62;
+  static constexpr int    class_count  = 32;
+
+  /**
+   * The size class of an allocation: 16 to 128 bytes in steps of 16,
+   * then four classes between each power of two up to max_small.
+   **/
+  constexpr int size_class(Size_t size) noexcept
+  {
+    if (size <= 128)
+      return (size <= min_align) ? 0 : (size - 1) / 16;
+    const int bits = 64 - __builtin_clzl(size - 1);
+    const Size_t group_begin = Size_t(1) << (bits - 1);
+    return 8 + (bits - 8) * 4 + ((size - 1 - group_begin) >> (bits - 3));
+  }
+
+  /** The size of the objects of a size class */
+  constexpr Size_t class_size(int cls) noexcept
+  {
+    if (cls < 8)
+      return (cls + 1) * 16;
+    const Size_t base = Size_t(128) << ((cls - 8) / 4);
+    return base + ((cls - 8) % 4 + 1) * (base / 4);
+  }
+
+  static_assert(size_class(max_small) == class_count - 1);
+  static_assert(class_size(class_count - 1) == max_small);
+
+  /** The header at the start of every span */
+  struct alignas(span_header) Span
+  {
+    enum State : uint8_t {
+      current, // allocated from by the owner
+      partial, // in the owner's list of spans with free objects
+      full     // in no list, or handed back by another CPU
+    };
+
+    Span*  prev = nullptr;
+    Span*  next = nullptr;
+    Span*  next_returned = nullptr;
+    void*  free = nullptr;     // freed by the owner
+    Addr_t bump;               // the objects never handed out begin here
+    std::atomic<void*> remote {nullptr}; // freed by other CPUs
+    std::atomic<bool>  parked {false};   // full, waiting for a remote free
+    uint32_t used  = 0;        // handed out, as far as the owner knows
+    uint16_t cpu;
+    uint8_t  cls;
+    State    state = current;
+
+    Span(int cpu_, int cls_) noexcept
+      : bump{reinterpret_cast<Addr_t>(this) + span_header},
+        cpu(cpu_), cls(cls_) {}
+
+    Size_t obj_size() const noexcept
+    { return class_size(cls); }
+
+    Addr_t end() const noexcept
+    { return reinterpret_cast<Addr_t>(this) + span_size; }
+  };
+  static_assert(sizeof(Span) == span_header);
+
+  template <typename Source, int Cpus>
+  class Alloc {
+  public:
+
+    explicit Alloc(Source& src)
+      : source_{src},
+        begin_{src.addr_begin()},
+        map_size_{(src.addr_end() - src.addr_begin() + span_size - 1) / span_size},
+        page_count_{(src.addr_end() - src.addr_begin() + page_size - 1) / page_size}
+    {
+      Expects(begin_ % page_size == 0);
+      chunk_map_ = static_cast<uint8_t*>(source_.allocate(map_size_));
+      Expects(chunk_map_ != nullptr);
+      __builtin_memset(chunk_map_, 0, map_size_);
+      large_map_ = static_cast<uint8_t*>(source_.allocate(page_count_));
+      Expects(large_map_ != nullptr);
+      __builtin_memset(large_map_, 0, page_count_);
+    }
+
+    ~Alloc()
+    {
+      source_.deallocate(large_map_, page_count_);
+      source_.deallocate(chunk_map_, map_size_);
+    }
+
+    Alloc(const Alloc&) = delete;
+    Alloc& operator=(const Alloc&) = delete;
+
+    /** Allocate from the caller's CPU. Returns nullptr when out of memory */
+    void* allocate(Size_t size, int cpu) noexcept
+    {
+      auto& heap = cpus_[cpu];
+      if (UNLIKELY(size > max_small))
+        return allocate_large(heap, min_align, size);
+      return allocate_small(heap, size_class(size), cpu);
+    }
+
+    /** Allocate with an alignment (a power of two) */
+    void* allocate_aligned(Size_t align, Size_t size, int cpu) noexcept
+    {
+      if (align <= min_align)
+        return allocate(size, cpu);
+
+      auto& heap = cpus_[cpu];
+      // spans are page aligned, so are objects of a size class divisible
+      // by the alignment, if small enough
+      if (align <= span_header and size <= max_small) {
+        int cls = size_class((size + align - 1) & ~(align - 1));
+        while (class_size(cls) % align) cls++;
+        return allocate_small(heap, cls, cpu);
+      }
+      return allocate_large(heap, align, size);
+    }
+
+    /** Free from the caller's CPU, which needn't be the one allocating */
+    void deallocate(void* ptr, int cpu) noexcept
+    {
+      if (ptr == nullptr) return;
+      auto& heap = cpus_[cpu];
+      Span* span = span_of(ptr);
+      if (span == nullptr) {
+        deallocate_large(heap, ptr);
+        return;
+      }
+      add(heap.freed, span->obj_size());
+      if (span->cpu == cpu)
+        free_local(heap, span, ptr);
+      else
+        free_remote(span, ptr);
+    }
+
+    /** The usable size of an allocation */
+    Size_t usable_size(void* ptr) const noexcept
+    {
+      if (Span* span = span_of(ptr))
+        return span->obj_size();
+      const auto addr = reinterpret_cast<Addr_t>(ptr);
+      const Size_t total = large_size(addr);
+      return total - (addr - large_block(addr, total));
+    }
+
+    /** Bytes handed out and not yet freed, by all CPUs */
+    Size_t bytes_used() const noexcept
+    {
+      Size_t allocated = 0, freed = 0;
+      for (const auto& heap : cpus_) {
+        allocated += heap.allocated.load(std::memory_order_relaxed);
+        freed     += heap.freed.load(std::memory_order_relaxed);
+      }
+      return allocated - freed;
+    }
+
+    /** Bytes taken from the source, for spans and large allocations */
+    Size_t bytes_reserved() const noexcept
+    { return reserved_.load(std::memory_order_relaxed); }
+
+    /** Spans owned by a CPU, for diagnostics */
+    Size_t span_count(int cpu) const noexcept
+    { return cpus_[cpu].spans; }
+
+  private:
+    struct alignas(128) Cpu_heap {
+      std::array<Span*, class_count> current {};
+      std::array<Span*, class_count> partial {};
+      std::atomic<Span*> returned {nullptr}; // handed back by other CPUs
+      // written by this CPU only
+      std::atomic<Size_t> allocated {0};
+      std::atomic<Size_t> freed {0};
+      Size_t spans = 0;
+    };
+
+    Source& source_;
+    const Addr_t begin_;
+    const Size_t map_size_;
+    const Size_t page_count_;
+    uint8_t* chunk_map_ = nullptr; // 1 for the chunks holding a span
+    uint8_t* large_map_ = nullptr; // log2 of the block of a large allocation, by page
+    std::atomic<Size_t> reserved_ {0};
+    std::array<Cpu_heap, Cpus> cpus_;
+
+    static void add(std::atomic<Size_t>& counter, Size_t bytes) noexcept
+    {
+      // single writer, so no need for a locked instruction
+      counter.store(counter.load(std::memory_order_relaxed) + bytes,
+                    std::memory_order_relaxed);
+    }
+
+    Span* span_of(void* ptr) const noexcept
+    {
+      const auto addr = reinterpret_cast<Addr_t>(ptr);
+      Expects(addr >= begin_);
+      const auto chunk = (addr - begin_) / span_size;
+      Expects(chunk < map_size_);
+      if (chunk_map_[chunk] == 0)
+        return nullptr;
+      return reinterpret_cast<Span*>(begin_ + chunk * span_size);
+    }
+
+    /** The smallest power of two holding @size */
+    static Size_t block_size(Size_t size) noexcept
+    { return (size <= 1) ? 1 : Size_t(1) << (64 - __builtin_clzl(size - 1)); }
+
+    /** The size of the block holding the large allocation at @addr */
+    Size_t large_size(Addr_t addr) const noexcept
+    {
+      const uint8_t order = large_map_[(addr - begin_) / page_size];
+      Expects(order != 0);
+      return Size_t(1) << order;
+    }
+
+    Addr_t large_block(Addr_t addr, Size_t total) const noexcept
+    { return begin_ + ((addr - begin_) & ~(total - 1)); }
+
+    void* allocate_small(Cpu_heap& heap, int cls, int cpu) noexcept
+    {
+      Span* span = heap.current[cls];
+      void* ptr = span ? pop(span) : nullptr;
+      if (UNLIKELY(ptr == nullptr))
+      {
+        span = refill(heap, cls, cpu);
+        if (span == nullptr) return nullptr;
+        ptr = pop(span);
+      }
+      add(heap.allocated, span->obj_size());
+      return ptr;
+    }
+
+    /** An object of the span, or nullptr if it has none left */
+    static void* pop(Span* span) noexcept
+    {
+      if (span->free == nullptr)
+      {
+        const auto size = span->obj_size();
+        if (span->bump + size <= span->end())
+        {
+          auto* ptr = reinterpret_cast<void*>(span->bump);
+          span->bump += size;
+          span->used++;
+          return ptr;
+        }
+        if (collect_remote(span) == 0)
+          return nullptr;
+      }
+      void* ptr = span->free;
+      span->free = *static_cast<void**>(ptr);
+      span->used++;
+      return ptr;
+    }
+
+    /** Take back the objects freed by other CPUs, returning the count */
+    static uint32_t collect_remote(Span* span) noexcept
+    {
+      void* list = span->remote.exchange(nullptr, std::memory_order_acquire);
+      if (list == nullptr) return 0;
+      uint32_t count = 1;
+      void* tail = list;
+      while (*static_cast<void**>(tail) != nullptr) {
+        tail = *static_cast<void**>(tail);
+        count++;
+      }
+      *static_cast<void**>(tail) = span->free;
+      span->free = list;
+      span->used -= count;
+      return count;
+    }
+
+    /** Replace the exhausted span of a class. */
+    Span* refill(Cpu_heap& heap, int cls, int cpu) noexcept
+    {
+      // the spans other CPUs made room in
+      Span* ret = heap.returned.exchange(nullptr, std::memory_order_acquire);
+      while (ret != nullptr) {
+        Span* next = ret->next_returned;
+        make_partial(heap, ret);
+        ret = next;
+      }
+
+      if (Span* old = heap.current[cls]) {
+        heap.current[cls] = nullptr;
+        park(heap, old);
+      }
+
+      Span* span = heap.partial[cls];
+      while (span != nullptr)
+      {
+        unlink(heap, span);
+        if (span->free || collect_remote(span) || span->bump + span->obj_size() <= span->end())
+          break;
+        park(heap, span);
+        span = heap.partial[cls];
+      }
+
+      if (span == nullptr)
+      {
+        void* mem = source_.allocate(span_size);
+        if (mem == nullptr) return nullptr;
+        const auto addr = reinterpret_cast<Addr_t>(mem);
+        Expects((addr - begin_) % span_size == 0);
+        span = new (mem) Span(cpu, cls);
+        chunk_map_[(addr - begin_) / span_size] = 1;
+        reserved_.fetch_add(span_size, std::memory_order_relaxed);
+        heap.spans++;
+      }
+      span->state = Span::current;
+      heap.current[cls] = span;
+      return span;
+    }
+
+    /** Set aside a span without free objects, until one is freed */
+    void park(Cpu_heap& heap, Span* span) noexcept
+    {
+      span->state = Span::full;
+      span->parked.store(true);
+      // a remote free may have come in before it saw the span parked
+      if (span->remote.load() != nullptr and span->parked.exchange(false))
+        make_partial(heap, span);
+    }
+
+    void make_partial(Cpu_heap& heap, Span* span) noexcept
+    {
+      auto& head = heap.partial[span->cls];
+      span->state = Span::partial;
+      span->prev = nullptr;
+      span->next = head;
+      if (head) head->prev = span;
+      head = span;
+    }
+
+    void unlink(Cpu_heap& heap, Span* span) noexcept
+    {
+      if (span->prev) span->prev->next = span->next;
+      else heap.partial[span->cls] = span->next;
+      if (span->next) span->next->prev = span->prev;
+      span->prev = span->next = nullptr;
+    }
+
+    void free_local(Cpu_heap& heap, Span* span, void* ptr) noexcept
+    {
+      *static_cast<void**>(ptr) = span->free;
+      span->free = ptr;
+      span->used--;
+
+      switch (span->state) {
+      case Span::current:
+        break;
+      case Span::full:
+        // unless another CPU is already handing it back
+        if (span->parked.exchange(false))
+          make_partial(heap, span);
+        break;
+      case Span::partial:
+        if (span->used == 0)
+          release(heap, span);
+        break;
+      }
+    }
+
+    void free_remote(Span* span, void* ptr) noexcept
+    {
+      void* head = span->remote.load(std::memory_order_relaxed);
+      do {
+        *static_cast<void**>(ptr) = head;
+      } while (not span->remote.compare_exchange_weak(head, ptr));
+
+      // the first free into a parked span hands it back to the owner
+      if (span->parked.load() and span->parked.exchange(false))
+      {
+        auto& returned = cpus_[span->cpu].returned;
+        Span* next = returned.load(std::memory_order_relaxed);
+        do {
+          span->next_returned = next;
+        } while (not returned.compare_exchange_weak(next, span,
+                       std::memory_order_release, std::memory_order_relaxed));
+      }
+    }
+
+    void release(Cpu_heap& heap, Span* span) noexcept
+    {
+      unlink(heap, span);
+      const auto addr = reinterpret_cast<Addr_t>(span);
+      chunk_map_[(addr - begin_) / span_size] = 0;
+      span->~Span();
+      source_.deallocate(span, span_size);
+      reserved_.fetch_sub(span_size, std::memory_order_relaxed);
+      heap.spans--;
+    }
+
+    void* allocate_large(Cpu_heap& heap, Size_t align, Size_t size) noexcept
+    {
+      if (UNLIKELY(size > max_large or align > max_large)) return nullptr;
+      // blocks are aligned to their size from begin_, so to the alignment
+      // too, unless it is larger than a page and begin_ isn't aligned to it
+      Size_t total = block_size(std::max({size, align, page_size}));
+      if (align > page_size and (begin_ & (align - 1)) != 0)
+        total = block_size(size + align);
+      void* block = source_.allocate(total);
+      if (block == nullptr) return nullptr;
+
+      const auto base = reinterpret_cast<Addr_t>(block);
+      const auto data = (base + align - 1) & ~(align - 1);
+      Expects((data - begin_) % page_size == 0);
+      large_map_[(data - begin_) / page_size] = __builtin_ctzl(total);
+      reserved_.fetch_add(total, std::memory_order_relaxed);
+      add(heap.allocated, usable_size(reinterpret_cast<void*>(data)));
+      return reinterpret_cast<void*>(data);
+    }
+
+    void deallocate_large(Cpu_heap& heap, void* ptr) noexcept
+    {
+      const auto addr = reinterpret_cast<Addr_t>(ptr);
+      const Size_t total = large_size(addr);
+      add(heap.freed, usable_size(ptr));
+      large_map_[(addr - begin_) / page_size] = 0;
+      source_.deallocate(reinterpret_cast<void*>(large_block(addr, total)), total);
+      reserved_.fetch_sub(total, std::memory_order_relaxed);
+    }
+  };
+
+} // os::mem::pcpu
+
+#endif
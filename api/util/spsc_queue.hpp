@@ -0,0 +1,124 @@
+
+#pragma once
+#ifndef UTIL_SPSC_QUEUE_HPP
+#define UTIL_SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace util
+{
+
+/**
+ * A lock-free ring of fixed capacity, between one producer and one consumer.
+ *
+ * The indices written by each side live on cache lines of their own, and
+ * each side keeps a copy of the other's index, reading it again only when
+ * the ring looks full (or empty). Consuming in batches publishes the new
+ * head once per batch.
+ **/
+template<typename T, size_t N> class spsc_queue
+{
+public:
+	static_assert(N > 0 && (N & (N - 1)) == 0, "spsc_queue size must be a power of two");
+
+	spsc_queue() = default;
+	spsc_queue(const spsc_queue&) = delete;
+	spsc_queue& operator= (const spsc_queue&) = delete;
+
+	~spsc_queue()
+	{
+		consume_all([] (T&) {});
+	}
+
+	/** Add an item, by the producer. Returns false when full */
+	template <typename... Args>
+	bool emplace(Args&&... args)
+		noexcept(std::is_nothrow_constructible<T, Args...>::value)
+	{
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - head_cache_ == N)
+		{
+			head_cache_ = head_.load(std::memory_order_acquire);
+			if (tail - head_cache_ == N)
+				return false;
+		}
+		new (slot(tail)) T(std::forward<Args>(args)...);
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool push(T&& item)
+	{ return emplace(std::move(item)); }
+
+	bool push(const T& item)
+	{ return emplace(item); }
+
+	/** Take the oldest item, by the consumer */
+	bool pop(T& item)
+	{
+		const size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_cache_)
+		{
+			tail_cache_ = tail_.load(std::memory_order_acquire);
+			if (head == tail_cache_)
+				return false;
+		}
+		T* ptr = slot(head);
+		item = std::move(*ptr);
+		ptr->~T();
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** Call @func with every item there is, by the consumer. Returns the count */
+	template <typename Func>
+	size_t consume_all(Func&& func)
+	{
+		const size_t head = head_.load(std::memory_order_relaxed);
+		tail_cache_ = tail_.load(std::memory_order_acquire);
+		const size_t count = tail_cache_ - head;
+		for (size_t i = head; i != tail_cache_; i++)
+		{
+			T* ptr = slot(i);
+			T item {std::move(*ptr)};
+			ptr->~T();
+			func(item);
+		}
+		if (count)
+			head_.store(tail_cache_, std::memory_order_release);
+		return count;
+	}
+
+	/** The number of items, as seen at some point during the call */
+	size_t size() const noexcept
+	{ return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+
+	bool empty() const noexcept
+	{ return size() == 0; }
+
+	static constexpr size_t capacity() noexcept
+	{ return N; }
+
+private:
+	using storage_t = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+	T* slot(size_t index) noexcept
+	{ return reinterpret_cast<T*>(&slots_[index & (N - 1)]); }
+
+	// consumer
+	alignas(64) std::atomic<size_t> head_ {0};
+	size_t tail_cache_ = 0;
+	// producer
+	alignas(64) std::atomic<size_t> tail_ {0};
+	size_t head_cache_ = 0;
+
+	alignas(64) std::array<storage_t, N> slots_;
+};
+
+} // util
+
+#endif
@@ -0,0 +1,105 @@
+
+#pragma once
+#ifndef UTIL_WORK_DEQUE_HPP
+#define UTIL_WORK_DEQUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace util
+{
+
+/**
+ * A lock-free work-stealing deque of fixed capacity (Chase-Lev).
+ *
+ * The owner pushes and pops at the bottom, newest first, while any
+ * number of thieves steal from the top, oldest first. Only a steal racing
+ * with the owner for the last item needs a compare-and-swap.
+ *
+ * See "Correct and Efficient Work-Stealing for Weak Memory Models",
+ * Lê, Pop, Cohen and Zappa Nardelli, PPoPP 2013.
+ **/
+template<typename T, size_t N> class work_deque
+{
+public:
+	static_assert(N > 0 && (N & (N - 1)) == 0, "work_deque size must be a power of two");
+	static_assert(std::is_trivially_copyable<T>::value, "work_deque items must be trivially copyable");
+
+	/** Push an item, by the owner. Returns false when full */
+	bool push(T item) noexcept
+	{
+		const int64_t b = bottom_.load(std::memory_order_relaxed);
+		const int64_t t = top_.load(std::memory_order_acquire);
+		if (b - t >= (int64_t) N)
+			return false;
+		buff_[b & MASK].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom_.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/** Pop the newest item, by the owner */
+	bool pop(T& item) noexcept
+	{
+		const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+		bottom_.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top_.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			// empty
+			bottom_.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+		item = buff_[b & MASK].load(std::memory_order_relaxed);
+		if (t < b)
+			return true;
+
+		// the last one, which a thief may be taking
+		const bool won = top_.compare_exchange_strong(t, t + 1,
+		    std::memory_order_seq_cst, std::memory_order_relaxed);
+		bottom_.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+
+	/** Steal the oldest item, by anyone. Fails when empty, or when losing a race */
+	bool steal(T& item) noexcept
+	{
+		int64_t t = top_.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t b = bottom_.load(std::memory_order_acquire);
+		if (t >= b)
+			return false;
+
+		item = buff_[t & MASK].load(std::memory_order_relaxed);
+		return top_.compare_exchange_strong(t, t + 1,
+		    std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	/** The number of items, as seen at some point during the call */
+	size_t size() const noexcept
+	{
+		const int64_t b = bottom_.load(std::memory_order_relaxed);
+		const int64_t t = top_.load(std::memory_order_relaxed);
+		return (b > t) ? b - t : 0;
+	}
+
+	bool empty() const noexcept
+	{ return size() == 0; }
+
+	static constexpr size_t capacity() noexcept
+	{ return N; }
+
+private:
+	static constexpr int64_t MASK = N - 1;
+	// apart, as thieves write the top and the owner the bottom
+	alignas(64) std::atomic<int64_t> top_ {0};
+	alignas(64) std::atomic<int64_t> bottom_ {0};
+	alignas(64) std::array<std::atomic<T>, N> buff_ {};
+};
+
+} // util
+
+#endif
@@ -212,6 +212,19 @@ public:
     void enable_interrupts();
     bool interrupts_enabled() const noexcept;
 
+    /** Enable interrupts, but with event indices only once 3/4 of the
+        buffers in flight are used, coalescing completions */
+    void enable_interrupts_delayed();
+
+    /** Use the used_event / avail_event fields. Only if VIRTIO_F_EVENT_IDX */
+    void set_event_idx(bool enabled) noexcept
+    { _event_idx = enabled; }
+
+    /** Whether moving an index from @old_idx to @new_idx passes @event.
+        Virtio std. §2.4.7.2 */
+    static bool need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx) noexcept
+    { return (uint16_t) (new_idx - event - 1) < (uint16_t) (new_idx - old_idx); }
+
     /** Release token. @param head : the token ID to release*/
     void release(uint32_t head);
 
@@ -262,6 +275,14 @@ public:
     /** Initialize the queue buffer */
     void init_queue(int size, char* buf);
 
+    /** Interrupt when the used index passes this. After the avail ring */
+    volatile le16& used_event() noexcept
+    { return *(volatile le16*) &_queue.avail->ring[_size]; }
+
+    /** Notify when the avail index passes this. After the used ring */
+    volatile le16& avail_event() noexcept
+    { return *(volatile le16*) &_queue.used->ring[_size]; }
+
     std::string qname;
 
     // The size as read from the PCI device
@@ -276,6 +297,7 @@ public:
     uint16_t _desc_in_flight = 0; // Entries in _queue_desc currently in use
     uint16_t _last_used_idx = 0; // Last known value of _queue.used->idx
     uint16_t _pci_index = 0; // Queue nr.
+    bool _event_idx = false; // Using event indices
   };
 
 
@@ -14,6 +14,7 @@
 #include <vector>
 struct storage_entry;
 struct storage_header;
+namespace http { class Session_cache; }
 
 namespace liu
 {
@@ -144,6 +145,8 @@ struct Storage
   // store a Stream, but not its underlying transport
   // NOTE: UID is taken and used to determine its underlying type
   void add_stream(net::Stream&);
+  // store the TLS sessions and ticket keys of a HTTPS server
+  void add_tls_sessions(uid, const http::Session_cache&);
 
   // markers are used to delineate the end of variable-length structures
   void put_marker(uid);
@@ -188,6 +191,8 @@ struct Restore
   // 2. select whether or not its an outgoing or incoming connection
   // 3. provide the underlying transport stream, for example a TCP stream
   net::Stream_ptr as_tls_stream(void* ctx, bool outgoing, net::Stream_ptr tr);
+  // add the stored TLS sessions (that haven't expired) to a cache
+  void            as_tls_sessions(http::Session_cache&) const;
 
   template <typename S>
   inline const S& as_type() const;
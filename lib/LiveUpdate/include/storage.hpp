@@ -25,6 +25,7 @@ enum storage_type
   TYPE_TCP6   = 101,
   TYPE_WEBSOCKET  = 105,
   TYPE_STREAM = 106,
+  TYPE_TLS_SESSIONS = 107,
 };
 
 struct segmented_entry
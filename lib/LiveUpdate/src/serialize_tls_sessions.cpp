@@ -0,0 +1,21 @@
+#include <net/https/session_cache.hpp>
+#include "liveupdate.hpp"
+#include "storage.hpp"
+
+namespace liu
+{
+  void Storage::add_tls_sessions(uid id, const http::Session_cache& cache)
+  {
+    const size_t size = cache.serialized_size();
+    auto& entry = hdr.add_struct(TYPE_TLS_SESSIONS, id, size);
+    cache.serialize_to(entry.vla, size);
+  }
+
+  void Restore::as_tls_sessions(http::Session_cache& cache) const
+  {
+    if (ent->type != TYPE_TLS_SESSIONS) {
+      throw std::runtime_error("LiveUpdate: Restore::as_tls_sessions() encountered incorrect type " + std::to_string(ent->type));
+    }
+    cache.deserialize_from(ent->vla, ent->len);
+  }
+}
@@ -100,6 +100,11 @@ __clone_helper:
 __clone_return:
     mov rbx, rdi
     mov rsp, rsi
+    ;; off the previous thread's stack, let others resume it
+    test rdx, rdx
+    jz .restore
+    mov BYTE [rdx], 0
+.restore:
 
     pop rax ;; restore thread id
     pop rbp
@@ -29,9 +29,18 @@ __thread_yield:
     ;; align stack
     sub rsp, 8
     call __thread_suspend_and_yield
+    ;; returns only when there was no other thread to run
+    add rsp, 8
+    mov rsi, rsp
+    xor rdx, rdx
 
 __thread_restore:
     mov rsp, rsi
+    ;; off the previous thread's stack, let others resume it
+    test rdx, rdx
+    jz .restore
+    mov BYTE [rdx], 0
+.restore:
     ;; restore saved registers
     pop r15
     pop r14
@@ -26,6 +26,10 @@ static const uint32_t RXO  = 1 << 6; // receiver (rx) overrun
 static const uint32_t RXTO = 1 << 7; // receive timer interrupt
 #define LEGACY_INTR_MASK() (TXDW | TXQE | LSC | RXDMTO | RXO | RXTO)
 #define MSIX_INTR_MASK() (LSC | RXO | (1 << 20) | (1 << 22) | (1 << 24))
+#define LEGACY_RX_MASK() (RXDMTO | RXO | RXTO)
+#define MSIX_RX_MASK()   (1 << 20)
+// interrupt throttling, in units of 256ns: at most 20000 interrupts/sec
+static const uint32_t ITR_INTERVAL = 1000000000 / (20000 * 256);
 
 static int deferred_event = 0;
 static std::vector<e1000*> deferred_devices;
@@ -118,7 +122,7 @@ e1000::e1000(hw::PCI_Device& d, uint16_t mtu) :
 
   if (deferred_event == 0)
   {
-    deferred_event = Events::get().subscribe(&e1000::do_deferred_xmit);
+    deferred_event = Events::get().subscribe(&e1000::do_deferred_xmit, Events::PRIO_LOW);
   }
 
   // shared-memory & I/O address
@@ -206,13 +210,15 @@ e1000::e1000(hw::PCI_Device& d, uint16_t mtu) :
 
     // configure IVAR and MSI-X table entries
     this->config_msix();
+    for (int vec = 0; vec < 3; vec++)
+      write_cmd(REG_EITR(vec), ITR_INTERVAL);
 
     // CTRL_EXT = MSI-X PBA + **normal** IAME
     write_cmd(REG_CTRL_EXT, (1 << 31) | (1 << 27));
   }
   else
   {
-    write_cmd(REG_ITR, 100);
+    write_cmd(REG_ITR, ITR_INTERVAL);
     //write_cmd(REG_IAM, 0x0);
     // CTRL_EXT = IAME
     //write_cmd(REG_CTRL_EXT, (1 << 27));
@@ -265,7 +271,7 @@ e1000::e1000(hw::PCI_Device& d, uint16_t mtu) :
 #ifdef E1000E_FAKE_EVENT_HANDLER
   Timers::periodic(std::chrono::milliseconds(1),
     [this] (int) {
-      this->receive_handler();
+      this->napi_rx(napi_budget());
       this->transmit_handler();
       this->event_handler();
     });
@@ -277,7 +283,7 @@ void e1000::config_msix()
   #define IVAR_INT_ALLOC_VALID 0x8 // 10.2.4.9 p.328
   uint32_t ivar = 0;
   // rx queue 0 2:0
-  uint8_t vec0 = Events::get().subscribe({this, &e1000::receive_handler});
+  uint8_t vec0 = Events::get().subscribe([this] { this->napi_schedule(); }, Events::PRIO_HIGH);
   int m0 = m_pcidev.setup_msix_vector(SMP::cpu_id(), IRQ_BASE + vec0);
   ivar |= (IVAR_INT_ALLOC_VALID | m0);
 
@@ -485,7 +491,7 @@ void e1000::event_handler()
   if (status & RXDMTO)
   {
     PRINT("[e1000] rx descriptor minimum treshold hit!\n");
-    this->receive_handler();
+    this->napi_schedule();
   }
   if (status & RXO)
   {
@@ -494,20 +500,20 @@ void e1000::event_handler()
   // rx timer interrupt
   if (status & RXTO)
   {
-    this->receive_handler();
+    this->napi_schedule();
   }
 
   // ready to handle more events
   this->intr_cause_clear();
 }
 
-void e1000::receive_handler()
+int e1000::napi_rx(const int budget)
 {
   uint16_t old_idx = 0;
-  uint32_t received = 0;
+  int received = 0;
   std::array<net::Packet_ptr, NUM_RX_DESC> recv_array;
 
-  while (true)
+  while (received < std::min(budget, NUM_RX_DESC))
   {
     auto& tk = rx.desc[rx.current];
     if ((tk.status & 1) == 0) break;
@@ -538,10 +544,20 @@ void e1000::receive_handler()
     // acknowledge all rx packets
     write_cmd(REG_RXDESCTAIL, old_idx);
     // process rx packets
-    for (uint32_t i = 0; i < received; i++) {
+    for (int i = 0; i < received; i++) {
       Link_layer::receive(std::move(recv_array[i]));
     }
   }
+  return received;
+}
+void e1000::napi_irq(const bool enable)
+{
+  const uint32_t mask = (this->use_msix) ? MSIX_RX_MASK() : LEGACY_RX_MASK();
+  write_cmd(enable ? REG_IMS : REG_IMC, mask);
+}
+bool e1000::napi_pending()
+{
+  return (rx.desc[rx.current].status & 1) != 0;
 }
 
 void e1000::transmit_handler()
@@ -658,7 +674,7 @@ void e1000::flush()
 }
 void e1000::poll()
 {
-  this->receive_handler();
+  this->napi_rx(napi_budget());
 }
 void e1000::deactivate()
 {
@@ -84,7 +84,9 @@ private:
   net::Packet_ptr recv_packet(uint8_t*, uint16_t);
   uintptr_t       new_rx_packet();
   void event_handler();
-  void receive_handler();
+  int  napi_rx(int budget) override;
+  void napi_irq(bool enable) override;
+  bool napi_pending() override;
   void transmit_handler();
   uint16_t free_transmit_descr() const noexcept;
   bool can_transmit() const noexcept;
@@ -75,7 +75,9 @@ VirtioNet::VirtioNet(hw::PCI_Device& d, const uint16_t /*mtu*/)
     | (1 << VIRTIO_NET_F_MAC)
     | (1 << VIRTIO_NET_F_STATUS)
     ;//| (1 << VIRTIO_NET_F_MRG_RXBUF); //Merge RX Buffers (Everything i 1 buffer)
-  uint32_t wanted_features = needed_features;
+  // event indices let us coalesce interrupts and notifications
+  uint32_t wanted_features = needed_features
+    | (probe_features() & (1 << VIRTIO_F_RING_EVENT_IDX));
   negotiate_features(wanted_features);
 
 
@@ -118,6 +120,10 @@ VirtioNet::VirtioNet(hw::PCI_Device& d, const uint16_t /*mtu*/)
   new (&tx_q) Virtio::Queue(device_name() + ".tx_q", queue_size(1),1,iobase());
   new (&ctrl_q) Virtio::Queue(device_name() + ".ctl_q", queue_size(2),2,iobase());
 
+  const bool event_idx = wanted_features & (1 << VIRTIO_F_RING_EVENT_IDX);
+  rx_q.set_event_idx(event_idx);
+  tx_q.set_event_idx(event_idx);
+
   // Step 1 - Initialize RX/TX queues
   auto success = assign_queue(0, rx_q.queue_desc());
   CHECKSERT(success, "RX queue (%u) assigned (%p) to device",
@@ -172,7 +178,7 @@ VirtioNet::VirtioNet(hw::PCI_Device& d, const uint16_t /*mtu*/)
     assert(get_msix_vectors() >= 3);
     auto& irqs = this->get_irqs();
     // update BSP IDT
-    Events::get().subscribe(irqs[0], {this, &VirtioNet::msix_recv_handler});
+    Events::get().subscribe(irqs[0], {this, &VirtioNet::msix_recv_handler}, Events::PRIO_HIGH);
     Events::get().subscribe(irqs[1], {this, &VirtioNet::msix_xmit_handler});
     Events::get().subscribe(irqs[2], {this, &VirtioNet::msix_conf_handler});
   }
@@ -186,7 +192,7 @@ VirtioNet::VirtioNet(hw::PCI_Device& d, const uint16_t /*mtu*/)
   static bool init_deferred = false;
   if (!init_deferred) {
     init_deferred = true;
-    auto defirq = Events::get().subscribe(handle_deferred_devices);
+    auto defirq = Events::get().subscribe(handle_deferred_devices, Events::PRIO_LOW);
     PER_CPU(deferred_devs).irq = defirq;
   }
 #endif
@@ -213,16 +219,20 @@ void VirtioNet::msix_conf_handler()
   VDBG("\t    New status: 0x%x \n",_conf.status);
 }
 void VirtioNet::msix_recv_handler()
+{
+  Nic::napi_schedule();
+}
+int VirtioNet::napi_rx(const int budget)
 {
   auto rx = stat_packets_rx_total_;
-  rx_q.disable_interrupts();
   // handle incoming packets as long as bufstore has available buffers
-  int max = 128;
-  while (rx_q.new_incoming() && max-- > 0)
+  int received = 0;
+  while (received < budget && rx_q.new_incoming())
   {
     auto res = rx_q.dequeue();
     VDBG_RX("[virtionet] Recv %u bytes\n", (uint32_t) res.size());
     auto pckt = recv_packet(res.data(), res.size());
+    received++;
 
     // Stat increase packets received
     stat_packets_rx_total_++;
@@ -238,8 +248,19 @@ void VirtioNet::msix_recv_handler()
     }
     add_receive_buffer(bufstore().get_buffer());
   }
-  rx_q.enable_interrupts();
   if (rx != stat_packets_rx_total_) rx_q.kick();
+  return received;
+}
+void VirtioNet::napi_irq(const bool enable)
+{
+  if (enable)
+    rx_q.enable_interrupts();
+  else
+    rx_q.disable_interrupts();
+}
+bool VirtioNet::napi_pending()
+{
+  return rx_q.new_incoming() > 0;
 }
 void VirtioNet::msix_xmit_handler()
 {
@@ -254,7 +275,8 @@ void VirtioNet::msix_xmit_handler()
     net::Packet::operator delete(res.data() - sizeof(net::Packet));
     dequeued_tx++;
   }
-  tx_q.enable_interrupts();
+  // no need to hear about every completed packet
+  tx_q.enable_interrupts_delayed();
 
   // If we have a transmit queue, eat from it, otherwise let the stack know we
   // have increased transmit capacity
@@ -408,7 +430,7 @@ void VirtioNet::handle_deferred_devices()
 
 void VirtioNet::poll()
 {
-  msix_recv_handler();
+  napi_rx(napi_budget());
   msix_xmit_handler();
   // flush transmit_q immediately
   if (this->deferred_kick)
@@ -440,12 +462,12 @@ void VirtioNet::move_to_this_cpu()
   this->Virtio::move_to_this_cpu();
   // reset the IRQ handlers on this CPU
   auto& irqs = this->Virtio::get_irqs();
-  Events::get().subscribe(irqs[0], {this, &VirtioNet::msix_recv_handler});
+  Events::get().subscribe(irqs[0], {this, &VirtioNet::msix_recv_handler}, Events::PRIO_HIGH);
   Events::get().subscribe(irqs[1], {this, &VirtioNet::msix_xmit_handler});
   Events::get().subscribe(irqs[2], {this, &VirtioNet::msix_conf_handler});
 #ifndef NO_DEFERRED_KICK
   // update deferred kick IRQ
-  auto defirq = Events::get().subscribe(handle_deferred_devices);
+  auto defirq = Events::get().subscribe(handle_deferred_devices, Events::PRIO_LOW);
   PER_CPU(deferred_devs).irq = defirq;
 #endif
 }
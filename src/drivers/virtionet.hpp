@@ -208,6 +208,11 @@ private:
   /** Legacy IRQ handler */
   void legacy_handler();
 
+  /** Interrupt mitigation, see hw::Nic */
+  int  napi_rx(int budget) override;
+  void napi_irq(bool enable) override;
+  bool napi_pending() override;
+
   /** Allocate and queue buffer from bufstore_ in RX queue. */
   void add_receive_buffer(uint8_t*);
 
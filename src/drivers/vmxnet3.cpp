@@ -149,7 +149,7 @@ vmxnet3::vmxnet3(hw::PCI_Device& d, const uint16_t mtu) :
     Events::get().subscribe(irqs[0], {this, &vmxnet3::msix_evt_handler});
     Events::get().subscribe(irqs[1], {this, &vmxnet3::msix_xmit_handler});
     for (int q = 0; q < NUM_RX_QUEUES; q++)
-    Events::get().subscribe(irqs[2 + q], {this, &vmxnet3::msix_recv_handler});
+    Events::get().subscribe(irqs[2 + q], {this, &vmxnet3::msix_recv_handler}, Events::PRIO_HIGH);
   }
   else {
     assert(0 && "This driver does not support legacy IRQs");
@@ -263,7 +263,7 @@ vmxnet3::vmxnet3(hw::PCI_Device& d, const uint16_t mtu) :
   }
 
   // deferred transmit
-  this->deferred_irq = Events::get().subscribe(handle_deferred);
+  this->deferred_irq = Events::get().subscribe(handle_deferred, Events::PRIO_LOW);
 
   // enable interrupts
   enable_intr(0);
@@ -443,12 +443,38 @@ void vmxnet3::msix_xmit_handler()
   this->enable_intr(1);
 }
 void vmxnet3::msix_recv_handler()
+{
+  Nic::napi_schedule();
+}
+int vmxnet3::napi_rx(const int budget)
+{
+  int received = 0;
+  for (int q = 0; q < NUM_RX_QUEUES; q++)
+  {
+      received += this->receive_handler(q, budget - received);
+  }
+  return received;
+}
+void vmxnet3::napi_irq(const bool enable)
 {
   for (int q = 0; q < NUM_RX_QUEUES; q++)
   {
-      this->receive_handler(q);
+    if (enable)
+      this->enable_intr(2 + q);
+    else
+      this->disable_intr(2 + q);
   }
 }
+bool vmxnet3::napi_pending()
+{
+  for (int q = 0; q < NUM_RX_QUEUES; q++)
+  {
+    uint32_t idx = rx[q].consumers % VMXNET3_NUM_RX_COMP;
+    uint32_t gen = (rx[q].consumers & VMXNET3_NUM_RX_COMP) ? 0 : VMXNET3_RXCF_GEN;
+    if (gen == (dma->rx[q].comp[idx].flags & VMXNET3_RXCF_GEN)) return true;
+  }
+  return false;
+}
 
 bool vmxnet3::transmit_handler()
 {
@@ -486,11 +512,10 @@ bool vmxnet3::transmit_handler()
   }
   return transmitted;
 }
-bool vmxnet3::receive_handler(const int Q)
+int vmxnet3::receive_handler(const int Q, const int budget)
 {
   std::vector<net::Packet_ptr> recvq;
-  this->disable_intr(2 + Q);
-  while (true)
+  while ((int) recvq.size() < budget)
   {
     uint32_t idx = rx[Q].consumers % VMXNET3_NUM_RX_COMP;
     uint32_t gen = (rx[Q].consumers & VMXNET3_NUM_RX_COMP) ? 0 : VMXNET3_RXCF_GEN;
@@ -531,7 +556,6 @@ bool vmxnet3::receive_handler(const int Q)
 
     rx[Q].buffers[desc] = nullptr;
   }
-  this->enable_intr(2 + Q);
   // refill always
   if (!recvq.empty()) {
     this->refill(rx[Q]);
@@ -540,7 +564,7 @@ bool vmxnet3::receive_handler(const int Q)
   for (auto& pckt : recvq) {
     Link::receive(std::move(pckt));
   }
-  return recvq.empty() == false;
+  return recvq.size();
 }
 
 void vmxnet3::transmit(net::Packet_ptr pckt_ptr)
@@ -641,7 +665,7 @@ void vmxnet3::poll()
   do {
     work = false;
     for (int q = 0; q < NUM_RX_QUEUES; q++)
-        work |= receive_handler(q);
+        work |= receive_handler(q, napi_budget()) > 0;
     // transmit
     work |= transmit_handler();
     // immediately flush when possible
@@ -71,7 +71,10 @@ private:
   void msix_evt_handler();
   void msix_xmit_handler();
   void msix_recv_handler();
-  bool receive_handler(int);
+  int  receive_handler(int queue, int budget);
+  int  napi_rx(int budget) override;
+  void napi_irq(bool enable) override;
+  bool napi_pending() override;
   bool transmit_handler();
   void enable_intr(uint8_t idx) noexcept;
   void disable_intr(uint8_t idx) noexcept;
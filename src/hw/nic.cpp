@@ -1,5 +1,7 @@
 
 #include <hw/nic.hpp>
+#include <kernel/events.hpp>
+#include <smp>
 
 namespace hw
 {
@@ -9,4 +11,39 @@ namespace hw
     (void) idx;
     return default_MTU;
   }
+
+  void Nic::napi_schedule()
+  {
+    if (m_napi_scheduled) return;
+    m_napi_scheduled = true;
+    napi_irq(false);
+
+    // the event belongs to the CPU taking the interrupts
+    if (m_napi_event < 0 || m_napi_cpu != SMP::cpu_id()) {
+      // the event of the CPU taking them before goes, on that CPU
+      if (m_napi_event >= 0) {
+        const uint8_t old_event = m_napi_event;
+        SMP::post(m_napi_cpu, [old_event] {
+          Events::get().unsubscribe(old_event);
+        });
+      }
+      m_napi_event = Events::get().subscribe({this, &Nic::napi_poll}, Events::PRIO_HIGH);
+      m_napi_cpu = SMP::cpu_id();
+    }
+    Events::get().trigger_event(m_napi_event);
+  }
+
+  void Nic::napi_poll()
+  {
+    if (napi_rx(m_napi_budget) >= m_napi_budget) {
+      // there is more, but let the other events go first
+      Events::get().trigger_event(m_napi_event);
+      return;
+    }
+    m_napi_scheduled = false;
+    napi_irq(true);
+    // packets arriving before the unmask raised no interrupt
+    if (napi_pending())
+      napi_schedule();
+  }
 }
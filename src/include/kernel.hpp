@@ -29,6 +29,7 @@ namespace kernel {
     const char* cmdline        = nullptr;
     int  panics                = 0;
     os::Panic_action panic_action {};
+    std::chrono::microseconds busy_poll {0};
     util::KHz cpu_khz {-1};
 	// Memory Mapping buffer (stored for live updates)
 	void*    mmap_addr  = nullptr;
@@ -85,6 +86,14 @@ namespace kernel {
     state().panic_action = action;
   }
 
+  inline std::chrono::microseconds busy_poll() noexcept {
+    return state().busy_poll;
+  }
+
+  inline void set_busy_poll(std::chrono::microseconds max_spin) noexcept {
+    state().busy_poll = max_spin;
+  }
+
   using ctor_t = void (*)();
   inline void run_ctors(ctor_t* begin, ctor_t* end)
   {
@@ -24,38 +24,42 @@ Events& Events::get()
 
 void Events::init_local()
 {
-  std::memset(event_subs.data(), 0, sizeof(event_subs));
-  std::memset(event_pend.data(), 0, sizeof(event_pend));
+  event_taken = {};
+  event_subs  = {};
+  for (auto& level : event_pend)
+    for (auto& word : level) word = 0;
 
   if (SMP::cpu_id() == 0)
   {
     // prevent legacy IRQs from being free for taking
-    for (int evt = 0; evt < 32; evt++)
-        event_subs[evt] = true;
+    event_taken[0] |= 0xFFFFFFFF;
   }
 }
 
-uint8_t Events::subscribe(event_callback func)
+uint8_t Events::subscribe(event_callback func, Priority prio)
 {
-  for (int evt = 0; evt < NUM_EVENTS; evt++) {
-    if (event_subs[evt] == false) {
-      subscribe(evt, func);
+  for (int w = 0; w < WORDS; w++) {
+    if (~event_taken[w]) {
+      const int evt = w * 64 + __builtin_ctzll(~event_taken[w]);
+      subscribe(evt, func, prio);
       return evt;
     }
   }
   throw std::out_of_range("No more free events");
 }
-void Events::subscribe(uint8_t evt, event_callback func)
+void Events::subscribe(uint8_t evt, event_callback func, Priority prio)
 {
-  // Mark as subscribed to
-  event_subs[evt] = true;
+  // Mark as taken
+  event_taken[evt / 64] |= 1ull << (evt % 64);
   // Set (new) callback for event
   callbacks[evt] = func;
-  // add to sublist if not there already
-  auto it = std::find(sublist.begin(), sublist.end(), evt);
-  if (it == sublist.end())
+  priority[evt] = prio;
+  if (stats[evt].count == nullptr)
+    create_stats(evt);
+  // Start handling it, if not already
+  if (not is_subscribed(evt))
   {
-    sublist.push_back(evt);
+    event_subs[evt / 64] |= 1ull << (evt % 64);
 #ifdef DEBUG_SMP
     SMP::global_lock();
     printf("Subscribed to intr=%u irq=%u on cpu %d\n",
@@ -68,41 +72,57 @@ void Events::subscribe(uint8_t evt, event_callback func)
 }
 void Events::unsubscribe(uint8_t evt)
 {
-  event_subs[evt] = false;
+  if (not is_subscribed(evt))
+    throw std::out_of_range("Event was not subscribed to");
+  event_taken[evt / 64] &= ~(1ull << (evt % 64));
+  event_subs[evt / 64]  &= ~(1ull << (evt % 64));
   callbacks[evt] = nullptr;
-  for (auto it = sublist.begin(); it != sublist.end(); ++it) {
-    if (*it == evt) {
-      sublist.erase(it); return;
-    }
-  }
-  throw std::out_of_range("Event was not in sublist?");
+}
+
+void Events::create_stats(uint8_t evt)
+{
+  const int cpu = this - managers.data();
+  const auto prefix = "cpu" + std::to_string(cpu) + ".events."
+                    + std::to_string(evt);
+  auto& statman = Statman::get();
+  stats[evt].count   = &statman.get_or_create(Stat::UINT64, prefix + ".count").get_uint64();
+  stats[evt].latency = &statman.get_or_create(Stat::UINT64, prefix + ".latency").get_uint64();
+  stats[evt].cycles  = &statman.get_or_create(Stat::UINT64, prefix + ".cycles").get_uint64();
 }
 
 void Events::defer(event_callback callback)
 {
-  auto ev = subscribe(nullptr);
+  auto ev = subscribe(nullptr, PRIO_LOW);
   subscribe(ev, event_callback::make_packed(
     [this, ev, callback] () {
       callback();
       // NOTE: we cant unsubscribe before after callback(),
       // because unsubscribe() deallocates event storage
       this->unsubscribe(ev);
-    }));
+    }), PRIO_LOW);
   // and trigger it once
-  event_pend[ev] = true;
+  trigger_event(ev);
 }
 
-void Events::process_events()
+int Events::process_priority(const Priority prio)
 {
-  bool handled_any;
-  do {
-    handled_any = false;
-
-    for (const uint8_t intr : sublist)
-    if (event_pend[intr])
+  int handled = 0;
+  for (int w = 0; w < WORDS; w++)
+  {
+    auto& pend = event_pend[prio][w];
+    // events triggered again from here on wait for the next round
+    uint64_t todo = pend.load(std::memory_order_relaxed);
+    while (todo)
     {
-      event_pend[intr] = false;
-      // call handler
+      const int bit = __builtin_ctzll(todo);
+      const uint64_t mask = 1ull << bit;
+      todo &= ~mask;
+      // a handler processing events itself may have taken it already
+      if ((pend.fetch_and(~mask, std::memory_order_relaxed) & mask) == 0)
+        continue;
+      const uint8_t intr = w * 64 + bit;
+      if (UNLIKELY(not is_subscribed(intr)))
+        continue;
 #ifdef DEBUG_SMP
       if (intr != 0) {
         SMP::global_lock();
@@ -111,10 +131,30 @@ void Events::process_events()
         SMP::global_unlock();
       }
 #endif
+      auto& stat = stats[intr];
+      const uint64_t begin = os::Arch::cpu_cycles();
+      *stat.latency += begin - triggered_at[intr];
+      // call handler
       callbacks[intr]();
+      *stat.cycles += os::Arch::cpu_cycles() - begin;
+      (*stat.count)++;
       // increment events handled
       handled_array[intr]++;
-      handled_any = true;
+      handled++;
     }
+  }
+  return handled;
+}
+
+bool Events::process_events()
+{
+  bool handled = false;
+  bool handled_any;
+  do {
+    handled_any = false;
+    for (int prio = 0; prio < NUM_PRIORITIES; prio++)
+      handled_any |= process_priority((Priority) prio) > 0;
+    handled |= handled_any;
   } while (handled_any);
+  return handled;
 }
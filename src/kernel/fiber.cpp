@@ -2,6 +2,7 @@
 
 //#define SMP_DEBUG 1
 #include <kernel/fiber.hpp>
+#include <kernel/fiber_pool.hpp>
 #include <common> // assert-based Exepcts/Ensures
 #include <cstdint>
 #include <memory>
@@ -17,6 +18,14 @@ int Fiber::next_id_{0};
 SMP::Array<Fiber*> Fiber::main_ = {{nullptr}};
 SMP::Array<Fiber*> Fiber::current_ {{nullptr}};
 
+void Fiber::Stack_deleter::operator()(char* stack) const
+{
+  if (pool)
+    pool->release(stack);
+  else
+    delete[] stack;
+}
+
 extern "C" {
   void __fiber_jumpstart(volatile void* th_stack, volatile Fiber* f, volatile void* parent_stack);
   void __fiber_yield(volatile void* stack, volatile void* parent_stack);
@@ -0,0 +1,193 @@
+
+#include <kernel/fiber_pool.hpp>
+#include <kernel/events.hpp>
+#include <kernel/memory.hpp>
+#include <util/bitops.hpp>
+#include <common>
+#include <malloc.h>
+#include <smp_utils>
+#include <algorithm>
+
+using namespace util;
+
+#if defined(ARCH_x86_64)
+// Virtual memory area for fiber stacks, each mapped after a guard page
+// left unmapped. Only the stacks take physical memory, from the heap,
+// so a stack of a power of two doesn't take twice that
+static const uintptr_t stack_area = 3ull << 45;
+static uintptr_t stacks_end = stack_area;
+// areas of stacks freed, with their sizes, for new ones
+static std::vector<std::pair<uintptr_t, size_t>> free_areas;
+static spinlock_t areas_lock = 0;
+
+static char* map_stack(size_t size)
+{
+  auto* phys = (char*) memalign(4096, size);
+  if (UNLIKELY(phys == nullptr))
+    return nullptr;
+
+  uintptr_t lin;
+  {
+    scoped_spinlock lock(areas_lock);
+    auto it = std::find_if(free_areas.begin(), free_areas.end(),
+                           [size] (const auto& area) { return area.second == size; });
+    if (it != free_areas.end()) {
+      lin = it->first;
+      *it = free_areas.back();
+      free_areas.pop_back();
+    }
+    else {
+      lin = stacks_end + Fiber_pool::guard_size;
+      stacks_end = lin + size;
+    }
+  }
+  const auto map = os::mem::map({lin, (uintptr_t) phys,
+      os::mem::Access::read | os::mem::Access::write, size}, "Fiber stack");
+  Expects(map);
+  return (char*) lin;
+}
+
+static void unmap_stack(char* stack, size_t size)
+{
+  auto* phys = (void*) os::mem::virt_to_phys((uintptr_t) stack);
+  os::mem::unmap((uintptr_t) stack);
+  free(phys);
+  scoped_spinlock lock(areas_lock);
+  free_areas.emplace_back((uintptr_t) stack, size);
+}
+#else
+// no paging API to leave a guard page unmapped with
+static char* map_stack(size_t size)
+{
+  return (char*) memalign(4096, size);
+}
+
+static void unmap_stack(char* stack, size_t)
+{
+  free(stack);
+}
+#endif
+
+Fiber_pool::Fiber_pool(int stack_size, size_t max_cached)
+  : stack_size_{(int) bits::roundto(guard_size, stack_size)},
+    max_cached_{max_cached}
+{
+  Expects(stack_size > 0);
+  event_ = Events::get().subscribe({this, &Fiber_pool::run});
+}
+
+Fiber_pool::~Fiber_pool()
+{
+  Expects(scheduler_ == nullptr);
+  Events::get().unsubscribe(event_);
+  // stacks go back to the pool as the fibers are deleted
+  for (auto* fiber : fibers_)
+    delete fiber;
+  for (auto* stack : free_)
+    free_stack(stack);
+}
+
+Fiber::Stack_ptr Fiber_pool::get_stack()
+{
+  char* stack;
+  if (not free_.empty()) {
+    stack = free_.back();
+    free_.pop_back();
+  }
+  else {
+    stack = map_stack(stack_size_);
+    if (UNLIKELY(stack == nullptr))
+      throw std::bad_alloc();
+  }
+  return Fiber::Stack_ptr(stack, Fiber::Stack_deleter{this});
+}
+
+void Fiber_pool::release(char* stack)
+{
+  if (free_.size() < max_cached_)
+    free_.push_back(stack);
+  else
+    free_stack(stack);
+}
+
+void Fiber_pool::free_stack(char* stack)
+{
+  unmap_stack(stack, stack_size_);
+}
+
+Fiber& Fiber_pool::add(Fiber* fiber)
+{
+  fiber->pool_ = this;
+  fibers_.insert(fiber);
+  enqueue(*fiber);
+  return *fiber;
+}
+
+void Fiber_pool::enqueue(Fiber& fiber)
+{
+  if (fiber.queued_) return;
+  fiber.queued_ = true;
+  queue_.push_back(&fiber);
+  // the running scheduler will get to it
+  if (scheduler_ == nullptr)
+    Events::get().trigger_event(event_);
+}
+
+void Fiber_pool::wake(Fiber& fiber)
+{
+  Expects(fiber.pool_ == this and not fiber.done());
+  enqueue(fiber);
+}
+
+void Fiber_pool::park()
+{
+  auto* fiber = Fiber::current();
+  Expects(fiber != nullptr and fiber->pool_ != nullptr);
+  fiber->pool_->parking_ = true;
+  Fiber::yield();
+}
+
+void Fiber_pool::run()
+{
+  if (scheduler_ != nullptr or queue_.empty())
+    return;
+
+  // Fibers yield to the fiber resuming them, so resume them from one
+  Fiber scheduler{get_stack(), stack_size_, typeid(void*), typeid(void*),
+                  &Fiber_pool::schedule, this};
+  scheduler_ = &scheduler;
+  scheduler.start();
+  scheduler_ = nullptr;
+}
+
+void* Fiber_pool::schedule(void* arg)
+{
+  auto& pool = *static_cast<Fiber_pool*>(arg);
+
+  // only the fibers queued by now, so that the ones yielding over and
+  // over let the rest of the event loop run in between
+  for (size_t count = pool.queue_.size(); count > 0; count--)
+  {
+    auto* fiber = pool.queue_.front();
+    pool.queue_.pop_front();
+    fiber->queued_ = false;
+
+    if (fiber->started())
+      fiber->resume();
+    else
+      fiber->start();
+
+    if (fiber->done()) {
+      pool.fibers_.erase(fiber);
+      delete fiber;
+    }
+    else if (not pool.parking_) {
+      // yielded, so after the others
+      pool.enqueue(*fiber);
+    }
+    pool.parking_ = false;
+  }
+  if (not pool.queue_.empty())
+    Events::get().trigger_event(pool.event_);
+  return nullptr;
+}
@@ -0,0 +1,153 @@
+#include <kernel/threads.hpp>
+#include <timers>
+#include <cerrno>
+
+using kernel::Thread_queue;
+using kernel::thread_t;
+
+// waiting threads, in queues by hash of the futex address
+static constexpr int FUTEX_BUCKETS = 256;
+static std::array<Thread_queue, FUTEX_BUCKETS> buckets;
+
+// lock both, in the same order everywhere
+static void lock_pair(Thread_queue& q1, Thread_queue& q2)
+{
+  if (&q1 == &q2) { lock(q1.lock); return; }
+  lock(&q1 < &q2 ? q1.lock : q2.lock);
+  lock(&q1 < &q2 ? q2.lock : q1.lock);
+}
+static void unlock_pair(Thread_queue& q1, Thread_queue& q2)
+{
+  unlock(q1.lock);
+  if (&q1 != &q2) unlock(q2.lock);
+}
+
+// on the CPU the timer was set on, by the thread's TID as it may
+// have exited without being able to stop the timer from its CPU
+static void futex_timeout(int64_t tid, Timers::id_t id)
+{
+  auto* thread = kernel::get_thread(tid);
+  if (thread == nullptr) return;
+  // the queue changes when requeued, so check it once locked
+  while (auto* queue = __atomic_load_n(&thread->queue, __ATOMIC_ACQUIRE))
+  {
+    scoped_spinlock lock(queue->lock);
+    if (thread->queue != queue) continue;
+    // woken already, and possibly waiting on something else
+    if (thread->futex.timer != id or thread->futex.timer_cpu != SMP::cpu_id())
+      return;
+    thread->futex.timed_out = true;
+    kernel::thread_wake(thread);
+    return;
+  }
+}
+
+namespace kernel
+{
+  Thread_queue& futex_queue(const int* addr)
+  {
+    const uint64_t key = (uintptr_t) addr >> 2;
+    return buckets[(key * 0x9E3779B97F4A7C15ull) >> 56];
+  }
+
+  void futex_stop_timer(thread_t* thread)
+  {
+    const auto id = thread->futex.timer;
+    if (id == Timers::UNUSED_ID) return;
+    thread->futex.timer = Timers::UNUSED_ID;
+    // the Timers of another CPU fire it, finding it no longer waited on
+    if (thread->futex.timer_cpu == SMP::cpu_id())
+      Timers::stop(id);
+  }
+
+  int futex_wait(int* addr, int val, uint32_t bitset,
+                 const std::chrono::nanoseconds* timeout)
+  {
+    if (bitset == 0) return -EINVAL;
+
+    auto* self = get_thread();
+    auto& queue = futex_queue(addr);
+    lock(queue.lock);
+    // the waker changes the value before waking, under the same lock
+    if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != val) {
+      unlock(queue.lock);
+      return -EAGAIN;
+    }
+    if (timeout and timeout->count() <= 0) {
+      unlock(queue.lock);
+      return -ETIMEDOUT;
+    }
+    THPRINT("FUTEX: Waiting for unlock... addr=%p val=%d\n", addr, val);
+    self->futex.addr   = addr;
+    self->futex.bitset = bitset;
+    self->futex.timed_out = false;
+    self->futex.timer  = Timers::UNUSED_ID;
+    if (timeout) {
+      // the thread isn't stolen by other CPUs while the timer is set
+      const int64_t tid = self->tid;
+      self->futex.timer_cpu = SMP::cpu_id();
+      self->futex.timer = Timers::oneshot(*timeout,
+          [tid] (Timers::id_t id) { futex_timeout(tid, id); });
+    }
+    thread_block(queue);
+
+    if (self->futex.timed_out)
+      self->futex.timer = Timers::UNUSED_ID;
+    futex_stop_timer(self);
+    self->futex.addr = nullptr;
+    return self->futex.timed_out ? -ETIMEDOUT : 0;
+  }
+
+  int futex_wake(int* addr, int count, uint32_t bitset)
+  {
+    if (bitset == 0) return -EINVAL;
+    auto& queue = futex_queue(addr);
+    scoped_spinlock lock(queue.lock);
+    int woken = 0;
+    for (auto* thread = queue.head; thread != nullptr and woken < count;)
+    {
+      auto* next = thread->q_next;
+      if (thread->futex.addr == addr and (thread->futex.bitset & bitset)) {
+        thread_wake(thread);
+        woken++;
+      }
+      thread = next;
+    }
+    return woken;
+  }
+
+  int futex_requeue(int* addr, int count, int* addr2, int requeue,
+                    const int* cmpval)
+  {
+    auto& from = futex_queue(addr);
+    auto& to   = futex_queue(addr2);
+    lock_pair(from, to);
+    if (cmpval and __atomic_load_n(addr, __ATOMIC_ACQUIRE) != *cmpval) {
+      unlock_pair(from, to);
+      return -EAGAIN;
+    }
+    int woken = 0, moved = 0;
+    for (auto* thread = from.head; thread != nullptr;)
+    {
+      auto* next = thread->q_next;
+      if (thread->futex.addr == addr) {
+        if (woken < count) {
+          thread_wake(thread);
+          woken++;
+        }
+        else if (moved < requeue) {
+          thread->futex.addr = addr2;
+          if (&from != &to) {
+            from.remove(thread);
+            to.push_back(thread);
+          }
+          moved++;
+        }
+        else break;
+      }
+      thread = next;
+    }
+    unlock_pair(from, to);
+    return woken + moved;
+  }
+}
@@ -31,6 +31,12 @@ size_t os::total_memuse() noexcept {
   return kernel::heap_usage() + kernel::state().liveupdate_size + kernel::heap_begin();
 }
 
+// overridden by the per-CPU allocator, when it replaces musl malloc
+__attribute__((weak))
+size_t os::heap_allocated() noexcept {
+  return kernel::heap_usage();
+}
+
 constexpr size_t heap_alignment = 4096;
 __attribute__((weak)) ssize_t __brk_max = 0x100000;
 
@@ -0,0 +1,149 @@
+
+// The malloc family, on top of the per-CPU size-class allocator.
+// Replaces the musl allocator, which serializes all CPUs on one lock.
+
+#include <util/alloc_pcpu.hpp>
+#include <kernel/memory.hpp>
+#include <os.hpp>
+#include <kernel.hpp>
+#include <smp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+extern "C" void* kalloc(size_t size);
+extern "C" void  kfree(void* ptr, size_t size);
+
+namespace {
+
+  /** Spans and large allocations come from the buddy allocator */
+  struct Kernel_source {
+    void* allocate(size_t size) noexcept
+    { return kalloc(size); }
+
+    void deallocate(void* ptr, size_t size) noexcept
+    { kfree(ptr, size); }
+
+    uintptr_t addr_begin() const noexcept
+    { return os::mem::raw_allocator().addr_begin(); }
+
+    uintptr_t addr_end() const noexcept
+    { return os::mem::raw_allocator().addr_end(); }
+  };
+
+  using Heap = os::mem::pcpu::Alloc<Kernel_source, SMP_MAX_CORES>;
+
+  Kernel_source source;
+  alignas(Heap) char heap_storage[sizeof(Heap)];
+  std::atomic<Heap*> heap {nullptr};
+  spinlock_t init_lock = 0;
+
+  Heap& get_heap() noexcept
+  {
+    Heap* h = heap.load(std::memory_order_acquire);
+    if (LIKELY(h != nullptr))
+      return *h;
+
+    Expects(kernel::heap_ready());
+    scoped_spinlock lock(init_lock);
+    h = heap.load(std::memory_order_relaxed);
+    if (h == nullptr) {
+      h = new (heap_storage) Heap(source);
+      heap.store(h, std::memory_order_release);
+    }
+    return *h;
+  }
+
+  inline bool is_pow2(size_t n) noexcept
+  { return n != 0 and (n & (n - 1)) == 0; }
+}
+
+size_t os::heap_allocated() noexcept
+{
+  Heap* h = heap.load(std::memory_order_acquire);
+  return (h != nullptr) ? h->bytes_used() : 0;
+}
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+  void* ptr = get_heap().allocate(size, SMP::cpu_id());
+  if (UNLIKELY(ptr == nullptr))
+    errno = ENOMEM;
+  return ptr;
+}
+
+void free(void* ptr)
+{
+  if (ptr != nullptr)
+    get_heap().deallocate(ptr, SMP::cpu_id());
+}
+
+void* calloc(size_t count, size_t size)
+{
+  size_t total;
+  if (UNLIKELY(__builtin_mul_overflow(count, size, &total))) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  void* ptr = malloc(total);
+  if (ptr != nullptr)
+    memset(ptr, 0, total);
+  return ptr;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+  if (ptr == nullptr)
+    return malloc(size);
+
+  auto& h = get_heap();
+  const size_t usable = h.usable_size(ptr);
+  // keep it, unless shrinking to less than half
+  if (size <= usable and size >= usable / 2)
+    return ptr;
+
+  void* res = malloc(size);
+  if (res != nullptr) {
+    memcpy(res, ptr, std::min(size, usable));
+    h.deallocate(ptr, SMP::cpu_id());
+  }
+  return res;
+}
+
+void* memalign(size_t align, size_t size)
+{
+  if (UNLIKELY(not is_pow2(align))) {
+    errno = EINVAL;
+    return nullptr;
+  }
+  void* ptr = get_heap().allocate_aligned(align, size, SMP::cpu_id());
+  if (UNLIKELY(ptr == nullptr))
+    errno = ENOMEM;
+  return ptr;
+}
+
+void* aligned_alloc(size_t align, size_t size)
+{
+  return memalign(align, size);
+}
+
+int posix_memalign(void** res, size_t align, size_t size)
+{
+  if (UNLIKELY(align < sizeof(void*) or not is_pow2(align)))
+    return EINVAL;
+  void* ptr = get_heap().allocate_aligned(align, size, SMP::cpu_id());
+  if (UNLIKELY(ptr == nullptr))
+    return ENOMEM;
+  *res = ptr;
+  return 0;
+}
+
+size_t malloc_usable_size(void* ptr)
+{
+  return (ptr != nullptr) ? get_heap().usable_size(ptr) : 0;
+}
+
+}
@@ -17,6 +17,14 @@ void os::set_panic_action(Panic_action action) noexcept {
   kernel::set_panic_action(action);
 }
 
+std::chrono::microseconds os::busy_poll() noexcept {
+  return kernel::busy_poll();
+}
+
+void os::set_busy_poll(std::chrono::microseconds max_spin) noexcept {
+  kernel::set_busy_poll(max_spin);
+}
+
 os::Span_mods os::modules()
 {
   auto* bootinfo_ = kernel::bootinfo();
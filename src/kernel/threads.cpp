@@ -1,15 +1,17 @@
 #include <kernel/threads.hpp>
 #include <arch/x86/cpu.hpp>
 #include <kprint>
+#include <os>
+#include <timers>
 #include <cassert>
-#include <deque>
-#include <map>
+#include <unordered_map>
 #include <pthread.h>
 
 extern "C" {
   void __thread_yield();
-  void __thread_restore(void* nexti, void* stack);
-  void __clone_return(void* nexti, void* stack);
+  // switch to @stack, then clear *prev_on_cpu (if any)
+  void __thread_restore(void* nexti, void* stack, bool* prev_on_cpu);
+  void __clone_return(void* nexti, void* stack, bool* prev_on_cpu);
   long syscall_SYS_set_thread_area(void* u_info);
 }
 
@@ -22,21 +24,85 @@ struct libc_internal {
 namespace kernel
 {
   static int64_t thread_counter = 1;
-  static std::map<int64_t, kernel::thread_t*> threads;
-  static std::deque<thread_t*> suspended;
+  // for looking up threads by TID
+  static std::unordered_map<int64_t, kernel::thread_t*> threads;
+  static spinlock_t threads_lock = 0;
+  // ready threads, by the CPU to run them
+  static SMP::Array<Thread_queue> runqueues;
+  // the wait queue of the thread switching out, while blocking
+  static SMP::Array<Thread_queue*> blocking {{nullptr}};
   static thread_t main_thread;
 
-  static void erase_suspension(thread_t* t)
+  void Thread_queue::push_back(thread_t* t) noexcept
   {
-      for (auto it = suspended.begin(); it != suspended.end();)
+      assert(t->queue == nullptr);
+      t->queue  = this;
+      t->q_next = nullptr;
+      t->q_prev = tail;
+      if (tail) tail->q_next = t;
+      else      head = t;
+      tail = t;
+      size++;
+  }
+  thread_t* Thread_queue::pop_front() noexcept
+  {
+      auto* t = head;
+      if (t) remove(t);
+      return t;
+  }
+  void Thread_queue::remove(thread_t* t) noexcept
+  {
+      assert(t->queue == this);
+      if (t->q_prev) t->q_prev->q_next = t->q_next;
+      else           head = t->q_next;
+      if (t->q_next) t->q_next->q_prev = t->q_prev;
+      else           tail = t->q_prev;
+      t->q_next = t->q_prev = nullptr;
+      __atomic_store_n(&t->queue, nullptr, __ATOMIC_RELEASE);
+      size--;
+  }
+
+  static void make_ready(thread_t* t)
+  {
+      auto& rq = runqueues.at(t->cpu);
+      scoped_spinlock lock(rq.lock);
+      rq.push_back(t);
+  }
+
+  // take a ready thread from another CPU. Only threads switched out by
+  // yielding, as the main thread and cloning parents stay where they are
+  static thread_t* steal_thread()
+  {
+#ifdef INCLUDEOS_SMP_ENABLE
+      const int me = SMP::cpu_id();
+      for (int cpu = 0; cpu < SMP::cpu_count(); cpu++)
       {
-          if (*it == t) {
-              it = suspended.erase(it);
-          }
-          else {
-              ++it;
+          if (cpu == me) continue;
+          auto& rq = runqueues.at(cpu);
+          if (rq.empty()) continue;
+          scoped_spinlock lock(rq.lock);
+          for (auto* t = rq.head; t != nullptr; t = t->q_next) {
+              // a futex timeout is on the Timers of its CPU
+              if (t != &main_thread and t->yielded
+                  and t->futex.timer == Timers::UNUSED_ID) {
+                  rq.remove(t);
+                  return t;
+              }
           }
       }
+#endif
+      return nullptr;
+  }
+
+  // the next thread to run on this CPU, or nullptr if none
+  static thread_t* next_thread()
+  {
+      auto& rq = PER_CPU(runqueues);
+      if (not rq.empty()) {
+          scoped_spinlock lock(rq.lock);
+          if (auto* next = rq.pop_front()) return next;
+      }
+      return steal_thread();
   }
 
   void thread_t::init(int tid)
@@ -68,20 +134,38 @@ namespace kernel
   void thread_t::suspend(void* ret_instr, void* ret_stack)
   {
       this->store_return(ret_instr, ret_stack);
-      // add to suspended (NB: can throw)
-      suspended.push_back(this);
+      // the child runs on a stack of its own
+      this->on_cpu = false;
+      // last in line on its run queue
+      make_ready(this);
   }
   void thread_t::yield()
   {
       // resume a waiting thread
-      assert(!suspended.empty());
-      auto* next = suspended.front();
-      suspended.pop_front();
+      auto* next = next_thread();
+      assert(next != nullptr);
       // resume next thread
       this->yielded = true;
       next->resume();
   }
 
+  void thread_t::migrate(int new_cpu)
+  {
+      assert(new_cpu >= 0 && new_cpu < SMP::cpu_count());
+      auto& rq = runqueues.at(this->cpu);
+      bool ready = false;
+      {
+          scoped_spinlock lock(rq.lock);
+          if (this->queue == &rq) {
+              rq.remove(this);
+              ready = true;
+          }
+          // when running or blocked, it goes there once ready
+          this->cpu = new_cpu;
+      }
+      if (ready) make_ready(this);
+  }
+
   void thread_t::exit()
   {
     const bool exiting_myself = (get_thread() == this);
@@ -103,35 +187,68 @@ namespace kernel
     if (this->clear_tid) {
         THPRINT("Clearing child value at %p\n", this->clear_tid);
         *(pthread_t*) this->clear_tid = 0;
+        // and wake whoever joins it
+        futex_wake((int*) this->clear_tid, 1);
+    }
+    // when killed by another thread: no futex timeout to wait for,
+    // and leave the queue it is on
+    futex_stop_timer(this);
+    while (auto* queue = __atomic_load_n(&this->queue, __ATOMIC_ACQUIRE)) {
+        scoped_spinlock lock(queue->lock);
+        if (this->queue == queue) queue->remove(this);
     }
     // delete this thread
-    auto it = threads.find(this->tid);
-    assert(it != threads.end());
-    assert(it->second == this);
-    threads.erase(it);
+    {
+        scoped_spinlock lock(threads_lock);
+        auto it = threads.find(this->tid);
+        assert(it != threads.end());
+        assert(it->second == this);
+        threads.erase(it);
+    }
     // free thread resources
     delete this;
-    // resume parent thread
+    // resume parent thread, if ready, or any other
     if (exiting_myself)
     {
-        erase_suspension(next);
-        next->resume();
+        auto& rq = runqueues.at(next->cpu);
+        {
+            scoped_spinlock lock(rq.lock);
+            if (next->queue == &rq) rq.remove(next);
+            else next = nullptr;
+        }
+        if (next == nullptr) {
+            // nothing to return to on this stack, so wait for a wakeup
+            while ((next = next_thread()) == nullptr) os::block();
+        }
+        // the exited thread's stack is not coming back
+        next->resume_from(nullptr);
     }
   }
 
   void thread_t::resume()
+  {
+      auto* prev = get_thread();
+      resume_from(prev != this ? &prev->on_cpu : nullptr);
+  }
+
+  void thread_t::resume_from(bool* prev_on_cpu)
   {
       THPRINT("Returning to tid=%ld tls=%p nexti=%p stack=%p\n",
             this->tid, this->my_tls, this->stored_nexti, this->stored_stack);
+      // another CPU may still be switching away from it
+      while (__atomic_load_n(&this->on_cpu, __ATOMIC_ACQUIRE))
+          asm("pause");
+      this->on_cpu = true;
+      this->cpu = SMP::cpu_id();
       // NOTE: the RAX return value here is CHILD thread id, not this
       if (this->yielded == false) {
           syscall_SYS_set_thread_area(this->my_tls);
-          __clone_return(this->stored_nexti, this->stored_stack);
+          __clone_return(this->stored_nexti, this->stored_stack, prev_on_cpu);
       }
       else {
           this->yielded = false;
           syscall_SYS_set_thread_area(this->my_tls);
-          __thread_restore(this->stored_nexti, this->stored_stack);
+          __thread_restore(this->stored_nexti, this->stored_stack, prev_on_cpu);
       }
       __builtin_unreachable();
   }
@@ -146,6 +263,7 @@ namespace kernel
       thread->parent = parent;
       thread->parent->children.push_back(thread);
       thread->my_stack = stack;
+      thread->cpu = SMP::cpu_id();
 
       // flag for write child TID
       if (flags & CLONE_CHILD_SETTID) {
@@ -155,10 +273,8 @@ namespace kernel
           thread->clear_tid = ctid;
       }
 
-      threads.emplace(
-            std::piecewise_construct,
-            std::forward_as_tuple(tid),
-            std::forward_as_tuple(thread));
+      scoped_spinlock lock(threads_lock);
+      threads.emplace(tid, thread);
       return thread;
     }
     catch (...) {
@@ -185,22 +301,75 @@ namespace kernel
   }
 
   thread_t* get_thread(int64_t tid) {
+      scoped_spinlock lock(threads_lock);
       auto it = threads.find(tid);
       if (it == threads.end()) return nullptr;
       return it->second;
   }
+
+  void thread_block(Thread_queue& queue)
+  {
+      auto* self = get_thread();
+      // switch to another thread, queueing this one once it is saved
+      PER_CPU(blocking) = &queue;
+      __thread_yield();
+      // woken, or there was no one else to run
+      if (PER_CPU(blocking) == nullptr) return;
+      PER_CPU(blocking) = nullptr;
+
+      // wait in place, until woken or another thread gets ready
+      queue.push_back(self);
+      unlock(queue.lock);
+      // the queue may change, e.g. by futex requeueing
+      while (auto* current = __atomic_load_n(&self->queue, __ATOMIC_ACQUIRE))
+      {
+          if (PER_CPU(runqueues).empty()) {
+              os::block();
+              continue;
+          }
+          lock(current->lock);
+          if (self->queue != current) {
+              unlock(current->lock);
+              continue;
+          }
+          current->remove(self);
+          thread_block(*current);
+          break;
+      }
+  }
+
+  void thread_wake(thread_t* thread)
+  {
+      assert(thread->queue != nullptr);
+      thread->queue->remove(thread);
+      // not switched out when waiting in place
+      if (thread->yielded) make_ready(thread);
+  }
 }
 
 extern "C"
 void __thread_suspend_and_yield(void* next_instr, void* stack)
 {
+    using namespace kernel;
     // don't go through the ardous yielding process when alone
-    if (kernel::suspended.empty()) return;
-    // suspend current thread
-    auto* thread = kernel::get_thread();
-    thread->suspend(next_instr, stack);
+    auto* next = next_thread();
+    if (next == nullptr) return;
+    auto* thread = get_thread();
+    // before queueing, as other CPUs may resume it from then on
+    thread->yielded = true;
+    // suspend current thread, on a wait queue or its run queue
+    thread->store_return(next_instr, stack);
+    if (auto* queue = PER_CPU(blocking))
+    {
+        PER_CPU(blocking) = nullptr;
+        queue->push_back(thread);
+        unlock(queue->lock);
+    }
+    else {
+        make_ready(thread);
+    }
     // resume some other thread
-    thread->yield();
+    next->resume();
 }
 
 extern "C"
@@ -1,5 +1,6 @@
-#include "stub.hpp"
+#include "common.hpp"
 #include <errno.h>
+#include <time.h>
 #include <kprint>
 #include <kernel/threads.hpp>
 
@@ -13,25 +14,60 @@
 #define FUTEX_UNLOCK_PI 7
 #define FUTEX_TRYLOCK_PI 8
 #define FUTEX_WAIT_BITSET 9
+#define FUTEX_WAKE_BITSET 10
 #define FUTEX_PRIVATE 128
 #define FUTEX_CLOCK_REALTIME 256
 
-extern void print_backtrace();
+#define FUTEX_BITSET_MATCH_ANY 0xffffffff
 
-static int sys_futex(int *uaddr, int futex_op, int val,
-                      const struct timespec *timeout, int /*val3*/)
+using namespace std::chrono;
+using kernel::futex_wait;
+using kernel::futex_wake;
+using kernel::futex_requeue;
+
+static nanoseconds to_nanos(const struct timespec& ts)
 {
-  if ((futex_op & 0xF) == FUTEX_WAIT)
-  {
-    THPRINT("FUTEX: Waiting for unlock... uaddr=%d val=%d\n", *uaddr, val);
-    while (*uaddr == val) __thread_yield();
+  return seconds(ts.tv_sec) + nanoseconds(ts.tv_nsec);
+}
+
+static long sys_futex(int *uaddr, int futex_op, int val,
+                      const struct timespec *timeout, int* uaddr2, int val3)
+{
+  if (uaddr == nullptr or ((uintptr_t) uaddr & 3))
+    return -EINVAL;
+
+  nanoseconds wait_for;
+  switch (futex_op & 0x7F) {
+  case FUTEX_WAIT:
+    // relative
+    if (timeout) wait_for = to_nanos(*timeout);
+    return futex_wait(uaddr, val, FUTEX_BITSET_MATCH_ANY,
+                      timeout ? &wait_for : nullptr);
+  case FUTEX_WAIT_BITSET:
+    // absolute, on the monotonic clock unless told otherwise
+    if (timeout) {
+      const auto now = (futex_op & FUTEX_CLOCK_REALTIME)
+          ? to_nanos(__arch_wall_clock())
+          : nanoseconds(__arch_system_time());
+      wait_for = to_nanos(*timeout) - now;
+    }
+    return futex_wait(uaddr, val, val3, timeout ? &wait_for : nullptr);
+  case FUTEX_WAKE:
+    return futex_wake(uaddr, val, FUTEX_BITSET_MATCH_ANY);
+  case FUTEX_WAKE_BITSET:
+    return futex_wake(uaddr, val, val3);
+  case FUTEX_REQUEUE:
+    // the timeout argument is the number to requeue
+    return futex_requeue(uaddr, val, uaddr2, (int) (uintptr_t) timeout, nullptr);
+  case FUTEX_CMP_REQUEUE:
+    return futex_requeue(uaddr, val, uaddr2, (int) (uintptr_t) timeout, &val3);
   }
-  return 0;
+  return -ENOSYS;
 }
 
 extern "C"
-int syscall_SYS_futex(int *uaddr, int futex_op, int val,
-                      const struct timespec *timeout, int val3)
+long syscall_SYS_futex(int *uaddr, int futex_op, int val,
+                       const struct timespec *timeout, int* uaddr2, int val3)
 {
-  return stubtrace(sys_futex, "futex", uaddr, futex_op, val, timeout, val3);
+  return strace(sys_futex, "futex", uaddr, futex_op, val, timeout, uaddr2, val3);
 }
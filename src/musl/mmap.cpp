@@ -7,9 +7,12 @@
 #include <kernel/memory.hpp>
 #include <kernel.hpp>
 #include <kprint>
+#include <smp_utils>
 
 using Alloc = os::mem::Raw_allocator;
 static Alloc* alloc;
+// the buddy allocator is shared by all CPUs
+static spinlock_t alloc_lock = 0;
 
 Alloc& os::mem::raw_allocator() {
   Expects(alloc);
@@ -28,11 +31,13 @@ uintptr_t __init_mmap(uintptr_t addr_begin, size_t size)
 extern "C" __attribute__((weak))
 void* kalloc(size_t size) {
   Expects(kernel::heap_ready());
+  scoped_spinlock lock(alloc_lock);
   return alloc->allocate(size);
 }
 
 extern "C" __attribute__((weak))
 void kfree (void* ptr, size_t size) {
+  scoped_spinlock lock(alloc_lock);
   alloc->deallocate(ptr, size);
 }
 
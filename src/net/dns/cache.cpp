@@ -0,0 +1,131 @@
+
+#include <net/dns/cache.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace net::dns {
+
+  net::Addr Cache::Entry::address(size_t i) const
+  {
+    Expects(i < count());
+    const auto* data = rdata.data() + i * addr_len();
+    if (rtype == Record_type::AAAA)
+    {
+      ip6::Addr addr;
+      std::copy(data, data + 16, addr.data());
+      return addr;
+    }
+    uint32_t whole;
+    memcpy(&whole, data, sizeof(whole));
+    return ip4::Addr{whole};
+  }
+
+  Cache::Key Cache::make_key(const Hostname& hostname, Record_type rtype)
+  {
+    // names are case insensitive
+    Key key {hostname, rtype};
+    std::transform(key.name.begin(), key.name.end(), key.name.begin(),
+                   [] (unsigned char c) { return std::tolower(c); });
+    return key;
+  }
+
+  const Cache::Entry* Cache::lookup(const Hostname& hostname, Record_type rtype,
+                                    timestamp_t now)
+  {
+    auto it = entries_.find(make_key(hostname, rtype));
+    if (it == entries_.end())
+      return nullptr;
+    if (it->second.expires <= now)
+    {
+      entries_.erase(it);
+      return nullptr;
+    }
+    it->second.hits++;
+    return &it->second;
+  }
+
+  const Cache::Entry* Cache::insert(const Hostname& hostname, Record_type rtype,
+                                    const Response& res, timestamp_t now)
+  {
+    Expects(rtype == Record_type::A or rtype == Record_type::AAAA);
+    Entry entry {0, 0, 0, rtype, res.rcode, {}};
+    // the shortest TTL of the records making up the answer
+    uint32_t ttl = UINT32_MAX;
+
+    if (res.rcode == Response_code::NO_ERROR)
+    {
+      for (const auto& rec : res.answers)
+      {
+        if (rec.rtype == rtype and rec.rdata.size() == entry.addr_len())
+        {
+          entry.rdata.insert(entry.rdata.end(), rec.rdata.begin(), rec.rdata.end());
+          ttl = std::min(ttl, rec.ttl);
+        }
+        // the aliases leading to the addresses
+        else if (rec.rtype == Record_type::ALIAS)
+          ttl = std::min(ttl, rec.ttl);
+      }
+    }
+    else if (res.rcode != Response_code::NAME_ERROR)
+    {
+      return nullptr;
+    }
+
+    if (entry.negative())
+    {
+      // RFC 2308 5: the TTL of the SOA, but no longer than its minimum
+      auto soa = std::find_if(res.auth.begin(), res.auth.end(),
+        [] (const Record& rec) { return rec.rtype == Record_type::SOA; });
+      if (soa == res.auth.end())
+        return nullptr;
+      ttl = std::min({ttl, soa->ttl, soa->soa_minimum(), max_negative_ttl_});
+    }
+    else
+    {
+      ttl = std::min(ttl, max_ttl_);
+    }
+
+    auto key = make_key(hostname, rtype);
+    if (ttl == 0)
+    {
+      entries_.erase(key);
+      return nullptr;
+    }
+    entry.ttl     = ttl;
+    entry.expires = now + ttl;
+    auto& stored = entries_[std::move(key)];
+    stored = std::move(entry);
+    return &stored;
+  }
+
+  Response_ptr Cache::make_response(const Hostname& hostname, const Entry& entry,
+                                    timestamp_t now)
+  {
+    auto res = std::make_unique<Response>();
+    res->rcode = entry.rcode;
+    const auto len = entry.addr_len();
+    for (size_t i = 0; i < entry.count(); i++)
+    {
+      auto& rec = res->answers.emplace_back();
+      rec.name     = hostname;
+      rec.rtype    = entry.rtype;
+      rec.rclass   = Class::INET;
+      rec.ttl      = entry.ttl_left(now);
+      rec.data_len = len;
+      rec.rdata.assign((const char*) entry.rdata.data() + i * len, len);
+    }
+    return res;
+  }
+
+  void Cache::flush_expired(timestamp_t now)
+  {
+    for (auto it = entries_.begin(); it != entries_.end();)
+    {
+      if (it->second.expires > now)
+        it++;
+      else
+        it = entries_.erase(it);
+    }
+  }
+
+}
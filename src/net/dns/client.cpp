@@ -1,6 +1,7 @@
 
 #include <net/dns/client.hpp>
 #include <net/inet>
+#include <algorithm>
 
 namespace net::dns
 {
@@ -11,99 +12,204 @@ namespace net::dns
   Timer::duration_t Client::DEFAULT_RESOLVE_TIMEOUT{std::chrono::seconds(5)};
 #endif
   Timer::duration_t Client::DEFAULT_FLUSH_INTERVAL{std::chrono::seconds(30)};
-  std::chrono::seconds Client::DEFAULT_CACHE_TTL{std::chrono::seconds(60)};
+  std::chrono::seconds Client::DEFAULT_CACHE_TTL{std::chrono::seconds(Cache::DEFAULT_MAX_TTL)};
 
   Client::Client(Stack& stack)
     : stack_{stack},
       cache_ttl_{DEFAULT_CACHE_TTL},
       flush_timer_{{this, &Client::flush_expired}}
   {
+    cache_.set_max_ttl(cache_ttl_.count());
   }
 
   void Client::resolve(Address dns_server,
                        Hostname hostname,
                        Resolve_handler func,
                        Timer::duration_t timeout, bool force)
+  {
+    const auto rtype = (dns_server.is_v6()) ? Record_type::AAAA : Record_type::A;
+    query(std::move(hostname), rtype, {dns_server}, std::move(func), timeout, force);
+  }
+
+  void Client::resolve(Hostname hostname,
+                       Record_type rtype,
+                       Resolve_handler func,
+                       Timer::duration_t timeout, bool force)
+  {
+    Expects(rtype == Record_type::A or rtype == Record_type::AAAA);
+    Expects(not nameservers_.empty() && "No nameservers added");
+    query(std::move(hostname), rtype, fastest_nameservers(), std::move(func), timeout, force);
+  }
+
+  void Client::query(Hostname hostname, Record_type rtype, std::vector<Address> servers,
+                     Resolve_handler func, Timer::duration_t timeout, bool force)
   {
     Expects(not hostname.empty());
     if(not is_FQDN(hostname) and not stack_.domain_name().empty())
     {
       hostname.append(".").append(stack_.domain_name());
     }
-    if(not force)
+    if(not force and caching())
     {
-      auto it = cache_.find(hostname);
-      if(it != cache_.end())
+      const auto now = timestamp();
+      const auto* entry = cache_.lookup(hostname, rtype, now);
+      if(entry != nullptr)
       {
-        Error err;
-        func(nullptr, err); // fix
+        auto res = Cache::make_response(hostname, *entry, now);
+        // refresh it before it expires, if still in use
+        if(prefetch_ and Cache::should_prefetch(*entry, now))
+          send_request(hostname, rtype, servers, nullptr, timeout);
+        func(std::move(res), {});
         return;
       }
     }
+    send_request(std::move(hostname), rtype, std::move(servers), std::move(func), timeout);
+  }
+
+  void Client::send_request(Hostname hostname, Record_type rtype, std::vector<Address> servers,
+                            Resolve_handler func, Timer::duration_t timeout)
+  {
+    // join the request already asking for the name
+    auto key = pending_key(hostname, rtype);
+    auto pending = pending_.find(key);
+    if(pending != pending_.end())
+    {
+      if(func)
+        requests_.at(pending->second).callbacks.push_back(std::move(func));
+      return;
+    }
+
     // Make sure we actually can bind to a socket
-    auto& socket = (dns_server.is_v6()) ? stack_.udp().bind6() : stack_.udp().bind();
+    auto& socket = (servers.front().is_v6()) ? stack_.udp().bind6() : stack_.udp().bind();
 
     // Create our query
-    Query query{std::move(hostname), (dns_server.is_v6() ? Record_type::AAAA : Record_type::A)};
+    Query query{std::move(hostname), rtype};
 #ifdef LIBFUZZER_ENABLED
     g_last_xid = query.id;
 #endif
+    const auto id = query.id;
 
     // store the request for later match
     auto emp = requests_.emplace(std::piecewise_construct,
-      std::forward_as_tuple(query.id),
-      std::forward_as_tuple(*this, socket, std::move(query), std::move(func)));
+      std::forward_as_tuple(id),
+      std::forward_as_tuple(*this, socket, std::move(query), std::move(servers), timeout));
 
     Ensures(emp.second && "Unable to insert");
     auto& req = emp.first->second;
-    req.resolve(dns_server, timeout);
+    if(func)
+      req.callbacks.push_back(std::move(func));
+    pending_.emplace(std::move(key), id);
+    req.resolve();
+  }
+
+  std::string Client::pending_key(const Hostname& hostname, Record_type rtype)
+  {
+    return hostname + '/' + std::to_string(static_cast<uint16_t>(rtype));
+  }
+
+  void Client::add_nameserver(Address server)
+  {
+    auto it = std::find_if(nameservers_.begin(), nameservers_.end(),
+      [&server] (const auto& ns) { return ns.address == server; });
+    if(it == nameservers_.end())
+      nameservers_.emplace_back(std::move(server));
+  }
+
+  std::vector<Client::Address> Client::fastest_nameservers() const
+  {
+    // the ones not measured yet go first, to be measured
+    std::vector<const Nameserver*> order;
+    for(const auto& ns : nameservers_)
+      order.push_back(&ns);
+    std::stable_sort(order.begin(), order.end(),
+      [] (const Nameserver* a, const Nameserver* b) { return a->srtt < b->srtt; });
+
+    // of the same address family, for one socket
+    std::vector<Address> servers;
+    const bool v6 = order.front()->address.is_v6();
+    for(const auto* ns : order)
+    {
+      if(ns->address.is_v6() != v6) continue;
+      servers.push_back(ns->address);
+      if(servers.size() == MAX_ATTEMPTS) break;
+    }
+    return servers;
+  }
+
+  void Client::nameserver_answered(const Address& server, std::chrono::microseconds rtt)
+  {
+    for(auto& ns : nameservers_)
+    {
+      if(ns.address != server) continue;
+      // as TCP (RFC 6298), 1/8 of each new measurement
+      ns.srtt = (ns.srtt.count() == 0) ? rtt : (ns.srtt * 7 + rtt) / 8;
+      return;
+    }
   }
 
-  Client::Request::Request(Client& cli, udp::Socket& sock,
-                              dns::Query q, Resolve_handler cb)
+  void Client::nameserver_timed_out(const Address& server, Timer::duration_t timeout)
+  {
+    for(auto& ns : nameservers_)
+    {
+      if(ns.address != server) continue;
+      const auto penalty = std::chrono::duration_cast<std::chrono::microseconds>(timeout);
+      ns.srtt = std::max(ns.srtt * 2, penalty);
+      ns.timeouts++;
+      return;
+    }
+  }
+
+  Client::Request::Request(Client& cli, udp::Socket& sock, dns::Query q,
+                           std::vector<Address> srvs, Timer::duration_t timeout)
     : client{cli},
       query{std::move(q)},
       response{nullptr},
       socket{sock},
-      callback{std::move(cb)},
-      timer({this, &Request::timeout})
+      timer({this, &Request::timeout}),
+      servers{std::move(srvs)},
+      attempt_timeout{timeout / servers.size()}
   {
+    Expects(not servers.empty());
     socket.on_read({this, &Client::Request::parse_response});
   }
 
-  void Client::Request::resolve(net::Addr server, Timer::duration_t timeout)
+  void Client::Request::resolve()
   {
     std::array<char, 256> buf;
     size_t len = query.write(buf.data());
 
-    socket.sendto(server, dns::SERVICE_PORT, buf.data(), len, nullptr,
+    sent = RTC::nanos_now();
+    socket.sendto(servers[attempt], dns::SERVICE_PORT, buf.data(), len, nullptr,
       {this, &Client::Request::handle_error});
 
-    timer.start(timeout);
+    timer.start(attempt_timeout);
   }
 
-  void Client::Request::parse_response(Addr, UDP::port_t, const char* data, size_t len)
+  void Client::Request::parse_response(Addr from, UDP::port_t, const char* data, size_t len)
   {
     if(UNLIKELY(len < sizeof(dns::Header)))
       return;
 
     const auto& reply = *(dns::Header*) data;
 
-    // this is a response to our query
-    if(query.id == ntohs(reply.id))
+    // this is a response to our query, from one of the servers asked
+    if(query.id == ntohs(reply.id)
+       and std::find(servers.begin(), servers.begin() + attempt + 1, from) != servers.begin() + attempt + 1)
     {
+      if(from == servers[attempt])
+      {
+        const auto rtt = std::chrono::nanoseconds(RTC::nanos_now() - sent);
+        client.nameserver_answered(from, std::chrono::duration_cast<std::chrono::microseconds>(rtt));
+      }
+
       auto res = std::make_unique<dns::Response>();
       // TODO: Validate
       res->parse(data, len);
 
-      this->response = std::move(res);
-
-      // TODO: Cache
-      /*if(client.cache_ttl_ > std::chrono::seconds::zero())
-      {
-        add_cache_entry(...);
-      }*/
+      if(client.caching())
+        client.add_cache_entry(query.hostname, query.rtype, *res);
 
+      this->response = std::move(res);
       finish({});
     }
     else
@@ -115,7 +221,18 @@ namespace net::dns
 
   void Client::Request::finish(const Error& err)
   {
-    callback(std::move(response), err);
+    timer.stop();
+    // new requests for the name from the callbacks are new requests
+    auto waiting = std::move(callbacks);
+    client.pending_.erase(pending_key(query.hostname, query.rtype));
+
+    for(size_t i = 0; i < waiting.size(); i++)
+    {
+      // everyone gets their own response
+      auto res = (i + 1 < waiting.size() and response != nullptr)
+        ? std::make_unique<dns::Response>(*response) : std::move(response);
+      waiting[i](std::move(res), err);
+    }
 
     auto erased = client.requests_.erase(query.id);
     Ensures(erased == 1);
@@ -123,11 +240,25 @@ namespace net::dns
 
   void Client::Request::timeout()
   {
+    client.nameserver_timed_out(servers[attempt], attempt_timeout);
+    // ask the next server
+    if(++attempt < servers.size())
+    {
+      resolve();
+      return;
+    }
     finish({Error::Type::timeout, "Request timed out"});
   }
 
   void Client::Request::handle_error(const Error& err)
   {
+    if(attempt + 1 < servers.size())
+    {
+      timer.stop();
+      attempt++;
+      resolve();
+      return;
+    }
     // This will call the user callback - do we want that?
     finish(err);
   }
@@ -144,15 +275,14 @@ namespace net::dns
     flush_timer_.stop();
   }
 
-  void Client::add_cache_entry(const Hostname& hostname, Address addr, std::chrono::seconds ttl)
+  void Client::add_cache_entry(const Hostname& hostname, Record_type rtype, const Response& res)
   {
-    // cache the address
-    cache_.emplace(std::piecewise_construct,
-      std::forward_as_tuple(hostname),
-      std::forward_as_tuple(addr, timestamp() + ttl.count()));
+    const auto* entry = cache_.insert(hostname, rtype, res, timestamp());
+    if(entry == nullptr)
+      return;
 
-    debug("<DNSClient> Cache entry added: [%s] %s (%lld)\n",
-      hostname.c_str(), addr.to_string().c_str(), ttl.count());
+    debug("<DNSClient> Cache entry added: [%s] %zu addresses (%u)\n",
+      hostname.c_str(), entry->count(), entry->ttl);
 
     // start the timer if not already active
     if(not flush_timer_.is_running())
@@ -161,14 +291,7 @@ namespace net::dns
 
   void Client::flush_expired()
   {
-    const auto now = timestamp();
-    for(auto it = cache_.begin(); it != cache_.end();)
-    {
-      if(it->second.expires > now)
-        it++;
-      else
-        it = cache_.erase(it);
-    }
+    cache_.flush_expired(timestamp());
 
     if(not cache_.empty())
       flush_timer_.start(DEFAULT_FLUSH_INTERVAL);
@@ -33,16 +33,19 @@ namespace net::dns {
     {
       case Record_type::A:    // IPv4
       case Record_type::AAAA: // IPv6
+      case Record_type::SOA:  // read as is, for the minimum
       {
+        if (UNLIKELY(remaining - (int) sizeof(rr_data) < data_len))
+          throw std::runtime_error("Nothing left to parse");
         this->rdata.assign(reader, this->data_len);
-        count += data_len;
         break;
       }
       default:
       {
-        count += parse_name(reader, buffer, len, this->rdata);
+        parse_name(reader, buffer, len, this->rdata);
       }
     }
+    count += data_len;
 
     return count;
   }
@@ -66,16 +69,18 @@ namespace net::dns {
 
     int count = 1;
     const auto* ureader = (unsigned char*) reader;
+    const auto* end = (unsigned char*) buffer + tot_len;
 
-    while (*ureader)
+    while (ureader < end and *ureader)
     {
       if (*ureader >= 192)
       {
         // read 16-bit offset, mask out the 2 top bits
-        uint16_t offset = (*ureader >> 8) | *(ureader+1);
+        uint16_t offset = (*ureader << 8) | *(ureader+1);
         offset &= 0x3fff; // remove 2 top bits
 
-        if(UNLIKELY(offset > tot_len))
+        // pointers can only go back, which also ends loops
+        if(UNLIKELY(offset >= (const char*) ureader - buffer))
           return 0;
 
         ureader = (unsigned char*) &buffer[offset];
@@ -83,10 +88,11 @@ namespace net::dns {
       }
       else
       {
-        output[namelen++] = *ureader++;
+        output.push_back(*ureader++);
+        namelen++;
 
-        // maximum label size
-        if(UNLIKELY(namelen > 63)) break;
+        // maximum name size
+        if(UNLIKELY(namelen > 255)) break;
       }
 
       // if we havent jumped to another location then we can count up
@@ -117,6 +123,17 @@ namespace net::dns {
     return count;
   }
 
+  uint32_t Record::soa_minimum() const
+  {
+    Expects(rtype == Record_type::SOA);
+    // the last of the fields following the two names
+    if (rdata.size() < sizeof(uint32_t))
+      return 0;
+    uint32_t minimum;
+    memcpy(&minimum, rdata.data() + rdata.size() - sizeof(minimum), sizeof(minimum));
+    return ntohl(minimum);
+  }
+
   ip4::Addr Record::get_ipv4() const
   {
     Expects(rtype == Record_type::A);
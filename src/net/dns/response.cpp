@@ -49,13 +49,14 @@ namespace net::dns {
     Expects(len >= sizeof(Header));
 
     const auto& hdr = *(const Header*) buffer;
+    this->rcode = static_cast<Response_code>(hdr.rcode);
 
     // move ahead of the dns header and the query field
     const char* reader = (char*)buffer + sizeof(Header);
     // Iterate past the question string we sent ...
-    while (*reader) reader++;
+    while (reader < buffer + len and *reader) reader++;
     // .. and past the question data
-    reader += sizeof(Question);
+    reader += 1 + sizeof(Question);
 
     if(UNLIKELY(reader > (buffer + len)))
       return -1;
@@ -133,6 +133,7 @@ namespace net {
       break;
 
     case Ethertype::VLAN:
+    case Ethertype::QINQ:
       PRINT("VLAN frame\n");
       if(not vlan_upstream_)
         packets_dropped_++;
@@ -11,33 +11,39 @@
 namespace net {
 
 Ethernet_8021Q::Ethernet_8021Q(downstream phys_down,
-                               const addr& mac, const int id) noexcept
+                               const addr& mac, const int id,
+                               const int outer_id) noexcept
   : Ethernet(phys_down, mac),
-    id_{id}
+    id_{id},
+    outer_id_{outer_id}
 {}
 
 void Ethernet_8021Q::receive(Packet_ptr pkt)
 {
   auto& vlan = *reinterpret_cast<ethernet::VLAN_header*>(pkt->layer_begin());
+  // the payload type is found after the last tag
+  const auto ethertype = (outer_id_)
+    ? reinterpret_cast<ethernet::QinQ_header*>(pkt->layer_begin())->type : vlan.type;
+  const auto header_size = this->header_size();
 
   PRINT("<802.1Q IN> %#x (id %d) - ", vlan.tpid, vlan.vid());
 
-  switch(vlan.type) {
+  switch(ethertype) {
   case Ethertype::IP4:
     PRINT("IPv4 packet\n");
-    pkt->increment_layer_begin(header_size());
+    pkt->increment_layer_begin(header_size);
     ip4_upstream_(std::move(pkt), vlan.dest == MAC::BROADCAST);
     break;
 
   case Ethertype::IP6:
     PRINT("IPv6 packet\n");
-    pkt->increment_layer_begin(header_size());
+    pkt->increment_layer_begin(header_size);
     ip6_upstream_(std::move(pkt), vlan.dest == MAC::BROADCAST);
     break;
 
   case Ethertype::ARP:
     PRINT("ARP packet\n");
-    pkt->increment_layer_begin(header_size());
+    pkt->increment_layer_begin(header_size);
     arp_upstream_(std::move(pkt));
     break;
 
@@ -46,12 +52,12 @@ void Ethernet_8021Q::receive(Packet_ptr pkt)
     break;
 
   case Ethertype::VLAN:
-    PRINT("VLAN frame\n");
-    assert(false && "Do not support multiple VLAN atm.. O.o");
+  case Ethertype::QINQ:
+    PRINT("VLAN frame with more tags than supported, dropping\n");
     break;
 
   default:
-    uint16_t type = ntohs(static_cast<uint16_t>(vlan.type));
+    uint16_t type = ntohs(static_cast<uint16_t>(ethertype));
 
     // Trailer negotiation and encapsulation RFC 893 and 1122
     if (UNLIKELY(type == ntohs(static_cast<uint16_t>(Ethertype::TRAILER_NEGO)) or
@@ -63,9 +69,9 @@ void Ethernet_8021Q::receive(Packet_ptr pkt)
 
     // This might be 802.3 LLC traffic
     if (type > 1500) {
-      PRINT("<802.1Q> UNKNOWN ethertype 0x%hx\n", vlan.type);
+      PRINT("<802.1Q> UNKNOWN ethertype 0x%hx\n", ethertype);
     } else {
-      PRINT("IEEE802.3 Length field: 0x%hx\n", vlan.type);
+      PRINT("IEEE802.3 Length field: 0x%hx\n", ethertype);
     }
     break;
   }
@@ -94,19 +100,35 @@ void Ethernet_8021Q::transmit(Packet_ptr pkt, addr dest, Ethertype type)
 
   do {
     // Demote to VLAN frame
-    next->increment_layer_begin(- (int)sizeof(ethernet::VLAN_header));
+    next->increment_layer_begin(- (int)header_size());
 
-    auto& hdr = *reinterpret_cast<ethernet::VLAN_header*>(next->layer_begin());
+    if (outer_id_)
+    {
+      auto& hdr = *reinterpret_cast<ethernet::QinQ_header*>(next->layer_begin());
 
-    // Add source address
-    hdr.src = mac_;
-    hdr.dest = dest;
+      hdr.src = mac_;
+      hdr.dest = dest;
 
-    hdr.type = type;
-    hdr.set_vid(id_);
-    hdr.tpid = static_cast<uint16_t>(Ethertype::VLAN);
+      hdr.type = type;
+      hdr.s_tpid = static_cast<uint16_t>(Ethertype::QINQ);
+      hdr.set_svid(outer_id_);
+      hdr.c_tpid = static_cast<uint16_t>(Ethertype::VLAN);
+      hdr.set_cvid(id_);
+    }
+    else
+    {
+      auto& hdr = *reinterpret_cast<ethernet::VLAN_header*>(next->layer_begin());
+
+      // Add source address
+      hdr.src = mac_;
+      hdr.dest = dest;
+
+      hdr.type = type;
+      hdr.set_vid(id_);
+      hdr.tpid = static_cast<uint16_t>(Ethertype::VLAN);
+    }
     PRINT(" \t <802.1 unchain> Transmitting %i b, from %s -> %s. Type: 0x%hx ID: %d\n",
-          next->size(), hdr.src.str().c_str(), hdr.dest.str().c_str(), hdr.type, hdr.vid());
+          next->size(), mac_.str().c_str(), dest.str().c_str(), type, id_);
 
     // Stat increment packets transmitted
     packets_tx_++;
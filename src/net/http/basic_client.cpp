@@ -4,7 +4,10 @@
 namespace http {
 
   const Basic_client::timeout_duration Basic_client::DEFAULT_TIMEOUT{std::chrono::seconds(5)};
+  const Basic_client::timeout_duration Basic_client::DEFAULT_IDLE_TIMEOUT{std::chrono::seconds(30)};
+  const std::chrono::seconds Basic_client::DEFAULT_DNS_TTL{std::chrono::seconds(60)};
   int Basic_client::default_follow_redirect{0};
+  size_t Basic_client::default_max_connections{6};
 
   Basic_client::Basic_client(TCP& tcp, Request_handler on_send)
     : Basic_client(tcp, std::move(on_send), false)
@@ -14,7 +17,11 @@ namespace http {
   Basic_client::Basic_client(TCP& tcp, Request_handler on_send, const bool https_supported)
     : tcp_(tcp),
       on_send_{std::move(on_send)},
-      supports_https(https_supported)
+      supports_https(https_supported),
+      max_conns_{default_max_connections},
+      idle_timeout_{DEFAULT_IDLE_TIMEOUT},
+      dns_ttl_{DEFAULT_DNS_TTL},
+      queue_timer_{{this, &Basic_client::timeout_queued}}
   {
   }
 
@@ -35,8 +42,6 @@ namespace http {
   {
     Expects(cb != nullptr);
     using namespace std;
-    auto& conn = (not secure) ?
-      get_connection(host) : get_secure_connection(host);
 
     auto&& header = req->header();
 
@@ -53,7 +58,19 @@ namespace http {
     if(on_send_)
       on_send_(*req, options, host);
 
-    conn.send(move(req), move(cb), options.follow_redirect, options.timeout);
+    auto* conn = get_connection(host, secure);
+
+    // all connections to the host are busy, wait for one of them
+    if(conn == nullptr)
+    {
+      const auto timeout = chrono::duration_cast<chrono::nanoseconds>(options.timeout);
+      const uint64_t expires = (timeout > timeout.zero()) ? RTC::nanos_now() + timeout.count() : 0;
+      queued_[{host, secure}].push_back({move(req), move(cb), move(options), expires});
+      arm_queue_timer();
+      return;
+    }
+
+    conn->send(move(req), move(cb), options.follow_redirect, options.timeout);
   }
 
   void Basic_client::send(Request_ptr req, URI url, Response_handler cb, Options options)
@@ -65,8 +82,8 @@ namespace http {
 
     using namespace std;
 
-    // Default to port 80 if non given
-    const uint16_t port = (url.port() != 0xFFFF) ? url.port() : 80;
+    // Default to port 80 (443 if secure) if non given
+    const uint16_t port = (url.port() != 0xFFFF) ? url.port() : (secure ? 443 : 80);
 
     if (url.host_is_ip4())
     {
@@ -77,20 +94,18 @@ namespace http {
     }
     else
     {
-      tcp_.stack().resolve(std::string(url.host()),
-      ResolveCallback::make_packed(
+      resolve(std::string(url.host()),
+      Resolve_handler::make_packed(
       [
         this,
         request = move(req),
-        url{move(url)},
         cb{move(cb)},
         opt{move(options)},
         secure,
         port
       ]
-        (net::dns::Response_ptr res, const net::Error&) mutable
+        (net::Addr addr) mutable
       {
-        auto addr = res->get_first_addr();
         if(UNLIKELY(addr == net::Addr::addr_any))
         {
           cb({Error::RESOLVE_HOST}, nullptr, Connection::empty());
@@ -108,70 +123,14 @@ namespace http {
     Expects(url.is_valid() && "Invalid URI (missing scheme?)");
     Expects(cb != nullptr);
 
-    // find out if this is a secured request or not
-    const bool secure = url.scheme_is_secure();
-    validate_secure(secure);
-
-    using namespace std;
-
-    if (url.host_is_ip4())
-    {
-      std::string host(url.host());
-      auto ip = net::ip4::Addr(host);
-      // setup request with method and headers
-      auto req = create_request(method);
-      *req << hfields;
-
-      // Set Host and URI path
-      populate_from_url(*req, url);
+    // setup request with method and headers
+    auto req = create_request(method);
+    *req << hfields;
 
-      // Default to port 80 if non given
-      const uint16_t port = (url.port() != 0xFFFF) ? url.port() : 80;
+    // Set Host and URI path
+    populate_from_url(*req, url);
 
-      send(move(req), {ip, port}, move(cb), secure, move(options));
-    }
-    else
-    {
-      tcp_.stack().resolve(std::string(url.host()),
-      ResolveCallback::make_packed(
-      [
-        this,
-        method,
-        url{move(url)},
-        hfields{move(hfields)},
-        cb{move(cb)},
-        opt{move(options)},
-        secure
-      ]
-        (net::dns::Response_ptr res, const net::Error& err)
-      {
-        // Host resolved
-        if (not err)
-        {
-          auto addr = res->get_first_addr();
-          if(UNLIKELY(addr == net::Addr::addr_any))
-          {
-            cb({Error::RESOLVE_HOST}, nullptr, Connection::empty());
-            return;
-          }
-          // setup request with method and headers
-          auto req = create_request(method);
-          *req << hfields;
-
-          // Set Host and URI path
-          populate_from_url(*req, url);
-
-          // Default to port 80 if non given
-          const uint16_t port = (url.port() != 0xFFFF) ? url.port() : 80;
-
-          send(move(req), {addr, port}, move(cb), secure, move(opt));
-        }
-        else
-        {
-          cb({Error::RESOLVE_HOST}, nullptr, Connection::empty());
-        }
-      }));
-    }
+    send(std::move(req), std::move(url), std::move(cb), std::move(options));
   }
 
   void Basic_client::request(Method method, Host host, std::string path,
@@ -196,78 +155,18 @@ namespace http {
                        Options options)
   {
     Expects(url.is_valid() && "Invalid URI (missing scheme?)");
-    // find out if this is a secured request or not
-    const bool secure = url.scheme_is_secure();
-    validate_secure(secure);
-
-    using namespace std;
-    if (url.host_is_ip4())
-    {
-      std::string host(url.host());
-      auto ip = net::ip4::Addr(host);
-      // setup request with method and headers
-      auto req = create_request(method);
-      *req << hfields;
 
-      // Set Host and URI path
-      populate_from_url(*req, url);
+    // setup request with method and headers
+    auto req = create_request(method);
+    *req << hfields;
 
-      // Add data and content length
-      this->add_data(*req, data);
+    // Set Host and URI path
+    populate_from_url(*req, url);
 
-      // Default to port 80 if non given
-      const uint16_t port = (url.port() != 0xFFFF) ? url.port() : 80;
+    // Add data and content length
+    add_data(*req, data);
 
-      send(move(req), {ip, port}, move(cb), secure, move(options));
-    }
-    else
-    {
-      tcp_.stack().resolve(
-        std::string(url.host()),
-        ResolveCallback::make_packed(
-        [
-          this,
-          method,
-          url{move(url)},
-          hfields{move(hfields)},
-          data{move(data)},
-          cb{move(cb)},
-          opt{move(options)},
-          secure
-        ]
-          (net::dns::Response_ptr res, const net::Error& err)
-        {
-          // Host resolved
-          if (not err)
-          {
-            auto addr = res->get_first_addr();
-            if(UNLIKELY(addr == net::Addr::addr_any))
-            {
-              cb({Error::RESOLVE_HOST}, nullptr, Connection::empty());
-              return;
-            }
-            // setup request with method and headers
-            auto req = this->create_request(method);
-            *req << hfields;
-
-            // Set Host & path from url
-            this->populate_from_url(*req, url);
-
-            // Add data and content length
-            this->add_data(*req, data);
-
-            // Default to port 80 if non given
-            const uint16_t port = (url.port() != 0xFFFF) ? url.port() : 80;
-
-            this->send(move(req), {addr, port}, move(cb), secure, move(opt));
-          }
-          else
-          {
-            cb({Error::RESOLVE_HOST}, nullptr, Connection::empty());
-          }
-        })
-      );
-    }
+    send(std::move(req), std::move(url), std::move(cb), std::move(options));
   }
 
   void Basic_client::request(Method method, Host host, std::string path,
@@ -317,46 +216,180 @@ namespace http {
       : std::string(url.host())); // to_string madness
   }
 
-  void Basic_client::resolve(const std::string& host, ResolveCallback cb)
+  void Basic_client::resolve(const std::string& host, Resolve_handler cb)
   {
-    static auto&& stack = tcp_.stack();
-    stack.resolve(host, cb);
+    if(dns_ttl_ > std::chrono::seconds::zero())
+    {
+      auto it = dns_cache_.find(host);
+      if(it != dns_cache_.end())
+      {
+        if(it->second.expires > RTC::time_since_boot())
+        {
+          cb(it->second.addr);
+          return;
+        }
+        dns_cache_.erase(it);
+      }
+    }
+
+    tcp_.stack().resolve(host,
+    ResolveCallback::make_packed(
+    [
+      this,
+      host,
+      cb{std::move(cb)}
+    ]
+      (net::dns::Response_ptr res, const net::Error& err)
+    {
+      if(err or res == nullptr)
+      {
+        cb({});
+        return;
+      }
+
+      // cache the first address for the shortest TTL of the records
+      net::Addr addr;
+      auto ttl = static_cast<uint32_t>(dns_ttl_.count());
+      for(const auto& rec : res->answers)
+      {
+        if(not rec.is_addr())
+          continue;
+        if(addr == net::Addr::addr_any)
+          addr = rec.get_addr();
+        ttl = std::min(ttl, rec.ttl);
+      }
+
+      if(addr != net::Addr::addr_any and ttl > 0)
+        dns_cache_[host] = {addr, RTC::time_since_boot() + ttl};
+
+      cb(addr);
+    }));
   }
 
-  Client_connection& Basic_client::get_connection(const Host host)
+  Client_connection* Basic_client::get_connection(const Host host, const bool secure)
   {
-    // return/create a set for the given host
-    auto& cset = conns_[host];
+    // return/create a set for the given host, plain and secured are never mixed
+    auto& cset = conns_[{host, secure}];
 
     // iterate all the connection and return the first free one
     for(auto& conn : cset)
     {
-      if(!conn->occupied())
-        return *conn;
+      if(conn->available())
+        return conn.get();
     }
 
+    if(cset.size() >= max_conns_)
+      return nullptr;
+
     // no non-occupied connections, emplace a new one
-    cset.push_back(std::make_unique<Client_connection>(
-      *this, std::make_unique<net::tcp::Stream>(tcp_.connect(host)))
-    );
-    return *cset.back();
+    auto stream = (not secure) ?
+      std::make_unique<net::tcp::Stream>(tcp_.connect(host)) : connect_secure(host);
+
+    cset.push_back(std::make_unique<Client_connection>(*this, std::move(stream), secure));
+    return cset.back().get();
   }
 
-  Client_connection& Basic_client::get_secure_connection(const Host)
+  Connection::Stream_ptr Basic_client::connect_secure(const Host)
   {
     throw Client_error{"Secured connections not supported (use the HTTPS Client)."};
   }
 
+  void Basic_client::send_queued(const Origin& origin)
+  {
+    // look it up every time, sending may end up back here
+    for(auto it = queued_.find(origin); it != queued_.end(); it = queued_.find(origin))
+    {
+      auto* conn = get_connection(origin.host, origin.secure);
+      if(conn == nullptr)
+        return;
+
+      auto q = std::move(it->second.front());
+      it->second.pop_front();
+      if(it->second.empty())
+        queued_.erase(it);
+
+      // what is left of the timeout after waiting
+      auto timeout = q.options.timeout;
+      if(q.expires != 0)
+      {
+        const auto now  = RTC::nanos_now();
+        const auto left = std::chrono::nanoseconds(q.expires > now ? q.expires - now : 0);
+        timeout = std::max(timeout_duration{1},
+                           std::chrono::duration_cast<timeout_duration>(left));
+      }
+      conn->send(std::move(q.req), std::move(q.cb), q.options.follow_redirect, timeout);
+    }
+  }
+
+  void Basic_client::timeout_queued()
+  {
+    const auto now = RTC::nanos_now();
+    std::vector<Response_handler> expired;
+    for(auto it = queued_.begin(); it != queued_.end(); )
+    {
+      auto& queue = it->second;
+      for(auto q = queue.begin(); q != queue.end(); )
+      {
+        if(q->expires != 0 and q->expires <= now) {
+          expired.push_back(std::move(q->cb));
+          q = queue.erase(q);
+        }
+        else ++q;
+      }
+      it = queue.empty() ? queued_.erase(it) : std::next(it);
+    }
+    arm_queue_timer();
+
+    // callbacks last, they may send new requests
+    for(auto& cb : expired)
+      cb({Error::TIMEOUT}, nullptr, Connection::empty());
+  }
+
+  void Basic_client::arm_queue_timer()
+  {
+    uint64_t next = 0;
+    for(const auto& entry : queued_)
+      for(const auto& q : entry.second)
+        if(q.expires != 0 and (next == 0 or q.expires < next))
+          next = q.expires;
+
+    if(next == 0)
+    {
+      queue_timer_.stop();
+      return;
+    }
+    const auto now = RTC::nanos_now();
+    queue_timer_.restart(std::chrono::nanoseconds(next > now ? next - now : 0));
+  }
+
+  void Basic_client::reuse(Client_connection& conn)
+  {
+    store_session(conn);
+
+    send_queued({conn.peer(), conn.secure()});
+
+    // nothing to do, close it if nothing comes up in a while
+    if(conn.available())
+      conn.idle(idle_timeout_);
+  }
+
   void Basic_client::close(Client_connection& c)
   {
     debug("<http::Basic_client> Closing %u:%s %p\n", c.local_port(), c.peer().to_string().c_str(), &c);
-    auto& cset = conns_.at(c.peer());
+    const Origin origin{c.peer(), c.secure()};
+    auto& cset = conns_.at(origin);
 
     cset.erase(std::remove_if(cset.begin(), cset.end(),
-    [port = c.local_port()] (const std::unique_ptr<Client_connection>& conn)->bool
+    [&c] (const std::unique_ptr<Client_connection>& conn)->bool
     {
-      return conn->local_port() == port;
-    }));
+      return conn.get() == &c;
+    }), cset.end());
+
+    // a connection can be opened for a waiting request
+    if(queued_.count(origin))
+      send_queued(origin);
+    else if(cset.empty())
+      conns_.erase(origin);
   }
 
 }
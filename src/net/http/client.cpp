@@ -11,24 +11,43 @@ namespace http {
   {
   }
 
-  Client_connection& Client::get_secure_connection(const Host host)
+  Client::~Client()
   {
-    // return/create a set for the given host
-    auto& cset = conns_[host];
-
-    // iterate all the connection and return the first free one
-    for(auto& conn : cset)
-    {
-      if(!conn->occupied())
-        return *conn;
-    }
+    for(auto& entry : sessions_)
+      SSL_SESSION_free(entry.second);
+  }
 
+  Connection::Stream_ptr Client::connect_secure(const Host host)
+  {
     auto tcp_stream = std::make_unique<net::tcp::Stream>(tcp_.connect(host));
-    auto tls_stream = std::make_unique<openssl::TLS_stream>(ssl_context, std::move(tcp_stream), true);
 
-    cset.push_back(std::make_unique<Client_connection>(*this, std::move(tls_stream)));
+    auto it = sessions_.find(host);
+    SSL_SESSION* session = (it != sessions_.end()) ? it->second : nullptr;
+
+    return std::make_unique<openssl::TLS_stream>(ssl_context, std::move(tcp_stream), true, session);
+  }
+
+  void Client::store_session(Client_connection& conn)
+  {
+    auto* tls = dynamic_cast<openssl::TLS_stream*>(conn.stream().get());
+    if(tls == nullptr)
+      return;
+
+    SSL_SESSION* session = tls->get1_session();
+    if(session == nullptr)
+      return;
+
+    auto& stored = sessions_[conn.peer()];
+    // the same session when it was resumed (TLS 1.2)
+    if(session == stored or not SSL_SESSION_is_resumable(session))
+    {
+      SSL_SESSION_free(session);
+      return;
+    }
 
-    return *cset.back();
+    if(stored != nullptr)
+      SSL_SESSION_free(stored);
+    stored = session;
   }
 
 }
@@ -4,7 +4,7 @@
 
 namespace http {
 
-  Client_connection::Client_connection(Basic_client& client, Stream_ptr stream)
+  Client_connection::Client_connection(Basic_client& client, Stream_ptr stream, bool secure)
     : Connection{std::move(stream)},
       client_(client),
       req_(nullptr),
@@ -12,7 +12,8 @@ namespace http {
       on_response_{nullptr},
       timer_({this, &Client_connection::timeout_request}),
       timeout_dur_{timeout_duration::zero()},
-      redirect_{client.default_follow_redirect}
+      redirect_{client.default_follow_redirect},
+      secure_{secure}
   {
     // setup close event
     stream_->on_close({this, &Client_connection::close});
@@ -22,6 +23,7 @@ namespace http {
   {
     Expects(available());
     req_ = std::move(req);
+    res_ = nullptr;
     on_response_ = std::move(on_res);
     Expects(on_response_ != nullptr);
     timeout_dur_ = timeout;
@@ -29,6 +31,8 @@ namespace http {
 
     if(timeout_dur_ > timeout_duration::zero())
       timer_.restart(timeout_dur_);
+    else
+      timer_.stop();
 
     // if the stream is not established, send the request when connected
     if(not stream_->is_connected())
@@ -43,6 +47,15 @@ namespace http {
     }
   }
 
+  void Client_connection::idle(timeout_duration timeout)
+  {
+    Expects(available());
+    if(timeout > timeout_duration::zero())
+      timer_.restart(timeout);
+    else
+      timer_.stop();
+  }
+
   void Client_connection::send_request()
   {
     keep_alive_ = (req_->header().value(header::Connection) != "close");
@@ -59,6 +72,13 @@ namespace http {
       return;
     }
 
+    // nothing was asked for, the connection can't be trusted anymore
+    if (UNLIKELY(on_response_ == nullptr)) {
+      keep_alive_ = false;
+      shutdown();
+      return;
+    }
+
     const std::string data{(char*) buf->data(), buf->size()};
 
     // restart timer since we got data
@@ -142,10 +162,23 @@ namespace http {
   {
     // If the request has timed out, but the response is received later,
     // just discard (we can't do anything because we have no callback).
-    // This MAY have side effects if the connection is reused and
-    // a delayed response is received
+    // Connections with errors are not reused, so a delayed response
+    // can't be mistaken for the response to a new request
     if (on_response_)
     {
+      // a connection in an unknown state, or one the server is about to close,
+      // can't be reused
+      if(err or res_ == nullptr)
+      {
+        keep_alive_ = false;
+      }
+      else
+      {
+        const auto conn = res_->header().value(header::Connection);
+        if(conn == "close" or (res_->version() < Version{1, 1} and conn != "keep-alive"))
+          keep_alive_ = false;
+      }
+
       if(UNLIKELY(not err and can_redirect(res_)))
       {
         uri::URI location{res_->header().value("Location")};
@@ -166,6 +199,14 @@ namespace http {
       timer_.stop();
 
       callback(err, std::move(res_), *this);
+
+      // reuse the connection, unless the callback already did
+      if(not released() and keep_alive_)
+      {
+        if(on_response_ == nullptr)
+          client_.reuse(*this);
+        return;
+      }
     }
     end();
     /*if(!released())
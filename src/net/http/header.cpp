@@ -1,5 +1,6 @@
 
 #include <net/http/header.hpp>
+#include <net/http/request_parser.hpp>
 
 namespace http {
 
@@ -17,6 +18,7 @@ Header::Header(const std::size_t limit) {
 bool Header::add_field(std::string field, std::string value) {
   if (field.empty()) return false;
   //-----------------------------------
+  own();
   if (size() < fields_.capacity()) {
     fields_.emplace_back(std::move(field), std::move(value));
     return true;
@@ -29,6 +31,7 @@ bool Header::add_field(std::string field, std::string value) {
 bool Header::set_field(std::string field, std::string value) {
   if (field.empty() || value.empty()) return false;
   //-----------------------------------
+  own();
   const auto target = find(field);
   //-----------------------------------
   if (target not_eq fields_.cend()) {
@@ -41,28 +44,32 @@ bool Header::set_field(std::string field, std::string value) {
 
 ///////////////////////////////////////////////////////////////////////////////
 bool Header::has_field(util::csview field) const noexcept {
-  return find(field) not_eq fields_.cend();
+  return find_borrowed(field) or find(field) not_eq fields_.cend();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 util::sview Header::value(util::csview field) const noexcept {
   if (field.empty()) return field;
+  if (const auto* borrowed = find_borrowed(field)) return borrowed->value;
   const auto it = find(field);
   return (it not_eq fields_.cend()) ? util::csview{it->second} : util::sview();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 bool Header::is_empty() const noexcept {
-  return fields_.empty();
+  return fields_.empty() and borrowed_.empty();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 std::size_t Header::size() const noexcept {
-  return fields_.size();
+  return fields_.size() + borrowed_.size();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void Header::erase(util::csview field) noexcept {
+  borrowed_.erase(std::remove_if(borrowed_.begin(), borrowed_.end(), [&field](const auto& _) {
+    return field_equals(_.name, field);
+  }), borrowed_.end());
   Const_iterator target;
   while ((target = find(field)) not_eq fields_.cend()) fields_.erase(target);
 }
@@ -70,6 +77,8 @@ void Header::erase(util::csview field) noexcept {
 ///////////////////////////////////////////////////////////////////////////////
 void Header::clear() noexcept {
   fields_.clear();
+  borrowed_.clear();
+  head_.reset();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -93,10 +102,39 @@ Header::Const_iterator Header::find(util::csview field) const noexcept {
   if (field.empty()) return fields_.cend();
   //-----------------------------------
   return
-    std::find_if(fields_.cbegin(), fields_.cend(), [&field](const auto _) {
-      return std::equal(_.first.cbegin(), _.first.cend(), field.cbegin(), field.cend(),
-        [](const auto a, const auto b) { return std::tolower(a) == std::tolower(b); });
+    std::find_if(fields_.cbegin(), fields_.cend(), [&field](const auto& _) {
+      return field_equals(_.first, field);
     });
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void Header::borrow(std::shared_ptr<const std::string> head,
+                    std::vector<Field_view> fields) noexcept {
+  fields_.clear();
+  head_     = std::move(head);
+  borrowed_ = std::move(fields);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Header::own() {
+  if (borrowed_.empty()) return;
+  //-----------------------------------
+  fields_.reserve(std::max(fields_.capacity(), borrowed_.size()));
+  for (const auto& field : borrowed_) {
+    fields_.emplace_back(std::string{field.name}, std::string{field.value});
+  }
+  borrowed_.clear();
+  head_.reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const Field_view* Header::find_borrowed(util::csview field) const noexcept {
+  if (field.empty()) return nullptr;
+  //-----------------------------------
+  for (const auto& _ : borrowed_) {
+    if (field_equals(_.name, field)) return &_;
+  }
+  return nullptr;
+}
+
 } //< namespace http
@@ -0,0 +1,436 @@
+
+#include <net/http/hpack.hpp>
+
+#include <algorithm>
+
+namespace http {
+namespace hpack {
+
+///
+/// The static table (RFC 7541 Appendix A), index 1 first
+///
+struct Static_entry {
+  util::sview name;
+  util::sview value;
+};
+
+static constexpr Static_entry static_table[] {
+  {":authority", ""},
+  {":method", "GET"},
+  {":method", "POST"},
+  {":path", "/"},
+  {":path", "/index.html"},
+  {":scheme", "http"},
+  {":scheme", "https"},
+  {":status", "200"},
+  {":status", "204"},
+  {":status", "206"},
+  {":status", "304"},
+  {":status", "400"},
+  {":status", "404"},
+  {":status", "500"},
+  {"accept-charset", ""},
+  {"accept-encoding", "gzip, deflate"},
+  {"accept-language", ""},
+  {"accept-ranges", ""},
+  {"accept", ""},
+  {"access-control-allow-origin", ""},
+  {"age", ""},
+  {"allow", ""},
+  {"authorization", ""},
+  {"cache-control", ""},
+  {"content-disposition", ""},
+  {"content-encoding", ""},
+  {"content-language", ""},
+  {"content-length", ""},
+  {"content-location", ""},
+  {"content-range", ""},
+  {"content-type", ""},
+  {"cookie", ""},
+  {"date", ""},
+  {"etag", ""},
+  {"expect", ""},
+  {"expires", ""},
+  {"from", ""},
+  {"host", ""},
+  {"if-match", ""},
+  {"if-modified-since", ""},
+  {"if-none-match", ""},
+  {"if-range", ""},
+  {"if-unmodified-since", ""},
+  {"last-modified", ""},
+  {"link", ""},
+  {"location", ""},
+  {"max-forwards", ""},
+  {"proxy-authenticate", ""},
+  {"proxy-authorization", ""},
+  {"range", ""},
+  {"referer", ""},
+  {"refresh", ""},
+  {"retry-after", ""},
+  {"server", ""},
+  {"set-cookie", ""},
+  {"strict-transport-security", ""},
+  {"transfer-encoding", ""},
+  {"user-agent", ""},
+  {"vary", ""},
+  {"via", ""},
+  {"www-authenticate", ""},
+};
+
+static constexpr std::size_t STATIC_ENTRIES = sizeof(static_table) / sizeof(static_table[0]);
+static_assert(STATIC_ENTRIES == 61);
+
+///////////////////////////////////////////////////////////////////////////////
+void Dynamic_table::insert(std::string name, std::string value) {
+  const auto size = entry_size(name, value);
+  // an entry larger than the table empties it (RFC 7541 4.4)
+  if (size > max_size_) {
+    evict(0);
+    return;
+  }
+  evict(max_size_ - size);
+  entries_.emplace_front(std::move(name), std::move(value));
+  size_ += size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Dynamic_table::set_max_size(const std::size_t max_size) {
+  max_size_ = max_size;
+  evict(max_size_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Dynamic_table::evict(const std::size_t max) noexcept {
+  while (size_ > max) {
+    const auto& oldest = entries_.back();
+    size_ -= entry_size(oldest.first, oldest.second);
+    entries_.pop_back();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void encode_integer(uint64_t value, const int prefix, const uint8_t flags, std::string& out) {
+  const uint8_t mask = (1u << prefix) - 1;
+  if (value < mask) {
+    out.push_back(static_cast<char>(flags | value));
+    return;
+  }
+  out.push_back(static_cast<char>(flags | mask));
+  value -= mask;
+  while (value >= 128) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool decode_integer(const uint8_t*& p, const uint8_t* end, const int prefix, uint64_t& value) noexcept {
+  if (p >= end) return false;
+  const uint8_t mask = (1u << prefix) - 1;
+  value = *p++ & mask;
+  if (value < mask) return true;
+
+  int shift = 0;
+  uint8_t b;
+  do {
+    // more than 8 octets is nothing but an attack
+    if (p >= end or shift > 56) return false;
+    b = *p++;
+    value += static_cast<uint64_t>(b & 0x7f) << shift;
+    shift += 7;
+  } while (b & 0x80);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void encode_string(util::csview str, std::string& out) {
+  const auto huffman_len = huffman::encoded_length(str);
+  if (huffman_len < str.size()) {
+    encode_integer(huffman_len, 7, 0x80, out);
+    huffman::encode(str, out);
+  }
+  else {
+    encode_integer(str.size(), 7, 0x00, out);
+    out.append(str.data(), str.size());
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool decode_string(const uint8_t*& p, const uint8_t* end, std::string& str) {
+  if (p >= end) return false;
+  const bool huffman_coded = *p & 0x80;
+  uint64_t len;
+  if (not decode_integer(p, end, 7, len)) return false;
+  if (len > static_cast<uint64_t>(end - p)) return false;
+
+  str.clear();
+  if (huffman_coded) {
+    if (not huffman::decode(p, len, str)) return false;
+  }
+  else {
+    str.assign(reinterpret_cast<const char*>(p), len);
+  }
+  p += len;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Decoder::lookup(const uint64_t index, util::sview& name, util::sview& value) const noexcept {
+  if (index == 0) return false;
+  if (index <= STATIC_ENTRIES) {
+    name  = static_table[index - 1].name;
+    value = static_table[index - 1].value;
+    return true;
+  }
+  const auto dyn = index - STATIC_ENTRIES - 1;
+  if (dyn >= table_.count()) return false;
+  const auto& field = table_.at(dyn);
+  name  = field.first;
+  value = field.second;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Decoder::decode(util::csview block, std::vector<Field>& fields) {
+  const auto* p   = reinterpret_cast<const uint8_t*>(block.data());
+  const auto* end = p + block.size();
+  std::size_t list_size = 0;
+  bool        first     = true;
+
+  while (p < end)
+  {
+    const uint8_t b = *p;
+    util::sview name, value;
+    uint64_t index;
+
+    //-----------------------------------
+    // Indexed Header Field (6.1)
+    //-----------------------------------
+    if (b & 0x80) {
+      if (not decode_integer(p, end, 7, index)) return false;
+      if (not lookup(index, name, value)) return false;
+      fields.emplace_back(std::string{name}, std::string{value});
+    }
+    //-----------------------------------
+    // Dynamic Table Size Update (6.3)
+    //-----------------------------------
+    else if ((b & 0xe0) == 0x20) {
+      // only allowed at the start of a block
+      if (not first) return false;
+      uint64_t size;
+      if (not decode_integer(p, end, 5, size)) return false;
+      if (size > max_table_size_) return false;
+      table_.set_max_size(size);
+      continue;
+    }
+    //-----------------------------------
+    // Literal Header Field (6.2)
+    //-----------------------------------
+    else {
+      // with incremental indexing, without indexing or never indexed
+      const bool indexing = (b & 0xc0) == 0x40;
+      if (not decode_integer(p, end, indexing ? 6 : 4, index)) return false;
+
+      Field field;
+      if (index) {
+        if (not lookup(index, name, value)) return false;
+        field.first = std::string{name};
+      }
+      else if (not decode_string(p, end, field.first)) {
+        return false;
+      }
+      if (not decode_string(p, end, field.second)) return false;
+
+      if (indexing) table_.insert(field.first, field.second);
+      fields.push_back(std::move(field));
+    }
+    first = false;
+
+    const auto& field = fields.back();
+    list_size += Dynamic_table::entry_size(field.first, field.second);
+    if (list_size > max_list_size_) return false;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Encoder::set_max_table_size(const std::size_t size) {
+  // never use more than the default, even if the peer would allow it
+  const auto max = std::min(size, DEFAULT_TABLE_SIZE);
+  if (max not_eq table_.max_size()) {
+    table_.set_max_size(max);
+    size_update_ = true;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Encoder::encode(util::csview name, util::csview value, std::string& out) {
+  if (size_update_) {
+    encode_integer(table_.max_size(), 5, 0x20, out);
+    size_update_ = false;
+  }
+
+  uint64_t name_index = 0;
+  for (std::size_t i = 0; i < STATIC_ENTRIES; ++i) {
+    if (static_table[i].name not_eq name) continue;
+    if (static_table[i].value == value) {
+      encode_integer(i + 1, 7, 0x80, out);
+      return;
+    }
+    if (name_index == 0) name_index = i + 1;
+  }
+  for (std::size_t i = 0; i < table_.count(); ++i) {
+    const auto& field = table_.at(i);
+    if (field.first not_eq name) continue;
+    if (field.second == value) {
+      encode_integer(STATIC_ENTRIES + 1 + i, 7, 0x80, out);
+      return;
+    }
+    if (name_index == 0) name_index = STATIC_ENTRIES + 1 + i;
+  }
+
+  // credentials are kept out of the tables (RFC 7541 7.1.3)
+  if (name == "authorization" or name == "set-cookie") {
+    encode_integer(name_index, 4, 0x10, out);
+  }
+  // large entries would only evict more useful ones
+  else if (Dynamic_table::entry_size(name, value) > table_.max_size() / 2) {
+    encode_integer(name_index, 4, 0x00, out);
+  }
+  else {
+    encode_integer(name_index, 6, 0x40, out);
+    table_.insert(std::string{name}, std::string{value});
+  }
+  if (name_index == 0) encode_string(name, out);
+  encode_string(value, out);
+}
+
+namespace huffman {
+
+///
+/// Code lengths of the canonical Huffman code of RFC 7541 Appendix B,
+/// by symbol (256 is EOS). The codes are assigned in order of length,
+/// then symbol, so the lengths are all that is needed to rebuild them
+///
+static constexpr uint8_t code_lengths[257] {
+  13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,  //   0
+  28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,  //  16
+   6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,  //  32
+   5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,  //  48
+  13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  //  64
+   7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,  //  80
+  15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,  //  96
+   6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,  // 112
+  20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,  // 128
+  24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,  // 144
+  22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,  // 160
+  21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,  // 176
+  26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,  // 192
+  19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,  // 208
+  20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,  // 224
+  26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,  // 240
+  30,                                                              // 256
+};
+
+static constexpr int EOS      = 256;
+static constexpr int MIN_BITS = 5;
+static constexpr int MAX_BITS = 30;
+
+///
+/// Codes by symbol for encoding, and the canonical ranges for decoding
+///
+struct Code_table {
+  uint32_t code[257];
+  // codes of length n are first[n] .. first[n] + count[n] - 1,
+  // for the symbols starting at symbols[offset[n]]
+  uint32_t first[MAX_BITS + 1] {};
+  uint16_t count[MAX_BITS + 1] {};
+  uint16_t offset[MAX_BITS + 1] {};
+  uint16_t symbols[257];
+
+  Code_table() noexcept {
+    for (int sym = 0; sym <= EOS; ++sym) count[code_lengths[sym]]++;
+
+    uint32_t next = 0;
+    uint16_t index = 0;
+    for (int len = 1; len <= MAX_BITS; ++len) {
+      first[len]  = next;
+      offset[len] = index;
+      for (int sym = 0; sym <= EOS; ++sym) {
+        if (code_lengths[sym] not_eq len) continue;
+        code[sym] = next++;
+        symbols[index++] = sym;
+      }
+      next <<= 1;
+    }
+  }
+};
+
+static const Code_table& table() noexcept {
+  static const Code_table codes;
+  return codes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t encoded_length(util::csview str) noexcept {
+  std::size_t bits = 0;
+  for (const char c : str) bits += code_lengths[static_cast<uint8_t>(c)];
+  return (bits + 7) / 8;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void encode(util::csview str, std::string& out) {
+  const auto& codes = table();
+  uint64_t acc  = 0;
+  int      bits = 0;
+  for (const char c : str) {
+    const auto sym = static_cast<uint8_t>(c);
+    acc = (acc << code_lengths[sym]) | codes.code[sym];
+    bits += code_lengths[sym];
+    while (bits >= 8) {
+      bits -= 8;
+      out.push_back(static_cast<char>(acc >> bits));
+    }
+    acc &= (uint64_t{1} << bits) - 1;
+  }
+  // pad with the most significant bits of EOS (all ones)
+  if (bits > 0) {
+    out.push_back(static_cast<char>((acc << (8 - bits)) | (0xff >> bits)));
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool decode(const uint8_t* data, const std::size_t len, std::string& out) {
+  const auto& codes = table();
+  uint32_t code = 0;
+  int      bits = 0;
+
+  for (std::size_t i = 0; i < len; ++i) {
+    for (int shift = 7; shift >= 0; --shift) {
+      code = (code << 1) | ((data[i] >> shift) & 1);
+      if (++bits < MIN_BITS) continue;
+
+      // wraps around when below the first code of this length
+      const uint32_t n = code - codes.first[bits];
+      if (n < codes.count[bits]) {
+        const auto sym = codes.symbols[codes.offset[bits] + n];
+        if (sym == EOS) return false;
+        out.push_back(static_cast<char>(sym));
+        code = 0;
+        bits = 0;
+      }
+      else if (bits == MAX_BITS) {
+        return false;
+      }
+    }
+  }
+  // padding is at most 7 bits, all ones
+  return bits < 8 and code == (1u << bits) - 1;
+}
+
+} //< namespace huffman
+
+} //< namespace hpack
+} //< namespace http
@@ -0,0 +1,784 @@
+
+#include <net/http/http2.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+//#define H2_DEBUG 1
+#ifdef H2_DEBUG
+#define H2_PRINT(fmt, ...) printf("<h2::Session> " fmt, ##__VA_ARGS__)
+#else
+#define H2_PRINT(fmt, ...) /* fmt */
+#endif
+
+namespace http {
+namespace h2 {
+
+///////////////////////////////////////////////////////////////////////////////
+static inline uint32_t read32(const uint8_t* p) noexcept {
+  return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | p[3];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static inline void write32(uint8_t* p, const uint32_t v) noexcept {
+  p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int match_preface(util::csview data) noexcept {
+  const auto len = std::min(data.size(), PREFACE.size());
+  if (data.compare(0, len, PREFACE.substr(0, len)) not_eq 0) return -1;
+  return len == PREFACE.size() ? 1 : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Frame_header Frame_header::parse(const uint8_t* data) noexcept {
+  return {
+    (uint32_t{data[0]} << 16) | (uint32_t{data[1]} << 8) | data[2],
+    static_cast<Frame_type>(data[3]),
+    data[4],
+    read32(data + 5) & 0x7fffffff
+  };
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Frame_header::serialize(uint8_t* data) const noexcept {
+  data[0] = length >> 16;
+  data[1] = length >> 8;
+  data[2] = length;
+  data[3] = static_cast<uint8_t>(type);
+  data[4] = flags;
+  write32(data + 5, stream_id);
+}
+
+///
+/// Fields only meaningful to a HTTP/1.x connection (RFC 7540 8.1.2.2)
+///
+static bool connection_specific(util::csview name) noexcept {
+  return name == "connection" or name == "keep-alive" or name == "proxy-connection"
+      or name == "transfer-encoding" or name == "upgrade";
+}
+
+///
+/// Remove the padding of a DATA or HEADERS frame
+///
+static bool strip_padding(const Frame_header& hdr, const uint8_t*& p, uint32_t& len) noexcept {
+  if (not (hdr.flags & flag::PADDED)) return true;
+  if (len < 1) return false;
+  const uint8_t pad = *p++;
+  --len;
+  if (pad > len) return false;
+  len -= pad;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Session::Session(Write_handler on_write, Request_handler on_request,
+                 const Settings& settings)
+  : on_write_{std::move(on_write)},
+    on_request_{std::move(on_request)},
+    local_{settings},
+    decoder_{settings.header_table_size, settings.max_header_list_size},
+    recv_window_{std::max(settings.initial_window_size, Settings::DEFAULT_WINDOW_SIZE)}
+{
+  Expects(local_.max_frame_size >= Settings::MIN_FRAME_SIZE);
+  send_settings();
+  // SETTINGS don't apply to the connection window, only WINDOW_UPDATE does
+  if (recv_window_ > Settings::DEFAULT_WINDOW_SIZE)
+    send_window_update(0, recv_window_ - Settings::DEFAULT_WINDOW_SIZE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::receive(util::csview input) {
+  if (UNLIKELY(failed_)) return false;
+
+  util::sview data = input;
+  // the start of a frame arrived in an earlier read
+  if (not in_.empty()) {
+    in_.append(input.data(), input.size());
+    data = in_;
+  }
+  const auto* p   = reinterpret_cast<const uint8_t*>(data.data());
+  const auto* end = p + data.size();
+  bool ok = true;
+
+  receiving_ = true;
+  if (not preface_received_) {
+    const int match = match_preface(data);
+    if (match < 0)
+      ok = connection_error(Error_code::PROTOCOL_ERROR);
+    else if (match > 0) {
+      preface_received_ = true;
+      p += PREFACE.size();
+    }
+  }
+
+  while (ok and preface_received_ and end - p >= static_cast<long>(Frame_header::SIZE))
+  {
+    const auto hdr = Frame_header::parse(p);
+    if (hdr.length > local_.max_frame_size) {
+      ok = connection_error(Error_code::FRAME_SIZE_ERROR);
+      break;
+    }
+    if (end - p < static_cast<long>(Frame_header::SIZE + hdr.length))
+      break;
+    ok = handle_frame(hdr, p + Frame_header::SIZE);
+    p += Frame_header::SIZE + hdr.length;
+  }
+
+  // keep a partial frame for the next read
+  if (not ok)
+    in_.clear();
+  else if (not in_.empty())
+    in_.erase(0, reinterpret_cast<const char*>(p) - in_.data());
+  else if (p < end)
+    in_.assign(reinterpret_cast<const char*>(p), end - p);
+
+  receiving_ = false;
+  flush();
+  return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_frame(const Frame_header& hdr, const uint8_t* payload) {
+  H2_PRINT("Frame type=%u flags=%#x stream=%u length=%u\n",
+           static_cast<unsigned>(hdr.type), hdr.flags, hdr.stream_id, hdr.length);
+
+  // a header block must not be interleaved with other frames
+  if (header_stream_ not_eq 0 and hdr.type not_eq Frame_type::CONTINUATION)
+    return connection_error(Error_code::PROTOCOL_ERROR);
+  // the client preface ends with a SETTINGS frame
+  if (not settings_received_ and hdr.type not_eq Frame_type::SETTINGS)
+    return connection_error(Error_code::PROTOCOL_ERROR);
+
+  switch (hdr.type) {
+  case Frame_type::DATA:          return handle_data(hdr, payload);
+  case Frame_type::HEADERS:       return handle_headers(hdr, payload);
+  case Frame_type::PRIORITY:      return handle_priority(hdr, payload);
+  case Frame_type::RST_STREAM:    return handle_rst_stream(hdr, payload);
+  case Frame_type::SETTINGS:      return handle_settings(hdr, payload);
+  case Frame_type::PING:          return handle_ping(hdr, payload);
+  case Frame_type::GOAWAY:        return handle_goaway(hdr, payload);
+  case Frame_type::WINDOW_UPDATE: return handle_window_update(hdr, payload);
+  case Frame_type::CONTINUATION:  return handle_continuation(hdr, payload);
+  // clients can't push
+  case Frame_type::PUSH_PROMISE:  return connection_error(Error_code::PROTOCOL_ERROR);
+  }
+  // unknown frame types are ignored
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_data(const Frame_header& hdr, const uint8_t* payload) {
+  const auto id = hdr.stream_id;
+  if (id == 0) return connection_error(Error_code::PROTOCOL_ERROR);
+
+  // the whole frame counts against flow control, padding included
+  const uint32_t flow = hdr.length;
+  if (recv_consumed_ + flow > recv_window_)
+    return connection_error(Error_code::FLOW_CONTROL_ERROR);
+  recv_consumed_ += flow;
+
+  const uint8_t* p = payload;
+  uint32_t len = hdr.length;
+  if (not strip_padding(hdr, p, len))
+    return connection_error(Error_code::PROTOCOL_ERROR);
+
+  auto it = streams_.find(id);
+  if (it == streams_.end() or it->second.remote_closed)
+  {
+    if (id > last_stream_id_) return connection_error(Error_code::PROTOCOL_ERROR);
+    reset_stream(id, Error_code::STREAM_CLOSED);
+  }
+  else
+  {
+    auto& stream = it->second;
+    if (stream.request == nullptr or stream.recv_consumed + flow > local_.initial_window_size) {
+      reset_stream(id, stream.request ? Error_code::FLOW_CONTROL_ERROR : Error_code::PROTOCOL_ERROR);
+    }
+    else {
+      stream.recv_consumed += flow;
+      if (len > 0)
+        stream.request->add_chunk(std::string{reinterpret_cast<const char*>(p), len});
+
+      if (hdr.flags & flag::END_STREAM) {
+        stream.remote_closed = true;
+        // the stream may be gone once the request is handled
+        on_request_(id, std::move(stream.request));
+      }
+      else if (stream.recv_consumed >= local_.initial_window_size / 2) {
+        send_window_update(id, stream.recv_consumed);
+        stream.recv_consumed = 0;
+      }
+    }
+  }
+
+  if (recv_consumed_ >= recv_window_ / 2) {
+    send_window_update(0, recv_consumed_);
+    recv_consumed_ = 0;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_headers(const Frame_header& hdr, const uint8_t* payload) {
+  const auto id = hdr.stream_id;
+  // client initiated streams are odd
+  if (id == 0 or id % 2 == 0) return connection_error(Error_code::PROTOCOL_ERROR);
+
+  const uint8_t* p = payload;
+  uint32_t len = hdr.length;
+  if (not strip_padding(hdr, p, len))
+    return connection_error(Error_code::PROTOCOL_ERROR);
+
+  const uint8_t* priority = nullptr;
+  if (hdr.flags & flag::PRIORITY) {
+    if (len < 5) return connection_error(Error_code::FRAME_SIZE_ERROR);
+    priority = p;
+    p += 5;
+    len -= 5;
+  }
+
+  auto it = streams_.find(id);
+  if (it not_eq streams_.end())
+  {
+    // trailers, ending the stream
+    if (it->second.remote_closed) return connection_error(Error_code::STREAM_CLOSED);
+    if (not (hdr.flags & flag::END_STREAM)) return connection_error(Error_code::PROTOCOL_ERROR);
+  }
+  else
+  {
+    // stream ids only increase
+    if (id <= last_stream_id_) return connection_error(Error_code::PROTOCOL_ERROR);
+    last_stream_id_ = id;
+
+    // a refused stream is not created, but the block is still decoded
+    if (not goaway_sent_ and streams_.size() < local_.max_concurrent_streams) {
+      Stream stream;
+      stream.send_window = peer_.initial_window_size;
+      streams_.emplace(id, std::move(stream));
+    }
+  }
+  if (priority) set_priority(id, priority);
+
+  header_stream_ = id;
+  header_flags_  = hdr.flags;
+  header_block_.assign(reinterpret_cast<const char*>(p), len);
+
+  if (hdr.flags & flag::END_HEADERS)
+    return end_headers();
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_continuation(const Frame_header& hdr, const uint8_t* payload) {
+  if (header_stream_ == 0 or hdr.stream_id not_eq header_stream_)
+    return connection_error(Error_code::PROTOCOL_ERROR);
+
+  header_block_.append(reinterpret_cast<const char*>(payload), hdr.length);
+  // don't buffer forever, the decoded list would be too large anyway
+  if (header_block_.size() > local_.max_header_list_size)
+    return connection_error(Error_code::ENHANCE_YOUR_CALM);
+
+  if (hdr.flags & flag::END_HEADERS)
+    return end_headers();
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::end_headers() {
+  const auto id = header_stream_;
+  header_stream_ = 0;
+
+  std::vector<hpack::Field> fields;
+  if (not decoder_.decode(header_block_, fields))
+    return connection_error(Error_code::COMPRESSION_ERROR);
+  header_block_.clear();
+
+  auto it = streams_.find(id);
+  if (it == streams_.end()) {
+    reset_stream(id, Error_code::REFUSED_STREAM);
+    return true;
+  }
+
+  auto& stream = it->second;
+  // trailer fields are not passed on
+  if (stream.request == nullptr) {
+    stream.request = make_request(fields);
+    if (stream.request == nullptr) {
+      reset_stream(id, Error_code::PROTOCOL_ERROR);
+      return true;
+    }
+  }
+
+  if (header_flags_ & flag::END_STREAM) {
+    stream.remote_closed = true;
+    // the stream may be gone once the request is handled
+    on_request_(id, std::move(stream.request));
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Request_ptr Session::make_request(std::vector<hpack::Field>& fields) {
+  util::sview method, scheme, path, authority;
+  bool regular_seen = false;
+  bool host_seen    = false;
+
+  for (const auto& field : fields)
+  {
+    const auto& name = field.first;
+    if (name.empty()) return nullptr;
+
+    if (name.front() == ':') {
+      // pseudo-header fields come first, and only once (RFC 7540 8.1.2.1)
+      if (regular_seen) return nullptr;
+      util::sview* pseudo = nullptr;
+      if      (name == ":method")    pseudo = &method;
+      else if (name == ":scheme")    pseudo = &scheme;
+      else if (name == ":path")      pseudo = &path;
+      else if (name == ":authority") pseudo = &authority;
+      if (pseudo == nullptr or not pseudo->empty()) return nullptr;
+      *pseudo = field.second;
+      continue;
+    }
+
+    regular_seen = true;
+    // names are lowercase in HTTP/2
+    if (std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' and c <= 'Z'; }))
+      return nullptr;
+    if (connection_specific(name)) return nullptr;
+    if (name == "te" and field.second not_eq "trailers") return nullptr;
+    if (name == "host") host_seen = true;
+  }
+  if (method.empty() or scheme.empty() or path.empty()) return nullptr;
+
+  auto req = std::make_unique<Request>(std::string{}, fields.size() + 1, false);
+  req->set_method(method::code(method));
+  req->set_uri(URI{path});
+  req->set_version(Version{2, 0});
+
+  auto& header = req->header();
+  if (not host_seen and not authority.empty())
+    header.add_field(header::Host, std::string{authority});
+
+  for (auto& field : fields)
+  {
+    if (field.first.front() == ':') continue;
+    // cookies may be split up to compress better (RFC 7540 8.1.2.5)
+    if (field.first == "cookie" and header.has_field(field.first)) {
+      header.set_field(field.first, std::string{header.value(field.first)} + "; " + field.second);
+      continue;
+    }
+    header.add_field(std::move(field.first), std::move(field.second));
+  }
+  req->set_headers_complete(true);
+  return req;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::set_priority(const uint32_t stream_id, const uint8_t* data) noexcept {
+  const uint32_t depends_on = read32(data) & 0x7fffffff;
+  if (depends_on == stream_id) {
+    reset_stream(stream_id, Error_code::PROTOCOL_ERROR);
+    return;
+  }
+  auto it = streams_.find(stream_id);
+  if (it == streams_.end()) return;
+  it->second.depends_on = depends_on;
+  it->second.weight     = uint16_t{data[4]} + 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_priority(const Frame_header& hdr, const uint8_t* payload) {
+  if (hdr.stream_id == 0) return connection_error(Error_code::PROTOCOL_ERROR);
+  if (hdr.length not_eq 5) {
+    reset_stream(hdr.stream_id, Error_code::FRAME_SIZE_ERROR);
+    return true;
+  }
+  set_priority(hdr.stream_id, payload);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_rst_stream(const Frame_header& hdr, const uint8_t*) {
+  if (hdr.length not_eq 4) return connection_error(Error_code::FRAME_SIZE_ERROR);
+  if (hdr.stream_id == 0 or hdr.stream_id > last_stream_id_)
+    return connection_error(Error_code::PROTOCOL_ERROR);
+  // responses still being written to it are dropped
+  streams_.erase(hdr.stream_id);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_settings(const Frame_header& hdr, const uint8_t* payload) {
+  if (hdr.stream_id not_eq 0) return connection_error(Error_code::PROTOCOL_ERROR);
+  if (hdr.flags & flag::ACK) {
+    if (hdr.length not_eq 0) return connection_error(Error_code::FRAME_SIZE_ERROR);
+    return true;
+  }
+  if (hdr.length % 6 not_eq 0) return connection_error(Error_code::FRAME_SIZE_ERROR);
+
+  for (const uint8_t* p = payload; p < payload + hdr.length; p += 6)
+  {
+    const uint16_t id    = (uint16_t{p[0]} << 8) | p[1];
+    const uint32_t value = read32(p + 2);
+    switch (id) {
+    case Settings::HEADER_TABLE_SIZE:
+      peer_.header_table_size = value;
+      encoder_.set_max_table_size(value);
+      break;
+    case Settings::ENABLE_PUSH:
+      if (value > 1) return connection_error(Error_code::PROTOCOL_ERROR);
+      peer_.enable_push = value;
+      break;
+    case Settings::MAX_CONCURRENT_STREAMS:
+      peer_.max_concurrent_streams = value;
+      break;
+    case Settings::INITIAL_WINDOW_SIZE:
+      if (value > Settings::MAX_WINDOW_SIZE)
+        return connection_error(Error_code::FLOW_CONTROL_ERROR);
+      // applies to the windows of all open streams (RFC 7540 6.9.2)
+      for (auto& entry : streams_)
+        entry.second.send_window += int64_t{value} - peer_.initial_window_size;
+      peer_.initial_window_size = value;
+      break;
+    case Settings::MAX_FRAME_SIZE:
+      if (value < Settings::MIN_FRAME_SIZE or value > 0xffffff)
+        return connection_error(Error_code::PROTOCOL_ERROR);
+      peer_.max_frame_size = value;
+      break;
+    case Settings::MAX_HEADER_LIST_SIZE:
+      peer_.max_header_list_size = value;
+      break;
+    default:
+      // unknown settings are ignored
+      break;
+    }
+  }
+  settings_received_ = true;
+  send_frame(Frame_type::SETTINGS, flag::ACK, 0, nullptr, 0);
+  send_pending();
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_ping(const Frame_header& hdr, const uint8_t* payload) {
+  if (hdr.stream_id not_eq 0) return connection_error(Error_code::PROTOCOL_ERROR);
+  if (hdr.length not_eq 8) return connection_error(Error_code::FRAME_SIZE_ERROR);
+  if (not (hdr.flags & flag::ACK))
+    send_frame(Frame_type::PING, flag::ACK, 0, payload, 8);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_goaway(const Frame_header& hdr, const uint8_t* payload) {
+  if (hdr.stream_id not_eq 0) return connection_error(Error_code::PROTOCOL_ERROR);
+  if (hdr.length < 8) return connection_error(Error_code::FRAME_SIZE_ERROR);
+  goaway_received_ = true;
+
+  // the peer won't act on streams above the last one, don't keep them
+  // around with responses no one reads
+  const uint32_t last_id = read32(payload) & 0x7fffffff;
+  for (auto it = streams_.upper_bound(last_id); it not_eq streams_.end(); )
+  {
+    const auto id = it->first;
+    ++it;
+    reset_stream(id, Error_code::REFUSED_STREAM);
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::handle_window_update(const Frame_header& hdr, const uint8_t* payload) {
+  if (hdr.length not_eq 4) return connection_error(Error_code::FRAME_SIZE_ERROR);
+  const uint32_t increment = read32(payload) & 0x7fffffff;
+
+  if (hdr.stream_id == 0)
+  {
+    if (increment == 0) return connection_error(Error_code::PROTOCOL_ERROR);
+    send_window_ += increment;
+    if (send_window_ > Settings::MAX_WINDOW_SIZE)
+      return connection_error(Error_code::FLOW_CONTROL_ERROR);
+  }
+  else
+  {
+    auto it = streams_.find(hdr.stream_id);
+    if (it == streams_.end()) {
+      if (hdr.stream_id > last_stream_id_) return connection_error(Error_code::PROTOCOL_ERROR);
+      // a stream recently closed
+      return true;
+    }
+    if (increment == 0) {
+      reset_stream(hdr.stream_id, Error_code::PROTOCOL_ERROR);
+      return true;
+    }
+    it->second.send_window += increment;
+    if (it->second.send_window > Settings::MAX_WINDOW_SIZE) {
+      reset_stream(hdr.stream_id, Error_code::FLOW_CONTROL_ERROR);
+      return true;
+    }
+  }
+  send_pending();
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::send_headers(const uint32_t stream_id, const Response& res, const bool end_stream) {
+  auto it = streams_.find(stream_id);
+  if (it == streams_.end() or it->second.local_closed) return;
+  auto& stream = it->second;
+
+  std::string block;
+  encoder_.encode(":status", std::to_string(static_cast<int>(res.status_code())), block);
+  std::string name;
+  for (const auto& field : res.header())
+  {
+    name.resize(field.first.size());
+    std::transform(field.first.begin(), field.first.end(), name.begin(),
+                   [](char c) { return (c >= 'A' and c <= 'Z') ? c + ('a' - 'A') : c; });
+    if (connection_specific(name)) continue;
+    encoder_.encode(name, field.second, block);
+  }
+
+  // without a length the body ends when the caller says so
+  stream.has_length   = res.header().has_field(header::Content_Length);
+  stream.content_left = res.content_length();
+
+  // split into HEADERS and CONTINUATION frames
+  const std::size_t max = peer_.max_frame_size;
+  std::size_t offset = 0;
+  do {
+    const auto len  = std::min(max, block.size() - offset);
+    const bool last = offset + len == block.size();
+    uint8_t flags = last ? flag::END_HEADERS : 0;
+    if (offset == 0 and end_stream) flags |= flag::END_STREAM;
+    send_frame(offset == 0 ? Frame_type::HEADERS : Frame_type::CONTINUATION,
+               flags, stream_id, block.data() + offset, len);
+    offset += len;
+  } while (offset < block.size());
+
+  if (end_stream) close_local(it);
+  flush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::send_data(const uint32_t stream_id, const uint8_t* data, std::size_t len) {
+  auto it = streams_.find(stream_id);
+  if (it == streams_.end() or it->second.local_closed or it->second.end_pending) return;
+  auto& stream = it->second;
+
+  // the whole body is here when it reaches the Content-Length
+  bool end = false;
+  if (stream.has_length) {
+    len = std::min(len, stream.content_left);
+    stream.content_left -= len;
+    end = stream.content_left == 0;
+  }
+
+  // nothing queued ahead of it, frame what the windows allow straight
+  // from the caller, and only queue the rest
+  if (stream.pending.empty() and not blocked(stream))
+  {
+    while (len > 0)
+    {
+      const auto window = std::min(send_window_, stream.send_window);
+      if (window <= 0) break;
+      const auto n = std::min<std::size_t>({len, peer_.max_frame_size,
+                                            static_cast<std::size_t>(window)});
+      const bool last = n == len and end;
+      send_frame(Frame_type::DATA, last ? flag::END_STREAM : 0, stream_id, data, n);
+      stream.send_window -= n;
+      send_window_       -= n;
+      data += n;
+      len  -= n;
+      if (last) {
+        close_local(it);
+        flush();
+        return;
+      }
+    }
+  }
+
+  stream.pending.append(reinterpret_cast<const char*>(data), len);
+  stream.end_pending = end;
+  send_pending();
+  flush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::end_stream(const uint32_t stream_id) {
+  auto it = streams_.find(stream_id);
+  if (it == streams_.end() or it->second.local_closed or it->second.end_pending) return;
+  it->second.end_pending = true;
+  send_pending();
+  flush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::shutdown() {
+  if (goaway_sent_) return;
+  uint8_t payload[8];
+  write32(payload, last_stream_id_);
+  write32(payload + 4, static_cast<uint32_t>(Error_code::NO_ERROR));
+  send_frame(Frame_type::GOAWAY, 0, 0, payload, sizeof(payload));
+  goaway_sent_ = true;
+  flush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::send_pending() {
+  // weighted round robin: each round a stream may send weight KiB
+  static constexpr int32_t QUANTUM = 1024;
+  bool progress = true;
+
+  while (progress)
+  {
+    progress = false;
+    for (auto it = streams_.begin(); it not_eq streams_.end(); )
+    {
+      auto next = std::next(it);
+      auto& stream = it->second;
+      if (stream.local_closed or (stream.pending.empty() and not stream.end_pending)) {
+        it = next;
+        continue;
+      }
+      // the stream it depends on goes first
+      if (blocked(stream)) {
+        it = next;
+        continue;
+      }
+
+      // unused share is not saved up while blocked by flow control
+      const int32_t share = QUANTUM * stream.weight;
+      stream.deficit = std::min(stream.deficit + share, share);
+      bool ended = false;
+      while (stream.deficit > 0 and not stream.pending.empty())
+      {
+        const auto window = std::min(send_window_, stream.send_window);
+        if (window <= 0) break;
+        const auto len = std::min<std::size_t>({stream.pending.size(), peer_.max_frame_size,
+                                                static_cast<std::size_t>(window)});
+        ended = len == stream.pending.size() and stream.end_pending;
+        send_frame(Frame_type::DATA, ended ? flag::END_STREAM : 0, it->first,
+                   stream.pending.data(), len);
+        stream.pending.erase(0, len);
+        stream.deficit     -= len;
+        stream.send_window -= len;
+        send_window_       -= len;
+        progress = true;
+      }
+
+      if (stream.pending.empty())
+      {
+        stream.deficit = 0;
+        if (stream.end_pending) {
+          // nothing left to carry END_STREAM
+          if (not ended)
+            send_frame(Frame_type::DATA, flag::END_STREAM, it->first, nullptr, 0);
+          close_local(it);
+          progress = true;
+        }
+      }
+      it = next;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::blocked(const Stream& stream) const noexcept {
+  // bounded by the number of streams, should the peer make a cycle
+  auto depends_on = stream.depends_on;
+  for (std::size_t n = 0; depends_on not_eq 0 and n < streams_.size(); n++)
+  {
+    const auto parent = streams_.find(depends_on);
+    // a closed stream no longer holds back its dependents
+    if (parent == streams_.end()) return false;
+    if (not parent->second.pending.empty()) return true;
+    depends_on = parent->second.depends_on;
+  }
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::close_local(std::map<uint32_t, Stream>::iterator it) {
+  auto& stream = it->second;
+  stream.local_closed = true;
+  stream.pending.clear();
+  if (stream.remote_closed)
+    streams_.erase(it);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::send_frame(Frame_type type, uint8_t flags, uint32_t stream_id,
+                         const void* payload, std::size_t len) {
+  uint8_t hdr[Frame_header::SIZE];
+  Frame_header{static_cast<uint32_t>(len), type, flags, stream_id}.serialize(hdr);
+  if (out_ == nullptr)
+    out_ = net::Stream::construct_buffer();
+  out_->insert(out_->end(), hdr, hdr + sizeof(hdr));
+  const auto* data = static_cast<const uint8_t*>(payload);
+  if (len) out_->insert(out_->end(), data, data + len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::send_settings() {
+  const std::pair<Settings::Id, uint32_t> settings[] {
+    {Settings::HEADER_TABLE_SIZE,      local_.header_table_size},
+    {Settings::ENABLE_PUSH,            local_.enable_push},
+    {Settings::MAX_CONCURRENT_STREAMS, local_.max_concurrent_streams},
+    {Settings::INITIAL_WINDOW_SIZE,    local_.initial_window_size},
+    {Settings::MAX_FRAME_SIZE,         local_.max_frame_size},
+    {Settings::MAX_HEADER_LIST_SIZE,   local_.max_header_list_size},
+  };
+  uint8_t payload[sizeof(settings) / sizeof(settings[0]) * 6];
+  uint8_t* p = payload;
+  for (const auto& setting : settings) {
+    p[0] = setting.first >> 8;
+    p[1] = setting.first;
+    write32(p + 2, setting.second);
+    p += 6;
+  }
+  send_frame(Frame_type::SETTINGS, 0, 0, payload, sizeof(payload));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::send_window_update(const uint32_t stream_id, const uint32_t increment) {
+  uint8_t payload[4];
+  write32(payload, increment);
+  send_frame(Frame_type::WINDOW_UPDATE, 0, stream_id, payload, sizeof(payload));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::reset_stream(const uint32_t stream_id, const Error_code code) {
+  H2_PRINT("Reset stream %u: %u\n", stream_id, static_cast<unsigned>(code));
+  uint8_t payload[4];
+  write32(payload, static_cast<uint32_t>(code));
+  send_frame(Frame_type::RST_STREAM, 0, stream_id, payload, sizeof(payload));
+  streams_.erase(stream_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Session::connection_error(const Error_code code) {
+  H2_PRINT("Connection error: %u\n", static_cast<unsigned>(code));
+  if (not failed_) {
+    uint8_t payload[8];
+    write32(payload, last_stream_id_);
+    write32(payload + 4, static_cast<uint32_t>(code));
+    send_frame(Frame_type::GOAWAY, 0, 0, payload, sizeof(payload));
+    goaway_sent_ = true;
+    failed_      = true;
+  }
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Session::flush() {
+  if (receiving_ or out_ == nullptr or out_->empty()) return;
+  // the frames are written as they were put together, without a copy
+  on_write_(std::move(out_));
+  out_ = nullptr;
+}
+
+} //< namespace h2
+} //< namespace http
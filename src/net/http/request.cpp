@@ -60,6 +60,34 @@ Request::Request(std::string request, const std::size_t limit, const bool parse)
   if (parse) this->parse();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+Request::Request(const Request_view& head, const std::size_t limit)
+  : Message{std::max(limit, head.num_fields)}
+  , method_{method::code(head.method)}
+  , uri_{head.target}
+  , version_{head.major, head.minor}
+{
+  // the parsed data is reused for the next read, so copy the
+  // fields in one go and keep views into the copy
+  if (head.num_fields > 0) {
+    const char* begin = head.fields[0].name.data();
+    const auto& last  = head.fields[head.num_fields - 1];
+    const char* end   = last.value.data() + last.value.size();
+    auto copy = std::make_shared<const std::string>(begin, end);
+
+    std::vector<Field_view> fields;
+    fields.reserve(head.num_fields);
+    const auto rebase = [&] (util::csview view) {
+      return util::sview{copy->data() + (view.data() - begin), view.size()};
+    };
+    for (const auto& field : head) {
+      fields.push_back({rebase(field.name), rebase(field.value)});
+    }
+    header().borrow(std::move(copy), std::move(fields));
+  }
+  set_headers_complete(true);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 Request& Request::parse() {
   if (parse_request(this, request_) not_eq request_.length()) {
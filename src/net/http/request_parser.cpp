@@ -0,0 +1,252 @@
+
+#include <net/http/request_parser.hpp>
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace http {
+
+///////////////////////////////////////////////////////////////////////////////
+Arena::Arena(const std::size_t size)
+  : data_{new char[size]}
+  , size_{size}
+{}
+
+///////////////////////////////////////////////////////////////////////////////
+void* Arena::allocate(const std::size_t size, const std::size_t align) noexcept {
+  const auto base  = reinterpret_cast<uintptr_t>(data_.get());
+  const auto start = (base + used_ + align - 1) & ~(align - 1);
+  if (start + size > base + size_) return nullptr;
+  used_ = start + size - base;
+  return reinterpret_cast<void*>(start);
+}
+
+///
+/// Find the first occurrence of either a or b in [p, end)
+///
+/// @return Pointer to the delimiter found, or end
+///
+static inline const char* find_either(const char* p, const char* const end,
+                                      const char a, const char b) noexcept
+{
+#if defined(__AVX2__)
+  const __m256i va32 = _mm256_set1_epi8(a);
+  const __m256i vb32 = _mm256_set1_epi8(b);
+  for (; end - p >= 32; p += 32) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const uint32_t mask = _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, va32), _mm256_cmpeq_epi8(x, vb32)));
+    if (mask) return p + __builtin_ctz(mask);
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i va = _mm_set1_epi8(a);
+  const __m128i vb = _mm_set1_epi8(b);
+  for (; end - p >= 16; p += 16) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const uint32_t mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)));
+    if (mask) return p + __builtin_ctz(mask);
+  }
+#endif
+  for (; p < end; ++p) {
+    if (*p == a or *p == b) return p;
+  }
+  return end;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static inline char lower(const char c) noexcept {
+  return (c >= 'A' and c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool field_equals(util::csview a, util::csview b) noexcept {
+  if (a.size() not_eq b.size()) return false;
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    if (lower(a[i]) not_eq lower(b[i])) return false;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+util::sview Request_view::value(util::csview name) const noexcept {
+  for (const auto& field : *this) {
+    if (field_equals(field.name, name)) return field.value;
+  }
+  return {};
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static inline bool is_ows(const char c) noexcept {
+  return c == ' ' or c == '\t';
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static inline bool contains_token(util::sview list, util::csview token) noexcept {
+  // comma separated list, e.g. "Connection: keep-alive, Upgrade"
+  while (not list.empty()) {
+    auto comma = list.find(',');
+    auto item  = list.substr(0, comma);
+    while (not item.empty() and is_ows(item.front())) item.remove_prefix(1);
+    while (not item.empty() and is_ows(item.back()))  item.remove_suffix(1);
+    if (field_equals(item, token)) return true;
+    if (comma == util::csview::npos) break;
+    list.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
+///
+/// Length of the line ending at p, accepting a bare LF
+///
+/// @return 1 or 2, 0 if more data is needed, -1 if malformed
+///
+static inline int eol_length(const char* p, const char* const end) noexcept {
+  if (*p == '\n') return 1;
+  if (p + 1 >= end) return 0;
+  return (p[1] == '\n') ? 2 : -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int Request_parser::parse(util::csview data, Request_view& req) noexcept {
+  const auto mark = arena_.used();
+  const int  res  = parse_head(data, req);
+  // don't hold on to fields of a request not parsed
+  if (res < 0) arena_.rewind(mark);
+  return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int Request_parser::parse_head(util::csview data, Request_view& req) noexcept {
+  const char* const begin = data.data();
+  const char* const end   = begin + data.size();
+  const char* p = begin;
+
+  // RFC 7230 3.5: ignore empty lines before the request-line
+  while (p < end and (*p == '\r' or *p == '\n')) ++p;
+
+  //-----------------------------------
+  // Request-line
+  //-----------------------------------
+  const char* sp = find_either(p, end, ' ', '\r');
+  if (sp == end) return incomplete;
+  if (*sp not_eq ' ' or sp == p) return invalid;
+  req.method = {p, static_cast<std::size_t>(sp - p)};
+  p = sp + 1;
+
+  sp = find_either(p, end, ' ', '\r');
+  if (sp == end) return incomplete;
+  if (*sp not_eq ' ' or sp == p) return invalid;
+  req.target = {p, static_cast<std::size_t>(sp - p)};
+  p = sp + 1;
+
+  // HTTP-version = "HTTP/" DIGIT "." DIGIT
+  if (end - p < 9) return incomplete;
+  if (std::memcmp(p, "HTTP/", 5) not_eq 0
+      or p[5] < '0' or p[5] > '9' or p[6] not_eq '.' or p[7] < '0' or p[7] > '9')
+    return invalid;
+  req.major = p[5] - '0';
+  req.minor = p[7] - '0';
+  p += 8;
+  if (*p not_eq '\r' and *p not_eq '\n') return invalid;
+  int eol = eol_length(p, end);
+  if (eol <= 0) return eol == 0 ? incomplete : invalid;
+  p += eol;
+
+  //-----------------------------------
+  // Header fields
+  //-----------------------------------
+  req.fields         = nullptr;
+  req.num_fields     = 0;
+  req.content_length = 0;
+  req.chunked        = false;
+  req.keep_alive     = (req.major == 1 and req.minor >= 1);
+  bool have_length   = false;
+
+  while (true)
+  {
+    if (p >= end) return incomplete;
+
+    // empty line ends the header section
+    if (*p == '\r' or *p == '\n') {
+      eol = eol_length(p, end);
+      if (eol <= 0) return eol == 0 ? incomplete : invalid;
+      p += eol;
+      break;
+    }
+
+    if (req.num_fields == max_fields_) return invalid;
+
+    const char* colon = find_either(p, end, ':', '\n');
+    if (colon == end) return incomplete;
+    // no empty names, and no whitespace between name and colon
+    if (*colon not_eq ':' or colon == p or is_ows(colon[-1])) return invalid;
+    const util::sview name {p, static_cast<std::size_t>(colon - p)};
+
+    const char* v = colon + 1;
+    while (v < end and is_ows(*v)) ++v;
+    const char* vend = find_either(v, end, '\r', '\n');
+    if (vend == end) return incomplete;
+    eol = eol_length(vend, end);
+    if (eol <= 0) return eol == 0 ? incomplete : invalid;
+    p = vend + eol;
+    if (p == end) return incomplete;
+    while (vend > v and is_ows(vend[-1])) --vend;
+    const util::sview value {v, static_cast<std::size_t>(vend - v)};
+
+    // obsolete line folding is rejected (RFC 7230 3.2.4)
+    if (is_ows(*p)) return invalid;
+
+    // fields are allocated one by one, ending up contiguous in the arena
+    auto* field = arena_.make_array<Field_view>(1);
+    if (field == nullptr) return invalid;
+    *field = {name, value};
+    if (req.fields == nullptr) req.fields = field;
+    req.num_fields++;
+
+    // the fields needed to frame the message are picked up on the way
+    switch (name.size()) {
+    case 14: // Content-Length
+      if (field_equals(name, "Content-Length")) {
+        if (value.empty()) return invalid;
+        std::size_t len = 0;
+        for (const char c : value) {
+          if (c < '0' or c > '9') return invalid;
+          if (len > (SIZE_MAX - 9) / 10) return invalid;
+          len = len * 10 + (c - '0');
+        }
+        // differing duplicates would allow request smuggling
+        if (have_length and len not_eq req.content_length) return invalid;
+        req.content_length = len;
+        have_length = true;
+      }
+      break;
+    case 17: // Transfer-Encoding
+      if (field_equals(name, "Transfer-Encoding"))
+        req.chunked = contains_token(value, "chunked");
+      break;
+    case 10: // Connection
+      if (field_equals(name, "Connection")) {
+        if (contains_token(value, "close"))
+          req.keep_alive = false;
+        else if (contains_token(value, "keep-alive"))
+          req.keep_alive = true;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  // RFC 7230 3.3.3: Transfer-Encoding overrides Content-Length
+  if (req.chunked) req.content_length = 0;
+
+  req.header_length = p - begin;
+  return static_cast<int>(req.header_length);
+}
+
+} //< namespace http
@@ -1,51 +1,59 @@
 
 #include <net/http/response_writer.hpp>
 
-#include <sstream>
-
 namespace http {
 
   Response_writer::Response_writer(Response_ptr res, Connection& conn)
     : response_(std::move(res)),
-      connection_(conn)
+      connection_(conn),
+      seq_{conn.begin_response()}
   {
     Ensures(not connection_.released());
   }
 
   void Response_writer::write(std::string data)
   {
+    const bool coalesce = not header_sent_;
     pre_write(data.size());
 
-    connection_.stream()->write(std::move(data));
+    // header and body in one write
+    if(coalesce)
+      write_head(http::OK, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    else if(not data.empty())
+      send(net::Stream::construct_buffer(data.begin(), data.end()));
   }
 
   void Response_writer::write(net::tcp::buffer_t buffer)
+  {
+    if(not header_sent_)
+    {
+      write(http::OK, std::move(buffer));
+      return;
+    }
+    pre_write(buffer->size());
+    send(std::move(buffer));
+  }
+
+  void Response_writer::write(status_t code, net::tcp::buffer_t buffer)
   {
     pre_write(buffer->size());
 
-    connection_.stream()->write(std::move(buffer));
+    // copying a small body is cheaper than sending it in a segment of its own,
+    // larger ones are passed on as they are
+    if(buffer->size() <= COALESCE_LIMIT) {
+      write_head(code, buffer->data(), buffer->size());
+      return;
+    }
+    write_head(code, nullptr, 0);
+    send(std::move(buffer));
   }
 
   void Response_writer::pre_write(size_t len)
   {
-    // send headers if not already sent
-    if(not header_sent_)
+    // help out with setting the content-length if none is set
+    if(not header_sent_ and not header().has_field(header::Content_Length))
     {
-      // lets help out with setting the content-length if none is set
-      if(not header().has_field(header::Content_Length))
-      {
-        response_->set_content_length(len);
-      }
-      // content-length is already set
-      else
-      {
-        const auto cl = response_->content_length();
-        // don't allow writing more than content-length in header allows
-        if(cl < len)
-          throw Response_writer_error{"Trying to write more than Content-Length allows: " + std::to_string(cl)};
-      }
-      // write headers
-      write_header(http::OK);
+      response_->set_content_length(len);
     }
     else
     {
@@ -56,23 +64,24 @@ namespace http {
     }
   }
 
-  void Response_writer::write_header(status_t code)
+  void Response_writer::write_head(status_t code, const uint8_t* body, size_t len)
   {
-    if(LIKELY(not header_sent_))
-    {
-      response_->set_status_code(code);
+    if(UNLIKELY(header_sent_))
+      throw Response_writer_error{"Headers already sent."};
 
-      std::ostringstream header;
-      header << response_->status_line() << "\r\n" << response_->header();
+    response_->set_status_code(code);
+    header_sent_ = true;
 
-      connection_.stream()->write(header.str());
+    // disable keep alive if "Connection: close" is present
+    if(response_->header().value(http::header::Connection) == "close")
+      connection_.keep_alive(false);
 
-      // disable keep alive if "Connection: close" is present
-      if(response_->header().value(http::header::Connection) == "close")
-        connection_.keep_alive(false);
-    }
-    else
-      throw Response_writer_error{"Headers already sent."};
+    connection_.write_response_head(seq_, *response_, body, len);
+  }
+
+  void Response_writer::write_header(status_t code)
+  {
+    write_head(code, nullptr, 0);
   }
 
   void Response_writer::write()
@@ -85,7 +94,9 @@ namespace http {
 
   void Response_writer::end()
   {
-    connection_.end();
+    if(ended_) return;
+    ended_ = true;
+    connection_.end_response(seq_);
   }
 
   Response_writer::~Response_writer()
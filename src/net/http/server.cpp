@@ -92,6 +92,15 @@ namespace http {
     }
   }
 
+  bool Server::receive(const Request_view& head, Server_connection& conn)
+  {
+    if(on_request_view_ == nullptr)
+      return false;
+    ++stat_req_rx_;
+    on_request_view_(head, std::make_unique<Response_writer>(create_response(), conn));
+    return true;
+  }
+
   void Server::receive(Request_ptr req, status_t code, Server_connection& conn)
   {
     ++stat_req_rx_;
@@ -102,9 +111,11 @@ namespace http {
     else
     {
       ++stat_req_bad_;
-      // an error occured when parsing
-      // call user on_error or something
-      conn.send(create_response(code));
+      // an error occured when parsing, the connection closes after it
+      auto res = create_response(code);
+      if(not conn.keep_alive())
+        res->header().set_field(header::Connection, "close");
+      conn.send(std::move(res));
     }
   }
 
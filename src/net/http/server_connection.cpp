@@ -2,6 +2,8 @@
 #include <net/http/server_connection.hpp>
 #include <net/http/server.hpp>
 
+#include <algorithm>
+
 namespace http {
 
  Server_connection::Server_connection(Server& server, Stream_ptr stream, size_t idx, const size_t bufsize)
@@ -9,16 +11,131 @@ namespace http {
       server_(server),
       req_(nullptr),
       idx_(idx),
-      idle_since_{0}
+      idle_since_{0},
+      arena_{ARENA_SIZE}
   {
     stream_->on_read(bufsize, {this, &Server_connection::recv_request});
     // setup close event
     stream_->on_close({this, &Server_connection::close});
+    stream_->on_write({this, &Server_connection::written});
   }
 
   void Server_connection::send(Response_ptr res)
   {
-    stream_->write(res->to_string());
+    const auto seq = begin_response();
+    const auto str = res->to_string();
+    write_response(seq, Stream::construct_buffer(str.begin(), str.end()));
+    end_response(seq);
+  }
+
+  uint32_t Server_connection::begin_response()
+  {
+    if(h2_)
+      return h2_stream_;
+    pending_.emplace_back();
+    return first_seq_ + static_cast<uint32_t>(pending_.size() - 1);
+  }
+
+  void Server_connection::write_response(const uint32_t seq, buffer_t buf)
+  {
+    if(h2_) {
+      h2_->send_data(seq, buf->data(), buf->size());
+      return;
+    }
+    const uint32_t idx = seq - first_seq_;
+    if(UNLIKELY(released() or idx >= pending_.size()))
+      return;
+
+    // only the oldest response goes straight out
+    if(idx == 0)
+      stream_->write(std::move(buf));
+    else
+      pending_[idx].bufs.push_back(std::move(buf));
+  }
+
+  void Server_connection::end_response(const uint32_t seq)
+  {
+    if(h2_) {
+      h2_->end_stream(seq);
+      return;
+    }
+    const uint32_t idx = seq - first_seq_;
+    if(UNLIKELY(idx >= pending_.size()))
+      return;
+
+    pending_[idx].ended = true;
+    flush_responses();
+
+    if(released())
+    {
+      // the stream was taken over (e.g. upgrade), done when nothing refers to us
+      if(pending_.empty())
+        close();
+    }
+    else if(pending_.empty() and not keep_alive_)
+    {
+      shutdown();
+    }
+  }
+
+  void Server_connection::write_response_head(const uint32_t seq, const Response& res,
+                                              const uint8_t* body, const size_t len)
+  {
+    if(h2_) {
+      h2_->send_headers(seq, res);
+      if(len) h2_->send_data(seq, body, len);
+      return;
+    }
+    Connection::write_response_head(seq, res, body, len);
+  }
+
+  void Server_connection::on_written(Written_handler handler)
+  {
+    written_.push_back({std::move(handler)});
+  }
+
+  void Server_connection::written(const size_t n)
+  {
+    // a handler writing may be called back from within, so nothing is
+    // removed (moving the others) until the outermost call is done
+    ++written_depth_;
+    for(size_t i = 0; i < written_.size(); i++)
+    {
+      if(written_[i].done)
+        continue;
+      // a copy, as the handlers may be added to meanwhile
+      auto handler = written_[i].handler;
+      if(not handler(n))
+        written_[i].done = true;
+    }
+    if(--written_depth_ > 0)
+      return;
+    written_.erase(std::remove_if(written_.begin(), written_.end(),
+      [] (const Written& w) { return w.done; }), written_.end());
+
+    // closed by a handler writing
+    if(close_pending_ and not receiving_)
+      close();
+  }
+
+  void Server_connection::flush_responses()
+  {
+    while(not pending_.empty())
+    {
+      auto& front = pending_.front();
+      if(not released())
+      {
+        for(auto& buf : front.bufs)
+          stream_->write(std::move(buf));
+      }
+      front.bufs.clear();
+
+      if(not front.ended)
+        break;
+
+      pending_.pop_front();
+      ++first_seq_;
+    }
   }
 
   void Server_connection::recv_request(buffer_t buf)
@@ -27,54 +144,182 @@ namespace http {
       //end_response({Error::NO_REPLY});
       return;
     }
+    update_idle();
+
+    util::sview data{(const char*) buf->data(), buf->size()};
+
+    // a request handler may close the connection, which must not
+    // be deleted before we are done with it
+    receiving_ = true;
+    receive_data(data);
+    receiving_ = false;
 
-    const std::string data{(char*) buf->data(), buf->size()};
+    // closed by a handler, or a request took over the stream and
+    // all responses are done
+    if(close_pending_ or (released() and pending_.empty()))
+      close();
+  }
 
-    // create response if not exist
-    if(req_ == nullptr)
+  void Server_connection::receive_data(util::sview data)
+  {
+    if(h2_)
     {
-      try {
-        req_ = make_request(data); // this also parses
-        update_idle();
+      if(not h2_->receive(data))
+        shutdown();
+      return;
+    }
+    // the rest is dropped after a request that couldn't be parsed
+    if(failed_)
+      return;
+
+    // the start of a head arrived in an earlier read
+    if(not head_.empty())
+    {
+      head_.append(data.data(), data.size());
+      data = head_;
+    }
+
+    // HTTP/2 starts with its preface instead of a first request
+    if(req_ == nullptr and first_seq_ == 0 and pending_.empty())
+    {
+      const int preface = h2::match_preface(data);
+      if(preface > 0) {
+        start_http2(data);
+        return;
       }
-      catch(...)
-      {
-        // Invalid request, just return (?)
-        //end_request(http::Bad_Request);
+      if(preface == 0) {
+        if(head_.empty())
+          head_.assign(data.data(), data.size());
         return;
       }
     }
-    // if there already is a request
-    else
-    {
-      // note: need to validate that the method is allowed, etc.
-      // add chunks of body data
-      req_->add_chunk(std::move(data));
-      update_idle();
-    }
 
-    const auto& header = req_->header();
+    parse_requests(data);
+  }
 
-    if(not header.is_empty() && header.has_field(header::Content_Length))
+  void Server_connection::parse_requests(util::sview data)
+  {
+    while(not data.empty())
     {
-      try
+      // create request if not exist
+      if(req_ == nullptr)
       {
-        const unsigned conlen = std::stoul(std::string(header.value(header::Content_Length)));
-        // risk buffering forever if no timeout
-        if(conlen == req_->body().size())
+        arena_.reset();
+        Request_view head;
+        const int len = Request_parser{arena_}.parse(data, head);
+
+        if(len == Request_parser::incomplete)
+        {
+          // keep what is left for the next read, data may be the tail of head_
+          if(not head_.empty() and data.data() >= head_.data()
+             and data.data() < head_.data() + head_.size())
+            head_.erase(0, data.data() - head_.data());
+          else
+            head_.assign(data.data(), data.size());
+
+          // risk buffering forever
+          if(head_.size() > MAX_HEAD_SIZE)
+            bad_request();
+          return;
+        }
+
+        if(len == Request_parser::invalid)
+        {
+          bad_request();
+          return;
+        }
+
+        // handled in place, without a Request
+        if(not head.chunked and head.content_length == 0
+           and server_.receive(head, *this))
+        {
+          data.remove_prefix(len);
+          if(close_pending_ or released() or stream_->is_closing())
+            break;
+          continue;
+        }
+
+        try {
+          // chunked bodies are left to the complete parser,
+          // which takes the rest of the data
+          if(UNLIKELY(head.chunked))
+          {
+            req_ = make_request(std::string{data}); // this also parses
+            data = {};
+          }
+          else
+          {
+            req_ = std::make_unique<Request>(head);
+            data.remove_prefix(len);
+          }
+          body_left_ = head.chunked ? 0 : head.content_length;
+        }
+        catch(...)
+        {
+        }
+        if(req_ == nullptr)
         {
-          end_request();
+          bad_request();
+          return;
         }
       }
-      catch(...)
+
+      // note: need to validate that the method is allowed, etc.
+      // add chunks of body data, anything after it is the next request
+      const auto n = std::min(body_left_, data.size());
+      if(n > 0)
       {
-        end_request(http::Bad_Request);
+        req_->add_chunk(std::string{data.substr(0, n)});
+        body_left_ -= n;
+        data.remove_prefix(n);
       }
-    }
-    else
-    {
+
+      // risk buffering forever if no timeout
+      if(body_left_ > 0)
+        break;
+
       end_request();
+
+      // no more requests if the stream was taken over or is closing
+      if(close_pending_ or released() or stream_->is_closing())
+        break;
     }
+    // data may refer to the buffered head, done with it now
+    head_.clear();
+  }
+
+  void Server_connection::start_http2(util::csview data)
+  {
+    h2_ = std::make_unique<h2::Session>(
+        h2::Session::Write_handler{this, &Server_connection::h2_write},
+        h2::Session::Request_handler{this, &Server_connection::h2_request});
+    const bool ok = h2_->receive(data);
+    // data may refer to the buffered preface
+    head_.clear();
+    if(not ok)
+      shutdown();
+  }
+
+  void Server_connection::h2_write(buffer_t buf)
+  {
+    if(not released())
+      stream_->write(std::move(buf));
+  }
+
+  void Server_connection::h2_request(const uint32_t stream_id, Request_ptr req)
+  {
+    h2_stream_ = stream_id;
+    server_.receive(std::move(req), http::OK, *this);
+  }
+
+  void Server_connection::bad_request()
+  {
+    head_.clear();
+    // nothing after it can be parsed, answered after the responses
+    // before it, and closed when they are all sent
+    failed_ = true;
+    keep_alive_ = false;
+    end_request(http::Bad_Request);
   }
 
   void Server_connection::end_request(const status_t code)
@@ -84,6 +329,16 @@ namespace http {
 
   void Server_connection::close()
   {
+    // still parsing or writing, closed once done
+    if(receiving_ or written_depth_ > 0)
+    {
+      close_pending_ = true;
+      return;
+    }
+    // responses still being written give up, without writing more
+    pending_.clear();
+    h2_.reset();
+    written_.clear();
     server_.close(*this);
   }
 
@@ -0,0 +1,472 @@
+
+#include <net/http/static_files.hpp>
+#include <net/http/mime_types.hpp>
+
+#include <cstdio>
+
+namespace http {
+
+  // content coding and file extension of each precompressed variant
+  static const util::csview CODING[] {"br", "gzip"};
+  static const util::csview SUFFIX[] {".br", ".gz"};
+
+  static util::sview trim(util::sview str) noexcept
+  {
+    while(not str.empty() and (str.front() == ' ' or str.front() == '\t'))
+      str.remove_prefix(1);
+    while(not str.empty() and (str.back() == ' ' or str.back() == '\t'))
+      str.remove_suffix(1);
+    return str;
+  }
+
+  // parse decimal digits, false if empty, not a number or overflowing
+  static bool parse_u64(util::csview str, uint64_t& value) noexcept
+  {
+    if(str.empty() or str.size() > 19)
+      return false;
+    value = 0;
+    for(const char c : str)
+    {
+      if(c < '0' or c > '9')
+        return false;
+      value = value * 10 + (c - '0');
+    }
+    return true;
+  }
+
+  Static_files::File::File(fs::Dirent ent)
+    : dirent{std::move(ent)},
+      length{std::to_string(dirent.size())}
+  {
+    // anything changing along with the content will do
+    char buf[64];
+    const int len = snprintf(buf, sizeof(buf), "\"%llx-%x-%llx\"",
+                             (unsigned long long) dirent.size(),
+                             (unsigned) dirent.modified(),
+                             (unsigned long long) dirent.block());
+    etag.assign(buf, len);
+  }
+
+  Static_files::Static_files(fs::Dirent root, size_t cache_limit, size_t file_limit)
+    : root_{std::move(root)},
+      cache_limit_{cache_limit},
+      file_limit_{file_limit}
+  {
+    Expects(root_.is_dir());
+  }
+
+  bool Static_files::serve(const Request& req, Response_writer_ptr& res)
+  {
+    const auto method = req.method();
+    if(method != GET and method != HEAD)
+      return false;
+
+    std::string path {req.uri().path()};
+    if(path.empty() or path.front() != '/' or path.find("/..") != std::string::npos)
+      return false;
+    if(path.back() == '/')
+      path.append("index.html");
+
+    auto* entry = lookup(path);
+    if(entry == nullptr)
+      return false;
+
+    // the preferred variant the client accepts
+    const auto accept = req.header().value(header::Accept_Encoding);
+    int enc = IDENTITY;
+    for(int e = BROTLI; e < IDENTITY; e++)
+    {
+      if(entry->variants[e] and accepts_encoding(accept, CODING[e])) {
+        enc = e;
+        break;
+      }
+    }
+    File& file = *entry->variants[enc];
+
+    auto& header = res->header();
+    header.set_field(header::Content_Type, std::string(entry->mime));
+    header.set_field(header::ETag, file.etag);
+    header.set_field(header::Accept_Ranges, "bytes");
+    if(entry->variants[BROTLI] or entry->variants[GZIP])
+      header.set_field(header::Vary, "Accept-Encoding");
+    if(enc != IDENTITY)
+      header.set_field(header::Content_Encoding, std::string(CODING[enc]));
+
+    const auto if_none_match = req.header().value(header::If_None_Match);
+    if(not if_none_match.empty() and etag_matches(if_none_match, file.etag))
+    {
+      res->write_header(Not_Modified);
+      return true;
+    }
+
+    const uint64_t size = file.dirent.size();
+    Byte_range range {0, size - 1};
+    status_t code = OK;
+
+    const auto range_value = req.header().value(header::Range);
+    const auto if_range = req.header().value(header::If_Range);
+    // a range of an old version of the file means the whole new one
+    if(not range_value.empty() and size > 0
+       and (if_range.empty() or if_range == file.etag))
+    {
+      switch(parse_range(range_value, size, range))
+      {
+      case -1:
+        header.set_field(header::Content_Range, "bytes */" + file.length);
+        header.set_field(header::Content_Length, "0");
+        res->write_header(Range_Not_Satisfiable);
+        return true;
+      case 1:
+        code = Partial_Content;
+        header.set_field(header::Content_Range, "bytes " + std::to_string(range.first)
+          + "-" + std::to_string(range.last) + "/" + file.length);
+        break;
+      default:
+        range = {0, size - 1};
+      }
+    }
+
+    if(method == HEAD or size == 0)
+    {
+      header.set_field(header::Content_Length,
+        (code == Partial_Content) ? std::to_string(range.length()) : file.length);
+      res->write_header(code);
+      return true;
+    }
+
+    write_range(res, file, code, range);
+    return true;
+  }
+
+  struct Static_files::Transfer {
+    Response_writer_ptr res;
+    fs::Dirent          dirent;
+    uint64_t            pos;
+    uint64_t            last;
+    size_t              read_size;
+    status_t            code;
+    size_t              in_flight {0}; // bytes not yet written by the stream
+    bool                header_sent {false};
+    bool                reading {false};
+
+    Transfer(Response_writer_ptr r, fs::Dirent ent, status_t c,
+             Byte_range range, size_t size)
+      : res{std::move(r)}, dirent{std::move(ent)}, pos{range.first},
+        last{range.last}, read_size{size}, code{c}
+    {}
+
+    /** Queue parts until enough are in flight, false when done */
+    bool read()
+    {
+      // writing may call back, the loop takes over
+      if(reading)
+        return true;
+      reading = true;
+      while(res != nullptr and pos <= last
+            and in_flight < READS_IN_FLIGHT * read_size)
+      {
+        const uint64_t len = std::min<uint64_t>(read_size, last + 1 - pos);
+        auto buf = dirent.read(pos, len);
+        if(UNLIKELY(not buf or buf.size() != len))
+        {
+          fail();
+          break;
+        }
+        pos += len;
+        in_flight += len;
+        if(not header_sent)
+          res->write(code, std::move(buf.get()));
+        else
+          res->write(std::move(buf.get()));
+        header_sent = true;
+      }
+      reading = false;
+      // all queued, the response is done
+      if(pos > last)
+        res = nullptr;
+      return res != nullptr;
+    }
+
+    bool written(size_t n)
+    {
+      in_flight -= std::min(n, in_flight);
+      return read();
+    }
+
+    void fail()
+    {
+      // the client can't tell a short body from a complete one
+      // unless the connection is closed
+      res->connection().keep_alive(false);
+      if(not header_sent) {
+        res->header().set_field(header::Content_Length, "0");
+        res->write_header(Internal_Server_Error);
+      }
+      else {
+        res->connection().shutdown();
+      }
+      res = nullptr;
+    }
+  };
+
+  void Static_files::write_range(Response_writer_ptr& res, File& file,
+                                 status_t code, Byte_range range)
+  {
+    res->header().set_field(header::Content_Length, std::to_string(range.length()));
+
+    // read from disk a part at a time, as the connection writes them
+    if(file.chunks.empty())
+    {
+      auto& conn = res->connection();
+      auto transfer = std::make_shared<Transfer>(
+          std::move(res), file.dirent, code, range, read_size_);
+      // before reading, as writing may call back right away
+      conn.on_written([transfer] (size_t n) { return transfer->written(n); });
+      transfer->read();
+      return;
+    }
+
+    bool first = true;
+    uint64_t pos = range.first;
+    while(pos <= range.last)
+    {
+      const uint64_t offset = pos % CHUNK_SIZE;
+      const uint64_t len = std::min<uint64_t>(CHUNK_SIZE - offset, range.last + 1 - pos);
+
+      const auto& chunk = file.chunks[pos / CHUNK_SIZE];
+      // whole chunks are shared, only the ends of a range are copied
+      auto buf = (offset == 0 and len == chunk->size()) ? chunk
+        : net::Stream::construct_buffer(chunk->begin() + offset,
+                                        chunk->begin() + offset + len);
+      if(first)
+        res->write(code, std::move(buf));
+      else
+        res->write(std::move(buf));
+      first = false;
+      pos += len;
+    }
+  }
+
+  // memory used by an entry besides the content of its files
+  static size_t entry_overhead(const std::string& path) noexcept
+  { return 2 * path.size() + 256; }
+
+  Static_files::Entry* Static_files::lookup(const std::string& path, bool make_room)
+  {
+    auto it = files_.find(path);
+    if(it != files_.end())
+    {
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      return &it->second;
+    }
+
+    // relative to the root
+    const std::string rel = path.substr(1);
+    auto ent = root_.stat_sync(rel);
+    if(not ent.is_file())
+      return nullptr;
+
+    Entry entry;
+    const auto name = util::sview{path}.substr(path.rfind('/') + 1);
+    const auto dot = name.rfind('.');
+    entry.mime = ext_to_mime_type(
+      (dot != util::sview::npos) ? name.substr(dot + 1) : util::sview{});
+
+    entry.variants[IDENTITY].emplace(std::move(ent));
+    load(*entry.variants[IDENTITY], make_room);
+
+    for(int e = BROTLI; e < IDENTITY; e++)
+    {
+      auto var = root_.stat_sync(rel + std::string(SUFFIX[e]));
+      if(var.is_file()) {
+        entry.variants[e].emplace(std::move(var));
+        load(*entry.variants[e], make_room);
+      }
+    }
+
+    entry.bytes = entry_overhead(path);
+    for(auto& var : entry.variants)
+      if(var and not var->chunks.empty())
+        entry.bytes += var->dirent.size();
+    // the content is counted already
+    used_bytes_ += entry_overhead(path);
+    while(make_room and not lru_.empty() and used_bytes_ > cache_limit_)
+      evict();
+
+    lru_.push_front(path);
+    entry.lru = lru_.begin();
+    return &files_.emplace(path, std::move(entry)).first->second;
+  }
+
+  void Static_files::evict()
+  {
+    auto it = files_.find(lru_.back());
+    for(auto& var : it->second.variants)
+      if(var and not var->chunks.empty())
+        cached_bytes_ -= var->dirent.size();
+    used_bytes_ -= it->second.bytes;
+    files_.erase(it);
+    lru_.pop_back();
+  }
+
+  void Static_files::load(File& file, bool make_room)
+  {
+    const uint64_t size = file.dirent.size();
+    if(size == 0 or size > file_limit_ or size > cache_limit_)
+      return;
+    while(make_room and not lru_.empty() and used_bytes_ + size > cache_limit_)
+      evict();
+    if(used_bytes_ + size > cache_limit_)
+      return;
+
+    for(uint64_t pos = 0; pos < size; pos += CHUNK_SIZE)
+    {
+      const uint64_t len = std::min<uint64_t>(CHUNK_SIZE, size - pos);
+      auto buf = file.dirent.read(pos, len);
+      if(not buf or buf.size() != len)
+      {
+        file.chunks.clear();
+        return;
+      }
+      file.chunks.push_back(std::move(buf.get()));
+    }
+    cached_bytes_ += size;
+    used_bytes_   += size;
+  }
+
+  void Static_files::preload()
+  {
+    preload("/", root_);
+  }
+
+  void Static_files::preload(const std::string& path, fs::Dirent dir)
+  {
+    auto list = dir.ls();
+    if(list.error)
+      return;
+
+    for(auto& ent : *list.entries)
+    {
+      const auto& name = ent.name();
+      if(name == "." or name == "..")
+        continue;
+
+      if(ent.is_dir())
+      {
+        preload(path + name + "/", ent);
+      }
+      else if(ent.is_file())
+      {
+        // variants are loaded along with the file they belong to
+        const util::sview sv {name};
+        bool variant = false;
+        for(const auto suffix : SUFFIX)
+          variant |= (sv.size() > suffix.size() and sv.substr(sv.size() - suffix.size()) == suffix);
+
+        // what is preloaded isn't dropped for more of it
+        if(not variant)
+          lookup(path + name, false);
+      }
+
+      if(used_bytes_ >= cache_limit_)
+        return;
+    }
+  }
+
+  int Static_files::parse_range(util::sview value, uint64_t size, Byte_range& range) noexcept
+  {
+    value = trim(value);
+    constexpr util::csview unit {"bytes="};
+    if(value.substr(0, unit.size()) != unit)
+      return 0;
+    value.remove_prefix(unit.size());
+
+    // serving multiple ranges is optional
+    if(value.find(',') != util::sview::npos)
+      return 0;
+
+    const auto dash = value.find('-');
+    if(dash == util::sview::npos)
+      return 0;
+    const auto first = trim(value.substr(0, dash));
+    const auto last  = trim(value.substr(dash + 1));
+
+    uint64_t a = 0, b = 0;
+    // suffix range, the last b bytes
+    if(first.empty())
+    {
+      if(not parse_u64(last, b))
+        return 0;
+      if(b == 0)
+        return -1;
+      range = {(b < size) ? size - b : 0, size - 1};
+      return 1;
+    }
+
+    if(not parse_u64(first, a))
+      return 0;
+    if(last.empty())
+      b = size - 1;
+    else if(not parse_u64(last, b) or b < a)
+      return 0;
+
+    if(a >= size)
+      return -1;
+    range = {a, std::min(b, size - 1)};
+    return 1;
+  }
+
+  bool Static_files::etag_matches(util::sview value, util::sview etag) noexcept
+  {
+    // weak comparison, W/ doesn't matter
+    auto opaque = [] (util::sview tag) {
+      return (tag.substr(0, 2) == "W/") ? tag.substr(2) : tag;
+    };
+    etag = opaque(etag);
+
+    while(not value.empty())
+    {
+      const auto comma = value.find(',');
+      const auto tag = trim(value.substr(0, comma));
+      if(tag == "*" or opaque(tag) == etag)
+        return true;
+      if(comma == util::sview::npos)
+        break;
+      value.remove_prefix(comma + 1);
+    }
+    return false;
+  }
+
+  bool Static_files::accepts_encoding(util::sview value, util::csview coding) noexcept
+  {
+    bool any = false;
+    while(not value.empty())
+    {
+      const auto comma = value.find(',');
+      const auto item = trim(value.substr(0, comma));
+
+      const auto semi = item.find(';');
+      const auto name = trim(item.substr(0, semi));
+      if(name == coding or name == "*")
+      {
+        // q=0 means "not acceptable", any other weight is fine
+        bool accepted = true;
+        if(semi != util::sview::npos)
+        {
+          auto q = trim(item.substr(semi + 1));
+          if(q.substr(0, 2) == "q=")
+            accepted = q.substr(2).find_first_not_of("0.") != util::sview::npos;
+        }
+        // the coding itself rules over the wildcard
+        if(name == coding)
+          return accepted;
+        any = accepted;
+      }
+      if(comma == util::sview::npos)
+        break;
+      value.remove_prefix(comma + 1);
+    }
+    return any;
+  }
+
+}
@@ -57,11 +57,14 @@ namespace http
 
   void Botan_server::on_connect(TCP_conn conn)
   {
-    connect(
-      std::make_unique<net::botan::Server> (
+    auto stream = std::make_unique<net::botan::Server> (
         std::make_unique<net::tcp::Stream>(
-          std::move(conn)), rng, *credman)
-    );
+          std::move(conn)), rng, *credman, &session_manager_);
+    stream->on_connect(
+      [this] (net::Stream&) {
+        sessions_.count_handshake();
+      });
+    connect(std::move(stream));
   }
 
 }
@@ -2,9 +2,107 @@
 #include <net/openssl/init.hpp>
 #include <net/openssl/tls_stream.hpp>
 #include <memdisk>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <smp>
+#include <smp_utils>
 
 namespace http
 {
+  // handshakes offloaded to other CPUs use the cache from there
+  static spinlock_t cache_lock = 0;
+
+  static Session_cache& session_cache(SSL_CTX* ctx)
+  {
+    return *(Session_cache*) SSL_CTX_get_app_data(ctx);
+  }
+
+  // sessions by id, in the cache instead of OpenSSL's own
+  static int new_session(SSL* ssl, SSL_SESSION* sess)
+  {
+    const int len = i2d_SSL_SESSION(sess, nullptr);
+    if (len <= 0) return 0;
+    Session_cache::Blob blob(len);
+    auto* ptr = blob.data();
+    i2d_SSL_SESSION(sess, &ptr);
+
+    unsigned int id_len;
+    const auto* id = SSL_SESSION_get_id(sess, &id_len);
+    scoped_spinlock guard {cache_lock};
+    session_cache(SSL_get_SSL_CTX(ssl)).store(id, id_len, std::move(blob));
+    // not keeping a reference
+    return 0;
+  }
+
+  static SSL_SESSION* get_session(SSL* ssl, const unsigned char* id, int id_len, int* copy)
+  {
+    *copy = 0;
+    scoped_spinlock guard {cache_lock};
+    const auto* blob = session_cache(SSL_get_SSL_CTX(ssl)).find(id, id_len);
+    if (blob == nullptr) return nullptr;
+    const auto* ptr = blob->data();
+    return d2i_SSL_SESSION(nullptr, &ptr, blob->size());
+  }
+
+  static void remove_session(SSL_CTX* ctx, SSL_SESSION* sess)
+  {
+    unsigned int id_len;
+    const auto* id = SSL_SESSION_get_id(sess, &id_len);
+    scoped_spinlock guard {cache_lock};
+    session_cache(ctx).remove(id, id_len);
+  }
+
+  // tickets encrypted with the (rotating) keys of the cache
+  static int ticket_key(SSL* ssl, unsigned char name[16], unsigned char* iv,
+                        EVP_CIPHER_CTX* cctx, HMAC_CTX* hctx, int enc)
+  {
+    auto& cache = session_cache(SSL_get_SSL_CTX(ssl));
+    scoped_spinlock guard {cache_lock};
+    if (enc)
+    {
+      const auto& key = cache.ticket_key();
+      if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0)
+        return -1;
+      memcpy(name, key.name, sizeof(key.name));
+      EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), nullptr, key.aes_key, iv);
+      HMAC_Init_ex(hctx, key.hmac_key, sizeof(key.hmac_key), EVP_sha256(), nullptr);
+      return 1;
+    }
+    const auto* key = cache.find_ticket_key(name);
+    // unknown or expired, do a full handshake
+    if (key == nullptr) return 0;
+    HMAC_Init_ex(hctx, key->hmac_key, sizeof(key->hmac_key), EVP_sha256(), nullptr);
+    EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), nullptr, key->aes_key, iv);
+    // renew tickets of the previous key
+    return cache.is_current(*key) ? 1 : 2;
+  }
+
+  static void handshake_info(const SSL* ssl, int where, int)
+  {
+    if (where & SSL_CB_HANDSHAKE_DONE)
+    {
+      auto& cache = session_cache(SSL_get_SSL_CTX(ssl));
+      scoped_spinlock guard {cache_lock};
+      cache.count_handshake();
+      if (SSL_session_reused((SSL*) ssl))
+        cache.count_resumption();
+    }
+  }
+
+  static void enable_session_cache(SSL_CTX* ctx, Session_cache& cache)
+  {
+    SSL_CTX_set_app_data(ctx, &cache);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+    static const unsigned char context[] = "https";
+    SSL_CTX_set_session_id_context(ctx, context, sizeof(context) - 1);
+    SSL_CTX_set_timeout(ctx, cache.lifetime());
+    SSL_CTX_sess_set_new_cb(ctx, new_session);
+    SSL_CTX_sess_set_get_cb(ctx, get_session);
+    SSL_CTX_sess_set_remove_cb(ctx, remove_session);
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticket_key);
+    SSL_CTX_set_info_callback(ctx, handshake_info);
+  }
+
   void OpenSSL_server::openssl_initialize(const std::string& certif,
                                           const std::string& key)
   {
@@ -20,6 +118,7 @@ namespace http
     openssl::verify_rng();
 
     this->m_ctx = openssl::create_server(certif.c_str(), key.c_str());
+    enable_session_cache((SSL_CTX*) this->m_ctx, this->sessions_);
     assert(ERR_get_error() == 0);
   }
   OpenSSL_server::~OpenSSL_server()
@@ -35,8 +134,8 @@ namespace http
 
   void OpenSSL_server::on_connect(TCP_conn conn)
   {
-    connect(
-      std::make_unique<openssl::TLS_stream> ((SSL_CTX*) m_ctx, std::make_unique<net::tcp::Stream>(std::move(conn)))
-    );
+    auto stream = std::make_unique<openssl::TLS_stream> ((SSL_CTX*) m_ctx, std::make_unique<net::tcp::Stream>(std::move(conn)));
+    stream->offload_handshake(offload_handshakes_ && SMP::cpu_count() > 1);
+    connect(std::move(stream));
   }
 } // http
@@ -8,8 +8,47 @@ static uint8_t verify_host_passthrough(const char*, size_t, void* /*data*/) {
     return 1;
 }
 
+// sessions by id, in the cache of the server
+static int cache_store(void* data, uint64_t, const void* key, uint64_t key_size,
+                       const void* value, uint64_t value_size)
+{
+  auto& cache = *(http::Session_cache*) data;
+  const auto* val = (const uint8_t*) value;
+  cache.store((const uint8_t*) key, key_size, {val, val + value_size});
+  return 0;
+}
+static int cache_retrieve(void* data, const void* key, uint64_t key_size,
+                          void* value, uint64_t* value_size)
+{
+  auto& cache = *(http::Session_cache*) data;
+  const auto* session = cache.find((const uint8_t*) key, key_size);
+  if (session == nullptr || session->size() > *value_size) return -1;
+  memcpy(value, session->data(), session->size());
+  *value_size = session->size();
+  // s2n doesn't tell if a handshake was resumed, so count it here
+  cache.count_resumption();
+  return 0;
+}
+static int cache_delete(void* data, const void* key, uint64_t key_size)
+{
+  auto& cache = *(http::Session_cache*) data;
+  cache.remove((const uint8_t*) key, key_size);
+  return 0;
+}
+
 namespace http
 {
+  void S2N_server::add_ticket_key(const Session_cache::Ticket_key& key)
+  {
+    auto* config = (s2n_config*) this->m_config;
+    uint8_t secret[sizeof(key.aes_key)];
+    memcpy(secret, key.aes_key, sizeof(secret));
+    if (s2n_config_add_ticket_crypto_key(config, key.name, sizeof(key.name),
+                                         secret, sizeof(secret), key.created) < 0) {
+      print_s2n_error("Error adding session ticket key");
+    }
+  }
+
   void S2N_server::initialize(
       const std::string& ca_cert,
       const std::string& ca_key)
@@ -39,6 +78,33 @@ namespace http
       print_s2n_error("Error setting verify-host callback");
       exit(1);
     }
+
+    // ALPN: HTTP/2 when the client offers it
+    static const char* protocols[] = { "h2", "http/1.1" };
+    res = s2n_config_set_protocol_preferences(config, protocols, 2);
+    if (res < 0) {
+      print_s2n_error("Error setting protocol preferences");
+      exit(1);
+    }
+
+    // resumption by session id and by tickets
+    s2n_config_set_cache_store_callback(config, cache_store, &sessions_);
+    s2n_config_set_cache_retrieve_callback(config, cache_retrieve, &sessions_);
+    s2n_config_set_cache_delete_callback(config, cache_delete, &sessions_);
+    // a key encrypts for one lifetime, and decrypts for one more
+    const uint32_t lifetime = sessions_.ticket_lifetime();
+    s2n_config_set_ticket_encrypt_decrypt_key_lifetime(config, lifetime);
+    s2n_config_set_ticket_decrypt_key_lifetime(config, lifetime);
+    // s2n keeps a list of its own, given every new key
+    for (const auto& key : sessions_.ticket_keys())
+      add_ticket_key(key);
+    sessions_.on_ticket_key({this, &S2N_server::add_ticket_key});
+    sessions_.ticket_key();
+
+    if (s2n_config_set_session_tickets_onoff(config, 1) < 0
+     || s2n_config_set_session_cache_onoff(config, 1) < 0) {
+      print_s2n_error("Error enabling session resumption");
+    }
   }
   
   S2N_server::~S2N_server()
@@ -54,11 +120,17 @@ namespace http
 
   void S2N_server::on_connect(TCP_conn conn)
   {
-    connect(
-      std::make_unique<s2n::TLS_stream> (
+    // rotates the ticket key when it's time
+    sessions_.ticket_key();
+
+    auto stream = std::make_unique<s2n::TLS_stream> (
         (s2n_config*) this->m_config,
-        std::make_unique<net::tcp::Stream>(std::move(conn)))
-    );
+        std::make_unique<net::tcp::Stream>(std::move(conn)));
+    stream->on_connect(
+      [this] (net::Stream&) {
+        sessions_.count_handshake();
+      });
+    connect(std::move(stream));
   }
   
 }
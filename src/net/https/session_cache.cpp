@@ -0,0 +1,206 @@
+
+#include <net/https/session_cache.hpp>
+#include <kernel/rng.hpp>
+#include <kernel/rtc.hpp>
+#include <cstring>
+#include <stdexcept>
+
+namespace http {
+
+  // serialized: a header, the ticket keys, then every session as
+  // a session header followed by its id and data
+  struct serialized_cache {
+    static constexpr uint32_t MAGIC = 0x7e55c0de;
+    uint32_t magic;
+    uint32_t sessions;
+    uint32_t keys;
+  };
+  struct serialized_session {
+    uint64_t expires;
+    uint32_t id_len;
+    uint32_t len;
+  };
+
+  Session_cache::Session_cache(const std::string& name, size_t capacity, uint32_t lifetime)
+    : capacity_{capacity},
+      lifetime_{lifetime},
+      stat_handshakes_{Statman::get().get_or_create(Stat::UINT64, name + ".tls_handshakes").get_uint64()},
+      stat_resumed_{Statman::get().get_or_create(Stat::UINT64, name + ".tls_resumed").get_uint64()},
+      stat_hits_{Statman::get().get_or_create(Stat::UINT64, name + ".tls_session_hits").get_uint64()},
+      stat_misses_{Statman::get().get_or_create(Stat::UINT64, name + ".tls_session_misses").get_uint64()},
+      stat_sessions_{Statman::get().get_or_create(Stat::UINT32, name + ".tls_sessions").get_uint32()}
+  {}
+
+  void Session_cache::store(const uint8_t* id, size_t len, Blob session)
+  {
+    if (capacity_ == 0 or len == 0)
+      return;
+    insert(std::string{(const char*) id, len}, std::move(session), RTC::now() + lifetime_);
+  }
+
+  void Session_cache::insert(std::string id, Blob session, uint64_t expires)
+  {
+    auto it = index_.find(id);
+    if (it != index_.end())
+      erase(it->second);
+
+    while (index_.size() >= capacity_)
+      erase(std::prev(lru_.end()));
+
+    lru_.push_front({std::move(id), std::move(session), expires});
+    index_.emplace(lru_.front().id, lru_.begin());
+    stat_sessions_ = index_.size();
+  }
+
+  const Session_cache::Blob* Session_cache::find(const uint8_t* id, size_t len)
+  {
+    auto it = index_.find(std::string{(const char*) id, len});
+    if (it == index_.end()) {
+      ++stat_misses_;
+      return nullptr;
+    }
+    auto entry = it->second;
+    if (entry->expires <= RTC::now()) {
+      erase(entry);
+      ++stat_misses_;
+      return nullptr;
+    }
+    ++stat_hits_;
+    // most recently used
+    lru_.splice(lru_.begin(), lru_, entry);
+    return &entry->session;
+  }
+
+  void Session_cache::remove(const uint8_t* id, size_t len)
+  {
+    auto it = index_.find(std::string{(const char*) id, len});
+    if (it != index_.end())
+      erase(it->second);
+  }
+
+  void Session_cache::erase(List::iterator entry)
+  {
+    index_.erase(entry->id);
+    lru_.erase(entry);
+    stat_sessions_ = index_.size();
+  }
+
+  const Session_cache::Ticket_key& Session_cache::ticket_key()
+  {
+    if (keys_.empty() or keys_.back().created + ticket_lifetime_ <= RTC::now())
+      rotate_ticket_key();
+    return keys_.back();
+  }
+
+  const Session_cache::Ticket_key* Session_cache::find_ticket_key(const uint8_t* name)
+  {
+    const uint64_t now = RTC::now();
+    for (auto& key : keys_)
+    {
+      // a key encrypts for one lifetime, and decrypts for one more
+      if (memcmp(key.name, name, sizeof(key.name)) == 0)
+        return (key.created + 2 * ticket_lifetime_ > now) ? &key : nullptr;
+    }
+    return nullptr;
+  }
+
+  void Session_cache::rotate_ticket_key()
+  {
+    Ticket_key key;
+    rng_extract(key.name, sizeof(key.name));
+    rng_extract(key.aes_key, sizeof(key.aes_key));
+    rng_extract(key.hmac_key, sizeof(key.hmac_key));
+    key.created = RTC::now();
+    add_ticket_key(key);
+  }
+
+  void Session_cache::add_ticket_key(const Ticket_key& key)
+  {
+    // the current key, and the one before
+    if (keys_.size() >= 2)
+      keys_.erase(keys_.begin());
+    keys_.push_back(key);
+    if (on_ticket_key_)
+      on_ticket_key_(keys_.back());
+  }
+
+  size_t Session_cache::serialized_size() const noexcept
+  {
+    size_t size = sizeof(serialized_cache) + keys_.size() * sizeof(Ticket_key);
+    for (const auto& entry : lru_)
+      size += sizeof(serialized_session) + entry.id.size() + entry.session.size();
+    return size;
+  }
+
+  size_t Session_cache::serialize_to(void* addr, size_t size) const
+  {
+    if (size < serialized_size())
+      throw std::length_error("Session_cache: serialization buffer too small");
+
+    auto* ptr = (uint8_t*) addr;
+    const serialized_cache hdr {serialized_cache::MAGIC,
+                                (uint32_t) lru_.size(), (uint32_t) keys_.size()};
+    memcpy(ptr, &hdr, sizeof(hdr));
+    ptr += sizeof(hdr);
+    memcpy(ptr, keys_.data(), keys_.size() * sizeof(Ticket_key));
+    ptr += keys_.size() * sizeof(Ticket_key);
+
+    // least recently used first, to be inserted in the same order
+    for (auto it = lru_.rbegin(); it != lru_.rend(); ++it)
+    {
+      const serialized_session ses {it->expires, (uint32_t) it->id.size(),
+                                    (uint32_t) it->session.size()};
+      memcpy(ptr, &ses, sizeof(ses));
+      ptr += sizeof(ses);
+      memcpy(ptr, it->id.data(), it->id.size());
+      ptr += it->id.size();
+      memcpy(ptr, it->session.data(), it->session.size());
+      ptr += it->session.size();
+    }
+    return ptr - (uint8_t*) addr;
+  }
+
+  void Session_cache::deserialize_from(const void* addr, size_t size)
+  {
+    auto* ptr = (const uint8_t*) addr;
+    const auto* end = ptr + size;
+
+    serialized_cache hdr;
+    if (size < sizeof(hdr))
+      throw std::runtime_error("Session_cache: serialized data too short");
+    memcpy(&hdr, ptr, sizeof(hdr));
+    ptr += sizeof(hdr);
+    if (hdr.magic != serialized_cache::MAGIC
+        or (size_t) (end - ptr) < hdr.keys * sizeof(Ticket_key))
+      throw std::runtime_error("Session_cache: invalid serialized data");
+
+    for (uint32_t i = 0; i < hdr.keys; i++)
+    {
+      Ticket_key key;
+      memcpy(&key, ptr, sizeof(key));
+      ptr += sizeof(key);
+      add_ticket_key(key);
+    }
+
+    const uint64_t now = RTC::now();
+    for (uint32_t i = 0; i < hdr.sessions; i++)
+    {
+      serialized_session ses;
+      if ((size_t) (end - ptr) < sizeof(ses))
+        throw std::runtime_error("Session_cache: invalid serialized data");
+      memcpy(&ses, ptr, sizeof(ses));
+      ptr += sizeof(ses);
+      if ((size_t) (end - ptr) < (size_t) ses.id_len + ses.len)
+        throw std::runtime_error("Session_cache: invalid serialized data");
+
+      std::string id {(const char*) ptr, ses.id_len};
+      ptr += ses.id_len;
+      Blob session {ptr, ptr + ses.len};
+      ptr += ses.len;
+
+      if (ses.expires > now and capacity_ > 0)
+        insert(std::move(id), std::move(session), ses.expires);
+    }
+  }
+
+} // < namespace http
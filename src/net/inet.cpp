@@ -3,6 +3,8 @@
 #include <net/dhcp/dh4client.hpp>
 #include <net/ip6/slaac.hpp>
 #include <smp>
+#include <os>
+#include <rtc>
 #include <net/socket.hpp>
 #include <net/tcp/packet4_view.hpp> // due to ICMP error //temp
 #include <net/udp/packet4_view.hpp> // due to ICMP error //temp
@@ -16,6 +18,7 @@ Inet::Inet(hw::Nic& nic)
     ip4_(*this), ip6_(*this),
     icmp_(*this), icmp6_(*this),
     udp_(*this), tcp_(*this),
+    qdisc_timer_{{this, &Inet::qdisc_timeout}},
     dns_(*this), domain_name_{}, MTU_(nic.MTU())
 {
   static_assert(sizeof(ip4::Addr) == 4, "IPv4 addresses must be 32-bits");
@@ -108,15 +111,10 @@ Inet::Inet(hw::Nic& nic)
   // IP6 -> Ndp
   ip6_.set_linklayer_out(ndp_top);
 
-  // NDP -> Link
-  ndp_.set_linklayer_out(link_top);
-
-  // MLD -> Link
-  mld_.set_linklayer_out(link_top);
-
-  // Arp -> Link
+  // NDP, MLD, Arp -> Link
   assert(link_top);
-  arp_.set_linklayer_out(link_top);
+  link_out_ = link_top;
+  set_link_out(link_top);
 
 #ifndef INCLUDEOS_SINGLE_THREADED
   // move this nework stack automatically
@@ -292,8 +290,79 @@ void Inet::enable_conntrack(std::shared_ptr<Conntrack> ct)
   conntrack_ = ct;
 }
 
+void Inet::set_link_out(downstream_link link)
+{
+  ndp_.set_linklayer_out(link);
+  mld_.set_linklayer_out(link);
+  arp_.set_linklayer_out(link);
+}
+
+void Inet::set_qdisc(std::unique_ptr<Qdisc> qdisc)
+{
+  if (qdisc_ != nullptr)
+  {
+    // flush what's left, bypassing shaping
+    qdisc_timer_.stop();
+    const auto now = RTC::nanos_now();
+    while (not qdisc_->empty()) {
+      auto entry = qdisc_->dequeue(now);
+      if (entry.packet == nullptr) break;
+      link_out_(std::move(entry.packet), entry.dest, entry.type);
+    }
+  }
+
+  qdisc_ = std::move(qdisc);
+  if (qdisc_ != nullptr) {
+    INFO("Inet", "Using qdisc %s on %s",
+         qdisc_->name().c_str(), ifname().c_str());
+    set_link_out({this, &Inet::qdisc_transmit});
+  }
+  else {
+    set_link_out(link_out_);
+  }
+}
+
+void Inet::qdisc_transmit(Packet_ptr pckt, MAC::Addr dest, Ethertype type)
+{
+  qdisc_->enqueue({std::move(pckt), dest, type}, RTC::nanos_now());
+  qdisc_run();
+}
+
+void Inet::qdisc_run()
+{
+  if (qdisc_ == nullptr or qdisc_->empty()) return;
+
+  const auto now = RTC::nanos_now();
+  for (auto avail = nic_.transmit_queue_available();
+       avail > 0 and not qdisc_->empty(); avail--)
+  {
+    auto entry = qdisc_->dequeue(now);
+    if (entry.packet == nullptr) break;
+    link_out_(std::move(entry.packet), entry.dest, entry.type);
+  }
+
+  // a shaper is holding back packets, come back when they may leave
+  const auto next = qdisc_->next_event();
+  if (next != 0 and not qdisc_timer_.is_running()) {
+    qdisc_timer_.start(std::chrono::nanoseconds(next > now ? next - now : 0));
+  }
+}
+
+void Inet::qdisc_timeout()
+{
+  // a shaper may hold the packet that fills the qdisc,
+  // so release it before asking if there is room for more
+  qdisc_run();
+  force_start_send_queues();
+}
+
 void Inet::process_sendq(size_t packets) {
 
+  if (qdisc_ != nullptr) {
+    qdisc_run();
+    packets = transmit_queue_available();
+  }
+
   ////////////////////////////////////////////
   // divide up fairly
   size_t div = packets / tqa.size();
@@ -366,7 +435,13 @@ void Inet::resolve(const std::string& hostname,
      resolve_func       func,
      bool               force)
 {
-  if(is_configured_v6() and dns_server6_ != ip6::Addr::addr_any)
+  if(not dns_.nameservers().empty())
+  {
+    const auto rtype = (is_configured_v6() and not is_configured())
+      ? dns::Record_type::AAAA : dns::Record_type::A;
+    dns_.resolve(hostname, rtype, func, force);
+  }
+  else if(is_configured_v6() and dns_server6_ != ip6::Addr::addr_any)
     resolve(hostname, this->dns_server6_, func, force);
   else
     resolve(hostname, this->dns_server_, func, force);
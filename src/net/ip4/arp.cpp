@@ -87,21 +87,20 @@ namespace net {
   void Arp::cache(ip4::Addr ip, MAC::Addr mac) {
     PRINT("<Arp> Caching IP %s for %s\n", ip.str().c_str(), mac.str().c_str());
 
-    auto entry = cache_.find(ip);
+    auto* entry = cache_.find(ip);
 
-    if (entry != cache_.end()) {
+    if (entry != nullptr) {
       PRINT("Cached entry found: %s recorded @ %zu. Updating timestamp\n",
-             entry->second.mac().str().c_str(), entry->second.timestamp());
+             entry->mac().str().c_str(), entry->timestamp());
 
-      if (entry->second.mac() != mac) {
-        cache_.erase(entry);
-        cache_.emplace(ip, mac);
+      if (entry->mac() != mac) {
+        *entry = Cache_entry{mac};
       } else {
-        entry->second.update();
+        entry->update();
       }
 
     } else {
-      cache_.emplace(ip, mac); // Insert
+      cache_.assign(ip, Cache_entry{mac}); // Insert
       if (UNLIKELY(not flush_timer_.is_running())) {
         flush_timer_.start(flush_interval_);
       }
@@ -150,15 +149,15 @@ namespace net {
       dest_mac = linux_tap_device;
 #else
       // If we don't have a cached IP, perform address resolution
-      auto cache_entry = cache_.find(next_hop);
-      if (UNLIKELY(cache_entry == cache_.end())) {
+      const auto* cache_entry = cache_.find(next_hop);
+      if (UNLIKELY(cache_entry == nullptr)) {
         PRINT("<ARP> No cache entry for IP %s.  Resolving. \n", next_hop.to_string().c_str());
         await_resolution(std::move(pckt), next_hop);
         return;
       }
 
       // Get MAC from cache
-      dest_mac = cache_[next_hop].mac();
+      dest_mac = cache_entry->mac();
 #endif
 
       PRINT("<ARP> Found cache entry for IP %s -> %s \n",
@@ -227,16 +226,9 @@ namespace net {
   void Arp::flush_expired()
   {
     PRINT("<ARP> Flushing expired entries\n");
-    std::vector<ip4::Addr> expired;
-    for (auto ent : cache_) {
-      if (ent.second.expired()) {
-        expired.push_back(ent.first);
-      }
-    }
-
-    for (auto ip : expired) {
-      cache_.erase(ip);
-    }
+    cache_.erase_if([](const ip4::Addr&, const Cache_entry& ent) {
+      return ent.expired();
+    });
 
     if (not cache_.empty()) {
       flush_timer_.start(flush_interval_);
@@ -30,7 +30,11 @@ namespace net {
   postrouting_dropped_  {Statman::get().create(Stat::UINT32, inet.ifname() + ".ip4.postrouting_dropped").get_uint32()},
   input_dropped_        {Statman::get().create(Stat::UINT32, inet.ifname() + ".ip4.input_dropped").get_uint32()},
   output_dropped_       {Statman::get().create(Stat::UINT32, inet.ifname() + ".ip4.output_dropped").get_uint32()}
-  {}
+  {
+    // data of the largest datagram after the smallest header, and the largest header
+    reassembly_config_.max_datagram = 65515;
+    reassembly_config_.max_header = 60;
+  }
 
 
   IP4::IP_packet_ptr IP4::drop(IP_packet_ptr ptr, Direction direction, Drop_reason reason) {
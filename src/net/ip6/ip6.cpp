@@ -160,6 +160,10 @@ namespace net
 
     PRINT("* Packet was for me\n");
 
+    // Fragments are held back until the whole datagram is received
+    packet = this->reassemble(std::move(packet));
+    if (packet == nullptr) return;
+
     /* INPUT */
     // Confirm incoming packet if conntrack is active
     auto& conntrack = stack_.conntrack();
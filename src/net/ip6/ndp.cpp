@@ -584,9 +584,9 @@ namespace net
   ip6::Addr Ndp::next_hop(const ip6::Addr& dst) const
   {
     // First check destination cache
-    auto search = dest_cache_.find(dst);
-    if(search != dest_cache_.end())
-      return search->second.next_hop();
+    const auto* search = dest_cache_.find(dst);
+    if(search != nullptr)
+      return search->next_hop();
 
     const ip6::Stateful_addr* match = nullptr;
     // Check prefix list (longest prefix match)
@@ -617,11 +617,7 @@ namespace net
 
   bool Ndp::lookup(ip6::Addr ip)
   {
-    auto entry = neighbour_cache_.find(ip);
-    if (entry != neighbour_cache_.end()) {
-      return true;
-    }
-    return false;
+    return neighbour_cache_.contains(ip);
   }
 
   void Ndp::cache(ip6::Addr ip, uint8_t *ll_addr, NeighbourStates state, uint32_t flags, bool update)
@@ -635,22 +631,19 @@ namespace net
   void Ndp::cache(ip6::Addr ip, MAC::Addr mac, NeighbourStates state, uint32_t flags, bool update)
   {
     PRINT("Ndp Caching IP %s for %s\n", ip.str().c_str(), mac.str().c_str());
-    auto entry = neighbour_cache_.find(ip);
-    if (entry != neighbour_cache_.end()) {
+    auto* entry = neighbour_cache_.find(ip);
+    if (entry != nullptr) {
       PRINT("Cached entry found: %s recorded @ %zu. Updating timestamp\n",
-         entry->second.mac().str().c_str(), entry->second.timestamp());
-      if (entry->second.mac() != mac) {
-        neighbour_cache_.erase(entry);
-        neighbour_cache_.emplace(
-           std::make_pair(ip, Neighbour_Cache_entry{mac, state, flags})); // Insert
+         entry->mac().str().c_str(), entry->timestamp());
+      if (entry->mac() != mac) {
+        *entry = Neighbour_Cache_entry{mac, state, flags};
       } else if (update) {
-        entry->second.set_state(state);
-        entry->second.set_flags(flags);
-        entry->second.update();
+        entry->set_state(state);
+        entry->set_flags(flags);
+        entry->update();
       }
     } else {
-      neighbour_cache_.emplace(
-        std::make_pair(ip, Neighbour_Cache_entry{mac, state, flags})); // Insert
+      neighbour_cache_.assign(ip, Neighbour_Cache_entry{mac, state, flags}); // Insert
       if (UNLIKELY(not flush_neighbour_timer_.is_running())) {
         flush_neighbour_timer_.start(flush_interval_);
       }
@@ -659,12 +652,11 @@ namespace net
 
   void Ndp::dest_cache(ip6::Addr dest_ip, ip6::Addr next_hop)
   {
-    auto entry = dest_cache_.find(dest_ip);
-    if (entry != dest_cache_.end()) {
-      entry->second.update(next_hop);
+    auto* entry = dest_cache_.find(dest_ip);
+    if (entry != nullptr) {
+      entry->update(next_hop);
     } else {
-      dest_cache_.emplace(std::make_pair(dest_ip,
-            Destination_Cache_entry{next_hop}));
+      dest_cache_.assign(dest_ip, Destination_Cache_entry{next_hop});
     }
   }
 
@@ -715,13 +707,9 @@ namespace net
   {
     //TODO: Better to have a list of destination
     // list entries inside router entries for faster cleanup
-    for(auto it = dest_cache_.begin(); it != dest_cache_.end(); )
-    {
-      if(it->second.next_hop() == ip)
-        it = dest_cache_.erase(it);
-      else
-        it++;
-    }
+    dest_cache_.erase_if([ip](const ip6::Addr&, const Destination_Cache_entry& ent) {
+      return ent.next_hop() == ip;
+    });
   }
 
   void Ndp::flush_expired_routers()
@@ -746,16 +734,9 @@ namespace net
   void Ndp::flush_expired_neighbours()
   {
     PRINT("NDP: Flushing expired entries\n");
-    std::vector<IP6::addr> expired;
-    for (auto ent : neighbour_cache_) {
-      if (ent.second.expired()) {
-        expired.push_back(ent.first);
-      }
-    }
-
-    for (auto ip : expired) {
-      neighbour_cache_.erase(ip);
-    }
+    neighbour_cache_.erase_if([](const ip6::Addr&, const Neighbour_Cache_entry& ent) {
+      return ent.expired();
+    });
 
     if (not neighbour_cache_.empty()) {
       flush_neighbour_timer_.start(flush_interval_);
@@ -796,15 +777,15 @@ namespace net
 
     if (mac == MAC::EMPTY) {
       // If we don't have a cached IP, perform NDP sol
-      auto neighbour_cache_entry = neighbour_cache_.find(next_hop);
-      if (UNLIKELY(neighbour_cache_entry == neighbour_cache_.end())) {
+      const auto* neighbour_cache_entry = neighbour_cache_.find(next_hop);
+      if (UNLIKELY(neighbour_cache_entry == nullptr)) {
         PRINT("NDP: No cache entry for IP %s.  Resolving. \n", next_hop.to_string().c_str());
         await_resolution(std::move(pckt), next_hop);
         return;
       }
 
       // Get MAC from cache
-      mac = neighbour_cache_[next_hop].mac();
+      mac = neighbour_cache_entry->mac();
 
       PRINT("NDP: Found cache entry for IP %s -> %s \n",
           next_hop.to_string().c_str(), mac.to_string().c_str());
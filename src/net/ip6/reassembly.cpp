@@ -0,0 +1,123 @@
+
+//#define REASSEMBLY_DEBUG 1
+#ifdef REASSEMBLY_DEBUG
+#define PRINT(fmt, ...) printf(fmt, ##__VA_ARGS__)
+#else
+#define PRINT(fmt, ...) /* fmt */
+#endif
+
+#include <net/ip6/ip6.hpp>
+#include <net/ip6/packet_ip6.hpp>
+#include <net/ip6/extension_header.hpp>
+#include <net/reassembly.hpp>
+#include <cassert>
+
+namespace net
+{
+  void IP6::set_reassembly_config(const Reassembly::Config& config)
+  {
+    Expects(reassembly_ == nullptr);
+    reassembly_config_ = config;
+  }
+
+  Reassembly& IP6::reassembly()
+  {
+    if (UNLIKELY(reassembly_ == nullptr))
+      reassembly_ = std::make_unique<Reassembly>(reassembly_config_);
+    return *reassembly_;
+  }
+
+  /**
+   * Find the fragment header, which may only be preceded by
+   * Hop-by-Hop and Destination options (RFC 8200 4.1).
+   * Returns the offset of the fragment header (0 if none), and the
+   * offset of the next header field pointing to it in nh_off.
+   */
+  static int find_fragment_header(const PacketIP6& packet, int& nh_off)
+  {
+    auto proto = packet.next_protocol();
+    int  off   = sizeof(ip6::Header);
+    nh_off     = offsetof(ip6::Header, next_header);
+
+    while (proto == Protocol::HOPOPT or proto == Protocol::OPTSV6)
+    {
+      if (off + (int) sizeof(ip6::Extension_header) > packet.size())
+        return 0;
+      const auto& ext = *(const ip6::Extension_header*) (packet.layer_begin() + off);
+      nh_off = off;
+      proto  = ext.proto();
+      off   += ext.size();
+    }
+
+    if (proto != Protocol::IPv6_FRAG
+        or off + (int) sizeof(ip6::Fragment_header) > packet.size())
+      return 0;
+    return off;
+  }
+
+  IP6::IP_packet_ptr IP6::reassemble(IP6::IP_packet_ptr packet)
+  {
+    assert(packet != nullptr);
+
+    int nh_off;
+    const int frag_off = find_fragment_header(*packet, nh_off);
+    if (LIKELY(frag_off == 0)) return packet;
+
+    const auto& fh = *(const ip6::Fragment_header*) (packet->layer_begin() + frag_off);
+    const int data_off = frag_off + sizeof(ip6::Fragment_header);
+    const uint32_t length = packet->size() - data_off;
+
+    PRINT("Reassembly on %s  id=%u offset=%u more=%d\n",
+          packet->ip_src().to_string().c_str(), fh.ident(), fh.offset(), fh.more());
+
+    // non-last fragments must have length mult of 8
+    if (UNLIKELY(fh.more() and length % 8 != 0)) {
+      return drop(std::move(packet), Direction::Upstream, Drop_reason::Bad_length);
+    }
+    // the unfragmentable part of the first fragment heads the datagram,
+    // pointing to the header after the fragment header
+    packet->layer_begin()[nh_off] = fh.next_header;
+    const auto* data = packet->layer_begin() + data_off;
+
+    IP_packet_ptr buffer;
+    // atomic fragment (RFC 6946), just strip the header in place
+    if (fh.offset() == 0 and not fh.more())
+    {
+      std::memmove(packet->layer_begin() + sizeof(ip6::Fragment_header),
+                   packet->layer_begin(), frag_off);
+      packet->increment_layer_begin(sizeof(ip6::Fragment_header));
+      buffer = std::move(packet);
+    }
+    else
+    {
+      const Reassembly::Key key {
+        packet->ip_src(), packet->ip_dst(),
+        fh.ident(), static_cast<uint8_t>(Protocol::IPv6_FRAG)
+      };
+      auto& assembly = reassembly();
+      const auto stats = assembly.stats();
+      buffer = static_unique_ptr_cast<PacketIP6> (
+          assembly.insert(key, {fh.offset(), length, data,
+                                packet->layer_begin(), (uint32_t) frag_off},
+                          fh.more()));
+      if (buffer == nullptr) {
+        if (assembly.stats().no_buffers != stats.no_buffers)
+          return drop(std::move(packet), Direction::Upstream, Drop_reason::No_buffers);
+        // too large or overlapping
+        if (assembly.stats().dropped != stats.dropped)
+          return drop(std::move(packet), Direction::Upstream, Drop_reason::Bad_length);
+        return nullptr;
+      }
+    }
+
+    if (UNLIKELY(buffer->size() - sizeof(ip6::Header) > 65535)) {
+      return drop(std::move(buffer), Direction::Upstream, Drop_reason::Bad_length);
+    }
+    buffer->set_ip_payload_length(buffer->size() - sizeof(ip6::Header));
+    buffer->calculate_payload_offset();
+
+    PRINT("Shipping large packet (%u / %u)\n",
+          buffer->size(), buffer->bufsize());
+    return buffer;
+  }
+}
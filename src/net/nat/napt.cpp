@@ -2,6 +2,7 @@
 #include <net/nat/napt.hpp>
 #include <net/nat/nat.hpp>
 #include <net/inet>
+#include <statman>
 
 //#define NAPT_DEBUG 1
 #ifdef NAPT_DEBUG
@@ -82,7 +83,11 @@ inline void update_snat(Conntrack& ct, Conntrack::Entry_ptr entry, uint16_t port
 
 
 NAPT::NAPT(std::shared_ptr<Conntrack> ct)
-  : conntrack(std::move(ct))
+  : conntrack(std::move(ct)),
+    tcp_pools{std::make_shared<Port_pools>()},
+    udp_pools{std::make_shared<Port_pools>()},
+    tcp_exhausted{Statman::get().get_or_create(Stat::UINT32, "napt.tcp.ports_exhausted").get_uint32()},
+    udp_exhausted{Statman::get().get_or_create(Stat::UINT32, "napt.udp.ports_exhausted").get_uint32()}
 {
   Expects(conntrack != nullptr);
 }
@@ -96,9 +101,7 @@ void NAPT::masquerade(IP4::IP_packet& pkt, Stack& inet, Conntrack::Entry_ptr ent
   {
     case Protocol::TCP:
     {
-      // Get the TCP ports for the given stack
-      auto& ports = inet.tcp_ports()[ip];
-      auto socket = masq(entry, ip, ports);
+      auto socket = masq(entry, ip, tcp_pools, inet.tcp_ports()[ip], tcp_exhausted);
       NATDBG("<NAPT> MASQ: %s => %s\n",
         entry->to_string().c_str(), socket.to_string().c_str());
       // static source nat
@@ -108,9 +111,7 @@ void NAPT::masquerade(IP4::IP_packet& pkt, Stack& inet, Conntrack::Entry_ptr ent
 
     case Protocol::UDP:
     {
-      // Get the UDP ports for the given stack
-      auto& ports = inet.udp_ports()[ip];
-      auto socket = masq(entry, ip, ports);
+      auto socket = masq(entry, ip, udp_pools, inet.udp_ports()[ip], udp_exhausted);
       NATDBG("<NAPT> MASQ: %s => %s\n",
         entry->to_string().c_str(), socket.to_string().c_str());
       // static source nat
@@ -171,25 +172,43 @@ void NAPT::demasquerade(IP4::IP_packet& pkt, const Stack&, Conntrack::Entry_ptr
   }
 }
 
-Socket NAPT::masq(Conntrack::Entry_ptr entry, const ip4::Addr addr, Port_util& ports)
+Port_pool& NAPT::pool(Port_pools& pools, const ip4::Addr addr,
+                      Port_util& ports, uint32_t& exhausted)
+{
+  auto it = pools.find(addr);
+  if(UNLIKELY(it == pools.end()))
+    it = pools.emplace(std::piecewise_construct,
+      std::forward_as_tuple(addr), std::forward_as_tuple(ports, exhausted)).first;
+  return it->second;
+}
+
+Socket NAPT::masq(Conntrack::Entry_ptr entry, const ip4::Addr addr,
+                  const std::shared_ptr<Port_pools>& pools,
+                  Port_util& ports, uint32_t& exhausted)
 {
   Expects(entry->proto != Protocol::ICMPv4);
 
   // If the entry is mirrored, it's not masked yet
   if(not is_snat(entry))
   {
-    // Generate a new eph port and bind it
-    auto port = ports.get_next_ephemeral();
-    ports.bind(port);
+    // Acquire a port unique towards the destination (endpoint dependent)
+    const auto port = pool(*pools, addr, ports, exhausted).acquire(entry->second.src);
 
     // Update the entry to have the new socket as second
     auto masq_sock = Socket{addr, port};
     auto updated = conntrack->update_entry(
       entry->proto, entry->second, {entry->second.src, masq_sock});
 
-    // Setup to unbind port on entry close
-    auto on_close = [&ports, port](Conntrack::Entry_ptr){ ports.unbind(port); };
-    updated->on_close = on_close;
+    // Setup to unbind port on entry close, unless the pool is gone by then
+    std::weak_ptr<Port_pools> weak = pools;
+    updated->on_close = [weak, addr, port](Conntrack::Entry_ptr e)
+    {
+      auto pools = weak.lock();
+      if (pools == nullptr) return;
+      auto it = pools->find(addr);
+      if (it != pools->end())
+        it->second.release(e->second.src, port);
+    };
   }
 
   return entry->second.dst;
@@ -0,0 +1,91 @@
+
+#include <net/nat/port_pool.hpp>
+
+namespace net {
+namespace nat {
+
+Port_pool::Port_pool(Port_util& ports, uint32_t& exhausted)
+  : ports_{ports},
+    refs_(Port_util::size(), 0),
+    exhausted_{exhausted}
+{}
+
+uint16_t Port_pool::acquire(const Socket& remote)
+{
+  auto it = dests_.find(remote);
+  if(it == dests_.end())
+    it = dests_.emplace(remote, Dest{net::new_ephemeral_port()}).first;
+
+  auto& dest = it->second;
+
+  // Prefer recently released ports
+  while(not dest.free.empty())
+  {
+    const auto port = dest.free.back();
+    dest.free.pop_back();
+    // the local stack may have bound it in the meantime
+    if(LIKELY(not taken(port)))
+    {
+      ++dest.in_use;
+      ref(port);
+      return port;
+    }
+  }
+
+  // Hand out a port never used towards this destination
+  while(dest.remaining > 0)
+  {
+    const auto port = dest.cursor;
+    --dest.remaining;
+    // wrap around to dynamic start if end
+    if(UNLIKELY(++dest.cursor == 0))
+      dest.cursor = port_ranges::DYNAMIC_START;
+
+    if(LIKELY(not taken(port)))
+    {
+      ++dest.in_use;
+      ref(port);
+      return port;
+    }
+  }
+
+  ++exhausted_;
+  if(dest.in_use == 0)
+    dests_.erase(it);
+
+  throw Port_error{"All ports towards destination are taken"};
+}
+
+void Port_pool::release(const Socket& remote, const uint16_t port) noexcept
+{
+  auto it = dests_.find(remote);
+  if(UNLIKELY(it == dests_.end()))
+    return;
+
+  auto& dest = it->second;
+  Expects(dest.in_use > 0);
+
+  unref(port);
+
+  // Forget about the destination when nothing is in use anymore
+  if(--dest.in_use == 0)
+    dests_.erase(it);
+  else
+    dest.free.push_back(port);
+}
+
+void Port_pool::ref(const uint16_t port) noexcept
+{
+  if(refs_[index(port)]++ == 0)
+    ports_.bind(port);
+}
+
+void Port_pool::unref(const uint16_t port) noexcept
+{
+  Expects(refs_[index(port)] > 0);
+  if(--refs_[index(port)] == 0)
+    ports_.unbind(port);
+}
+
+} // < namespace nat
+} // < namespace net
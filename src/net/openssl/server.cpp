@@ -32,6 +32,20 @@ namespace openssl
     BIO_free(kbio);
   }
 
+  // pick HTTP/2 when the client offers it (RFC 7301, RFC 7540 3.3)
+  static int
+  alpn_select(SSL*, const unsigned char** out, unsigned char* outlen,
+              const unsigned char* in, unsigned int inlen, void*)
+  {
+    static const unsigned char protocols[] = "\x02h2\x08http/1.1";
+    unsigned char* selected = nullptr;
+    if (SSL_select_next_proto(&selected, outlen, protocols, sizeof(protocols) - 1,
+                              in, inlen) != OPENSSL_NPN_NEGOTIATED)
+      return SSL_TLSEXT_ERR_NOACK;
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+  }
+
   SSL_CTX* create_server(const std::string& cert_file,
                          const std::string& key_file)
   {
@@ -39,8 +53,11 @@ namespace openssl
     auto* ctx = SSL_CTX_new(TLSv1_2_method());
     if (!ctx) throw std::runtime_error("SSL_CTX_new()");
 
-    int res = SSL_CTX_set_cipher_list(ctx, "AES256-SHA");
+    // HTTP/2 requires an AEAD cipher with ephemeral key exchange
+    int res = SSL_CTX_set_cipher_list(ctx,
+        "ECDHE-RSA-AES256-GCM-SHA384:ECDHE-RSA-AES128-GCM-SHA256");
     assert(res == 1);
+    SSL_CTX_set_alpn_select_cb(ctx, alpn_select, nullptr);
 
   #ifdef LOAD_FROM_MEMDISK
     auto& filesys = fs::memdisk().fs();
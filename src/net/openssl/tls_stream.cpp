@@ -1,14 +1,31 @@
 #include <net/openssl/tls_stream.hpp>
+#include <smp>
+#include <atomic>
 
 using namespace openssl;
 
-TLS_stream::TLS_stream(SSL_CTX* ctx, Stream_ptr t, bool outgoing)
+// a record, and what it may grow by when encrypted
+static const size_t WRITE_BUFFER_SIZE = SSL3_RT_MAX_PLAIN_LENGTH + SSL3_RT_MAX_ENCRYPTED_OVERHEAD;
+static const size_t READ_BUFFER_SIZE  = 8192;
+
+// SSL_do_handshake on another CPU, resumed on the one owning the stream
+struct TLS_stream::Handshake_job
+{
+  Handshake_job(TLS_stream* s, int c) : stream{s}, cpu{c} {}
+
+  enum state_t { QUEUED, RUNNING, DONE, CANCELLED };
+
+  TLS_stream* const stream;
+  const int cpu;
+  int      ret    = 0;
+  status_t status = STATUS_OK;
+  std::atomic<int> state {QUEUED};
+};
+
+TLS_stream::TLS_stream(SSL_CTX* ctx, Stream_ptr t, bool outgoing, SSL_SESSION* session)
   : m_transport(std::move(t))
 {
   ERR_clear_error(); // prevent old errors from mucking things up
-  this->m_bio_rd = BIO_new(BIO_s_mem());
-  this->m_bio_wr = BIO_new(BIO_s_mem());
-  assert(ERR_get_error() == 0 && "Initializing BIOs");
   this->m_ssl = SSL_new(ctx);
   assert(this->m_ssl != nullptr);
   assert(ERR_get_error() == 0 && "Initializing SSL");
@@ -18,7 +35,16 @@ TLS_stream::TLS_stream(SSL_CTX* ctx, Stream_ptr t, bool outgoing)
   else
       SSL_set_connect_state(this->m_ssl);
 
-  SSL_set_bio(this->m_ssl, this->m_bio_rd, this->m_bio_wr);
+  // resume an earlier session, skipping the full handshake
+  if (outgoing == true && session != nullptr)
+      SSL_set_session(this->m_ssl, session);
+
+  // one BIO for both directions
+  BIO* bio = create_bio(this);
+  assert(bio != nullptr && "Initializing BIO");
+  SSL_set_bio(this->m_ssl, bio, bio);
+  // read as much as there is, not one record header at a time
+  SSL_set_read_ahead(this->m_ssl, 1);
 
   // always-on callbacks
   m_transport->on_data({this,&TLS_stream::handle_data});
@@ -30,9 +56,12 @@ TLS_stream::TLS_stream(SSL_CTX* ctx, Stream_ptr t, bool outgoing)
     if (this->tls_perform_handshake() < 0) return;
   }
 }
-TLS_stream::TLS_stream(Stream_ptr t, SSL* ssl, BIO* rd, BIO* wr)
-  : m_transport(std::move(t)), m_ssl(ssl), m_bio_rd(rd), m_bio_wr(wr)
+TLS_stream::TLS_stream(Stream_ptr t, SSL* ssl)
+  : m_transport(std::move(t)), m_ssl(ssl)
 {
+  BIO* bio = create_bio(this);
+  assert(bio != nullptr && "Initializing BIO");
+  SSL_set_bio(this->m_ssl, bio, bio);
   // always-on callbacks
   m_transport->on_data({this, &TLS_stream::handle_data});
   m_transport->on_close({this, &TLS_stream::close_callback_once});
@@ -40,9 +69,99 @@ TLS_stream::TLS_stream(Stream_ptr t, SSL* ssl, BIO* rd, BIO* wr)
 TLS_stream::~TLS_stream()
 {
   assert(m_busy == 0 && "Cannot delete stream while in its call stack");
+  if (m_handshake != nullptr)
+  {
+    // unless already using the SSL object, the other CPU won't start
+    int state = Handshake_job::QUEUED;
+    while (not m_handshake->state.compare_exchange_weak(state, Handshake_job::CANCELLED))
+    {
+      if (state == Handshake_job::DONE) {
+        m_handshake->state = Handshake_job::CANCELLED;
+        break;
+      }
+      state = Handshake_job::QUEUED;
+      asm("pause");
+    }
+  }
   SSL_free(this->m_ssl);
 }
 
+BIO* TLS_stream::create_bio(TLS_stream* stream)
+{
+  static BIO_METHOD* method = [] {
+    auto* meth = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "TLS_stream");
+    BIO_meth_set_read(meth, &TLS_stream::bio_read);
+    BIO_meth_set_write(meth, &TLS_stream::bio_write);
+    BIO_meth_set_ctrl(meth, &TLS_stream::bio_ctrl);
+    return meth;
+  }();
+  BIO* bio = BIO_new(method);
+  if (bio == nullptr) return nullptr;
+  BIO_set_data(bio, stream);
+  BIO_set_init(bio, 1);
+  return bio;
+}
+
+int TLS_stream::bio_read(BIO* bio, char* out, int len)
+{
+  auto& self = *(TLS_stream*) BIO_get_data(bio);
+  BIO_clear_retry_flags(bio);
+  int total = 0;
+  while (total < len && not self.m_rd_queue.empty())
+  {
+    auto& buffer = *self.m_rd_queue.front();
+    const size_t n = std::min(buffer.size() - self.m_rd_offset, (size_t) (len - total));
+    memcpy(out + total, buffer.data() + self.m_rd_offset, n);
+    total += n;
+    self.m_rd_offset += n;
+    if (self.m_rd_offset == buffer.size()) {
+      self.m_rd_queue.pop_front();
+      self.m_rd_offset = 0;
+    }
+  }
+  if (total == 0) {
+    BIO_set_retry_read(bio);
+    return -1;
+  }
+  return total;
+}
+
+int TLS_stream::bio_write(BIO* bio, const char* data, int len)
+{
+  auto& self = *(TLS_stream*) BIO_get_data(bio);
+  BIO_clear_retry_flags(bio);
+  // records are gathered into one buffer until sent
+  if (self.m_wr_buffer == nullptr)
+  {
+    self.m_wr_buffer = self.construct_write_buffer();
+    if (UNLIKELY(self.m_wr_buffer == nullptr)) {
+      BIO_set_retry_write(bio);
+      return -1;
+    }
+    self.m_wr_buffer->reserve(std::max(WRITE_BUFFER_SIZE, (size_t) len));
+  }
+  self.m_wr_buffer->insert(self.m_wr_buffer->end(), data, data + len);
+  return len;
+}
+
+long TLS_stream::bio_ctrl(BIO* bio, int cmd, long, void*)
+{
+  auto& self = *(TLS_stream*) BIO_get_data(bio);
+  switch (cmd) {
+  case BIO_CTRL_FLUSH:
+      return 1;
+  case BIO_CTRL_PENDING: {
+      long pending = 0;
+      for (auto& buffer : self.m_rd_queue) pending += buffer->size();
+      return pending - self.m_rd_offset;
+    }
+  case BIO_CTRL_WPENDING:
+      return (self.m_wr_buffer) ? self.m_wr_buffer->size() : 0;
+  default:
+      return 0;
+  }
+}
+
 void TLS_stream::write(buffer_t buffer)
 {
   if (UNLIKELY(this->is_connected() == false)) {
@@ -81,51 +200,135 @@ void TLS_stream::write(const void* data, const size_t len)
   write(net::StreamBuffer::construct_write_buffer(buf, buf + len));
 }
 
-int TLS_stream::decrypt(const void *indata, int size)
+int TLS_stream::decrypt(buffer_t buffer)
 {
-  int n = BIO_write(this->m_bio_rd, indata, size);
-  if (UNLIKELY(n < 0)) {
-    //TODO can we handle this more gracefully?
-    TLS_PRINT("BIO_write failed\n");
-    this->close();
-    return -1;
+  // the handshake is running on another CPU, continue when it's back
+  if (UNLIKELY(m_handshake != nullptr))
+  {
+    if (not buffer->empty())
+      m_rd_pending.push_back(std::move(buffer));
+    return 0;
   }
+  // OpenSSL reads the records from the buffer itself
+  if (not buffer->empty())
+    m_rd_queue.push_back(std::move(buffer));
 
   // if we aren't finished initializing session
   if (UNLIKELY(!handshake_completed()))
   {
+    if (m_offload && offload_handshake_step())
+      return 0;
     int num = SSL_do_handshake(this->m_ssl);
-    auto status = this->status(num);
-    // OpenSSL wants to write
-    if (status == STATUS_WANT_IO)
-    {
-      tls_perform_stream_write();
+    return handshake_step(num, this->status(num));
+  }
+  return 1;
+}
+
+int TLS_stream::handshake_step(int num, status_t status)
+{
+  // OpenSSL wants to write
+  if (status == STATUS_WANT_IO)
+  {
+    tls_perform_stream_write();
+  }
+  else if (status == STATUS_FAIL)
+  {
+    if (num < 0) {
+      TLS_PRINT("TLS_stream::SSL_do_handshake() returned %d\n", num);
+      #ifdef VERBOSE_OPENSSL
+        ERR_print_errors_fp(stdout);
+      #endif
     }
-    else if (status == STATUS_FAIL)
-    {
-      if (num < 0) {
-        TLS_PRINT("TLS_stream::SSL_do_handshake() returned %d\n", num);
-        #ifdef VERBOSE_OPENSSL
-          ERR_print_errors_fp(stdout);
-        #endif
+    this->close();
+    return -1;
+  }
+  // nothing more to do if still not finished
+  if (handshake_completed() == false) return 0;
+  // handshake success
+  this->m_busy += 1;
+  connected();
+  this->m_busy -= 1;
+
+  if (this->m_deferred_close) {
+    TLS_PRINT("::read() close on m_deferred_close after tls_perform_stream_write\n");
+    this->close();
+    return -1;
+  }
+  return 1;
+}
+
+bool TLS_stream::offload_handshake_step()
+{
+#ifdef INCLUDEOS_SMP_ENABLE
+  // round-robin over the other CPUs
+  static std::atomic<unsigned> next {0};
+  const auto& cpus = SMP::active_cpus();
+  const int self = SMP::cpu_id();
+  int worker = -1;
+  for (size_t i = 0; i < cpus.size() && worker < 0; i++)
+  {
+    const int cpu = cpus[next++ % cpus.size()];
+    if (cpu != self) worker = cpu;
+  }
+  if (worker < 0) return false;
+
+  // the records are written to a buffer made on this CPU
+  if (m_wr_buffer == nullptr)
+  {
+    m_wr_buffer = construct_write_buffer();
+    if (UNLIKELY(m_wr_buffer == nullptr)) return false;
+    m_wr_buffer->reserve(WRITE_BUFFER_SIZE);
+  }
+
+  auto job = std::make_shared<Handshake_job>(this, self);
+  m_handshake = job;
+  SMP::add_task(
+    [job] () {
+      int state = Handshake_job::QUEUED;
+      if (not job->state.compare_exchange_strong(state, Handshake_job::RUNNING))
+        return;
+      auto& stream = *job->stream;
+      ERR_clear_error();
+      job->ret    = SSL_do_handshake(stream.m_ssl);
+      job->status = stream.status(job->ret);
+      job->state  = Handshake_job::DONE;
+    },
+    // done on the main CPU, forwarded to the one owning the stream
+    [job] () {
+      if (job->cpu == SMP::cpu_id()) {
+        resume_handshake(job);
+        return;
       }
-      this->close();
-      return -1;
-    }
-    // nothing more to do if still not finished
-    if (handshake_completed() == false) return 0;
-    // handshake success
-    this->m_busy += 1;
-    connected();
-    this->m_busy -= 1;
+      SMP::add_task([job] () { resume_handshake(job); }, job->cpu);
+      SMP::signal(job->cpu);
+    },
+    worker);
+  SMP::signal(worker);
+  return true;
+#else
+  return false;
+#endif
+}
 
-    if (this->m_deferred_close) {
-      TLS_PRINT("::read() close on m_deferred_close after tls_perform_stream_write\n");
-      this->close();
-      return -1;
-    }
+void TLS_stream::resume_handshake(Handshake_ptr job)
+{
+  // the stream was deleted
+  if (job->state != Handshake_job::DONE) return;
+  auto& self = *job->stream;
+  self.m_handshake = nullptr;
+  // read what came meanwhile after what OpenSSL left
+  for (auto& buffer : self.m_rd_pending)
+    self.m_rd_queue.push_back(std::move(buffer));
+  self.m_rd_pending.clear();
+
+  const int step = self.handshake_step(job->ret, job->status);
+  if (step < 0) return;
+  // the next handshake step, or data following the handshake
+  if (step > 0 || not self.m_rd_queue.empty())
+  {
+    auto buffer = self.construct_read_buffer();
+    if (buffer) self.tls_read(std::move(buffer));
   }
-  return n;
 }
 
 int TLS_stream::send_decrypted()
@@ -133,8 +336,9 @@ int TLS_stream::send_decrypted()
   int n;
   // read decrypted data
   do {
-    //TODO "increase the size or constructor based ??")
-    auto buffer=StreamBuffer::construct_read_buffer(8192);
+    // the rest of a record, if one is partly read
+    const int pending = SSL_pending(this->m_ssl);
+    auto buffer=StreamBuffer::construct_read_buffer(pending > 0 ? pending : READ_BUFFER_SIZE);
     if (!buffer) return 0;
     n = SSL_read(this->m_ssl,buffer->data(),buffer->size());
     if (n > 0) {
@@ -147,6 +351,8 @@ int TLS_stream::send_decrypted()
 
 void TLS_stream::handle_read_congestion()
 {
+  // resumed by the handshake
+  if (m_handshake != nullptr) return;
   //Ordering could be different
   send_decrypted(); //decrypt any incomplete
   this->m_busy += 1;
@@ -164,6 +370,7 @@ void TLS_stream::handle_write_congestion()
 {
   //this should resolve the potential malloc congestion
   //might be missing some TLS signalling but without malloc we cant do that either
+  if (m_handshake != nullptr) return;
   while(tls_perform_stream_write() >  0);
 }
 void TLS_stream::handle_data()
@@ -186,59 +393,51 @@ bool TLS_stream::tls_read(buffer_t buffer)
 {
   assert(buffer != nullptr);
   ERR_clear_error();
-  uint8_t* buf_ptr = buffer->data();
-  int      len = buffer->size();
 
-  while (len > 0)
-  {
-    if (this->m_deferred_close) {
-      TLS_PRINT("::read() close on m_deferred_close");
-      this->close();
-      return true;
-    }
-
-    const int decrypted_bytes = decrypt(buf_ptr, len);
-    if (UNLIKELY(decrypted_bytes == 0)) {
-      return false;
-    }
-    else if (UNLIKELY(decrypted_bytes < 0)) {
-      return true;
-    }
-    buf_ptr += decrypted_bytes;
-    len -= decrypted_bytes;
+  if (this->m_deferred_close) {
+    TLS_PRINT("::read() close on m_deferred_close");
+    this->close();
+    return true;
+  }
 
-    // enqueues decrypted data
-    int ret = send_decrypted();
+  const int decrypted = decrypt(std::move(buffer));
+  if (UNLIKELY(decrypted == 0)) {
+    return false;
+  }
+  else if (UNLIKELY(decrypted < 0)) {
+    return true;
+  }
 
-    // this goes here?
-    if (UNLIKELY(this->is_closing() || this->is_closed())) {
-      TLS_PRINT("TLS_stream::SSL_read closed during read\n");
-      return true;
-    }
-    if (this->m_deferred_close) {
-      TLS_PRINT("::read() close on m_deferred_close");
-      this->close();
-      return true;
-    }
+  // enqueues decrypted data
+  int ret = send_decrypted();
 
-    auto status = this->status(ret);
-    // did peer request stream renegotiation?
-    if (status == STATUS_WANT_IO)
-    {
-      TLS_PRINT("::read() STATUS_WANT_IO\n");
-      int ret;
-      do {
-        ret = tls_perform_stream_write();
-      } while (ret > 0);
-    }
-    else if (status == STATUS_FAIL)
-    {
-      TLS_PRINT("::read() close on STATUS_FAIL after tls_perform_stream_write\n");
-      this->close();
-      return true;
-    }
+  // this goes here?
+  if (UNLIKELY(this->is_closing() || this->is_closed())) {
+    TLS_PRINT("TLS_stream::SSL_read closed during read\n");
+    return true;
+  }
+  if (this->m_deferred_close) {
+    TLS_PRINT("::read() close on m_deferred_close");
+    this->close();
+    return true;
+  }
 
-  } // while it < end
+  auto status = this->status(ret);
+  // did peer request stream renegotiation?
+  if (status == STATUS_WANT_IO)
+  {
+    TLS_PRINT("::read() STATUS_WANT_IO\n");
+    int ret;
+    do {
+      ret = tls_perform_stream_write();
+    } while (ret > 0);
+  }
+  else if (status == STATUS_FAIL)
+  {
+    TLS_PRINT("::read() close on STATUS_FAIL after tls_perform_stream_write\n");
+    this->close();
+    return true;
+  }
 
   //forward data
   this->m_busy += 1;
@@ -258,43 +457,24 @@ bool TLS_stream::tls_read(buffer_t buffer)
 
 int TLS_stream::tls_perform_stream_write()
 {
-  ERR_clear_error();
-  int pending = BIO_ctrl_pending(this->m_bio_wr);
-  if (pending > 0)
-  {
-    TLS_PRINT("::tls_perform_stream_write() pending=%d bytes\n",pending);
-    auto buffer = net::StreamBuffer::construct_write_buffer(pending);
-    if (buffer == nullptr) {
-      return 0;
-    }
-    int n = BIO_read(this->m_bio_wr, buffer->data(), buffer->size());
-    assert(n == pending);
-    //What if we cant write..
-    if (m_transport->is_writable())
-    {
-      m_transport->write(buffer);
-
-      this->m_busy += 1;
-      stream_on_write(n);
-      this->m_busy -= 1;
-    }
-
-    if (UNLIKELY((pending = BIO_ctrl_pending(this->m_bio_wr)) > 0))
-    {
-      return pending;
-    }
+  if (m_wr_buffer == nullptr || m_wr_buffer->empty())
     return 0;
-  }
 
-  BIO_read(this->m_bio_wr, nullptr, 0);
-
-  if (!BIO_should_retry(this->m_bio_wr))
+  // the records go out in the buffer OpenSSL wrote them to
+  auto buffer = std::move(m_wr_buffer);
+  const int n = buffer->size();
+  TLS_PRINT("::tls_perform_stream_write() pending=%d bytes\n", n);
+  //What if we cant write..
+  if (m_transport->is_writable())
   {
-    TLS_PRINT("::tls_perform_stream_write() close on !BIO_should_retry\n");
-    this->close();
-    return -1;
+    m_transport->write(std::move(buffer));
+
+    this->m_busy += 1;
+    stream_on_write(n);
+    this->m_busy -= 1;
   }
-  return 0;
+  // anything written from on_write is in a new buffer
+  return (m_wr_buffer) ? m_wr_buffer->size() : 0;
 }
 
 int TLS_stream::tls_perform_handshake()
@@ -352,7 +532,7 @@ void TLS_stream::close_callback_once()
 
 bool TLS_stream::handshake_completed() const noexcept
 {
-  return SSL_is_init_finished(this->m_ssl);
+  return m_handshake == nullptr && SSL_is_init_finished(this->m_ssl);
 }
 TLS_stream::status_t TLS_stream::status(int n) const noexcept
 {
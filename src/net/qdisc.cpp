@@ -0,0 +1,468 @@
+
+//#define QDISC_DEBUG 1
+#ifdef QDISC_DEBUG
+#define PRINT(fmt, ...) printf(fmt, ##__VA_ARGS__)
+#else
+#define PRINT(fmt, ...) /* fmt */
+#endif
+
+#include <net/qdisc.hpp>
+#include <net/ip4/header.hpp>
+#include <net/ip6/header.hpp>
+#include <net/util.hpp>
+#include <statman>
+#include <cmath>
+
+namespace net {
+
+  Qdisc::Qdisc(const std::string& name)
+    : name_{name},
+      dropped_{Statman::get().get_or_create(Stat::UINT64, name + ".dropped").get_uint64()},
+      marked_{Statman::get().get_or_create(Stat::UINT64, name + ".marked").get_uint64()},
+      delay_us_{Statman::get().get_or_create(Stat::UINT32, name + ".delay_us").get_uint32()}
+  {}
+
+  void Qdisc::drop(Entry& entry) noexcept
+  {
+    PRINT("<Qdisc> %s dropping packet (%u bytes)\n",
+          name_.c_str(), (unsigned) entry.size());
+    entry.packet = nullptr;
+    dropped_++;
+  }
+
+  bool Qdisc::mark_or_drop(Entry& entry) noexcept
+  {
+    if (set_ce(entry)) {
+      marked_++;
+      return true;
+    }
+    drop(entry);
+    return false;
+  }
+
+  static inline bool is_ip4(const Qdisc::Entry& entry) noexcept
+  {
+    return entry.type == Ethertype::IP4
+      and entry.packet->size() >= (int) sizeof(ip4::Header);
+  }
+
+  static inline bool is_ip6(const Qdisc::Entry& entry) noexcept
+  {
+    return entry.type == Ethertype::IP6
+      and entry.packet->size() >= (int) sizeof(ip6::Header);
+  }
+
+  // Traffic class is split over the first two octets of the IPv6 header
+  static inline uint8_t traffic_class6(const uint8_t* hdr) noexcept
+  { return (hdr[0] << 4) | (hdr[1] >> 4); }
+
+  DSCP Qdisc::dscp(const Entry& entry) noexcept
+  {
+    const auto* hdr = entry.packet->layer_begin();
+    if (is_ip4(entry))
+      return static_cast<DSCP>(hdr[1] >> 2);
+    if (is_ip6(entry))
+      return static_cast<DSCP>(traffic_class6(hdr) >> 2);
+    return DSCP::CS0;
+  }
+
+  static inline uint32_t mix(uint32_t h, uint32_t v) noexcept
+  {
+    h ^= v;
+    return h * 0x01000193; // FNV prime
+  }
+
+  uint32_t Qdisc::flow_hash(const Entry& entry) noexcept
+  {
+    const auto* hdr = entry.packet->layer_begin();
+    uint32_t h = 0x811c9dc5;
+    uint8_t proto;
+    const uint8_t* l4;
+
+    if (is_ip4(entry))
+    {
+      const auto& ip = *reinterpret_cast<const ip4::Header*>(hdr);
+      h = mix(h, ip.saddr.whole);
+      h = mix(h, ip.daddr.whole);
+      proto = ip.protocol;
+      const int hlen = (ip.version_ihl & 0xf) * 4;
+      // only the first fragment carries the ports
+      const bool frag_tail = ntohs(ip.frag_off_flags) & 0x1fff;
+      l4 = (frag_tail or entry.packet->size() < hlen + 4) ? nullptr : hdr + hlen;
+    }
+    else if (is_ip6(entry))
+    {
+      const auto& ip = *reinterpret_cast<const ip6::Header*>(hdr);
+      for (auto w : ip.saddr.i32) h = mix(h, w);
+      for (auto w : ip.daddr.i32) h = mix(h, w);
+      proto = ip.next_header;
+      l4 = entry.packet->size() < (int) sizeof(ip6::Header) + 4
+        ? nullptr : hdr + sizeof(ip6::Header);
+    }
+    else {
+      return mix(h, static_cast<uint16_t>(entry.type));
+    }
+
+    h = mix(h, proto);
+    if (l4 != nullptr and (proto == static_cast<uint8_t>(Protocol::TCP)
+                        or proto == static_cast<uint8_t>(Protocol::UDP)))
+    {
+      h = mix(h, *reinterpret_cast<const uint32_t*>(l4));
+    }
+    return h;
+  }
+
+  bool Qdisc::set_ce(Entry& entry) noexcept
+  {
+    auto* hdr = entry.packet->layer_begin();
+    if (is_ip4(entry))
+    {
+      const uint8_t old = hdr[1];
+      if ((old & 0x3) == static_cast<uint8_t>(ECN::NOT_ECT)) return false;
+      if ((old & 0x3) == static_cast<uint8_t>(ECN::CE)) return true;
+      hdr[1] = old | static_cast<uint8_t>(ECN::CE);
+      // incremental checksum update (RFC 1624)
+      auto& ip = *reinterpret_cast<ip4::Header*>(hdr);
+      const uint32_t m_old = (hdr[0] << 8) | old;
+      const uint32_t m_new = (hdr[0] << 8) | hdr[1];
+      uint32_t sum = (~ntohs(ip.check) & 0xffff) + (~m_old & 0xffff) + m_new;
+      sum = (sum & 0xffff) + (sum >> 16);
+      sum = (sum & 0xffff) + (sum >> 16);
+      ip.check = htons(~sum & 0xffff);
+      return true;
+    }
+    if (is_ip6(entry))
+    {
+      const uint8_t ecn = traffic_class6(hdr) & 0x3;
+      if (ecn == static_cast<uint8_t>(ECN::NOT_ECT)) return false;
+      // ECN bits are bits 4-5 of the second octet
+      hdr[1] |= static_cast<uint8_t>(ECN::CE) << 4;
+      return true;
+    }
+    return false;
+  }
+
+  // Fifo
+
+  bool Fifo::enqueue(Entry entry, uint64_t now)
+  {
+    if (UNLIKELY(queue_.size() >= limit_)) {
+      drop(entry);
+      return false;
+    }
+    entry.enqueued = now;
+    queue_.push_back(std::move(entry));
+    return true;
+  }
+
+  Qdisc::Entry Fifo::dequeue(uint64_t now)
+  {
+    if (queue_.empty()) return {};
+    auto entry = std::move(queue_.front());
+    queue_.pop_front();
+    sojourn(entry, now);
+    return entry;
+  }
+
+  // Prio
+
+  Prio::Prio(const std::string& name, size_t band_limit)
+    : Qdisc{name}
+  {
+    for (size_t i = 0; i < bands; i++)
+      bands_[i] = std::make_unique<Fifo>(name + ".band" + std::to_string(i), band_limit);
+  }
+
+  void Prio::set_band(size_t band, std::unique_ptr<Qdisc> qdisc)
+  {
+    Expects(band < bands and qdisc != nullptr);
+    bands_[band] = std::move(qdisc);
+  }
+
+  size_t Prio::classify(const Entry& entry) noexcept
+  {
+    if (entry.type != Ethertype::IP4 and entry.type != Ethertype::IP6)
+      return 0;
+
+    switch (dscp(entry)) {
+    case DSCP::CS5:
+    case DSCP::CS6:
+    case DSCP::CS7:
+    case DSCP::EF_PHB:
+    case DSCP::VOICE_ADMIT:
+      return 0;
+    case DSCP::CS1:
+      return 2;
+    default:
+      return 1;
+    }
+  }
+
+  bool Prio::enqueue(Entry entry, uint64_t now)
+  {
+    return bands_[classify(entry)]->enqueue(std::move(entry), now);
+  }
+
+  Qdisc::Entry Prio::dequeue(uint64_t now)
+  {
+    for (auto& band : bands_)
+    {
+      if (band->empty()) continue;
+      auto entry = band->dequeue(now);
+      if (entry.packet != nullptr) {
+        sojourn(entry, now);
+        return entry;
+      }
+      // a shaped band may hold back packets, don't let it block lower bands
+    }
+    return {};
+  }
+
+  size_t Prio::size() const noexcept
+  {
+    size_t n = 0;
+    for (const auto& band : bands_) n += band->size();
+    return n;
+  }
+
+  size_t Prio::limit() const noexcept
+  {
+    // any band may be the one a packet goes to, so the smallest
+    size_t n = bands_[0]->limit();
+    for (const auto& band : bands_) n = std::min(n, band->limit());
+    return n;
+  }
+
+  uint64_t Prio::next_event() const noexcept
+  {
+    uint64_t next = 0;
+    for (const auto& band : bands_)
+    {
+      const auto t = band->next_event();
+      if (t != 0 and (next == 0 or t < next)) next = t;
+    }
+    return next;
+  }
+
+  // Token_bucket
+
+  Token_bucket::Token_bucket(const std::string& name, Config config,
+                             std::unique_ptr<Qdisc> child)
+    : Qdisc{name},
+      config_{config},
+      child_{std::move(child)},
+      burst_ns_{config.burst * 1'000'000'000ull / config.rate},
+      tokens_{burst_ns_}
+  {
+    Expects(config_.rate > 0 and child_ != nullptr);
+  }
+
+  Token_bucket::Token_bucket(const std::string& name, Config config)
+    : Token_bucket(name, config, std::make_unique<Fifo>(name + ".fifo"))
+  {}
+
+  bool Token_bucket::enqueue(Entry entry, uint64_t now)
+  {
+    return child_->enqueue(std::move(entry), now);
+  }
+
+  Qdisc::Entry Token_bucket::dequeue(uint64_t now)
+  {
+    // refill
+    if (now > last_) {
+      tokens_ = std::min(burst_ns_, tokens_ + (now - last_));
+      last_ = now;
+    }
+
+    if (held_.packet == nullptr)
+    {
+      held_ = child_->dequeue(now);
+      if (held_.packet == nullptr) return {};
+    }
+
+    const auto needed = cost(held_.size());
+    // a packet larger than the bucket goes out on a full bucket
+    if (tokens_ < std::min(needed, burst_ns_)) {
+      ready_ = now + std::min(needed, burst_ns_) - tokens_;
+      return {};
+    }
+    tokens_ -= std::min(needed, tokens_);
+    ready_ = 0;
+    sojourn(held_, now);
+    return std::move(held_);
+  }
+
+  // Fq_codel
+
+  Fq_codel::Fq_codel(const std::string& name, Config config)
+    : Qdisc{name},
+      config_{config},
+      flows_(config.flows)
+  {
+    Expects(config_.flows > 0 and config_.limit > 0);
+  }
+
+  bool Fq_codel::enqueue(Entry entry, uint64_t now)
+  {
+    const uint32_t idx = flow_hash(entry) % flows_.size();
+    auto& flow = flows_[idx];
+
+    entry.enqueued = now;
+    flow.bytes += entry.size();
+    flow.queue.push_back(std::move(entry));
+    packets_++;
+
+    if (not flow.active)
+    {
+      flow.active  = true;
+      flow.deficit = config_.quantum;
+      new_flows_.push_back(idx);
+    }
+
+    if (UNLIKELY(packets_ > config_.limit)) {
+      drop_from_fattest();
+      return false;
+    }
+    return true;
+  }
+
+  void Fq_codel::drop_from_fattest()
+  {
+    Flow* fattest = &flows_[0];
+    for (auto& flow : flows_)
+      if (flow.bytes > fattest->bytes) fattest = &flow;
+
+    auto entry = std::move(fattest->queue.front());
+    fattest->queue.pop_front();
+    fattest->bytes -= entry.size();
+    packets_--;
+    drop(entry);
+  }
+
+  uint64_t Fq_codel::control_law(uint64_t t, uint32_t count) const noexcept
+  {
+    return t + config_.interval / std::sqrt(count);
+  }
+
+  Qdisc::Entry Fq_codel::pop(Flow& flow, uint64_t now, bool& ok_to_drop)
+  {
+    ok_to_drop = false;
+    if (flow.queue.empty()) {
+      flow.first_above_time = 0;
+      return {};
+    }
+    auto entry = std::move(flow.queue.front());
+    flow.queue.pop_front();
+    flow.bytes -= entry.size();
+    packets_--;
+
+    const uint64_t sojourn_time = now - entry.enqueued;
+    if (sojourn_time < config_.target or flow.bytes <= config_.quantum)
+    {
+      // went below target, or too little queued to drain
+      flow.first_above_time = 0;
+    }
+    else if (flow.first_above_time == 0)
+    {
+      flow.first_above_time = now + config_.interval;
+    }
+    else if (now >= flow.first_above_time)
+    {
+      ok_to_drop = true;
+    }
+    return entry;
+  }
+
+  bool Fq_codel::congested(Entry& entry) noexcept
+  {
+    if (config_.ecn)
+      return mark_or_drop(entry);
+    drop(entry);
+    return false;
+  }
+
+  // CoDel dequeue, as in RFC 8289 section 5
+  Qdisc::Entry Fq_codel::codel_dequeue(Flow& flow, uint64_t now)
+  {
+    bool ok_to_drop;
+    auto entry = pop(flow, now, ok_to_drop);
+    if (entry.packet == nullptr) {
+      flow.dropping = false;
+      return entry;
+    }
+
+    if (flow.dropping)
+    {
+      if (not ok_to_drop) {
+        flow.dropping = false;
+      }
+      while (flow.dropping and now >= flow.drop_next)
+      {
+        flow.count++;
+        if (congested(entry)) {
+          flow.drop_next = control_law(flow.drop_next, flow.count);
+          return entry;
+        }
+        entry = pop(flow, now, ok_to_drop);
+        if (entry.packet == nullptr or not ok_to_drop)
+          flow.dropping = false;
+        else
+          flow.drop_next = control_law(flow.drop_next, flow.count);
+      }
+    }
+    else if (ok_to_drop)
+    {
+      if (not congested(entry))
+        entry = pop(flow, now, ok_to_drop);
+      flow.dropping = true;
+      // if we recently left the dropping state, resume at the previous rate
+      const uint32_t delta = flow.count - flow.lastcount;
+      flow.count = (delta > 1 and now - flow.drop_next < 16 * config_.interval)
+        ? delta : 1;
+      flow.drop_next = control_law(now, flow.count);
+      flow.lastcount = flow.count;
+    }
+    return entry;
+  }
+
+  Qdisc::Entry Fq_codel::dequeue(uint64_t now)
+  {
+    while (true)
+    {
+      auto& list = not new_flows_.empty() ? new_flows_ : old_flows_;
+      if (list.empty()) return {};
+
+      const uint32_t idx = list.front();
+      auto& flow = flows_[idx];
+
+      // out of credit, go to the back of the old flows
+      if (flow.deficit <= 0)
+      {
+        flow.deficit += config_.quantum;
+        list.pop_front();
+        old_flows_.push_back(idx);
+        continue;
+      }
+
+      auto entry = codel_dequeue(flow, now);
+      if (entry.packet == nullptr)
+      {
+        list.pop_front();
+        // a new flow gets a turn among the old ones before going idle,
+        // preventing starvation of the old flows
+        if (&list == &new_flows_ and not old_flows_.empty()) {
+          old_flows_.push_back(idx);
+        }
+        else {
+          flow.active = false;
+        }
+        continue;
+      }
+
+      flow.deficit -= entry.size();
+      sojourn(entry, now);
+      return entry;
+    }
+  }
+
+} //< namespace net
@@ -0,0 +1,206 @@
+
+#include <net/reassembly.hpp>
+#include <algorithm>
+#include <cstring>
+
+//#define REASSEMBLY_DEBUG 1
+#ifdef REASSEMBLY_DEBUG
+#define PRINT(fmt, ...) printf(fmt, ##__VA_ARGS__)
+#else
+#define PRINT(fmt, ...) /* fmt */
+#endif
+
+namespace net
+{
+  Reassembly::Reassembly(Config cfg)
+    : config_{std::move(cfg)}
+  {
+    const auto bufsize = config_.buffer_size();
+    Expects(config_.max_datagram > 0 and config_.byte_budget >= bufsize);
+    // buffers are only taken when available, so the pool never grows
+    pool_ = std::make_unique<BufferStore>(config_.byte_budget / bufsize, bufsize);
+  }
+
+  Reassembly::~Reassembly()
+  {
+    if (timer_ != Timers::UNUSED_ID)
+      Timers::stop(timer_);
+  }
+
+  Packet_ptr Reassembly::insert(const Key& key, const Fragment& frag, bool more)
+  {
+    stats_.fragments++;
+    const auto now = RTC::now();
+    expire(now);
+
+    const uint32_t frag_end = frag.offset + frag.length;
+    const bool has_header = frag.offset == 0 and frag.header_len > 0;
+    if (UNLIKELY(frag.length == 0 or frag_end > config_.max_datagram
+              or frag.header_len > config_.max_header))
+    {
+      PRINT("-> Invalid fragment (%u + %u), dropping\n", frag.offset, frag.length);
+      stats_.dropped++;
+      return nullptr;
+    }
+
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+      // make space for a new datagram by evicting the oldest
+      if (entries_.size() >= config_.max_entries)
+      {
+        erase(entries_.find(age_.front()));
+        stats_.evicted++;
+      }
+      if (UNLIKELY(not make_room()))
+      {
+        PRINT("-> Out of reassembly buffers, dropping fragment\n");
+        stats_.no_buffers++;
+        return nullptr;
+      }
+      it = entries_.emplace(key, Entry{}).first;
+      it->second.buffer = pool_->get_buffer();
+      it->second.created = now;
+      it->second.age = age_.insert(age_.end(), key);
+      arm_timer();
+    }
+    auto& entry = it->second;
+    auto& pieces = entry.pieces;
+
+    // find position, keeping pieces ordered by offset
+    auto pos = std::lower_bound(pieces.begin(), pieces.end(), frag.offset,
+      [](const Piece& p, uint32_t off) { return p.offset < off; });
+
+    // exact duplicates are simply ignored
+    if (pos != pieces.end() and pos->offset == frag.offset
+        and pos->length == frag.length)
+    {
+      PRINT("-> Duplicate fragment at %u, ignoring\n", frag.offset);
+      stats_.dropped++;
+      return nullptr;
+    }
+
+    // overlapping fragments invalidate the whole datagram (RFC 5722)
+    const bool overlaps =
+      (pos != pieces.begin() and std::prev(pos)->offset + std::prev(pos)->length > frag.offset)
+      or (pos != pieces.end() and frag_end > pos->offset);
+
+    bool bad_length = false;
+    if (not more)
+    {
+      bad_length = (entry.total != 0 and entry.total != frag_end)
+        or (not pieces.empty() and end_of(pieces) > frag_end);
+    }
+    else
+    {
+      bad_length = entry.total != 0 and frag_end > entry.total;
+    }
+
+    if (UNLIKELY(overlaps or bad_length))
+    {
+      PRINT("-> Overlapping or inconsistent fragment, dropping datagram\n");
+      erase(it);
+      stats_.dropped++;
+      return nullptr;
+    }
+
+    // straight to its place in the datagram, the header right before the data
+    auto* data = entry.buffer + data_offset();
+    if (has_header)
+    {
+      entry.header_len = frag.header_len;
+      std::memcpy(data - frag.header_len, frag.header, frag.header_len);
+    }
+    std::memcpy(data + frag.offset, frag.data, frag.length);
+    pieces.insert(pos, {frag.offset, frag.length});
+
+    if (not more)
+      entry.total = frag_end;
+
+    entry.received += frag.length;
+
+    // with no overlaps, having all bytes means the datagram is complete
+    if (entry.total != 0 and entry.received == entry.total)
+      return complete(it);
+
+    return nullptr;
+  }
+
+  Packet_ptr Reassembly::complete(Entries::iterator it)
+  {
+    auto& entry = it->second;
+    PRINT("-> Datagram complete (%u bytes in %zu pieces)\n",
+          entry.total, entry.pieces.size());
+
+    // the buffer becomes the packet, returning to the pool when released
+    auto* ptr = (Packet*) entry.buffer;
+    new (ptr) Packet(config_.max_header - entry.header_len,
+                     entry.header_len + entry.total,
+                     pool_->bufsize() - sizeof(Packet), pool_.get());
+    Packet_ptr packet{ptr};
+    entry.buffer = nullptr;
+
+    erase(it);
+    stats_.reassembled++;
+    return packet;
+  }
+
+  void Reassembly::expire(RTC::timestamp_t now)
+  {
+    while (not age_.empty())
+    {
+      auto it = entries_.find(age_.front());
+      if (now - it->second.created < config_.timeout)
+        break;
+
+      PRINT("-> Datagram timed out, dropping\n");
+      erase(it);
+      stats_.timeouts++;
+    }
+  }
+
+  void Reassembly::arm_timer()
+  {
+    if (timer_ != Timers::UNUSED_ID or age_.empty())
+      return;
+    const auto& oldest = entries_.find(age_.front())->second;
+    const auto deadline = oldest.created + config_.timeout;
+    const auto now = RTC::now();
+    const auto left = deadline > now ? deadline - now : 1;
+    timer_ = Timers::oneshot(std::chrono::seconds(left),
+                             {this, &Reassembly::on_timeout});
+  }
+
+  void Reassembly::on_timeout(Timers::id_t)
+  {
+    // expire without waiting for more fragments to arrive
+    timer_ = Timers::UNUSED_ID;
+    expire(RTC::now());
+    arm_timer();
+  }
+
+  bool Reassembly::make_room()
+  {
+    // buffers of datagrams handed out are only back once released
+    while (pool_->available() == 0)
+    {
+      if (age_.empty())
+        return false;
+
+      erase(entries_.find(age_.front()));
+      stats_.evicted++;
+    }
+    return true;
+  }
+
+  void Reassembly::erase(Entries::iterator it)
+  {
+    auto& entry = it->second;
+    if (entry.buffer)
+      pool_->release(entry.buffer);
+
+    age_.erase(entry.age);
+    entries_.erase(it);
+  }
+
+} //< namespace net
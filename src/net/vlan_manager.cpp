@@ -32,40 +32,83 @@ VLAN_manager& VLAN_manager::get(int N)
 
 VLAN_manager::VLAN_interface& VLAN_manager::add(hw::Nic& link, const int id)
 {
-  Expects(id > 0 and id <= 4096 && "Outside VID range (1-4096)");
+  return insert(link, 0, id);
+}
+
+VLAN_manager::VLAN_interface& VLAN_manager::add(hw::Nic& link, const int outer_id, const int id)
+{
+  Expects(outer_id > 0 and outer_id < num_ids - 1 && "Outside S-VID range (1-4094)");
+  return insert(link, outer_id, id);
+}
+
+VLAN_manager::VLAN_interface& VLAN_manager::insert(hw::Nic& link, const int outer_id, const int id)
+{
+  Expects(id > 0 and id < num_ids - 1 && "Outside VID range (1-4094)");
+
+  auto* table = &links_;
+  if (outer_id)
+  {
+    if (qinq_[outer_id] == nullptr)
+      qinq_[outer_id] = std::make_unique<Table>();
+    table = qinq_[outer_id].get();
+  }
+  Expects((*table)[id] == nullptr && "ID is already taken");
 
   // this is very redudant if it's already been set once,
   // but i'll keep it for now since it's not expensive.
-  this->setup(link,id);
+  // the hardware filter sees the outermost tag
+  this->setup(link, outer_id ? outer_id : id);
 
-  auto vif = std::make_unique<VLAN_interface>(link, id);
+  auto vif = std::make_unique<VLAN_interface>(link, id, outer_id);
   auto* raw = vif.get();
 
   // register as a device (unnecessary?)
   os::machine().add<hw::Nic>(std::move(vif));
 
-  auto it = links_.emplace(id, raw);
-  Ensures(it.second && "Could not insert - ID is most likely already taken");
+  (*table)[id] = raw;
 
   INFO("VLAN", "Added VLAN %s %s", raw->driver_name(), raw->device_name().c_str());
 
-  return *it.first->second;
+  return *raw;
+}
+
+VLAN_manager::VLAN_interface* VLAN_manager::find(const int id, const int outer_id) const noexcept
+{
+  if (outer_id == 0)
+    return links_[id & 0xFFF];
+
+  const auto& table = qinq_[outer_id & 0xFFF];
+  return (table) ? (*table)[id & 0xFFF] : nullptr;
 }
 
 void VLAN_manager::receive(Packet_ptr pkt)
 {
   auto& vlan = *reinterpret_cast<ethernet::VLAN_header*>(pkt->layer_begin());
-  Expects(vlan.tpid == static_cast<int>(Ethertype::VLAN));
 
-  auto id = vlan.vid();
+  VLAN_interface* vif;
+  if (LIKELY(vlan.tpid == static_cast<uint16_t>(Ethertype::VLAN)))
+  {
+    vif = links_[vlan.vid()];
+    PRINT("<VLAN_manager> Recieved frame tagged with ID %d ", vlan.vid());
+  }
+  else
+  {
+    Expects(vlan.tpid == static_cast<uint16_t>(Ethertype::QINQ));
+    auto& qinq = *reinterpret_cast<ethernet::QinQ_header*>(pkt->layer_begin());
+    // the S-tag must be followed by a C-tag
+    if (UNLIKELY(qinq.c_tpid != static_cast<uint16_t>(Ethertype::VLAN)))
+    {
+      PRINT("<VLAN_manager> Dropping S-tagged frame without C-tag (%#x)\n", qinq.c_tpid);
+      return;
+    }
+    vif = find(qinq.cvid(), qinq.svid());
+    PRINT("<VLAN_manager> Recieved frame tagged with S-ID %d ID %d ", qinq.svid(), qinq.cvid());
+  }
 
-  auto it = links_.find(id);
-  PRINT("<VLAN_manager> Recieved frame tagged with ID %d ", id);
-  if(it != links_.end())
+  if (vif != nullptr)
   {
     PRINT("- Found\n");
-    it->second->receive(std::move(pkt));
-    return;
+    vif->receive(std::move(pkt));
   }
   else
   {
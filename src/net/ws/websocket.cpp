@@ -6,8 +6,53 @@
 #include <cstdint>
 #include <net/ws/connector.hpp>
 
+#if defined(ARCH_x86_64) || defined(ARCH_i686)
+  #include <immintrin.h>
+#endif
+
 namespace net {
 
+void ws_header::apply_mask(char* data, const size_t len, const char* key,
+                           const size_t offset) noexcept
+{
+  // the key as it lines up with data
+  uint8_t kb[4];
+  for (size_t i = 0; i < 4; i++)
+    kb[i] = key[(offset + i) & 3];
+  uint32_t k32;
+  memcpy(&k32, kb, sizeof(k32));
+  size_t i = 0;
+  // every step is a multiple of 4 bytes, keeping the key aligned
+#if defined(ARCH_x86_64) || defined(ARCH_i686)
+#if defined(__AVX2__)
+  const __m256i k256 = _mm256_set1_epi32(k32);
+  for (; i + 32 <= len; i += 32)
+  {
+    auto* p = (__m256i*) &data[i];
+    _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), k256));
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i k128 = _mm_set1_epi32(k32);
+  for (; i + 16 <= len; i += 16)
+  {
+    auto* p = (__m128i*) &data[i];
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), k128));
+  }
+#endif
+#endif
+  const uint64_t k64 = ((uint64_t) k32 << 32) | k32;
+  for (; i + 8 <= len; i += 8)
+  {
+    uint64_t word;
+    memcpy(&word, &data[i], sizeof(word));
+    word ^= k64;
+    memcpy(&data[i], &word, sizeof(word));
+  }
+  for (; i < len; i++)
+    data[i] ^= kb[i & 3];
+}
+
 static inline std::string
 encode_hash(const std::string& key)
 {
@@ -180,18 +225,18 @@ void WebSocket::read_data(Stream::buffer_t buf)
     {
       const size_t written = message->append(data, len);
       len -= written;
-      data += len;
+      data += written;
     }
     // create new message
     else
     {
-      const size_t written = create_message(data, len);
+      const size_t written = create_message(buf, data, len);
 
       if(UNLIKELY(message == nullptr))
         return; // Something was invalid, error has been called and stream closed.
 
       len -= written;
-      data += len;
+      data += written;
     }
 
     if (message->is_complete()) {
@@ -200,6 +245,22 @@ void WebSocket::read_data(Stream::buffer_t buf)
   }
 }
 
+WebSocket::Message::Message(net::Stream::buffer_t buf, size_t offset)
+  : buf_{std::move(buf)}
+{
+  const auto& wsh = *(const ws_header*) (buf_->data() + offset);
+  this->header_length = wsh.header_length();
+  std::memcpy(header_.data(), &wsh, this->header_length);
+  this->offset_ = offset + this->header_length;
+  this->length_ = wsh.data_length();
+  Expects(this->offset_ + this->length_ <= buf_->size());
+  if (header().is_masked())
+  {
+    auto& hdr = *(ws_header*) header_.data();
+    ws_header::apply_mask(this->data(), length_, hdr.keymask(), 0);
+  }
+}
+
 size_t WebSocket::Message::append(const uint8_t* data, size_t len)
 {
   size_t total = 0;
@@ -219,14 +280,22 @@ size_t WebSocket::Message::append(const uint8_t* data, size_t len)
   // fill data with remainder
   if (this->header_complete())
   {
-    const size_t insert_size = std::min(data_.capacity() - data_.size(), len);
+    const size_t offset = data_.size();
+    const size_t insert_size = std::min(header().data_length() - offset, len);
     data_.insert(data_.end(), data, data + insert_size);
+    // unmask while the data is still in cache
+    if (header().is_masked())
+    {
+      auto& hdr = *(ws_header*) header_.data();
+      ws_header::apply_mask(this->data() + offset, insert_size, hdr.keymask(), offset);
+    }
     total += insert_size;
   }
   return total;
 }
 
-size_t WebSocket::create_message(const uint8_t* buf, size_t len)
+size_t WebSocket::create_message(const Stream::buffer_t& buffer,
+                                 const uint8_t* buf, size_t len)
 {
   // parse header
   if (len < sizeof(ws_header)) {
@@ -266,14 +335,20 @@ size_t WebSocket::create_message(const uint8_t* buf, size_t len)
     return std::min(hdr.data_length(), len);
   }
 
+  const size_t hdr_bytes = std::min<size_t>(hdr.header_length(), len);
+  // a whole frame in the buffer is read from where it lies
+  if (hdr_bytes == hdr.header_length() and len - hdr_bytes >= hdr.data_length())
+  {
+    this->message = std::make_unique<Message>(buffer, buf - buffer->data());
+    return hdr_bytes + message->size();
+  }
   this->message = std::make_unique<Message>(buf, len);
-  return len;
+  return hdr_bytes + message->size();
 }
 
 void WebSocket::finalize_message()
 {
   Expects(message != nullptr and message->is_complete());
-  message->unmask();
   const auto& hdr = message->header();
   switch (hdr.opcode()) {
   case op_code::TEXT:
@@ -299,13 +374,13 @@ void WebSocket::finalize_message()
     // the websocket is DEAD after close()
     return;
   case op_code::PING:
-    if (on_ping(hdr.data(), hdr.data_length())) // if return true, pong back
-      write_opcode(op_code::PONG, hdr.data(), hdr.data_length());
+    if (on_ping(message->data(), message->size())) // if return true, pong back
+      write_opcode(op_code::PONG, message->data(), message->size());
     break;
   case op_code::PONG:
     ping_timer.stop();
     if (on_pong != nullptr)
-      on_pong(hdr.data(), hdr.data_length());
+      on_pong(message->data(), message->size());
     break;
   default:
     //printf("Unknown opcode: %d\n", (int) hdr.opcode());
@@ -388,6 +463,26 @@ void WebSocket::write(Stream::buffer_t buffer, op_code code)
   /// write shared buffer
   this->stream->write(buffer);
 }
+Stream::buffer_t WebSocket::create_frame(const char* data, size_t len, op_code code)
+{
+  Expects((code == op_code::TEXT or code == op_code::BINARY)
+        && "Broadcast only supports TEXT or BINARY");
+  auto frame = create_wsmsg(len, code, false);
+  frame->insert(frame->end(), data, data + len);
+  return frame;
+}
+bool WebSocket::write_frame(const Stream::buffer_t& frame,
+                            const char* data, size_t len, op_code code)
+{
+  if (this->stream == nullptr || this->stream->is_writable() == false)
+    return false;
+  // the server side frame is shared, a client has to mask its own
+  if (clientside)
+    this->write(data, len, code);
+  else
+    this->stream->write(frame);
+  return true;
+}
 bool WebSocket::write_opcode(op_code code, const char* buffer, size_t datalen)
 {
   if (UNLIKELY(stream == nullptr || stream->is_writable() == false)) {
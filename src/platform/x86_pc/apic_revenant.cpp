@@ -60,19 +60,17 @@ static void revenant_task_handler()
 {
   auto& system = PER_CPU(smp_system);
   system.work_done = false;
+  // functions posted by other CPUs
+  smp_drain_inbox(SMP::cpu_id());
   // cpu-specific tasks
   while(revenant_task_doer(PER_CPU(smp_system)));
-  // global tasks (by taking from index 0)
-  while (revenant_task_doer(smp_system[0]));
+  // tasks for any CPU, queued here or stolen from others
+  while (smp_run_task(SMP::cpu_id()));
   // if we did any work with done functions, signal back
-  if (system.work_done) {
-    // set bit for this CPU
-    smp_main.bitmap.atomic_set(SMP::cpu_id());
-    // signal main CPU
-    x86::APIC::get().send_bsp_intr();
-  }
+  smp_flush_done();
 }
 
+
 void revenant_main(int cpu)
 {
   uintptr_t this_stack = smp_main.stack_base + cpu * smp_main.stack_size;
@@ -122,7 +120,13 @@ void revenant_main(int cpu)
   while (true)
   {
     Events::get().process_events();
+    // before halting, tasks to steal or mail
+    if (not smp_prepare_halt(cpu)) {
+      revenant_task_handler();
+      continue;
+    }
     os::halt();
+    smp_woken(cpu);
   }
   __builtin_unreachable();
 }
@@ -8,6 +8,9 @@
 #include <deque>
 #include <membitmap>
 #include <vector>
+#include <atomic>
+#include <util/work_deque.hpp>
+#include <util/spsc_queue.hpp>
 
 extern "C" void revenant_main(int);
 
@@ -21,6 +24,16 @@ struct smp_task {
   SMP::done_func done;
 };
 
+// a task any CPU can run, stolen from the deque of the one queuing it
+struct smp_stealable {
+  SMP::task_func func;
+  SMP::done_func done;
+  std::atomic<int>* group; // tasks left in its group
+};
+
+// functions posted from one CPU to another
+using smp_mailbox = util::spsc_queue<SMP::task_func, 256>;
+
 struct smp_stuff
 {
   uintptr_t stack_base;
@@ -29,6 +42,8 @@ struct smp_stuff
   uint32_t  bmp_storage[1] = {0};
   std::vector<int> initialized_cpus {0};
   MemBitmap bitmap{&bmp_storage[0], 1};
+  // CPUs halted with nothing to do, to be woken by an IPI
+  std::atomic<uint32_t> idle {0};
 };
 
 
@@ -41,8 +56,19 @@ struct smp_system_stuff
   std::vector<smp_task> tasks;
   std::vector<SMP::done_func> completed;
   bool work_done;
+  util::work_deque<smp_stealable*, 1024> deque;
+  uint32_t steal_seed = 1;
+  // from each CPU to this one, made by the sender when first posting
+  std::array<std::atomic<smp_mailbox*>, SMP_MAX_CORES> inbox {};
 };
  extern SMP::Array<smp_system_stuff> smp_system;
+
+// run one task of this CPU's deque, or stolen from another
+extern bool smp_run_task(int cpu);
+// whether any CPU has tasks queued
+extern bool smp_has_tasks();
+// have the BSP run the done functions of the tasks run here
+extern void smp_flush_done();
 }
 
 #endif
@@ -8,10 +8,12 @@
 #include <rtc>
 #include <kernel/events.hpp>
 #include <kernel/memory.hpp>
+#include <hw/nic.hpp>
 #include <kprint>
 #include <service>
 #include <cstdio>
 #include "cmos.hpp"
+#include "smp.hpp"
 //#define ENABLE_PROFILERS
 #include <profile>
 
@@ -158,11 +160,88 @@ void kernel::start(uint32_t boot_magic, uint32_t boot_addr)
 
 extern void __arch_poweroff();
 
+// Busy polling state, for the BSP
+struct Busy_poll {
+  uint64_t spin    = 0;  // cycles to spin next time
+  uint64_t ceiling = 0;  // the most cycles to spin, given the recent load
+  uint64_t window  = 0;  // when the current load window began
+  uint64_t asleep  = 0;  // cycles halted when it began
+  uint64_t wasted  = 0;  // cycles spun for nothing since it began
+};
+static Busy_poll busy;
+
+/**
+ *  Poll the NICs, events and mail until some work turns up, for as long
+ *  as the adaptive spin allows. Returns whether there was any work.
+ */
+static bool spin_before_halt(os::Machine::Vector<hw::Nic>& nics)
+{
+  const auto max_spin = kernel::busy_poll().count();
+  if (max_spin <= 0) return false;
+
+  const double cycles_per_us = os::cpu_freq().count() / 1000.0;
+  const uint64_t max_cycles = max_spin * cycles_per_us;
+  const uint64_t min_cycles = std::max<uint64_t>(max_cycles / 16, 1);
+
+  // every 10 ms, cap the spin by how busy the CPU was, counting spins
+  // that found nothing as idle, so that a quiet CPU keeps halting early
+  const uint64_t begin = os::Arch::cpu_cycles();
+  const uint64_t window = begin - busy.window;
+  if (window >= uint64_t(10000 * cycles_per_us))
+  {
+    const uint64_t asleep = PER_CPU(os_per_cpu).cycles_hlt;
+    const double idle = std::min(1.0,
+        double(asleep - busy.asleep + busy.wasted) / window);
+    busy.ceiling = std::max<uint64_t>(min_cycles, max_cycles * (1.0 - idle));
+    busy.window = begin;
+    busy.asleep = asleep;
+    busy.wasted = 0;
+  }
+  busy.spin = std::clamp(busy.spin, min_cycles, std::max(min_cycles, busy.ceiling));
+
+  uint64_t packets = 0;
+  for (auto& nic : nics)
+    packets += nic.get().get_packets_rx();
+
+  uint64_t now;
+  do {
+    uint64_t received = 0;
+    for (auto& nic : nics) {
+      nic.get().poll();
+      received += nic.get().get_packets_rx();
+    }
+    bool found = received != packets;
+    found |= x86::smp_drain_inbox(0);
+    found |= Events::get(0).process_events();
+    if (found) {
+      // traffic is coming: spin for longer next time
+      busy.spin = std::min(busy.spin * 2, std::max(min_cycles, busy.ceiling));
+      return true;
+    }
+    asm volatile("pause");
+    now = os::Arch::cpu_cycles();
+  } while (now - begin < busy.spin);
+
+  busy.wasted += now - begin;
+  busy.spin /= 2;
+  return false;
+}
+
 void os::event_loop()
 {
+  // NICs are all attached by now
+  auto nics = os::machine().count<hw::Nic>() > 0
+      ? os::machine().get<hw::Nic>() : os::Machine::Vector<hw::Nic>{};
+
   Events::get(0).process_events();
   do {
-    os::halt();
+    if (spin_before_halt(nics)) continue;
+    // other CPUs only interrupt this one for mail when it's halted
+    if (x86::smp_prepare_halt(0)) {
+      os::halt();
+      x86::smp_woken(0);
+    }
+    x86::smp_drain_inbox(0);
     Events::get(0).process_events();
   } while (kernel::is_running());
 
@@ -179,9 +179,166 @@ void SMP::init_task()
   /* do nothing */
 }
 
+#ifdef INCLUDEOS_SMP_ENABLE
+namespace x86
+{
+  static void run_stealable(smp_stealable* task)
+  {
+    task->func();
+    if (task->group)
+      task->group->fetch_sub(1, std::memory_order_release);
+    if (task->done)
+    {
+      if (SMP::cpu_id() == 0) {
+        task->done();
+      }
+      else {
+        auto& system = PER_CPU(smp_system);
+        lock(system.flock);
+        system.completed.push_back(std::move(task->done));
+        unlock(system.flock);
+        system.work_done = true;
+      }
+    }
+    delete task;
+  }
+
+  static void wake(int cpu)
+  {
+    if (cpu == 0)
+      x86::APIC::get().send_bsp_intr();
+    else
+      x86::APIC::get().send_ipi(cpu, 0x20);
+  }
+
+  // the one clearing the bit of a halted CPU wakes it
+  static bool wake_if_idle(int cpu)
+  {
+    const uint32_t bit = 1u << cpu;
+    if ((smp_main.idle.load(std::memory_order_relaxed) & bit)
+        and (smp_main.idle.fetch_and(~bit) & bit))
+    {
+      wake(cpu);
+      return true;
+    }
+    return false;
+  }
+
+  static void wake_idle_cpu()
+  {
+    // an AP, as the BSP only runs tasks of groups it waits for
+    uint32_t idle = smp_main.idle.load() & ~1u;
+    while (idle != 0)
+    {
+      const int cpu = __builtin_ctz(idle);
+      if (wake_if_idle(cpu)) return;
+      idle = smp_main.idle.load() & ~1u;
+    }
+  }
+
+  static void queue_task(smp_stealable* task)
+  {
+    if (UNLIKELY(not PER_CPU(smp_system).deque.push(task))) {
+      // too much queued already
+      run_stealable(task);
+      smp_flush_done();
+      return;
+    }
+    // the push is seen by an AP marking itself idle after this, or the
+    // mark is seen here; pairs with the fence of smp_prepare_halt
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wake_idle_cpu();
+  }
+
+  bool smp_run_task(int cpu)
+  {
+    auto& system = smp_system[cpu];
+    smp_stealable* task = nullptr;
+    if (not system.deque.pop(task))
+    {
+      // steal the oldest task of another CPU, starting at a random one
+      system.steal_seed = system.steal_seed * 1103515245 + 12345;
+      const unsigned start = system.steal_seed >> 16;
+      for (int i = 0; i < SMP_MAX_CORES; i++)
+      {
+        const int victim = (start + i) % SMP_MAX_CORES;
+        smp_stealable* stolen;
+        if (victim != cpu and smp_system[victim].deque.steal(stolen)) {
+          task = stolen;
+          break;
+        }
+      }
+      if (task == nullptr) return false;
+    }
+    run_stealable(task);
+    return true;
+  }
+
+  bool smp_has_tasks()
+  {
+    for (const auto& system : smp_system)
+      if (not system.deque.empty()) return true;
+    return false;
+  }
+
+  static bool inbox_pending(int cpu)
+  {
+    for (const auto& box : smp_system[cpu].inbox)
+    {
+      const auto* mailbox = box.load(std::memory_order_acquire);
+      if (mailbox and not mailbox->empty()) return true;
+    }
+    return false;
+  }
+
+  bool smp_drain_inbox(int cpu)
+  {
+    size_t count = 0;
+    for (auto& box : smp_system[cpu].inbox)
+    {
+      auto* mailbox = box.load(std::memory_order_acquire);
+      if (mailbox)
+        count += mailbox->consume_all([] (SMP::task_func& func) { func(); });
+    }
+    return count > 0;
+  }
+
+  bool smp_prepare_halt(int cpu)
+  {
+    // from here on, new tasks and mail wake this CPU
+    smp_main.idle.fetch_or(1u << cpu);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (not inbox_pending(cpu) and (cpu == 0 or not smp_has_tasks()))
+      return true;
+    smp_woken(cpu);
+    return false;
+  }
+
+  void smp_woken(int cpu)
+  {
+    smp_main.idle.fetch_and(~(1u << cpu));
+  }
+
+  void smp_flush_done()
+  {
+    auto& system = PER_CPU(smp_system);
+    if (SMP::cpu_id() == 0 or not system.work_done) return;
+    system.work_done = false;
+    // set bit for this CPU
+    smp_main.bitmap.atomic_set(SMP::cpu_id());
+    // signal main CPU
+    x86::APIC::get().send_bsp_intr();
+  }
+}
+#endif
+
 void SMP::add_task(smp_task_func task, smp_done_func done, int cpu)
 {
 #ifdef INCLUDEOS_SMP_ENABLE
+  if (cpu == 0) {
+    x86::queue_task(new smp_stealable{std::move(task), std::move(done), nullptr});
+    return;
+  }
   lock(smp_system[cpu].tlock);
   smp_system[cpu].tasks.emplace_back(std::move(task), std::move(done));
   unlock(smp_system[cpu].tlock);
@@ -193,6 +350,10 @@ void SMP::add_task(smp_task_func task, smp_done_func done, int cpu)
 void SMP::add_task(smp_task_func task, int cpu)
 {
 #ifdef INCLUDEOS_SMP_ENABLE
+  if (cpu == 0) {
+    x86::queue_task(new smp_stealable{std::move(task), nullptr, nullptr});
+    return;
+  }
   lock(smp_system[cpu].tlock);
   smp_system[cpu].tasks.emplace_back(std::move(task), nullptr);
   unlock(smp_system[cpu].tlock);
@@ -201,6 +362,52 @@ void SMP::add_task(smp_task_func task, int cpu)
   task();
 #endif
 }
+
+#ifdef INCLUDEOS_SMP_ENABLE
+bool SMP::post(int cpu, task_func func)
+{
+  auto& box = smp_system[cpu].inbox[SMP::cpu_id()];
+  // only this CPU makes it
+  auto* mailbox = box.load(std::memory_order_relaxed);
+  if (UNLIKELY(mailbox == nullptr)) {
+    mailbox = new smp_mailbox;
+    box.store(mailbox, std::memory_order_release);
+  }
+  if (not mailbox->push(std::move(func)))
+    return false;
+  // ring the doorbell only if the CPU is halted, once
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  x86::wake_if_idle(cpu);
+  return true;
+}
+#else
+namespace x86
+{
+  bool smp_prepare_halt(int) { return true; }
+  void smp_woken(int) {}
+  bool smp_drain_inbox(int) { return false; }
+}
+#endif
+
+#ifdef INCLUDEOS_SMP_ENABLE
+void SMP::Task_group::run(task_func func)
+{
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  x86::queue_task(new smp_stealable{std::move(func), nullptr, &pending_});
+}
+
+void SMP::Task_group::wait()
+{
+  // help out, rather than waiting idle
+  const int cpu = SMP::cpu_id();
+  while (pending_.load(std::memory_order_acquire) > 0)
+  {
+    if (not x86::smp_run_task(cpu))
+      asm volatile("pause");
+  }
+  x86::smp_flush_done();
+}
+#endif
 void SMP::add_bsp_task(smp_done_func task)
 {
 #ifdef INCLUDEOS_SMP_ENABLE
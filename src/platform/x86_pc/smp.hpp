@@ -15,6 +15,13 @@ namespace x86 {
 extern void init_SMP();
 extern void initialize_gdt_for_cpu(int cpuid);
 
+// whether a CPU may halt, with nothing to do. It's then woken by an
+// IPI for new tasks or mail, and must call smp_woken() after halting
+extern bool smp_prepare_halt(int cpu);
+extern void smp_woken(int cpu);
+// run the functions posted to a CPU, returning whether there were any
+extern bool smp_drain_inbox(int cpu);
+
 }
 
 #endif
@@ -144,13 +144,28 @@ Virtio::Token Virtio::Queue::dequeue()
 }
 
 void Virtio::Queue::disable_interrupts() {
-  _queue.avail->flags |= (1 << VIRTQ_AVAIL_F_NO_INTERRUPT);
+  _queue.avail->flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+  // the device ignores the flag with event indices, so put the
+  // event where the used index won't pass it for a whole lap
+  if (_event_idx) used_event() = _last_used_idx - 1;
 }
 void Virtio::Queue::enable_interrupts() {
-  _queue.avail->flags &= ~(1 << VIRTQ_AVAIL_F_NO_INTERRUPT);
+  _queue.avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+  if (_event_idx) used_event() = _last_used_idx;
+  // the event index is written before the used ring is read again,
+  // or a buffer used meanwhile raises no interrupt (Std. §2.6.7.2)
+  __arch_hw_barrier();
+}
+void Virtio::Queue::enable_interrupts_delayed() {
+  _queue.avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+  if (_event_idx) {
+    const uint16_t pending = _queue.avail->idx - _last_used_idx;
+    used_event() = _last_used_idx + pending * 3 / 4;
+  }
+  __arch_hw_barrier();
 }
 bool Virtio::Queue::interrupts_enabled() const noexcept {
-  return (_queue.avail->flags & (1 << VIRTQ_AVAIL_F_NO_INTERRUPT)) == 0;
+  return (_queue.avail->flags & VIRTQ_AVAIL_F_NO_INTERRUPT) == 0;
 }
 
 // this will force most of the implementation to not use PCI
@@ -158,13 +173,17 @@ bool Virtio::Queue::interrupts_enabled() const noexcept {
 #include <hw/pci.hpp>
 void Virtio::Queue::kick()
 {
+  [[maybe_unused]] const uint16_t old_idx = _queue.avail->idx;
   update_avail_idx();
 #if defined (PLATFORM_UNITTEST)
   // do nothing here
 #elif defined(ARCH_x86)
   // Std. §3.2.1 pt. 4
   __arch_hw_barrier();
-  if (!(_queue.used->flags & VIRTQ_USED_F_NO_NOTIFY)){
+  const bool notify = (_event_idx)
+      ? need_event(avail_event(), _queue.avail->idx, old_idx)
+      : !(_queue.used->flags & VIRTQ_USED_F_NO_NOTIFY);
+  if (notify){
     debug("<%s> Kicking virtio. Iobase 0x%x \n", qname.c_str(), _iobase);
     hw::outpw(_iobase + VIRTIO_PCI_QUEUE_NOTIFY , _pci_index);
   }else{
@@ -0,0 +1,74 @@
+
+#include <common.cxx>
+#include <nic_mock.hpp>
+#include <kernel/events.hpp>
+
+// A NIC with a number of packets waiting in its RX-ring
+class Napi_nic : public Nic_mock
+{
+public:
+  int  ring = 0;
+  int  rounds = 0;
+  bool irq_enabled = true;
+  int  unmasked = 0;
+  int  late = 0;   // packets coming just before the first unmask
+
+  void interrupt()
+  { napi_schedule(); }
+
+  int napi_rx(int budget) override
+  {
+    rounds++;
+    const int received = std::min(ring, budget);
+    ring -= received;
+    return received;
+  }
+  void napi_irq(bool enable) override
+  {
+    irq_enabled = enable;
+    if (enable) {
+      unmasked++;
+      ring += late;
+      late = 0;
+    }
+  }
+  bool napi_pending() override
+  { return ring > 0; }
+};
+
+CASE("NAPI polls with the interrupt masked until the ring is empty")
+{
+  Napi_nic nic;
+  nic.set_napi_budget(16);
+  nic.ring = 40;
+
+  nic.interrupt();
+  EXPECT(not nic.irq_enabled);
+  // more interrupts while scheduled change nothing
+  nic.interrupt();
+  EXPECT(nic.rounds == 0);
+
+  Events::get().process_events();
+  EXPECT(nic.ring == 0);
+  // 16 + 16 + 8
+  EXPECT(nic.rounds == 3);
+  EXPECT(nic.irq_enabled);
+  EXPECT(nic.unmasked == 1);
+}
+
+CASE("NAPI polls again for packets arriving while masked")
+{
+  Napi_nic nic;
+  nic.set_napi_budget(0);
+  EXPECT(nic.napi_budget() == 1);
+  nic.set_napi_budget(64);
+
+  nic.ring = 1;
+  nic.late = 5;
+  nic.interrupt();
+  Events::get().process_events();
+  EXPECT(nic.ring == 0);
+  EXPECT(nic.rounds == 2);
+  EXPECT(nic.unmasked == 2);
+  EXPECT(nic.irq_enabled);
+}
@@ -39,3 +39,27 @@ CASE("Virtio Queue dequeue")
   EXPECT(res.size() == 0);
   EXPECT(res.data() == nullptr);
 }
+
+CASE("Virtio Queue event index decides when to notify")
+{
+  // moving from 10 to 15 passes an event at 10 to 14, but not 15 or 9
+  EXPECT(Virtio::Queue::need_event(10, 15, 10));
+  EXPECT(Virtio::Queue::need_event(14, 15, 10));
+  EXPECT(not Virtio::Queue::need_event(15, 15, 10));
+  EXPECT(not Virtio::Queue::need_event(9, 15, 10));
+  // the indices wrap around
+  EXPECT(Virtio::Queue::need_event(65535, 2, 65534));
+  EXPECT(not Virtio::Queue::need_event(65533, 2, 65534));
+  // nothing added
+  EXPECT(not Virtio::Queue::need_event(10, 10, 10));
+}
+
+CASE("Virtio Queue interrupts with event index")
+{
+  Virtio::Queue q("Test queue", 256, 0, 0x1000);
+  q.set_event_idx(true);
+  q.disable_interrupts();
+  EXPECT(!q.interrupts_enabled());
+  q.enable_interrupts_delayed();
+  EXPECT(q.interrupts_enabled());
+}
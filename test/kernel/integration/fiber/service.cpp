@@ -2,6 +2,9 @@
 #include <os>
 #include <vector>
 #include <kernel/fiber.hpp>
+#include <kernel/fiber_pool.hpp>
+#include <kernel/memory.hpp>
+#include <timers>
 
 void scheduler1();
 void scheduler2();
@@ -231,6 +234,135 @@ long compute_int() {
   return i;
 }
 
+std::vector<int> pool_order;
+
+void pooled_worker(int id) {
+  for (int i = 0; i < 3; i++) {
+    pool_order.push_back(id);
+    Fiber::yield();
+  }
+}
+
+void parking_worker() {
+  pool_order.push_back(-1);
+  Fiber_pool::park();
+  pool_order.push_back(-2);
+}
+
+// a run of the pool resumes each ready fiber once
+void run_all(Fiber_pool& pool) {
+  while (pool.ready() > 0)
+    pool.run();
+}
+
+void pool_test() {
+  printf("\n============================================== \n");
+  printf("     POOL  - round robin on reused stacks\n");
+  printf("============================================== \n");
+
+  Fiber_pool pool{Fiber::default_stack_size, 4};
+  for (int i = 0; i < 3; i++)
+    pool.spawn(pooled_worker, i);
+  Expects(pool.ready() == 3);
+  pool.run();
+  Expects((pool_order == std::vector<int>{0, 1, 2}));
+  run_all(pool);
+
+  Expects((pool_order == std::vector<int>{0, 1, 2, 0, 1, 2, 0, 1, 2}));
+  Expects(pool.live() == 0);
+  // the workers' stacks, and the scheduler's
+  Expects(pool.cached() == 4);
+
+  pool_order.clear();
+  auto& parked = pool.spawn(parking_worker);
+  pool.run();
+  Expects(pool.live() == 1 and pool.ready() == 0);
+  pool.wake(parked);
+  pool.run();
+  Expects((pool_order == std::vector<int>{-1, -2}));
+  Expects(pool.live() == 0);
+  Expects(pool.cached() == 4);
+
+#if defined(ARCH_x86_64)
+  using namespace util::bitops;
+  // mapped stacks, below each an unmapped guard page
+  auto stack = pool.get_stack();
+  const auto lin = (uintptr_t) stack.get();
+  Expects(os::mem::flags(lin) == (os::mem::Access::read | os::mem::Access::write));
+  Expects(os::mem::flags(lin - 1) == os::mem::Access::none);
+  Expects(os::mem::flags(lin + pool.stack_size()) == os::mem::Access::none);
+#endif
+  INFO("Pool", "Round robin and park / wake OK");
+}
+
+static const int bench_switches = 100000;
+static const int bench_fibers   = 1000;
+
+void ping() {
+  for (int i = 0; i < bench_switches; i++)
+    Fiber::yield();
+}
+
+void nothing() {}
+
+void pool_bench() {
+  printf("\n============================================== \n");
+  printf("     POOL BENCH  - cost of switching fibers\n");
+  printf("============================================== \n");
+
+  Fiber_pool pool;
+  pool.spawn(ping);
+  pool.spawn(ping);
+  auto t0 = os::Arch::cpu_cycles();
+  run_all(pool);
+  auto cycles = os::Arch::cpu_cycles() - t0;
+  // each yield switches to the scheduler, and from it to the other fiber
+  INFO("Pool bench", "%lu cycles per context switch",
+       cycles / (2 * 2 * bench_switches));
+
+  Fiber_pool many{16 * 1024};
+  for (int round = 0; round < 2; round++)
+  {
+    t0 = os::Arch::cpu_cycles();
+    for (int i = 0; i < bench_fibers; i++)
+      many.spawn(nothing);
+    run_all(many);
+    cycles = os::Arch::cpu_cycles() - t0;
+    INFO("Pool bench", "%lu cycles per fiber, %s stacks", cycles / bench_fibers,
+         round == 0 ? "new" : "cached");
+  }
+}
+
+static Fiber_pool* yield_pool = nullptr;
+static bool timer_fired = false;
+static int  spins = 0;
+
+void spinning_worker() {
+  while (not timer_fired) {
+    spins++;
+    Fiber::yield();
+  }
+}
+
+// the event loop, and the timers, run while a fiber keeps yielding
+void pool_yield_test() {
+  printf("\n============================================== \n");
+  printf("     POOL  - yielding until a timer fires\n");
+  printf("============================================== \n");
+
+  yield_pool = new Fiber_pool;
+  yield_pool->spawn(spinning_worker);
+  Timers::oneshot(std::chrono::milliseconds(10), [] (auto) {
+    timer_fired = true;
+    Timers::oneshot(std::chrono::milliseconds(10), [] (auto) {
+      Expects(yield_pool->live() == 0);
+      INFO("Pool", "Fiber yielded %d times until the timer fired", spins);
+      SMP_PRINT("SUCCESS\n");
+      exit(0);
+    });
+  });
+}
+
 void Service::start()
 {
   Expects(Fiber::main() == nullptr);
@@ -292,6 +424,9 @@ void Service::start()
 
   INFO("Service", "Computed long: %li", ret);
 
+  pool_test();
+  pool_bench();
+
 
 #ifdef INCLUDEOS_SMP_ENABLE
   if (SMP::cpu_count() > 1) {
@@ -302,6 +437,5 @@ void Service::start()
   }
 #endif
   SMP_PRINT("Service done. rsp @ %p \n", get_rsp());
-  SMP_PRINT("SUCCESS\n");
-  exit(0);
+  pool_yield_test();
 }
@@ -0,0 +1,91 @@
+
+#include <os>
+#include <smp>
+#include <cassert>
+#include <cstdlib>
+
+// malloc/free throughput on 1 to 32 CPUs, the first one being the BSP.
+// Build the OS with -DPCPU_MALLOC=OFF to measure the musl allocator.
+
+static const int LOCAL_ROUNDS  = 2000;
+static const int REMOTE_ROUNDS = 200;
+static const int BATCH = 64;
+static const size_t SIZES[] { 16, 24, 40, 64, 100, 128, 200, 512, 1000, 4000 };
+
+struct alignas(SMP_ALIGN) Batch
+{
+  std::array<void*, BATCH> ptrs;
+};
+// the batches allocated by each CPU, freed by the next one
+static SMP::Array<Batch> handed;
+static minimal_barrier_t step;
+static minimal_barrier_t done;
+
+static void local_work(int worker, int)
+{
+  Batch batch;
+  for (int r = 0; r < LOCAL_ROUNDS; r++)
+  {
+    for (int i = 0; i < BATCH; i++) {
+      batch.ptrs[i] = malloc(SIZES[(i + r + worker) % std::size(SIZES)]);
+      assert(batch.ptrs[i] != nullptr);
+      *(volatile char*) batch.ptrs[i] = i;
+    }
+    for (auto* ptr : batch.ptrs)
+      free(ptr);
+  }
+}
+
+static void remote_work(int worker, int workers)
+{
+  for (int r = 0; r < REMOTE_ROUNDS; r++)
+  {
+    for (int i = 0; i < BATCH; i++) {
+      handed[worker].ptrs[i] = malloc(SIZES[(i + r + worker) % std::size(SIZES)]);
+      assert(handed[worker].ptrs[i] != nullptr);
+    }
+    step.inc();
+    step.spin_wait(workers * (2 * r + 1));
+    for (auto* ptr : handed[(worker + 1) % workers].ptrs)
+      free(ptr);
+    step.inc();
+    step.spin_wait(workers * (2 * r + 2));
+  }
+}
+
+/** Run the work on the BSP and workers-1 APs, returning the nanoseconds */
+static uint64_t run(int workers, void (*work)(int, int))
+{
+  step.reset(0);
+  done.reset(0);
+  const uint64_t start = os::nanos_since_boot();
+  for (int w = 1; w < workers; w++)
+  {
+    const int cpu = SMP::active_cpus(w);
+    SMP::add_task([w, workers, work] { work(w, workers); done.inc(); }, cpu);
+    SMP::signal(cpu);
+  }
+  work(0, workers);
+  done.inc();
+  done.spin_wait(workers);
+  return os::nanos_since_boot() - start;
+}
+
+void Service::start()
+{
+  const int max_workers = std::min(SMP::cpu_count(), 32);
+  printf("malloc benchmark, batches of %d allocations\n", BATCH);
+
+  for (int workers = 1; workers <= max_workers; workers *= 2)
+  {
+    const double local_ops  = 2.0 * LOCAL_ROUNDS * BATCH * workers;
+    const double remote_ops = 2.0 * REMOTE_ROUNDS * BATCH * workers;
+    const auto local_ns  = run(workers, local_work);
+    const auto remote_ns = run(workers, remote_work);
+    printf("%2d cores: %8.2f Mops/s freeing own, %8.2f Mops/s freeing others'\n",
+           workers, local_ops * 1000.0 / local_ns, remote_ops * 1000.0 / remote_ns);
+  }
+
+  printf("memory used %zu, allocated %zu\n", os::total_memuse(), os::heap_allocated());
+  printf("SUCCESS\n");
+}
@@ -92,6 +92,45 @@ static void random_irq_handler()
   }
 }
 
+// the BSP and idle APs split the range, with the BSP waiting for all
+static void smp_parallel_test()
+{
+  static std::array<int, 1000> values;
+  std::atomic<int> sum {0};
+  SMP::parallel_for(0, values.size(),
+    [&sum] (size_t i) {
+      values[i] = i;
+      sum += i;
+    });
+  assert(sum == 999 * 1000 / 2);
+  for (size_t i = 0; i < values.size(); i++)
+    assert(values[i] == (int) i);
+
+  SMP::global_lock();
+  printf("parallel_for on %d CPUs: sum = %d\n", SMP::cpu_count(), sum.load());
+  SMP::global_unlock();
+}
+
+// every AP posts back what the BSP posts to it
+static void smp_post_test()
+{
+  // fewer than a ring holds, as the BSP only reads replies afterwards
+  static const int MESSAGES = 200;
+  static int replies = 0;
+  for (int i = 0; i < MESSAGES; i++)
+  {
+    const int cpu = SMP::active_cpus(1 + i % (SMP::cpu_count() - 1));
+    while (not SMP::post(cpu,
+      [] {
+        while (not SMP::post(0,
+          [] {
+            if (++replies == MESSAGES)
+              printf("All %d posted messages replied to\n", replies);
+          }));
+      }));
+  }
+}
+
 static const uint8_t IRQ = 110;
 void SMP::init_task()
 {
@@ -120,4 +159,7 @@ void Service::start()
 
   // the rest
   smp_advanced_test();
+  smp_parallel_test();
+  if (SMP::cpu_count() > 1)
+    smp_post_test();
 }
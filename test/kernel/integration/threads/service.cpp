@@ -4,6 +4,7 @@
 #include <pthread.h>
 #include <kernel/threads.hpp>
 #include <thread>
+#include <vector>
 
 struct testdata
 {
@@ -64,6 +65,39 @@ extern "C" {
   }
 }
 
+static std::vector<int> pingpong;
+static void ping_pong(int id)
+{
+  for (int i = 0; i < 3; i++) {
+    pingpong.push_back(id);
+    sched_yield();
+  }
+}
+
+static kernel::Thread_queue waiters;
+static kernel::thread_t* sleeper = nullptr;
+static bool woken = false;
+
+static void block_until_woken()
+{
+  sleeper = kernel::get_thread();
+  lock(waiters.lock);
+  kernel::thread_block(waiters);
+  woken = true;
+}
+
+static kernel::thread_t* migrant = nullptr;
+static int migrant_runs = 0;
+
+static void run_and_yield()
+{
+  migrant = kernel::get_thread();
+  for (int i = 0; i < 2; i++) {
+    migrant_runs++;
+    sched_yield();
+  }
+}
+
 void Service::start()
 {
   int x = 666;
@@ -112,6 +146,78 @@ void Service::start()
     cpp_thread->join();
     delete cpp_thread;
 
+  printf("*** Testing futex timeouts and wakeups...\n");
+  {
+    static pthread_mutex_t cmtx = PTHREAD_MUTEX_INITIALIZER;
+    static pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
+    static bool signalled = false;
+    pthread_mutex_lock(&cmtx);
+    // no one to signal it, so it times out
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 10'000'000;
+    if (ts.tv_nsec >= 1'000'000'000) { ts.tv_sec++; ts.tv_nsec -= 1'000'000'000; }
+    res = pthread_cond_timedwait(&cond, &cmtx, &ts);
+    assert(res == ETIMEDOUT);
+
+    auto* signaller = new std::thread(
+        [] () {
+            pthread_mutex_lock(&cmtx);
+            signalled = true;
+            pthread_cond_signal(&cond);
+            pthread_mutex_unlock(&cmtx);
+        });
+    while (not signalled)
+      pthread_cond_wait(&cond, &cmtx);
+    pthread_mutex_unlock(&cmtx);
+    signaller->join();
+    delete signaller;
+    printf("Timed out, then woken by another thread\n");
+  }
+
+  printf("*** Testing yield ping-pong...\n");
+  {
+    // the main thread blocks in join, leaving the two to take turns
+    std::thread ping(ping_pong, 0);
+    std::thread pong(ping_pong, 1);
+    ping.join();
+    pong.join();
+    assert((pingpong == std::vector<int>{0, 1, 0, 1, 0, 1}));
+    printf("Threads took turns\n");
+  }
+
+  printf("*** Testing block and wake from another thread...\n");
+  {
+    // the new thread runs until it blocks
+    std::thread blocked(block_until_woken);
+    assert(sleeper != nullptr and not woken);
+    lock(waiters.lock);
+    assert(waiters.size == 1 and waiters.head == sleeper);
+    kernel::thread_wake(sleeper);
+    unlock(waiters.lock);
+    assert(waiters.empty());
+    blocked.join();
+    assert(woken);
+    printf("Blocked thread woken by the main thread\n");
+  }
+
+#ifdef INCLUDEOS_SMP_ENABLE
+  if (SMP::cpu_count() > 1)
+  {
+    printf("*** Testing migration and stealing...\n");
+    std::thread worker(run_and_yield);
+    assert(migrant_runs == 1 and migrant->cpu == 0);
+    // onto the run queue of CPU 1, which runs no threads, so
+    // yielding here finds nothing of its own and steals it back
+    migrant->migrate(1);
+    assert(migrant->cpu == 1);
+    sched_yield();
+    assert(migrant_runs == 2);
+    worker.join();
+    printf("Migrated thread stolen back by CPU 0\n");
+  }
+#endif
+
   printf("SUCCESS\n");
   os::shutdown();
 }
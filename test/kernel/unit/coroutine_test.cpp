@@ -0,0 +1,213 @@
+
+#include <common.cxx>
+#include <kernel/coroutine.hpp>
+#include <net/coroutine.hpp>
+#include <stdexcept>
+#include <vector>
+using namespace std::chrono;
+using namespace os::coro;
+
+extern delegate<uint64_t()> systime_override;
+static uint64_t current_time = 0;
+
+// completes when the test says so, or at once when @sync
+struct Fake_op : Completion<Fake_op, int> {
+  static inline std::vector<Fake_op*> pending;
+  bool sync;
+  int  value;
+  Fake_op(bool s, int v) : sync{s}, value{v} {}
+
+  void start()
+  {
+    if (sync) complete(value);
+    else pending.push_back(this);
+  }
+  void finish() { complete(value); }
+};
+
+static void finish_pending()
+{
+  auto ops = std::move(Fake_op::pending);
+  for (auto* op : ops) op->finish();
+}
+
+static Task<int> add(bool sync, int a, int b)
+{
+  int x = co_await Fake_op{sync, a};
+  int y = co_await Fake_op{sync, b};
+  co_return x + y;
+}
+
+static Task<> sum(bool sync, int& result)
+{
+  result = co_await add(sync, 1, 2);
+  result += co_await add(sync, 3, 4);
+}
+
+CASE("Tasks run when spawned, and resume their awaiters")
+{
+  int result = 0;
+  spawn(sum(true, result));
+  EXPECT(result == 10);
+
+  result = 0;
+  spawn(sum(false, result));
+  EXPECT(result == 0);
+  for (int i = 0; i < 4; i++) {
+    EXPECT(Fake_op::pending.size() == 1u);
+    finish_pending();
+  }
+  EXPECT(Fake_op::pending.empty());
+  EXPECT(result == 10);
+}
+
+static Task<int> fail()
+{
+  co_await Fake_op{false, 0};
+  throw std::runtime_error("failed");
+}
+
+static Task<> catch_failure(bool& caught)
+{
+  try {
+    co_await fail();
+  }
+  catch (const std::runtime_error&) {
+    caught = true;
+  }
+}
+
+CASE("Exceptions reach the awaiting task")
+{
+  bool caught = false;
+  spawn(catch_failure(caught));
+  EXPECT(not caught);
+  finish_pending();
+  EXPECT(caught);
+}
+
+CASE("Finished frames go back to the pool of the CPU")
+{
+  auto& pool = Frame_pool::get();
+  void* frame = pool.allocate(100);
+  const int cached = pool.cached(100);
+  pool.deallocate(frame, 100);
+  EXPECT(pool.cached(100) == cached + 1);
+  // the same size class is reused
+  EXPECT(pool.allocate(128) == frame);
+  pool.deallocate(frame, 128);
+
+  // running a task allocates nothing it doesn't give back
+  int result = 0;
+  spawn(sum(true, result));
+  const int after_one = pool.cached(100);
+  spawn(sum(true, result));
+  EXPECT(pool.cached(100) == after_one);
+}
+
+static Task<> sleep_twice(int& woken)
+{
+  co_await sleep(1ms);
+  woken++;
+  co_await sleep(0ms);
+  woken++;
+}
+
+CASE("Sleeping tasks wake up on their timer")
+{
+  systime_override = [] () -> uint64_t { return current_time; };
+  Timers::init([] (Timers::duration_t) {}, [] () {});
+  Timers::ready();
+
+  current_time = 0;
+  int woken = 0;
+  spawn(sleep_twice(woken));
+  EXPECT(woken == 0);
+  Timers::timers_handler();
+  EXPECT(woken == 0);
+  current_time = 1000000;
+  Timers::timers_handler();
+  EXPECT(woken == 2);
+}
+
+// a stream writing what it is told to once the test says so
+struct Test_stream : public net::Stream {
+  ReadCallback  read_cb;
+  CloseCallback close_cb;
+  WriteCallback write_cb;
+  size_t queued = 0;
+  bool   closed = false;
+
+  void on_connect(ConnectCallback) override {}
+  void on_read(size_t, ReadCallback cb) override { read_cb = std::move(cb); }
+  void on_data(DataCallback) override {}
+  size_t next_size() override { return 0; }
+  buffer_t read_next() override { return nullptr; }
+  void on_close(CloseCallback cb) override { close_cb = std::move(cb); }
+  void on_write(WriteCallback cb) override { write_cb = std::move(cb); }
+  void write(const void*, size_t n) override { queued += n; }
+  void write(buffer_t buf) override { queued += buf->size(); }
+  void write(const std::string& str) override { queued += str.size(); }
+  void close() override
+  {
+    closed = true;
+    if (close_cb) close_cb();
+  }
+  void reset_callbacks() override { read_cb.reset(); close_cb.reset(); write_cb.reset(); }
+  net::Socket local() const override { return {}; }
+  net::Socket remote() const override { return {}; }
+  std::string to_string() const override { return "Test_stream"; }
+  bool is_connected() const noexcept override { return not closed; }
+  bool is_writable() const noexcept override { return not closed; }
+  bool is_readable() const noexcept override { return not closed; }
+  bool is_closing() const noexcept override { return closed; }
+  bool is_closed() const noexcept override { return closed; }
+  int get_cpuid() const noexcept override { return 0; }
+  net::Stream* transport() noexcept override { return nullptr; }
+
+  void send(size_t n)
+  {
+    queued -= n;
+    if (write_cb) write_cb(n);
+  }
+};
+
+static Task<> write_twice(net::Stream& stream, std::vector<size_t>& written)
+{
+  const auto buf = net::Stream::construct_buffer(100, 'x');
+  written.push_back(co_await net::coro::write(stream, buf));
+  written.push_back(co_await net::coro::write(stream, buf));
+}
+
+static Task<> read_and_write(net::Stream& stream, std::vector<size_t>& written)
+{
+  net::coro::Reader reader{stream};
+  while (auto buf = co_await reader.read())
+    written.push_back(co_await reader.write(buf));
+  written.push_back(co_await reader.write(net::Stream::construct_buffer(1, 'x')));
+}
+
+CASE("Writes end when the stream closes, with what was written")
+{
+  Test_stream stream;
+  std::vector<size_t> written;
+  spawn(write_twice(stream, written));
+  stream.send(60);
+  stream.send(40);
+  EXPECT(written == std::vector<size_t>{100});
+  stream.send(30);
+  stream.close();
+  EXPECT(written == (std::vector<size_t>{100, 30}));
+  EXPECT(not stream.close_cb);
+
+  // read by a reader, which passes the close on
+  Test_stream echo;
+  written.clear();
+  spawn(read_and_write(echo, written));
+  echo.read_cb(net::Stream::construct_buffer(10, 'y'));
+  echo.send(10);
+  echo.read_cb(net::Stream::construct_buffer(10, 'y'));
+  echo.close();
+  // and nothing is written to the closed stream
+  EXPECT(written == (std::vector<size_t>{10, 0, 0}));
+}
@@ -0,0 +1,102 @@
+
+#include <common.cxx>
+#include <kernel/threads.hpp>
+#include <kernel/timers.hpp>
+#include <cerrno>
+
+using kernel::thread_t;
+
+extern delegate<uint64_t()> systime_override;
+
+// a blocked thread, waiting in place (not switched out)
+static void wait_on(thread_t& thread, int tid, int* addr, uint32_t bitset = ~0u)
+{
+  thread.init(tid);
+  thread.yielded = false;
+  thread.futex.addr   = addr;
+  thread.futex.bitset = bitset;
+  auto& queue = kernel::futex_queue(addr);
+  scoped_spinlock lock(queue.lock);
+  queue.push_back(&thread);
+}
+
+static bool waiting_on(const thread_t& thread, const int* addr)
+{
+  return thread.queue == &kernel::futex_queue(addr)
+     and thread.futex.addr == addr;
+}
+
+CASE("Futex wake matches the address and bitset, up to count")
+{
+  static int futex = 0;
+  static int other = 0;
+  thread_t t[4];
+  wait_on(t[0], 100, &futex, 0x1);
+  wait_on(t[1], 101, &futex, 0x2);
+  wait_on(t[2], 102, &futex, 0x3);
+  wait_on(t[3], 103, &other, 0x1);
+
+  EXPECT(kernel::futex_wake(&futex, 1, 0) == -EINVAL);
+  // the first matching waiter only
+  EXPECT(kernel::futex_wake(&futex, 1, 0x2) == 1);
+  EXPECT(waiting_on(t[0], &futex));
+  EXPECT(t[1].queue == nullptr);
+  EXPECT(waiting_on(t[2], &futex));
+
+  EXPECT(kernel::futex_wake(&futex, 10, 0x1) == 2);
+  EXPECT(t[0].queue == nullptr);
+  EXPECT(t[2].queue == nullptr);
+  // waiting on another address, whatever bucket it is in
+  EXPECT(waiting_on(t[3], &other));
+  EXPECT(kernel::futex_wake(&futex, 10) == 0);
+  EXPECT(kernel::futex_wake(&other, 10) == 1);
+}
+
+CASE("Futex requeue wakes some waiters and moves others")
+{
+  static int futex = 1;
+  static int target = 0;
+  thread_t t[4];
+  for (int i = 0; i < 4; i++) wait_on(t[i], 200 + i, &futex);
+
+  // the value changed since the caller read it
+  const int stale = 0;
+  EXPECT(kernel::futex_requeue(&futex, 1, &target, 1, &stale) == -EAGAIN);
+  EXPECT(waiting_on(t[0], &futex));
+
+  const int current = 1;
+  EXPECT(kernel::futex_requeue(&futex, 1, &target, 2, &current) == 3);
+  EXPECT(t[0].queue == nullptr);
+  EXPECT(waiting_on(t[1], &target));
+  EXPECT(waiting_on(t[2], &target));
+  EXPECT(waiting_on(t[3], &futex));
+
+  // woken through the address they were moved to
+  EXPECT(kernel::futex_wake(&futex, 10) == 1);
+  EXPECT(kernel::futex_wake(&target, 10) == 2);
+  EXPECT(t[1].queue == nullptr);
+  EXPECT(t[2].queue == nullptr);
+}
+
+CASE("Futex timeouts are only stopped on the CPU they are set on")
+{
+  systime_override = [] () -> uint64_t { return 0; };
+  Timers::init([] (Timers::duration_t) {}, [] () {});
+  Timers::ready();
+
+  thread_t thread;
+  thread.init(300);
+  thread.futex.timer_cpu = SMP::cpu_id();
+  thread.futex.timer = Timers::oneshot(std::chrono::seconds(1), [] (auto) {});
+  EXPECT(Timers::active() == 1u);
+  kernel::futex_stop_timer(&thread);
+  EXPECT(thread.futex.timer == Timers::UNUSED_ID);
+  EXPECT(Timers::active() == 0u);
+
+  // left to fire on the other CPU, finding the thread no longer waiting
+  thread.futex.timer_cpu = SMP::cpu_id() + 1;
+  thread.futex.timer = Timers::oneshot(std::chrono::seconds(1), [] (auto) {});
+  kernel::futex_stop_timer(&thread);
+  EXPECT(thread.futex.timer == Timers::UNUSED_ID);
+  EXPECT(Timers::active() == 1u);
+}
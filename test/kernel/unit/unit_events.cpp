@@ -1,6 +1,7 @@
 
 #include <common.cxx>
 #include <kernel/events.hpp>
+#include <statman>
 const int Events::NUM_EVENTS;
 
 static inline auto& manager() {
@@ -109,3 +110,44 @@ CASE("Too many events throws exception")
   // event not subscribed on should throw
   EXPECT_THROWS(manager().unsubscribe(35));
 }
+
+CASE("Higher priority events are handled first")
+{
+  static std::vector<char> order;
+  order.clear();
+  auto low    = manager().subscribe([] { order.push_back('L'); }, Events::PRIO_LOW);
+  auto normal = manager().subscribe([] { order.push_back('N'); });
+  static uint8_t high;
+  static int again = 1;
+  high = manager().subscribe(
+    [] {
+      order.push_back('H');
+      // triggered again while handled: waits for the next round
+      if (again-- > 0) manager().trigger_event(high);
+    }, Events::PRIO_HIGH);
+
+  manager().trigger_event(low);
+  manager().trigger_event(normal);
+  manager().trigger_event(high);
+  EXPECT(manager().process_events());
+  EXPECT((order == std::vector<char>{'H', 'N', 'L', 'H'}));
+  EXPECT(not manager().process_events());
+
+  manager().unsubscribe(low);
+  manager().unsubscribe(normal);
+  manager().unsubscribe(high);
+}
+
+CASE("Events count in Statman")
+{
+  auto evt = manager().subscribe([] { });
+  const auto name = "cpu0.events." + std::to_string(evt) + ".count";
+  auto& count = Statman::get().get_by_name(name.c_str()).get_uint64();
+  const auto before = count;
+  manager().trigger_event(evt);
+  // triggered twice before being handled, handled once
+  manager().trigger_event(evt);
+  manager().process_events();
+  EXPECT(count == before + 1);
+  manager().unsubscribe(evt);
+}
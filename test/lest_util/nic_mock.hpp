@@ -116,6 +116,7 @@ public:
   void transmit(net::Packet_ptr pkt)
   {
     NIC_INFO("transimtting packet");
+    packets_tx_++;
     //tx_queue_.emplace_back(std::move(ptr));
   }
 
@@ -129,6 +130,11 @@ public:
     }
   }
 
+  void receive_vlan(net::Packet_ptr ptr)
+  {
+    if (vlan_handler_) vlan_handler_(std::move(ptr));
+  }
+
   void flush() override {}
   void poll() override {}
 
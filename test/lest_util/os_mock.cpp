@@ -182,11 +182,22 @@ uint32_t __arch_rand32()
 int SMP::cpu_id() noexcept {
   return 0;
 }
+int SMP::cpu_count() noexcept {
+  return 1;
+}
 void SMP::global_lock() noexcept {}
 void SMP::global_unlock() noexcept {}
 void SMP::add_task(SMP::task_func func, int) { func(); }
 void SMP::signal(int) {}
 
+/// threads ///
+extern "C" {
+  void __thread_yield() {}
+  void __thread_restore(void*, void*, bool*) {}
+  void __clone_return(void*, void*, bool*) {}
+  long syscall_SYS_set_thread_area(void*) { return 0; }
+}
+
 extern "C"
 void (*current_eoi_mechanism) () = nullptr;
 
@@ -0,0 +1,40 @@
+#include <service>
+#include <net/https/openssl_server.hpp>
+#include <net/interfaces>
+#include <info>
+#include <smp>
+
+static const int CLIENTS = 16;
+
+std::unique_ptr<http::OpenSSL_server> server_;
+static int requests = 0;
+
+void Service::start()
+{
+  auto& inet = net::Interfaces::get(0);
+  inet.network_config(
+    {  10,  0,  0, 46 },  // IP
+    {  255,255,255, 0 },  // Netmask
+    {  10,  0,  0,  1 },  // Gateway
+    {  8,  8,  8,  8 }   // DNS
+  );
+
+  using namespace http;
+
+  server_ = std::make_unique<OpenSSL_server>("/test.pem", "/test.key", inet.tcp());
+  server_->offload_handshakes(true);
+  INFO("Server", "Offloading handshakes over %d CPUs", SMP::cpu_count());
+
+  server_->on_request([] (Request_ptr req, Response_writer_ptr writer)
+  {
+    writer->header().set_field(header::Content_Type, "text/plain");
+    writer->header().set_field(header::Connection, "close");
+    writer->write(std::string(req->uri().path()));
+
+    if (++requests == CLIENTS)
+      printf("SUCCESS\n");
+  });
+
+  server_->listen(443);
+  printf("Listening on port 443\n");
+}
@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+
+from builtins import str
+import sys
+import os
+import ssl
+import threading
+import urllib.request
+
+from vmrunner import vmrunner
+
+CLIENTS = 16
+
+def fetch(i, results):
+    context = ssl.create_default_context()
+    context.check_hostname = False
+    context.verify_mode = ssl.CERT_NONE
+    url = "https://10.0.0.46/client" + str(i)
+    results[i] = urllib.request.urlopen(url, context=context, timeout=10).read()
+
+def Server_test(triggerline):
+    # the handshakes all start before any of them is done
+    results = [None] * CLIENTS
+    threads = [threading.Thread(target=fetch, args=(i, results)) for i in range(CLIENTS)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    for i in range(CLIENTS):
+        assert(results[i] == ("/client" + str(i)).encode("utf-8"))
+
+# Get an auto-created VM from the vmrunner
+vm = vmrunner.vms[0]
+
+# Add custom event for testing server
+vm.on_output("Listening on port 443", Server_test)
+
+if len(sys.argv) > 1:
+    vm.boot(image_name=str(sys.argv[1]))
+else:
+    # Boot the VM, taking a timeout as parameter
+    vm.cmake().boot(30,image_name='net_https').clean()
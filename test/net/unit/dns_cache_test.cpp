@@ -0,0 +1,166 @@
+
+#include <common.cxx>
+#include <net/dns/cache.hpp>
+#include <net/dns/query.hpp>
+
+using namespace net;
+using namespace net::dns;
+
+///
+/// A response to a query, with records added to it
+///
+struct Response_builder
+{
+  std::vector<char> data;
+  size_t answers = 0, auth = 0;
+
+  Response_builder(const std::string& name, Record_type rtype, Response_code rcode)
+    : data(512)
+  {
+    Query query{1, name, rtype};
+    data.resize(query.write(data.data()));
+    auto& hdr = header();
+    hdr.qr = DNS_QR_RESPONSE;
+    hdr.rcode = static_cast<uint8_t>(rcode);
+  }
+
+  Header& header()
+  { return *(Header*) data.data(); }
+
+  // the name as a pointer to the one in the question
+  void add(Record_type rtype, uint32_t ttl, const std::string& rdata, bool authority = false)
+  {
+    data.push_back((char) 0xc0);
+    data.push_back((char) sizeof(Header));
+    rr_data rr {htons((uint16_t) rtype), htons(DNS_CLASS_INET), htonl(ttl), htons((uint16_t) rdata.size())};
+    data.insert(data.end(), (char*) &rr, (char*) &rr + sizeof(rr));
+    data.insert(data.end(), rdata.begin(), rdata.end());
+    if (authority) header().auth_count = htons(++auth);
+    else header().ans_count = htons(++answers);
+  }
+
+  Response parse() const
+  {
+    Response res;
+    res.parse(data.data(), data.size());
+    return res;
+  }
+};
+
+static std::string soa_rdata(uint32_t minimum)
+{
+  // two root names, then serial, refresh, retry, expire and minimum
+  std::string rdata(2, '\0');
+  const uint32_t fields[] {htonl(1), htonl(2), htonl(3), htonl(4), htonl(minimum)};
+  rdata.append((const char*) fields, sizeof(fields));
+  return rdata;
+}
+
+CASE("DNS cache keeps addresses for the shortest TTL of the answer")
+{
+  Response_builder builder{"www.includeos.org", Record_type::A, Response_code::NO_ERROR};
+  builder.add(Record_type::ALIAS, 300, std::string("\3www\0", 5));
+  builder.add(Record_type::A, 120, std::string("\x0a\x00\x00\x01", 4));
+  builder.add(Record_type::A, 60, std::string("\x0a\x00\x00\x02", 4));
+  const auto res = builder.parse();
+  EXPECT(res.answers.size() == 3u);
+  EXPECT(res.answers.at(1).name == "www.includeos.org");
+
+  Cache cache;
+  const auto* entry = cache.insert("www.includeos.org", Record_type::A, res, 1000);
+  EXPECT(entry != nullptr);
+  EXPECT(not entry->negative());
+  EXPECT(entry->ttl == 60u);
+  EXPECT(entry->count() == 2u);
+  EXPECT(entry->address(1) == net::Addr(10,0,0,2));
+
+  // names are case insensitive, and types apart
+  EXPECT(cache.lookup("WWW.IncludeOS.org", Record_type::A, 1030) == entry);
+  EXPECT(cache.lookup("www.includeos.org", Record_type::AAAA, 1030) == nullptr);
+
+  auto cached = Cache::make_response("www.includeos.org", *entry, 1030);
+  EXPECT(cached->answers.size() == 2u);
+  EXPECT(cached->answers.front().ttl == 30u);
+  EXPECT(cached->get_first_ipv4() == ip4::Addr(10,0,0,1));
+
+  EXPECT(cache.lookup("www.includeos.org", Record_type::A, 1060) == nullptr);
+  EXPECT(cache.empty());
+
+  // capped by the max TTL
+  cache.set_max_ttl(10);
+  EXPECT(cache.insert("www.includeos.org", Record_type::A, res, 1000)->ttl == 10u);
+}
+
+CASE("DNS cache keeps AAAA records apart from A records")
+{
+  Response_builder builder{"includeos.org", Record_type::AAAA, Response_code::NO_ERROR};
+  const ip6::Addr addr{0xfe80, 0, 0, 0, 0, 0, 0, 1};
+  builder.add(Record_type::AAAA, 100, std::string((const char*) &addr, sizeof(addr)));
+
+  Cache cache;
+  const auto* entry = cache.insert("includeos.org", Record_type::AAAA, builder.parse(), 0);
+  EXPECT(entry != nullptr);
+  EXPECT(entry->count() == 1u);
+  EXPECT(entry->address(0).v6() == addr);
+  EXPECT(Cache::make_response("includeos.org", *entry, 0)->get_first_ipv6() == addr);
+  // not an answer to A
+  EXPECT(cache.insert("includeos.org", Record_type::A, builder.parse(), 0) == nullptr);
+  EXPECT(cache.size() == 1u);
+}
+
+CASE("DNS cache keeps negative answers for the TTL of the SOA")
+{
+  Response_builder nxdomain{"nothing.includeos.org", Record_type::A, Response_code::NAME_ERROR};
+  nxdomain.add(Record_type::SOA, 600, soa_rdata(90), true);
+  const auto res = nxdomain.parse();
+  EXPECT(res.rcode == Response_code::NAME_ERROR);
+  EXPECT(res.auth.size() == 1u);
+  EXPECT(res.auth.front().soa_minimum() == 90u);
+
+  Cache cache;
+  const auto* entry = cache.insert("nothing.includeos.org", Record_type::A, res, 0);
+  EXPECT(entry != nullptr);
+  EXPECT(entry->negative());
+  EXPECT(entry->ttl == 90u);
+  auto cached = Cache::make_response("nothing.includeos.org", *entry, 10);
+  EXPECT(cached->rcode == Response_code::NAME_ERROR);
+  EXPECT(not cached->has_addr());
+
+  // no data, limited by the max negative TTL
+  Response_builder nodata{"includeos.org", Record_type::AAAA, Response_code::NO_ERROR};
+  nodata.add(Record_type::SOA, 3600, soa_rdata(86400), true);
+  cache.set_max_negative_ttl(300);
+  entry = cache.insert("includeos.org", Record_type::AAAA, nodata.parse(), 0);
+  EXPECT(entry->negative());
+  EXPECT(entry->ttl == 300u);
+
+  // not without a SOA, nor failures
+  Response_builder no_soa{"x.includeos.org", Record_type::A, Response_code::NAME_ERROR};
+  EXPECT(cache.insert("x.includeos.org", Record_type::A, no_soa.parse(), 0) == nullptr);
+  Response_builder failure{"x.includeos.org", Record_type::A, Response_code::SERVER_FAIL};
+  failure.add(Record_type::SOA, 600, soa_rdata(90), true);
+  EXPECT(cache.insert("x.includeos.org", Record_type::A, failure.parse(), 0) == nullptr);
+
+  cache.flush_expired(91);
+  EXPECT(cache.size() == 1u);
+}
+
+CASE("DNS cache prefetches entries hit in the last tenth of their TTL")
+{
+  Response_builder builder{"includeos.org", Record_type::A, Response_code::NO_ERROR};
+  builder.add(Record_type::A, 100, std::string("\x0a\x00\x00\x01", 4));
+  Cache cache;
+  cache.insert("includeos.org", Record_type::A, builder.parse(), 0);
+
+  const auto* entry = cache.lookup("includeos.org", Record_type::A, 10);
+  EXPECT(not Cache::should_prefetch(*entry, 10));
+  entry = cache.lookup("includeos.org", Record_type::A, 85);
+  EXPECT(not Cache::should_prefetch(*entry, 85));
+  entry = cache.lookup("includeos.org", Record_type::A, 95);
+  EXPECT(Cache::should_prefetch(*entry, 95));
+
+  // refreshed
+  entry = cache.insert("includeos.org", Record_type::A, builder.parse(), 95);
+  EXPECT(entry->hits == 0u);
+  EXPECT(cache.lookup("includeos.org", Record_type::A, 150) != nullptr);
+}
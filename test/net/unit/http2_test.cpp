@@ -0,0 +1,342 @@
+
+#include <common.cxx>
+#include <net/http/http2.hpp>
+
+using namespace http;
+using namespace http::h2;
+
+///
+/// A client talking to a Session, collecting the frames sent back
+///
+struct Client {
+  struct Frame {
+    Frame_header hdr;
+    std::string  payload;
+  };
+
+  std::string  out;
+  std::vector<std::pair<uint32_t, Request_ptr>> requests;
+  Session      session;
+  hpack::Encoder encoder;
+  hpack::Decoder decoder;
+
+  Client(const Settings& settings = {})
+    : session{{this, &Client::on_write}, {this, &Client::on_request}, settings}
+  {}
+
+  void on_write(Session::buffer_t buf)
+  { out.append(buf->begin(), buf->end()); }
+
+  void on_request(uint32_t id, Request_ptr req)
+  { requests.emplace_back(id, std::move(req)); }
+
+  static std::string frame(Frame_type type, uint8_t flags, uint32_t id, const std::string& payload = {})
+  {
+    uint8_t hdr[Frame_header::SIZE];
+    Frame_header{static_cast<uint32_t>(payload.size()), type, flags, id}.serialize(hdr);
+    return std::string{reinterpret_cast<char*>(hdr), sizeof(hdr)} + payload;
+  }
+
+  std::string headers(uint32_t id, const std::string& method, const std::string& path, bool end_stream)
+  {
+    std::string block;
+    encoder.encode(":method", method, block);
+    encoder.encode(":scheme", "https", block);
+    encoder.encode(":path", path, block);
+    encoder.encode(":authority", "includeos.org", block);
+    encoder.encode("user-agent", "test", block);
+    return frame(Frame_type::HEADERS, flag::END_HEADERS | (end_stream ? flag::END_STREAM : 0), id, block);
+  }
+
+  bool connect()
+  {
+    return session.receive(std::string{PREFACE} + frame(Frame_type::SETTINGS, 0, 0));
+  }
+
+  // frames sent by the session since last time
+  std::vector<Frame> frames()
+  {
+    std::vector<Frame> result;
+    size_t pos = 0;
+    while (out.size() - pos >= Frame_header::SIZE) {
+      auto hdr = Frame_header::parse(reinterpret_cast<const uint8_t*>(out.data() + pos));
+      result.push_back({hdr, out.substr(pos + Frame_header::SIZE, hdr.length)});
+      pos += Frame_header::SIZE + hdr.length;
+    }
+    out.clear();
+    return result;
+  }
+};
+
+static Response make_ok(const std::string& body)
+{
+  Response res;
+  res.set_status_code(OK);
+  res.header().set_field(header::Content_Type, "text/plain");
+  res.header().set_field(header::Connection, "keep-alive");
+  res.set_content_length(body.size());
+  return res;
+}
+
+CASE("HTTP/2 session exchanges SETTINGS and handles a request")
+{
+  Client client;
+  EXPECT(client.connect());
+
+  auto frames = client.frames();
+  EXPECT(frames.size() == 2u);
+  EXPECT(frames[0].hdr.type == Frame_type::SETTINGS);
+  EXPECT(frames[0].hdr.flags == 0);
+  EXPECT(frames[1].hdr.type == Frame_type::SETTINGS);
+  EXPECT(frames[1].hdr.flags == flag::ACK);
+
+  EXPECT(client.session.receive(client.headers(1, "GET", "/index.html", true)));
+  EXPECT(client.requests.size() == 1u);
+  auto& req = *client.requests[0].second;
+  EXPECT(client.requests[0].first == 1u);
+  EXPECT(req.method() == GET);
+  EXPECT(req.uri().path() == "/index.html");
+  EXPECT(req.version() == Version(2, 0));
+  EXPECT(req.header().value(header::Host) == "includeos.org");
+  EXPECT(req.header().value(header::User_Agent) == "test");
+
+  const std::string body {"Hello HTTP/2"};
+  client.session.send_headers(1, make_ok(body));
+  client.session.send_data(1, reinterpret_cast<const uint8_t*>(body.data()), body.size());
+  EXPECT(client.session.open_streams() == 0u);
+
+  frames = client.frames();
+  EXPECT(frames.size() == 2u);
+  EXPECT(frames[0].hdr.type == Frame_type::HEADERS);
+  EXPECT(frames[0].hdr.flags == flag::END_HEADERS);
+  std::vector<hpack::Field> fields;
+  EXPECT(client.decoder.decode(frames[0].payload, fields));
+  EXPECT(fields[0] == hpack::Field(":status", "200"));
+  // connection specific fields are dropped, names are lowercase
+  for (auto& field : fields) EXPECT(field.first != "connection");
+  EXPECT(fields.size() == 3u);
+
+  EXPECT(frames[1].hdr.type == Frame_type::DATA);
+  EXPECT(frames[1].hdr.flags == flag::END_STREAM);
+  EXPECT(frames[1].payload == body);
+}
+
+CASE("HTTP/2 session ends a stream only when told, without a Content-Length")
+{
+  Client client;
+  EXPECT(client.connect());
+  EXPECT(client.session.receive(client.headers(1, "GET", "/stream", true)));
+  client.frames();
+
+  Response res;
+  res.set_status_code(OK);
+  client.session.send_headers(1, res);
+  const std::string part {"part"};
+  for (int i = 0; i < 2; i++)
+    client.session.send_data(1, reinterpret_cast<const uint8_t*>(part.data()), part.size());
+  EXPECT(client.session.open_streams() == 1u);
+
+  auto frames = client.frames();
+  EXPECT(frames.size() == 3u);
+  EXPECT(frames[0].hdr.flags == flag::END_HEADERS);
+  EXPECT(frames[1].payload == part);
+  EXPECT(frames[2].hdr.flags == 0);
+
+  client.session.end_stream(1);
+  frames = client.frames();
+  EXPECT(frames.size() == 1u);
+  EXPECT(frames[0].hdr.type == Frame_type::DATA);
+  EXPECT(frames[0].hdr.flags == flag::END_STREAM);
+  EXPECT(client.session.open_streams() == 0u);
+
+  // a complete response without a body ends with its HEADERS
+  EXPECT(client.session.receive(client.headers(3, "GET", "/empty", true)));
+  client.frames();
+  res.set_status_code(No_Content);
+  client.session.send_headers(3, res, true);
+  frames = client.frames();
+  EXPECT(frames.size() == 1u);
+  EXPECT(frames[0].hdr.flags == (flag::END_HEADERS | flag::END_STREAM));
+  EXPECT(client.session.open_streams() == 0u);
+}
+
+CASE("HTTP/2 session collects request bodies and CONTINUATION")
+{
+  Client client;
+  EXPECT(client.connect());
+  client.frames();
+
+  // header block split in two
+  auto hdrs = client.headers(3, "POST", "/submit", false);
+  auto block = hdrs.substr(Frame_header::SIZE);
+  std::string data = Client::frame(Frame_type::HEADERS, 0, 3, block.substr(0, 5))
+    + Client::frame(Frame_type::CONTINUATION, flag::END_HEADERS, 3, block.substr(5))
+    + Client::frame(Frame_type::DATA, 0, 3, "hello=")
+    + Client::frame(Frame_type::DATA, flag::END_STREAM, 3, "world");
+
+  // arriving a few bytes at a time
+  for (size_t i = 0; i < data.size(); i += 7)
+    EXPECT(client.session.receive(data.substr(i, 7)));
+
+  EXPECT(client.requests.size() == 1u);
+  EXPECT(client.requests[0].second->method() == POST);
+  EXPECT(client.requests[0].second->body() == "hello=world");
+}
+
+CASE("HTTP/2 session respects flow control windows")
+{
+  Client client;
+  EXPECT(client.connect());
+  EXPECT(client.session.receive(client.headers(1, "GET", "/big", true)));
+  client.frames();
+
+  const std::string body(100000, 'x');
+  client.session.send_headers(1, make_ok(body));
+  client.session.send_data(1, reinterpret_cast<const uint8_t*>(body.data()), body.size());
+
+  size_t sent = 0;
+  for (auto& frame : client.frames())
+    if (frame.hdr.type == Frame_type::DATA) {
+      EXPECT(frame.payload.size() <= Settings::MIN_FRAME_SIZE);
+      sent += frame.payload.size();
+    }
+  EXPECT(sent == Settings::DEFAULT_WINDOW_SIZE);
+  EXPECT(client.session.send_window() == 0);
+
+  // open both windows
+  std::string increment {"\x00\x01\x00\x00", 4};
+  EXPECT(client.session.receive(Client::frame(Frame_type::WINDOW_UPDATE, 0, 0, increment)
+                              + Client::frame(Frame_type::WINDOW_UPDATE, 0, 1, increment)));
+  auto frames = client.frames();
+  for (auto& frame : frames) sent += frame.payload.size();
+  EXPECT(sent == body.size());
+  EXPECT(frames.back().hdr.flags == flag::END_STREAM);
+  EXPECT(client.session.open_streams() == 0u);
+}
+
+CASE("HTTP/2 session answers PING and rejects protocol errors")
+{
+  Client client;
+  EXPECT(client.connect());
+  client.frames();
+
+  EXPECT(client.session.receive(Client::frame(Frame_type::PING, 0, 0, "12345678")));
+  auto frames = client.frames();
+  EXPECT(frames.size() == 1u);
+  EXPECT(frames[0].hdr.flags == flag::ACK);
+  EXPECT(frames[0].payload == "12345678");
+
+  // malformed request: uppercase field name gets the stream reset
+  std::string block;
+  client.encoder.encode(":method", "GET", block);
+  client.encoder.encode(":scheme", "https", block);
+  client.encoder.encode(":path", "/", block);
+  client.encoder.encode("Bad", "1", block);
+  EXPECT(client.session.receive(Client::frame(Frame_type::HEADERS, flag::END_HEADERS | flag::END_STREAM, 1, block)));
+  frames = client.frames();
+  EXPECT(frames.size() == 1u);
+  EXPECT(frames[0].hdr.type == Frame_type::RST_STREAM);
+  EXPECT(client.requests.empty());
+
+  // even stream ids are not for clients
+  EXPECT(not client.session.receive(client.headers(2, "GET", "/", true)));
+  frames = client.frames();
+  EXPECT(frames.back().hdr.type == Frame_type::GOAWAY);
+  EXPECT(client.session.closing());
+}
+
+CASE("HTTP/2 session serves heavier streams first")
+{
+  Client client;
+  EXPECT(client.connect());
+  EXPECT(client.session.receive(client.headers(1, "GET", "/light", true)));
+  EXPECT(client.session.receive(client.headers(3, "GET", "/heavy", true)));
+  // weight 256 for stream 3
+  std::string priority {"\x00\x00\x00\x00\xff", 5};
+  EXPECT(client.session.receive(Client::frame(Frame_type::PRIORITY, 0, 3, priority)));
+  client.frames();
+
+  // fill the connection window, then let both compete for more
+  const std::string body(40000, 'x');
+  for (uint32_t id : {1u, 3u}) {
+    client.session.send_headers(id, make_ok(body));
+    client.session.send_data(id, reinterpret_cast<const uint8_t*>(body.data()), body.size());
+  }
+  client.frames();
+  std::string increment {"\x00\x00\x40\x00", 4};
+  EXPECT(client.session.receive(Client::frame(Frame_type::WINDOW_UPDATE, 0, 0, increment)));
+
+  size_t light = 0, heavy = 0;
+  for (auto& frame : client.frames()) {
+    if (frame.hdr.type not_eq Frame_type::DATA) continue;
+    (frame.hdr.stream_id == 1 ? light : heavy) += frame.payload.size();
+  }
+  EXPECT(heavy > light);
+}
+
+CASE("HTTP/2 session opens the connection window as configured")
+{
+  Settings settings;
+  settings.initial_window_size = 1 << 20;
+  Client client{settings};
+  EXPECT(client.connect());
+  auto frames = client.frames();
+  EXPECT(frames.size() == 3u);
+  EXPECT(frames[1].hdr.type == Frame_type::WINDOW_UPDATE);
+  EXPECT(frames[1].hdr.stream_id == 0u);
+  EXPECT(frames[1].payload == std::string("\x00\x0f\x00\x01", 4));
+
+  // more than the default window is accepted on the connection
+  EXPECT(client.session.receive(client.headers(1, "POST", "/upload", false)));
+  const std::string chunk(Settings::MIN_FRAME_SIZE, 'x');
+  for (int i = 0; i < 6; i++)
+    EXPECT(client.session.receive(Client::frame(Frame_type::DATA, 0, 1, chunk)));
+  EXPECT(not client.session.closing());
+}
+
+CASE("HTTP/2 session holds a stream back until all it depends on is sent")
+{
+  Client client;
+  EXPECT(client.connect());
+  for (uint32_t id : {1u, 3u, 5u})
+    EXPECT(client.session.receive(client.headers(id, "GET", "/", true)));
+  // 5 depends on 3, which depends on 1
+  EXPECT(client.session.receive(Client::frame(Frame_type::PRIORITY, 0, 3, std::string{"\x00\x00\x00\x01\x0f", 5})));
+  EXPECT(client.session.receive(Client::frame(Frame_type::PRIORITY, 0, 5, std::string{"\x00\x00\x00\x03\x0f", 5})));
+  client.frames();
+
+  // stream 1 fills the connection window, and more is queued
+  const std::string big(100000, 'x');
+  client.session.send_headers(1, make_ok(big));
+  client.session.send_data(1, reinterpret_cast<const uint8_t*>(big.data()), big.size());
+  const std::string body(100, 'y');
+  client.session.send_headers(5, make_ok(body));
+  client.session.send_data(5, reinterpret_cast<const uint8_t*>(body.data()), body.size());
+  client.frames();
+  // stream 3 has nothing to send, but its parent has
+  std::string increment {"\x00\x00\x10\x00", 4};
+  EXPECT(client.session.receive(Client::frame(Frame_type::WINDOW_UPDATE, 0, 0, increment)));
+  for (auto& frame : client.frames())
+    EXPECT(frame.hdr.stream_id not_eq 5u);
+}
+
+CASE("HTTP/2 session resets streams above the last one of a GOAWAY")
+{
+  Client client;
+  EXPECT(client.connect());
+  for (uint32_t id : {1u, 3u, 5u})
+    EXPECT(client.session.receive(client.headers(id, "GET", "/", true)));
+  client.frames();
+  EXPECT(client.session.open_streams() == 3u);
+
+  std::string payload {"\x00\x00\x00\x01\x00\x00\x00\x00", 8};
+  EXPECT(client.session.receive(Client::frame(Frame_type::GOAWAY, 0, 0, payload)));
+  EXPECT(client.session.closing());
+  EXPECT(client.session.open_streams() == 1u);
+  auto frames = client.frames();
+  EXPECT(frames.size() == 2u);
+  for (auto& frame : frames) {
+    EXPECT(frame.hdr.type == Frame_type::RST_STREAM);
+    EXPECT(frame.hdr.stream_id > 1u);
+  }
+}
@@ -0,0 +1,99 @@
+
+#include <common.cxx>
+#include <nic_mock.hpp>
+#include <net/inet>
+#include <net/http/basic_client.hpp>
+
+static uint64_t my_time = 0;
+
+static uint64_t get_time()
+{ return my_time; }
+
+#include <delegate>
+extern delegate<uint64_t()> systime_override;
+
+using namespace http;
+using namespace std::chrono;
+
+///
+/// A client with secured connections, over plain TCP
+///
+struct Test_client : public Basic_client {
+  explicit Test_client(TCP& tcp) : Basic_client(tcp, nullptr, true) {}
+
+  Connection::Stream_ptr connect_secure(const Host host) override
+  { return std::make_unique<net::tcp::Stream>(tcp_.connect(host)); }
+};
+
+static const Basic_client::Host host {net::ip4::Addr{10,0,0,2}, 443};
+
+static void setup(net::Inet& inet)
+{
+  systime_override = get_time;
+  my_time = 1000 * 1'000'000'000ull;
+  Timers::init([] (Timers::duration_t) {}, [] () {});
+  Timers::ready();
+  inet.network_config({10,0,0,1}, {255,255,255,0}, {10,0,0,1});
+}
+
+CASE("HTTP client pools plain and secured connections apart")
+{
+  Nic_mock nic;
+  net::Inet inet{nic};
+  setup(inet);
+  Test_client client{inet.tcp()};
+  client.set_max_connections(1);
+
+  int responses = 0;
+  const auto on_response = [&responses] (Error, Response_ptr, Connection&) { responses++; };
+
+  client.request(GET, host, "/plain", {}, on_response, false);
+  EXPECT(client.connection_count(host, false) == 1u);
+
+  // the plain connection to the same host and port is not used for it
+  client.request(GET, host, "/secure", {}, on_response, true);
+  EXPECT(client.connection_count(host, true) == 1u);
+  EXPECT(client.queued_count(host, true) == 0u);
+
+  // but waits for the one secured connection allowed
+  client.request(GET, host, "/secure2", {}, on_response, true);
+  EXPECT(client.connection_count(host, true) == 1u);
+  EXPECT(client.queued_count(host, true) == 1u);
+  EXPECT(client.queued_count(host, false) == 0u);
+  EXPECT(responses == 0);
+}
+
+CASE("HTTP client times out requests waiting for a connection")
+{
+  Nic_mock nic;
+  net::Inet inet{nic};
+  setup(inet);
+  Basic_client client{inet.tcp()};
+  client.set_max_connections(1);
+
+  Basic_client::Options busy;
+  busy.timeout = seconds(10);
+  client.request(GET, host, "/busy", {}, [] (Error, Response_ptr, Connection&) {}, false, busy);
+
+  Error error;
+  int responses = 0;
+  Basic_client::Options options;
+  options.timeout = milliseconds(100);
+  client.request(GET, host, "/waiting", {}, [&] (Error err, Response_ptr res, Connection&) {
+    responses++;
+    error = err;
+    EXPECT(res == nullptr);
+  }, false, options);
+  EXPECT(client.queued_count(host) == 1u);
+
+  my_time += duration_cast<nanoseconds>(milliseconds(50)).count();
+  Timers::timers_handler();
+  EXPECT(responses == 0);
+
+  my_time += duration_cast<nanoseconds>(milliseconds(50)).count();
+  Timers::timers_handler();
+  EXPECT(responses == 1);
+  EXPECT(error.timeout());
+  EXPECT(client.queued_count(host) == 0u);
+  EXPECT(client.connection_count(host) == 1u);
+}
@@ -0,0 +1,142 @@
+
+#include <common.cxx>
+#include <net/http/hpack.hpp>
+
+using namespace http::hpack;
+
+static std::string from_hex(const std::string& hex)
+{
+  std::string out;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2)
+    out.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+  return out;
+}
+
+CASE("HPACK integers use an N-bit prefix (RFC 7541 C.1)")
+{
+  std::string out;
+  encode_integer(10, 5, 0, out);
+  EXPECT(out == from_hex("0a"));
+
+  out.clear();
+  encode_integer(1337, 5, 0, out);
+  EXPECT(out == from_hex("1f9a0a"));
+
+  const auto* p = reinterpret_cast<const uint8_t*>(out.data());
+  uint64_t value = 0;
+  EXPECT(decode_integer(p, p + out.size(), 5, value));
+  EXPECT(value == 1337u);
+
+  // truncated
+  p = reinterpret_cast<const uint8_t*>(out.data());
+  EXPECT(not decode_integer(p, p + 2, 5, value));
+}
+
+CASE("HPACK Huffman code round trips and rejects bad padding")
+{
+  const std::string text {"www.example.com"};
+  std::string coded;
+  huffman::encode(text, coded);
+  EXPECT(coded == from_hex("f1e3c2e5f23a6ba0ab90f4ff"));
+  EXPECT(huffman::encoded_length(text) == coded.size());
+
+  std::string decoded;
+  EXPECT(huffman::decode(reinterpret_cast<const uint8_t*>(coded.data()), coded.size(), decoded));
+  EXPECT(decoded == text);
+
+  std::string all;
+  for (int c = 0; c < 256; c++) all.push_back(static_cast<char>(c));
+  coded.clear();
+  decoded.clear();
+  huffman::encode(all, coded);
+  EXPECT(huffman::decode(reinterpret_cast<const uint8_t*>(coded.data()), coded.size(), decoded));
+  EXPECT(decoded == all);
+
+  // padding must be ones
+  const uint8_t zeros[] {0xf1, 0xe0};
+  decoded.clear();
+  EXPECT(not huffman::decode(zeros, sizeof(zeros), decoded));
+}
+
+CASE("HPACK decodes requests with Huffman coding (RFC 7541 C.4)")
+{
+  Decoder decoder;
+  std::vector<Field> fields;
+
+  EXPECT(decoder.decode(from_hex("828684418cf1e3c2e5f23a6ba0ab90f4ff"), fields));
+  EXPECT(fields.size() == 4u);
+  EXPECT(fields[0] == Field(":method", "GET"));
+  EXPECT(fields[3] == Field(":authority", "www.example.com"));
+  EXPECT(decoder.table().size() == 57u);
+
+  fields.clear();
+  EXPECT(decoder.decode(from_hex("828684be5886a8eb10649cbf"), fields));
+  EXPECT(fields.size() == 5u);
+  EXPECT(fields[3] == Field(":authority", "www.example.com"));
+  EXPECT(fields[4] == Field("cache-control", "no-cache"));
+  EXPECT(decoder.table().size() == 110u);
+
+  fields.clear();
+  EXPECT(decoder.decode(from_hex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"), fields));
+  EXPECT(fields.size() == 5u);
+  EXPECT(fields[1] == Field(":scheme", "https"));
+  EXPECT(fields[2] == Field(":path", "/index.html"));
+  EXPECT(fields[4] == Field("custom-key", "custom-value"));
+  EXPECT(decoder.table().count() == 3u);
+  EXPECT(decoder.table().size() == 164u);
+}
+
+CASE("HPACK rejects invalid indexes and late table size updates")
+{
+  Decoder decoder;
+  std::vector<Field> fields;
+  // index 0, and past the end of the tables
+  EXPECT(not decoder.decode(from_hex("80"), fields));
+  EXPECT(not decoder.decode(from_hex("be"), fields));
+  // size update after a field
+  EXPECT(not decoder.decode(from_hex("823f61"), fields));
+  // size update above the limit from SETTINGS
+  EXPECT(not decoder.decode(from_hex("3fe21f"), fields));
+  // size update to 0 at the start is fine
+  fields.clear();
+  EXPECT(decoder.decode(from_hex("2082"), fields));
+  EXPECT(fields.size() == 1u);
+}
+
+CASE("HPACK encoder output is understood by the decoder")
+{
+  Encoder encoder;
+  Decoder decoder;
+
+  for (int round = 0; round < 2; round++)
+  {
+    std::string block;
+    encoder.encode(":status", "200", block);
+    encoder.encode("content-type", "text/html", block);
+    encoder.encode("server", "IncludeOS", block);
+    encoder.encode("set-cookie", "secret=1", block);
+
+    std::vector<Field> fields;
+    EXPECT(decoder.decode(block, fields));
+    EXPECT(fields.size() == 4u);
+    EXPECT(fields[0] == Field(":status", "200"));
+    EXPECT(fields[1] == Field("content-type", "text/html"));
+    EXPECT(fields[2] == Field("server", "IncludeOS"));
+    EXPECT(fields[3] == Field("set-cookie", "secret=1"));
+
+    // the second time all but the cookie are single octet indexes
+    if (round == 1) EXPECT(block.size() < 16u);
+  }
+  // credentials are not indexed
+  EXPECT(encoder.table().count() == 2u);
+  EXPECT(decoder.table().count() == 2u);
+
+  // a smaller table from the peer is signalled in the next block
+  encoder.set_max_table_size(0);
+  std::string block;
+  encoder.encode("server", "IncludeOS", block);
+  std::vector<Field> fields;
+  EXPECT(decoder.decode(block, fields));
+  EXPECT(decoder.table().count() == 0u);
+  EXPECT(fields.back() == Field("server", "IncludeOS"));
+}
@@ -0,0 +1,181 @@
+
+#include <common.cxx>
+#include <net/http/request.hpp>
+#include <net/http/request_parser.hpp>
+
+using namespace http;
+
+static const std::string get_request {
+  "GET /api/v1/users?id=42 HTTP/1.1\r\n"
+  "Host: includeos.org\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:60.0) Gecko/20100101 Firefox/60.0\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+  "Accept-Language: en-US,en;q=0.5\r\n"
+  "Accept-Encoding: gzip, deflate\r\n"
+  "Cookie: session=6f1c3e; theme=dark\r\n"
+  "Connection: keep-alive\r\n"
+  "\r\n"
+};
+
+CASE("Request_parser parses the request-line and fields as views")
+{
+  Arena arena;
+  Request_view req;
+  const int len = Request_parser{arena}.parse(get_request, req);
+
+  EXPECT(len == static_cast<int>(get_request.size()));
+  EXPECT(req.method == "GET");
+  EXPECT(req.target == "/api/v1/users?id=42");
+  EXPECT(req.major == 1);
+  EXPECT(req.minor == 1);
+  EXPECT(req.num_fields == 7u);
+  EXPECT(req.value("host") == "includeos.org");
+  EXPECT(req.value("COOKIE") == "session=6f1c3e; theme=dark");
+  EXPECT(req.value("Content-Type").empty());
+  EXPECT(req.keep_alive);
+  EXPECT(req.content_length == 0u);
+
+  // views point into the input, nothing is copied
+  EXPECT(req.target.data() == get_request.data() + 4);
+  EXPECT(arena.used() == req.num_fields * sizeof(Field_view));
+}
+
+CASE("Request_parser reports incomplete heads until the empty line")
+{
+  Arena arena;
+  Request_parser parser{arena};
+  Request_view req;
+
+  for (size_t n = 0; n < get_request.size(); n++) {
+    EXPECT(parser.parse({get_request.data(), n}, req) == Request_parser::incomplete);
+  }
+  // nothing is kept in the arena by incomplete attempts
+  EXPECT(arena.used() == 0u);
+  EXPECT(parser.parse(get_request, req) == static_cast<int>(get_request.size()));
+}
+
+CASE("Request_parser finds the body and framing fields")
+{
+  const std::string post {
+    "POST /submit HTTP/1.0\r\n"
+    "content-length: 11\r\n"
+    "Connection: Keep-Alive\r\n"
+    "\r\n"
+    "hello=world"
+  };
+  Arena arena;
+  Request_view req;
+  const int len = Request_parser{arena}.parse(post, req);
+  EXPECT(len == static_cast<int>(post.size() - 11));
+  EXPECT(req.content_length == 11u);
+  EXPECT(req.keep_alive);
+  EXPECT(post.substr(len) == "hello=world");
+
+  Request request{req};
+  EXPECT(request.method() == POST);
+  EXPECT(request.version() == Version(1, 0));
+  EXPECT(request.header().value(header::Content_Length) == "11");
+}
+
+CASE("Request keeps its fields as views, valid after the parsed data is gone")
+{
+  auto data = std::make_unique<std::string>(get_request);
+  Arena arena;
+  Request_view req;
+  Request_parser{arena}.parse(*data, req);
+  Request request{req};
+  data.reset();
+  arena.reset();
+
+  EXPECT(request.header().size() == 7u);
+  EXPECT(request.header().value("host") == "includeos.org");
+  const auto cookie = request.header().value(header::Cookie);
+  EXPECT(cookie == "session=6f1c3e; theme=dark");
+
+  // copies share the fields
+  Request copy{request};
+  EXPECT(copy.header().value(header::Cookie).data() == cookie.data());
+
+  // fields are copied into the request when changed
+  EXPECT(request.header().set_field(header::Host, "includeos.io"));
+  EXPECT(request.header().value(header::Host) == "includeos.io");
+  EXPECT(request.header().value(header::Cookie) == "session=6f1c3e; theme=dark");
+  EXPECT(request.header().size() == 7u);
+  request.header().erase(header::Cookie);
+  EXPECT(not request.header().has_field(header::Cookie));
+  EXPECT(copy.header().has_field(header::Cookie));
+  EXPECT(request.to_string().find("Host: includeos.io\r\n") != std::string::npos);
+}
+
+CASE("Request_parser rejects malformed requests")
+{
+  Arena arena;
+  Request_parser parser{arena};
+  Request_view req;
+  EXPECT(parser.parse("GET  HTTP/1.1\r\n\r\n", req) == Request_parser::invalid);
+  EXPECT(parser.parse("GET / HTPT/1.1\r\n\r\n", req) == Request_parser::invalid);
+  EXPECT(parser.parse("GET / HTTP/1.1\r\nHost : a\r\n\r\n", req) == Request_parser::invalid);
+  EXPECT(parser.parse("GET / HTTP/1.1\r\nA: b\r\n c\r\n\r\n", req) == Request_parser::invalid);
+  EXPECT(parser.parse("POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", req) == Request_parser::invalid);
+  EXPECT(parser.parse("POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n", req)
+         == Request_parser::invalid);
+  EXPECT(arena.used() == 0u);
+}
+
+CASE("Request_parser handles pipelined requests in one buffer")
+{
+  const std::string two = get_request + "GET /second HTTP/1.1\r\nConnection: close\r\n\r\n";
+  Arena arena;
+  Request_parser parser{arena};
+  Request_view first, second;
+
+  const int len = parser.parse(two, first);
+  EXPECT(len == static_cast<int>(get_request.size()));
+  EXPECT(parser.parse(util::csview{two}.substr(len), second) > 0);
+  EXPECT(second.target == "/second");
+  EXPECT(not second.keep_alive);
+  // both requests are still valid
+  EXPECT(first.value("Host") == "includeos.org");
+  EXPECT(second.value("Connection") == "close");
+}
+
+#include <chrono>
+CASE("HTTP request parsing benchmark")
+{
+  using namespace std::chrono;
+  static const int ITERATIONS = 100000;
+
+  Arena arena;
+  Request_parser parser{arena};
+  Request_view req;
+  size_t fields = 0;
+
+  auto start = steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    arena.reset();
+    parser.parse(get_request, req);
+    fields += req.num_fields;
+  }
+  const double view_sec = duration<double>(steady_clock::now() - start).count();
+  EXPECT(fields == ITERATIONS * 7u);
+
+  start = steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    arena.reset();
+    parser.parse(get_request, req);
+    Request request{req};
+    fields += request.header().size();
+  }
+  const double request_sec = duration<double>(steady_clock::now() - start).count();
+
+  start = steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    Request request{get_request};
+    fields += request.header().size();
+  }
+  const double legacy_sec = duration<double>(steady_clock::now() - start).count();
+
+  printf("Request_parser:            %.0f req/s\n", ITERATIONS / view_sec);
+  printf("Request_parser + Request:  %.0f req/s\n", ITERATIONS / request_sec);
+  printf("Request (http_parser):     %.0f req/s\n", ITERATIONS / legacy_sec);
+}
@@ -0,0 +1,200 @@
+
+#include <common.cxx>
+#include <nic_mock.hpp>
+#include <net/inet>
+#include <net/http/server.hpp>
+
+using namespace http;
+
+///
+/// The test side of a Test_stream, outliving the connection
+///
+struct Peer {
+  std::string               data;
+  net::Stream::ReadCallback read_cb;
+  bool                      closing = false;
+
+  void send(const std::string& str)
+  { read_cb(net::Stream::construct_buffer(str.begin(), str.end())); }
+};
+
+///
+/// A stream fed by the test, collecting what is written to it.
+/// Closing it signals the close at once, as an aborted TCP
+/// connection does
+///
+struct Test_stream : public net::Stream {
+  Peer&         peer;
+  CloseCallback close_cb;
+
+  explicit Test_stream(Peer& p) : peer{p} {}
+
+  void on_connect(ConnectCallback) override {}
+  void on_read(size_t, ReadCallback cb) override { peer.read_cb = std::move(cb); }
+  void on_data(DataCallback) override {}
+  size_t next_size() override { return 0; }
+  buffer_t read_next() override { return nullptr; }
+  void on_close(CloseCallback cb) override { close_cb = std::move(cb); }
+  void on_write(WriteCallback) override {}
+  void write(const void* buf, size_t n) override
+  { peer.data.append((const char*) buf, n); }
+  void write(buffer_t buf) override
+  { peer.data.append(buf->begin(), buf->end()); }
+  void write(const std::string& str) override { peer.data.append(str); }
+  void close() override
+  {
+    peer.closing = true;
+    if (close_cb) close_cb();
+  }
+  void reset_callbacks() override { peer.read_cb.reset(); close_cb.reset(); }
+  net::Socket local() const override { return {}; }
+  net::Socket remote() const override { return {}; }
+  std::string to_string() const override { return "Test_stream"; }
+  bool is_connected() const noexcept override { return not peer.closing; }
+  bool is_writable() const noexcept override { return not peer.closing; }
+  bool is_readable() const noexcept override { return not peer.closing; }
+  bool is_closing() const noexcept override { return peer.closing; }
+  bool is_closed() const noexcept override { return peer.closing; }
+  int get_cpuid() const noexcept override { return 0; }
+  net::Stream* transport() noexcept override { return nullptr; }
+};
+
+struct Test_server : public Server {
+  using Server::Server;
+  using Server::connect;
+};
+
+static std::string get(const std::string& path)
+{ return "GET " + path + " HTTP/1.1\r\nHost: includeos.org\r\n\r\n"; }
+
+CASE("Server_connection answers pipelined requests in order")
+{
+  Nic_mock nic;
+  net::Inet inet{nic};
+  std::vector<std::pair<std::string, Response_writer_ptr>> writers;
+  Test_server server{inet.tcp(), [&writers] (Request_ptr req, Response_writer_ptr res) {
+    writers.emplace_back(std::string{req->uri().path()}, std::move(res));
+  }};
+
+  Peer test;
+  server.connect(std::make_unique<Test_stream>(test));
+
+  // the last one split over two reads
+  const auto last = get("/3");
+  test.send(get("/1") + get("/2") + last.substr(0, 10));
+  test.send(last.substr(10));
+  EXPECT(writers.size() == 3u);
+  EXPECT(writers[0].first == "/1");
+  EXPECT(writers[1].first == "/2");
+  EXPECT(writers[2].first == "/3");
+
+  const auto answer = [&writers] (int i) {
+    writers[i].second->write(writers[i].first);
+    writers[i].second.reset();
+  };
+  // held back until the responses before them are done
+  answer(2);
+  answer(1);
+  EXPECT(test.data.empty());
+
+  answer(0);
+  const auto one   = test.data.find("/1");
+  const auto two   = test.data.find("/2");
+  const auto three = test.data.find("/3");
+  EXPECT(one != std::string::npos);
+  EXPECT(one < two);
+  EXPECT(two < three);
+  EXPECT(three != std::string::npos);
+  EXPECT(server.connected_clients() == 1u);
+}
+
+CASE("Server_connection stops parsing when a handler closes it")
+{
+  Nic_mock nic;
+  net::Inet inet{nic};
+  int requests = 0;
+  Test_server server{inet.tcp(), [&requests] (Request_ptr, Response_writer_ptr res) {
+    requests++;
+    res->header().set_field(header::Connection, "close");
+    res->write("bye");
+    // ending the response closes the stream, and the connection
+  }};
+
+  Peer test;
+  server.connect(std::make_unique<Test_stream>(test));
+  EXPECT(server.connected_clients() == 1u);
+
+  test.send(get("/1") + get("/2"));
+  EXPECT(requests == 1);
+  EXPECT(test.closing);
+  EXPECT(test.data.find("bye") != std::string::npos);
+  EXPECT(server.connected_clients() == 0u);
+}
+
+CASE("Server_connection hands requests without a body to the view handler")
+{
+  Nic_mock nic;
+  net::Inet inet{nic};
+  std::vector<std::string> owned;
+  Test_server server{inet.tcp(), [&owned] (Request_ptr req, Response_writer_ptr) {
+    owned.emplace_back(req->uri().path());
+  }};
+  std::vector<std::string> viewed;
+  server.on_request_view([&viewed] (const Request_view& head, Response_writer_ptr res) {
+    viewed.emplace_back(head.target);
+    EXPECT(head.value("host") == "includeos.org");
+    res->write("ok");
+  });
+
+  Peer test;
+  server.connect(std::make_unique<Test_stream>(test));
+  test.send(get("/1")
+    + "POST /2 HTTP/1.1\r\nHost: includeos.org\r\nContent-Length: 2\r\n\r\nhi"
+    + get("/3"));
+  EXPECT((viewed == std::vector<std::string>{"/1", "/3"}));
+  EXPECT((owned == std::vector<std::string>{"/2"}));
+}
+
+CASE("Header iterates over borrowed fields without copying them")
+{
+  Arena arena{1024};
+  Request_view head;
+  const std::string req = "GET / HTTP/1.1\r\nHost: includeos.org\r\nX-Test: a\r\n\r\n";
+  EXPECT(Request_parser{arena}.parse(req, head) == (int) req.size());
+  const Request request{head};
+
+  const auto& header = request.header();
+  std::vector<std::pair<std::string, std::string>> fields;
+  for (const auto& field : header)
+    fields.emplace_back(field.first, field.second);
+  EXPECT(fields.size() == 2u);
+  EXPECT(fields[1].first == "X-Test");
+  EXPECT(fields[1].second == "a");
+  // still borrowed, the views point into the same copy
+  EXPECT((*header.begin()).second.data() == header.value("Host").data());
+}
+
+CASE("Server_connection answers a bad request after those before it, then closes")
+{
+  Nic_mock nic;
+  net::Inet inet{nic};
+  std::vector<Response_writer_ptr> writers;
+  Test_server server{inet.tcp(), [&writers] (Request_ptr, Response_writer_ptr res) {
+    writers.push_back(std::move(res));
+  }};
+
+  Peer test;
+  server.connect(std::make_unique<Test_stream>(test));
+  test.send(get("/1") + "NOT A REQUEST\r\n\r\n" + get("/3"));
+  EXPECT(writers.size() == 1u);
+  EXPECT(test.data.empty());
+  EXPECT(not test.closing);
+
+  writers[0]->write("first");
+  writers.clear();
+  const auto bad = test.data.find("HTTP/1.1 400 Bad Request\r\n");
+  EXPECT(test.data.find("first") < bad);
+  EXPECT(bad != std::string::npos);
+  EXPECT(test.data.find("Connection: close\r\n", bad) != std::string::npos);
+  EXPECT(test.closing);
+}
@@ -0,0 +1,272 @@
+
+#include <common.cxx>
+#include <fs/disk.hpp>
+#include <fs/memdisk.hpp>
+#include <net/http/static_files.hpp>
+#include <unistd.h>
+
+using namespace http;
+
+///
+/// A stream collecting what is written to it, written when told to
+///
+struct Test_stream : public net::Stream {
+  std::string data;
+  WriteCallback write_cb;
+
+  void on_connect(ConnectCallback) override {}
+  void on_read(size_t, ReadCallback) override {}
+  void on_data(DataCallback) override {}
+  size_t next_size() override { return 0; }
+  buffer_t read_next() override { return nullptr; }
+  void on_close(CloseCallback) override {}
+  void on_write(WriteCallback cb) override { write_cb = std::move(cb); }
+  void write(const void* buf, size_t n) override
+  { data.append((const char*) buf, n); }
+  void write(buffer_t buf) override
+  { data.append(buf->begin(), buf->end()); }
+  void write(const std::string& str) override { data.append(str); }
+  void close() override {}
+  void reset_callbacks() override {}
+  net::Socket local() const override { return {}; }
+  net::Socket remote() const override { return {}; }
+  std::string to_string() const override { return "Test_stream"; }
+  bool is_connected() const noexcept override { return true; }
+  bool is_writable() const noexcept override { return true; }
+  bool is_readable() const noexcept override { return true; }
+  bool is_closing() const noexcept override { return false; }
+  bool is_closed() const noexcept override { return false; }
+  int get_cpuid() const noexcept override { return 0; }
+  net::Stream* transport() noexcept override { return nullptr; }
+};
+
+static fs::Disk_ptr disk = nullptr;
+
+static fs::Disk_ptr open_memdisk()
+{
+  const char* rootp(getenv("INCLUDEOS_SRC"));
+  std::string path="memdisk.fat";
+  if (access(path.c_str(),F_OK) == -1)
+  {
+    if (rootp == nullptr) path = "..";
+    else path = std::string(rootp) + "/test";
+    path += "/memdisk.fat";
+  }
+  auto* fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) return nullptr;
+  fseek(fp, 0L, SEEK_END);
+  long int size = ftell(fp);
+  rewind(fp);
+  char* buffer = new char[size];
+  if (fread(buffer, size, 1, fp) != 1) return nullptr;
+  fclose(fp);
+
+  auto* mdisk = new fs::MemDisk(buffer, buffer + size);
+  auto d = std::make_shared<fs::Disk>(*mdisk);
+  d->init_fs([] (auto, auto&) {});
+  return d;
+}
+
+///
+/// Serve a request, returning what was sent on the connection
+///
+static std::string serve(Static_files& files, Method method, std::string path,
+                         Header_set fields = {}, bool* found = nullptr)
+{
+  auto stream = std::make_unique<Test_stream>();
+  auto* stream_ptr = stream.get();
+  Connection conn{std::move(stream)};
+  // files read from disk are written as the stream writes
+  size_t sent = 0;
+
+  Request req;
+  req.set_method(method);
+  req.set_uri(URI{std::move(path)});
+  req << fields;
+  auto writer = std::make_unique<Response_writer>(make_response(), conn);
+  const bool served = files.serve(req, writer);
+  writer = nullptr;
+  while (stream_ptr->write_cb and sent < stream_ptr->data.size()) {
+    const auto n = stream_ptr->data.size() - sent;
+    sent += n;
+    stream_ptr->write_cb(n);
+  }
+  if (found) *found = served;
+  return stream_ptr->data;
+}
+
+CASE("Static_files parses single byte ranges")
+{
+  Static_files::Byte_range range {0, 0};
+  EXPECT(Static_files::parse_range("bytes=0-99", 1000, range) == 1);
+  EXPECT(range.first == 0u);
+  EXPECT(range.last == 99u);
+
+  EXPECT(Static_files::parse_range("bytes=900-", 1000, range) == 1);
+  EXPECT(range.first == 900u);
+  EXPECT(range.last == 999u);
+
+  // the last 100 bytes
+  EXPECT(Static_files::parse_range("bytes=-100", 1000, range) == 1);
+  EXPECT(range.first == 900u);
+  EXPECT(range.length() == 100u);
+
+  // limited to the file
+  EXPECT(Static_files::parse_range("bytes=500-5000", 1000, range) == 1);
+  EXPECT(range.last == 999u);
+  EXPECT(Static_files::parse_range("bytes=-5000", 1000, range) == 1);
+  EXPECT(range.first == 0u);
+
+  // unsatisfiable
+  EXPECT(Static_files::parse_range("bytes=1000-", 1000, range) == -1);
+  EXPECT(Static_files::parse_range("bytes=-0", 1000, range) == -1);
+
+  // ignored
+  EXPECT(Static_files::parse_range("bytes=0-1,5-6", 1000, range) == 0);
+  EXPECT(Static_files::parse_range("bytes=9-1", 1000, range) == 0);
+  EXPECT(Static_files::parse_range("items=0-1", 1000, range) == 0);
+  EXPECT(Static_files::parse_range("bytes=x-1", 1000, range) == 0);
+}
+
+CASE("Static_files matches entity tags and content codings")
+{
+  EXPECT(Static_files::etag_matches("\"abc\"", "\"abc\""));
+  EXPECT(Static_files::etag_matches("\"x\", W/\"abc\"", "\"abc\""));
+  EXPECT(Static_files::etag_matches("*", "\"abc\""));
+  EXPECT(not Static_files::etag_matches("\"abcd\"", "\"abc\""));
+
+  EXPECT(Static_files::accepts_encoding("gzip, deflate, br", "br"));
+  EXPECT(Static_files::accepts_encoding("gzip;q=0.5", "gzip"));
+  EXPECT(not Static_files::accepts_encoding("gzip;q=0", "gzip"));
+  EXPECT(not Static_files::accepts_encoding("deflate", "gzip"));
+  EXPECT(Static_files::accepts_encoding("*", "br"));
+  EXPECT(not Static_files::accepts_encoding("*, br;q=0", "br"));
+  EXPECT(not Static_files::accepts_encoding("", "gzip"));
+}
+
+CASE("Static_files serves files from a FAT file system")
+{
+  disk = open_memdisk();
+  EXPECT(disk != nullptr);
+  auto& filesys = disk->fs();
+  const auto content = filesys.read_file("/folder/file.txt").to_string();
+  EXPECT(not content.empty());
+
+  Static_files files{filesys.stat("/")};
+
+  bool found = false;
+  auto res = serve(files, GET, "/folder/file.txt", {{"Host", "test"}}, &found);
+  EXPECT(found);
+  EXPECT(res.find("HTTP/1.1 200 OK\r\n") == 0u);
+  EXPECT(res.find("Content-Type: text/plain\r\n") != std::string::npos);
+  EXPECT(res.find("Content-Length: " + std::to_string(content.size()) + "\r\n") != std::string::npos);
+  EXPECT(res.substr(res.size() - content.size()) == content);
+  EXPECT(files.cached_bytes() == content.size());
+
+  // the ETag makes a conditional GET
+  const auto pos = res.find("ETag: ") + 6;
+  const auto etag = res.substr(pos, res.find("\r\n", pos) - pos);
+  res = serve(files, GET, "/folder/file.txt", {{"If-None-Match", etag}});
+  EXPECT(res.find("HTTP/1.1 304 Not Modified\r\n") == 0u);
+  EXPECT(res.find("\r\n\r\n") == res.size() - 4);
+
+  // a range
+  res = serve(files, GET, "/folder/file.txt", {{"Range", "bytes=1-3"}});
+  EXPECT(res.find("HTTP/1.1 206 Partial Content\r\n") == 0u);
+  EXPECT(res.find("Content-Range: bytes 1-3/" + std::to_string(content.size())) != std::string::npos);
+  EXPECT(res.substr(res.size() - 3) == content.substr(1, 3));
+
+  // ...not when it's for another version of the file
+  res = serve(files, GET, "/folder/file.txt", {{"Range", "bytes=1-3"}, {"If-Range", "\"old\""}});
+  EXPECT(res.find("HTTP/1.1 200 OK\r\n") == 0u);
+
+  res = serve(files, GET, "/folder/file.txt", {{"Range", "bytes=100000-"}});
+  EXPECT(res.find("HTTP/1.1 416 ") == 0u);
+
+  // HEAD has the length, but no body
+  res = serve(files, HEAD, "/folder/file.txt");
+  EXPECT(res.find("Content-Length: " + std::to_string(content.size()) + "\r\n") != std::string::npos);
+  EXPECT(res.find("\r\n\r\n") == res.size() - 4);
+
+  // not found, or not allowed
+  serve(files, GET, "/folder/nothing.txt", {}, &found);
+  EXPECT(not found);
+  serve(files, GET, "/folder/../test.pem", {}, &found);
+  EXPECT(not found);
+  serve(files, POST, "/folder/file.txt", {}, &found);
+  EXPECT(not found);
+}
+
+CASE("Static_files preloads, or reads from disk what doesn't fit")
+{
+  auto& filesys = disk->fs();
+  const auto content = filesys.read_file("/test.pem").to_string();
+
+  Static_files files{filesys.stat("/")};
+  files.preload();
+  EXPECT(files.cached_bytes() > content.size());
+  auto res = serve(files, GET, "/test.pem", {{"Range", "bytes=-100"}});
+  EXPECT(res.substr(res.size() - 100) == content.substr(content.size() - 100));
+
+  Static_files uncached{filesys.stat("/"), 0};
+  res = serve(uncached, GET, "/test.pem");
+  EXPECT(res.substr(res.size() - content.size()) == content);
+  EXPECT(uncached.cached_bytes() == 0u);
+}
+
+CASE("Static_files reads uncached files a few parts at a time")
+{
+  auto& filesys = disk->fs();
+  const auto content = filesys.read_file("/test.pem").to_string();
+  EXPECT(content.size() > 8 * 128u);
+
+  Static_files files{filesys.stat("/"), 0};
+  files.set_read_size(128);
+
+  auto stream = std::make_unique<Test_stream>();
+  auto* test = stream.get();
+  Connection conn{std::move(stream)};
+  Request req;
+  req.set_method(GET);
+  req.set_uri(URI{"/test.pem"});
+  auto writer = std::make_unique<Response_writer>(make_response(), conn);
+  EXPECT(files.serve(req, writer));
+  EXPECT(writer == nullptr);
+
+  // the parts in flight, and one more each time one is written
+  const auto head = test->data.find("\r\n\r\n") + 4;
+  EXPECT(test->data.size() - head == Static_files::READS_IN_FLIGHT * 128);
+  test->write_cb(128);
+  EXPECT(test->data.size() - head == (Static_files::READS_IN_FLIGHT + 1) * 128);
+
+  while (test->data.size() - head < content.size())
+    test->write_cb(128);
+  EXPECT(test->data.substr(head) == content);
+  // done, not reading any more
+  test->write_cb(128);
+  EXPECT(test->data.size() - head == content.size());
+}
+
+CASE("Static_files drops the least recently used files for new ones")
+{
+  auto& filesys = disk->fs();
+  const auto pem  = filesys.stat("/test.pem").size();
+  const auto text = filesys.stat("/folder/file.txt").size();
+
+  // room for one of them at a time
+  const size_t limit = pem + 300;
+  EXPECT(text < 300u);
+  Static_files files{filesys.stat("/"), limit};
+  serve(files, GET, "/test.pem");
+  EXPECT(files.cached_bytes() == pem);
+  serve(files, GET, "/folder/file.txt");
+  EXPECT(files.cached_bytes() == text);
+  EXPECT(files.used_bytes() <= limit);
+
+  // still cached, and most recently used
+  serve(files, GET, "/folder/file.txt");
+  EXPECT(files.cached_bytes() == text);
+  const auto res = serve(files, GET, "/test.pem");
+  EXPECT(res.find("HTTP/1.1 200 OK\r\n") == 0u);
+  EXPECT(files.cached_bytes() == pem);
+}
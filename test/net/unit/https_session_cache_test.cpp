@@ -0,0 +1,124 @@
+
+#include <common.cxx>
+#include <net/https/session_cache.hpp>
+
+extern delegate<uint64_t()> systime_override;
+static uint64_t now = 1000;
+
+using http::Session_cache;
+
+static Session_cache::Blob blob(const std::string& str)
+{
+  return {str.begin(), str.end()};
+}
+
+static const Session_cache::Blob* find(Session_cache& cache, const std::string& id)
+{
+  return cache.find((const uint8_t*) id.data(), id.size());
+}
+
+static void store(Session_cache& cache, const std::string& id, const std::string& data)
+{
+  cache.store((const uint8_t*) id.data(), id.size(), blob(data));
+}
+
+CASE("Session_cache keeps the most recently used sessions until they expire")
+{
+  systime_override = [] () -> uint64_t { return now; };
+  Session_cache cache{"test", 3, 60};
+
+  store(cache, "a", "session a");
+  store(cache, "b", "session b");
+  store(cache, "c", "session c");
+  EXPECT(cache.size() == 3u);
+  EXPECT(*find(cache, "a") == blob("session a"));
+
+  // b is the least recently used
+  store(cache, "d", "session d");
+  EXPECT(cache.size() == 3u);
+  EXPECT(find(cache, "b") == nullptr);
+  EXPECT(find(cache, "a") != nullptr);
+  EXPECT(find(cache, "d") != nullptr);
+
+  // replacing
+  store(cache, "a", "session a2");
+  EXPECT(*find(cache, "a") == blob("session a2"));
+  EXPECT(cache.size() == 3u);
+
+  cache.remove((const uint8_t*) "d", 1);
+  EXPECT(find(cache, "d") == nullptr);
+
+  now += 60;
+  EXPECT(find(cache, "a") == nullptr);
+  EXPECT(cache.size() == 1u);
+
+  auto& hits = Statman::get().get_by_name("test.tls_session_hits").get_uint64();
+  auto& misses = Statman::get().get_by_name("test.tls_session_misses").get_uint64();
+  EXPECT(hits == 4u);
+  EXPECT(misses == 3u);
+}
+
+CASE("Session_cache rotates ticket keys, and decrypts with the previous one")
+{
+  Session_cache cache{"test", 3, 60};
+  cache.set_ticket_lifetime(100);
+  int rotations = 0;
+  cache.on_ticket_key([&rotations] (const auto&) { rotations++; });
+
+  const auto first = cache.ticket_key();
+  EXPECT(rotations == 1);
+  EXPECT(&cache.ticket_key() == &cache.ticket_keys().back());
+  EXPECT(rotations == 1);
+  EXPECT(cache.find_ticket_key(first.name) != nullptr);
+  EXPECT(cache.is_current(*cache.find_ticket_key(first.name)));
+
+  now += 100;
+  const auto second = cache.ticket_key();
+  EXPECT(rotations == 2);
+  EXPECT(memcmp(first.name, second.name, sizeof(first.name)) != 0);
+  // still known, but not for new tickets
+  auto* key = cache.find_ticket_key(first.name);
+  EXPECT(key != nullptr);
+  EXPECT(not cache.is_current(*key));
+  EXPECT(memcmp(key->aes_key, first.aes_key, sizeof(first.aes_key)) == 0);
+
+  now += 100;
+  EXPECT(cache.find_ticket_key(first.name) == nullptr);
+  cache.ticket_key();
+  EXPECT(cache.ticket_keys().size() == 2u);
+
+  uint8_t unknown[16] {};
+  EXPECT(cache.find_ticket_key(unknown) == nullptr);
+}
+
+CASE("Session_cache is serialized with sessions and ticket keys")
+{
+  Session_cache cache{"test", 10, 60};
+  store(cache, "old", "expires first");
+  now += 30;
+  store(cache, "a", "session a");
+  store(cache, "b", "session b");
+  find(cache, "a");
+  const auto key = cache.ticket_key();
+
+  std::vector<uint8_t> buffer(cache.serialized_size());
+  EXPECT(cache.serialize_to(buffer.data(), buffer.size()) == buffer.size());
+  EXPECT_THROWS(cache.serialize_to(buffer.data(), buffer.size() - 1));
+
+  now += 40;
+  Session_cache restored{"test", 10, 60};
+  restored.deserialize_from(buffer.data(), buffer.size());
+  EXPECT(restored.size() == 2u);
+  EXPECT(find(restored, "old") == nullptr);
+  EXPECT(*find(restored, "b") == blob("session b"));
+  EXPECT(restored.find_ticket_key(key.name) != nullptr);
+
+  // the least recently used goes first, as before
+  Session_cache smaller{"test", 1, 60};
+  smaller.deserialize_from(buffer.data(), buffer.size());
+  EXPECT(smaller.size() == 1u);
+  EXPECT(find(smaller, "a") != nullptr);
+
+  buffer[0] ^= 0xff;
+  EXPECT_THROWS(restored.deserialize_from(buffer.data(), buffer.size()));
+}
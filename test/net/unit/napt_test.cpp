@@ -185,3 +185,27 @@ CASE("NAPT MASQUERADE")
   EXPECT(not tcp_ports.is_bound(new_src.port()));
 
 }
+
+CASE("NAPT entries closing after the NAPT is gone")
+{
+  auto conntrack = std::make_shared<Conntrack>();
+  auto napt = std::make_unique<NAPT>(conntrack);
+
+  Nic_mock nic;
+  Inet inet{nic};
+  inet.network_config({10,0,0,40},{255,255,255,0}, 0);
+
+  const Socket src{ip4::Addr{10,0,0,1}, 32222};
+  const Socket dst{ip4::Addr{10,0,0,42},53};
+
+  auto udp = udp_packet(src, dst);
+  auto* entry = get_entry(*conntrack, *udp);
+  napt->masquerade(*udp, inet, entry);
+  EXPECT(udp->ip_src() == inet.ip_addr());
+
+  // the close handler finds no pool to release the port to
+  napt = nullptr;
+  entry->timeout = RTC::now();
+  conntrack->remove_expired();
+  EXPECT(conntrack->number_of_entries() == 0u);
+}
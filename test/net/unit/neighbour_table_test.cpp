@@ -0,0 +1,83 @@
+
+#include <common.cxx>
+#include <net/neighbour_table.hpp>
+#include <net/ip4/addr.hpp>
+#include <unordered_map>
+
+using namespace net;
+using Table = Neighbour_table<ip4::Addr, int>;
+
+CASE("Neighbour table insert, find and erase")
+{
+  Table table;
+  EXPECT(table.empty());
+  EXPECT(table.find({10,0,0,1}) == nullptr);
+
+  table.assign({10,0,0,1}, 1);
+  table.assign({10,0,0,2}, 2);
+  EXPECT(table.size() == 2u);
+  EXPECT(*table.find({10,0,0,1}) == 1);
+  EXPECT(*table.find({10,0,0,2}) == 2);
+
+  // assign replaces
+  table.assign({10,0,0,1}, 42);
+  EXPECT(table.size() == 2u);
+  EXPECT(*table.find({10,0,0,1}) == 42);
+
+  EXPECT(table.erase({10,0,0,1}));
+  EXPECT(not table.erase({10,0,0,1}));
+  EXPECT(table.find({10,0,0,1}) == nullptr);
+  EXPECT(*table.find({10,0,0,2}) == 2);
+
+  table.clear();
+  EXPECT(table.empty());
+  EXPECT(table.find({10,0,0,2}) == nullptr);
+}
+
+CASE("Neighbour table grows and matches a reference map")
+{
+  Table table;
+  std::unordered_map<ip4::Addr, int> ref;
+
+  for (int i = 0; i < 2000; i++)
+  {
+    const ip4::Addr addr{10, (uint8_t)(rand() % 4), (uint8_t)(rand() % 8), (uint8_t)(rand() % 256)};
+    if (rand() % 3 == 0) {
+      EXPECT(table.erase(addr) == (ref.erase(addr) == 1));
+    }
+    else {
+      table.assign(addr, i);
+      ref[addr] = i;
+    }
+  }
+
+  EXPECT(table.size() == ref.size());
+  EXPECT(table.capacity() >= table.size());
+  for (auto& ent : ref)
+  {
+    auto* val = table.find(ent.first);
+    EXPECT(val != nullptr);
+    EXPECT(*val == ent.second);
+  }
+
+  // Remove half of them
+  const auto removed = table.erase_if([](const ip4::Addr&, const int& val) {
+    return val % 2 == 0;
+  });
+  size_t odd = 0;
+  for (auto& ent : ref) {
+    if (ent.second % 2) {
+      EXPECT(*table.find(ent.first) == ent.second);
+      odd++;
+    }
+    else {
+      EXPECT(table.find(ent.first) == nullptr);
+    }
+  }
+  EXPECT(table.size() == odd);
+  EXPECT(removed == ref.size() - odd);
+
+  size_t visited = 0;
+  table.for_each([&visited](const ip4::Addr&, const int&) { visited++; });
+  EXPECT(visited == odd);
+}
@@ -0,0 +1,73 @@
+
+#include <common.cxx>
+#include <net/nat/port_pool.hpp>
+#include <set>
+
+using namespace net;
+using namespace net::nat;
+
+CASE("Port pool reuses the same port towards different destinations")
+{
+  Port_util util;
+  uint32_t exhausted = 0;
+  Port_pool pool{util, exhausted};
+
+  const Socket dst1{ip4::Addr{10,0,0,1}, 80};
+  const Socket dst2{ip4::Addr{10,0,0,2}, 80};
+
+  const auto port1 = pool.acquire(dst1);
+  EXPECT(port_ranges::is_dynamic(port1));
+  EXPECT(util.is_bound(port1));
+  EXPECT(pool.use_count(port1) == 1);
+
+  // Drain every port towards dst1, all unique
+  std::set<uint16_t> used{port1};
+  for(int i = 1; i < Port_util::size(); ++i)
+    used.insert(pool.acquire(dst1));
+  EXPECT(used.size() == (size_t)Port_util::size());
+
+  EXPECT_THROWS_AS(pool.acquire(dst1), Port_error);
+  EXPECT(exhausted == 1u);
+
+  // Another destination can still get ports
+  const auto port2 = pool.acquire(dst2);
+  EXPECT(pool.use_count(port2) == 2);
+  EXPECT(pool.destinations() == 2u);
+
+  // Releasing gives the port back to the destination
+  pool.release(dst1, port1);
+  EXPECT(pool.acquire(dst1) == port1);
+}
+
+CASE("Port pool unbinds ports when released by every destination")
+{
+  Port_util util;
+  uint32_t exhausted = 0;
+  Port_pool pool{util, exhausted};
+
+  const Socket dst{ip4::Addr{10,0,0,1}, 53};
+
+  const auto port = pool.acquire(dst);
+  EXPECT(util.is_bound(port));
+
+  pool.release(dst, port);
+  EXPECT(not util.is_bound(port));
+  EXPECT(pool.use_count(port) == 0);
+  EXPECT(pool.destinations() == 0u);
+}
+
+CASE("Port pool skips ports bound by the local stack")
+{
+  Port_util util;
+  uint32_t exhausted = 0;
+  Port_pool pool{util, exhausted};
+
+  // Bind every ephemeral port but one
+  const uint16_t free_port = port_ranges::DYNAMIC_START + 42;
+  for(int p = port_ranges::DYNAMIC_START; p <= port_ranges::DYNAMIC_END; ++p)
+    if(p != free_port) util.bind(p);
+
+  const Socket dst{ip4::Addr{10,0,0,1}, 443};
+  EXPECT(pool.acquire(dst) == free_port);
+  EXPECT_THROWS_AS(pool.acquire(dst), Port_error);
+}
@@ -0,0 +1,190 @@
+
+#include <common.cxx>
+#include <packet_factory.hpp>
+#include <nic_mock.hpp>
+#include <net/inet>
+#include <net/qdisc.hpp>
+
+static uint64_t my_time = 0;
+
+static uint64_t get_time()
+{ return my_time; }
+
+#include <delegate>
+extern delegate<uint64_t()> systime_override;
+
+using namespace net;
+
+static const uint64_t ms = 1'000'000;
+
+static Qdisc::Entry ip4_entry(DSCP dscp, ECN ecn = ECN::NOT_ECT, uint16_t port = 80)
+{
+  auto tcp = create_tcp_packet_init({ip4::Addr{10,0,0,1}, port},
+                                    {ip4::Addr{10,0,0,2}, 80});
+  // full sized segment
+  tcp->set_data_end(tcp->ip_header_length() + tcp->tcp_header_length() + 1000);
+  tcp->set_ip_total_length(tcp->size());
+  tcp->set_ip_dscp(dscp);
+  tcp->set_ip_ecn(ecn);
+  tcp->set_ip_checksum();
+  return {std::move(tcp), MAC::Addr{}, Ethertype::IP4};
+}
+
+CASE("Qdisc reads DSCP and marks ECN capable packets")
+{
+  auto entry = ip4_entry(DSCP::EF_PHB, ECN::ECT_0);
+  EXPECT(Qdisc::dscp(entry) == DSCP::EF_PHB);
+  EXPECT(Qdisc::set_ce(entry));
+
+  auto& ip = static_cast<PacketIP4&>(*entry.packet);
+  EXPECT(ip.ip_ecn() == ECN::CE);
+  EXPECT(ip.ip_dscp() == DSCP::EF_PHB);
+  EXPECT(ip.compute_ip_checksum() == 0);
+
+  auto not_ect = ip4_entry(DSCP::CS0);
+  EXPECT(not Qdisc::set_ce(not_ect));
+}
+
+CASE("Prio serves expedited traffic first and lower effort last")
+{
+  Prio prio{"test.qdisc.prio"};
+  EXPECT(prio.enqueue(ip4_entry(DSCP::CS1), 0));
+  EXPECT(prio.enqueue(ip4_entry(DSCP::CS0), 0));
+  EXPECT(prio.enqueue(ip4_entry(DSCP::EF_PHB), 0));
+  EXPECT(prio.size() == 3u);
+
+  EXPECT(Qdisc::dscp(prio.dequeue(1)) == DSCP::EF_PHB);
+  EXPECT(Qdisc::dscp(prio.dequeue(1)) == DSCP::CS0);
+  EXPECT(Qdisc::dscp(prio.dequeue(1)) == DSCP::CS1);
+  EXPECT(prio.dequeue(1).packet == nullptr);
+  EXPECT(prio.empty());
+}
+
+CASE("Fifo drops at the tail when full")
+{
+  Fifo fifo{"test.qdisc.fifo", 2};
+  const auto dropped = fifo.dropped();
+  EXPECT(fifo.enqueue(ip4_entry(DSCP::CS0), 0));
+  EXPECT(fifo.enqueue(ip4_entry(DSCP::CS0), 0));
+  EXPECT(not fifo.enqueue(ip4_entry(DSCP::CS0), 0));
+  EXPECT(fifo.size() == 2u);
+  EXPECT(fifo.dropped() == dropped + 1);
+
+  EXPECT(fifo.dequeue(2 * ms).packet != nullptr);
+  EXPECT(fifo.delay_us() == 2000u);
+}
+
+CASE("Token bucket limits the rate")
+{
+  // 1 packet per millisecond, bucket fits one packet
+  auto entry = ip4_entry(DSCP::CS0);
+  const uint32_t len = entry.size();
+  Token_bucket tbf{"test.qdisc.tbf", {len * 1000ull, len}};
+
+  uint64_t now = 1000 * ms;
+  EXPECT(tbf.enqueue(std::move(entry), now));
+  EXPECT(tbf.enqueue(ip4_entry(DSCP::CS0), now));
+  EXPECT(tbf.enqueue(ip4_entry(DSCP::CS0), now));
+
+  // first packet goes out on the full bucket
+  EXPECT(tbf.dequeue(now).packet != nullptr);
+  EXPECT(tbf.dequeue(now).packet == nullptr);
+  EXPECT(tbf.next_event() == now + ms);
+  EXPECT(tbf.size() == 2u);
+
+  EXPECT(tbf.dequeue(now + ms / 2).packet == nullptr);
+  EXPECT(tbf.dequeue(now + ms).packet != nullptr);
+  EXPECT(tbf.dequeue(now + 2 * ms).packet != nullptr);
+  EXPECT(tbf.empty());
+  EXPECT(tbf.next_event() == 0u);
+}
+
+CASE("Inet releases shaped packets from its timer when the qdisc is full")
+{
+  systime_override = get_time;
+  my_time = 1000 * ms;
+  Timers::init([] (Timers::duration_t) {}, [] () {});
+  Timers::ready();
+
+  Nic_mock nic;
+  Inet inet{nic};
+  // 1 packet per millisecond, room for one more behind the held one
+  const uint32_t len = ip4_entry(DSCP::CS0).size();
+  inet.set_qdisc(std::make_unique<Token_bucket>("test.qdisc.tbf",
+      Token_bucket::Config{len * 1000ull, len},
+      std::make_unique<Fifo>("test.qdisc.tbf.fifo", 2)));
+  auto& qdisc = *inet.qdisc();
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT(qdisc.enqueue(ip4_entry(DSCP::CS0), my_time));
+    inet.force_start_send_queues();
+  }
+  EXPECT(nic.get_packets_tx() == 1u);
+  EXPECT(qdisc.size() == 2u);
+  EXPECT(inet.transmit_queue_available() == 0u);
+
+  my_time += ms;
+  Timers::timers_handler();
+  EXPECT(nic.get_packets_tx() == 2u);
+  my_time += ms;
+  Timers::timers_handler();
+  EXPECT(nic.get_packets_tx() == 3u);
+  EXPECT(qdisc.empty());
+}
+
+CASE("Prio reports the limit of a band")
+{
+  Prio prio{"test.qdisc.prio", 4};
+  EXPECT(prio.limit() == 4u);
+  prio.set_band(2, std::make_unique<Fifo>("test.qdisc.prio.band2", 2));
+  EXPECT(prio.limit() == 2u);
+}
+
+CASE("Fq_codel separates flows and drops from a standing queue")
+{
+  Fq_codel::Config config;
+  config.ecn = false;
+  config.quantum = 1000;
+  Fq_codel fq{"test.qdisc.fq_codel", config};
+
+  // a bulk flow builds a queue, a sparse flow sends a single packet
+  for (int i = 0; i < 20; i++)
+    EXPECT(fq.enqueue(ip4_entry(DSCP::CS0, ECN::NOT_ECT, 1000), 0));
+  EXPECT(fq.enqueue(ip4_entry(DSCP::CS0, ECN::NOT_ECT, 2000), 0));
+  EXPECT(fq.active_flows() == 2u);
+
+  // the bulk flow got its quantum, then the sparse flow is served
+  auto first = fq.dequeue(0);
+  auto second = fq.dequeue(0);
+  EXPECT(first.packet != nullptr);
+  EXPECT(second.packet != nullptr);
+  EXPECT(Qdisc::flow_hash(first) != Qdisc::flow_hash(second));
+
+  // delay above target for more than an interval starts dropping
+  const auto dropped = fq.dropped();
+  uint64_t now = 10 * ms;
+  while (not fq.empty()) {
+    fq.dequeue(now);
+    now += 20 * ms;
+  }
+  EXPECT(fq.dropped() > dropped);
+}
+
+CASE("Fq_codel marks ECN capable packets instead of dropping")
+{
+  Fq_codel fq{"test.qdisc.fq_codel_ecn"};
+  for (int i = 0; i < 20; i++)
+    EXPECT(fq.enqueue(ip4_entry(DSCP::CS0, ECN::ECT_0), 0));
+
+  const auto dropped = fq.dropped();
+  const auto marked = fq.marked();
+  uint64_t now = 10 * ms;
+  int sent = 0;
+  while (not fq.empty()) {
+    if (fq.dequeue(now).packet != nullptr) sent++;
+    now += 20 * ms;
+  }
+  EXPECT(sent == 20);
+  EXPECT(fq.dropped() == dropped);
+  EXPECT(fq.marked() > marked);
+}
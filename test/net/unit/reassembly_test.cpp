@@ -0,0 +1,280 @@
+#include <common.cxx>
+#include <nic_mock.hpp>
+#include <net/inet>
+#include <net/ip6/extension_header.hpp>
+#include <net/reassembly.hpp>
+
+static uint64_t my_time = 0;
+
+static uint64_t get_time()
+{ return my_time; }
+
+#include <delegate>
+extern delegate<uint64_t()> systime_override;
+
+using namespace net;
+
+// fragment data is the low byte of its offset in the datagram
+static std::vector<uint8_t> data_at(uint32_t offset, uint32_t length)
+{
+  std::vector<uint8_t> data(length);
+  for (uint32_t i = 0; i < length; i++)
+    data[i] = (offset + i) & 0xff;
+  return data;
+}
+
+static bool is_data(const uint8_t* data, uint32_t length)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < length; i++)
+    ok = ok and data[i] == (i & 0xff);
+  return ok;
+}
+
+static Packet_ptr insert(Reassembly& engine, const Reassembly::Key& key,
+                         uint32_t offset, uint32_t length, bool more)
+{
+  auto data = data_at(offset, length);
+  return engine.insert(key, {offset, length, data.data(), nullptr, 0}, more);
+}
+
+static const Reassembly::Key key1 {ip4::Addr{10,0,0,1}, ip4::Addr{10,0,0,2}, 1, 17};
+static const Reassembly::Key key2 {ip4::Addr{10,0,0,1}, ip4::Addr{10,0,0,2}, 2, 17};
+
+CASE("Reassembly of out-of-order fragments")
+{
+  systime_override = get_time;
+  Reassembly engine;
+
+  EXPECT(not insert(engine, key1, 1600, 100, false));
+  EXPECT(not insert(engine, key1, 0, 800, true));
+  EXPECT(engine.entries() == 1u);
+  EXPECT(engine.bytes_held() > 0u);
+
+  auto datagram = insert(engine, key1, 800, 800, true);
+  EXPECT(datagram != nullptr);
+  EXPECT(datagram->size() == 1700);
+  EXPECT(is_data(datagram->layer_begin(), datagram->size()));
+
+  EXPECT(engine.entries() == 0u);
+  EXPECT(engine.bytes_held() == 0u);
+  EXPECT(engine.stats().reassembled == 1u);
+}
+
+CASE("Reassembly keeps the header of the first fragment, in the same buffer")
+{
+  systime_override = get_time;
+  Reassembly engine;
+
+  const uint8_t header[] {0xde, 0xad, 0xbe, 0xef};
+  auto data = data_at(3000, 1000);
+  EXPECT(not engine.insert(key1, {3000, 1000, data.data(), header, 4}, false));
+  data = data_at(0, 3000);
+  auto datagram = engine.insert(key1, {0, 3000, data.data(), header, 4}, true);
+  EXPECT(datagram != nullptr);
+  EXPECT(datagram->size() == 4004);
+  EXPECT(std::memcmp(datagram->layer_begin(), header, 4) == 0);
+  EXPECT(is_data(datagram->layer_begin() + 4, 4000));
+  EXPECT(engine.bytes_held() == 0u);
+  // assembled in place, in a buffer of the pool
+  EXPECT(datagram->bufsize() + sizeof(Packet) == engine.config().buffer_size());
+}
+
+CASE("Reassembly drops overlapping fragments and ignores duplicates")
+{
+  systime_override = get_time;
+  Reassembly engine;
+
+  EXPECT(not insert(engine, key1, 0, 800, true));
+  // duplicate, held in the one buffer
+  EXPECT(not insert(engine, key1, 0, 800, true));
+  EXPECT(engine.entries() == 1u);
+  EXPECT(engine.bytes_held() == engine.config().buffer_size());
+  // overlap drops the whole datagram
+  EXPECT(not insert(engine, key1, 400, 800, true));
+  EXPECT(engine.entries() == 0u);
+  EXPECT(engine.bytes_held() == 0u);
+}
+
+CASE("Reassembly copies fragments out of the NIC buffers")
+{
+  systime_override = get_time;
+  BufferStore nic_buffers{4, 2048};
+  Reassembly engine;
+
+  for (uint32_t offset : {0u, 800u})
+  {
+    auto* ptr = (Packet*) nic_buffers.get_buffer();
+    new (ptr) Packet(0, 0, 2048 - sizeof(Packet), &nic_buffers);
+    Packet_ptr packet{ptr};
+    auto data = data_at(offset, 800);
+    std::memcpy(packet->layer_begin(), data.data(), 800);
+    packet->set_data_end(800);
+    EXPECT(not engine.insert(key1, {offset, 800, packet->layer_begin(), nullptr, 0}, true));
+  }
+  // the NIC has all its buffers back while the datagram is incomplete
+  EXPECT(nic_buffers.available() == 4u);
+  EXPECT(engine.entries() == 1u);
+}
+
+CASE("Reassembly enforces timeout and byte budget")
+{
+  systime_override = get_time;
+  my_time = 1000;
+
+  Reassembly::Config config;
+  config.timeout = 10;
+  config.max_datagram = 4096;
+  config.byte_budget = 2 * config.buffer_size();
+  Reassembly engine{config};
+
+  EXPECT(not insert(engine, key1, 0, 1024, true));
+  EXPECT(not insert(engine, key2, 0, 1024, true));
+  EXPECT(engine.entries() == 2u);
+
+  // the first datagram is evicted to make room for a third
+  const Reassembly::Key key3 {ip4::Addr{10,0,0,1}, ip4::Addr{10,0,0,2}, 3, 17};
+  EXPECT(not insert(engine, key3, 0, 1024, true));
+  EXPECT(engine.entries() == 2u);
+  EXPECT(engine.bytes_held() <= config.byte_budget);
+  EXPECT(engine.stats().evicted == 1u);
+
+  // and times out
+  my_time += 10;
+  engine.expire(RTC::now());
+  EXPECT(engine.entries() == 0u);
+  EXPECT(engine.stats().timeouts == 2u);
+}
+
+CASE("Reassembly runs out of buffers while datagrams are held")
+{
+  systime_override = get_time;
+  Reassembly::Config config;
+  config.max_datagram = 4096;
+  config.byte_budget = config.buffer_size();
+  Reassembly engine{config};
+
+  auto datagram = insert(engine, key1, 0, 1000, false);
+  EXPECT(datagram != nullptr);
+  // the only buffer is held by the datagram handed out
+  EXPECT(not insert(engine, key2, 0, 800, true));
+  EXPECT(engine.entries() == 0u);
+  EXPECT(engine.stats().no_buffers == 1u);
+  EXPECT(engine.stats().dropped == 0u);
+
+  datagram = nullptr;
+  EXPECT(not insert(engine, key2, 0, 800, true));
+  EXPECT(engine.entries() == 1u);
+}
+
+CASE("Reassembly expires datagrams from a timer, without new fragments")
+{
+  // the test clock is both seconds (RTC) and nanoseconds (Timers)
+  systime_override = get_time;
+  my_time = 1000;
+  Timers::init([] (Timers::duration_t) {}, [] () {});
+  Timers::ready();
+
+  Reassembly::Config config;
+  config.timeout = 10;
+  Reassembly engine{config};
+
+  EXPECT(not insert(engine, key1, 0, 800, true));
+  EXPECT(Timers::active() == 1u);
+  Timers::timers_handler();
+  EXPECT(engine.entries() == 1u);
+
+  my_time += std::chrono::nanoseconds(std::chrono::seconds(10)).count();
+  Timers::timers_handler();
+  EXPECT(engine.entries() == 0u);
+  EXPECT(engine.bytes_held() == 0u);
+  EXPECT(engine.stats().timeouts == 1u);
+  EXPECT(Timers::active() == 0u);
+}
+
+// IPv6 fragment of @length bytes at @offset, after the fixed header
+static IP6::IP_packet_ptr ip6_fragment(Inet& inet, uint32_t offset,
+                                       uint32_t length, bool more)
+{
+  auto packet = inet.create_ip6_packet(Protocol::IPv6_FRAG);
+  packet->set_ip_src(ip6::Addr{0xfe80, 0, 0, 0, 0, 0, 0, 1});
+  packet->set_ip_dst(ip6::Addr{0xfe80, 0, 0, 0, 0, 0, 0, 2});
+
+  auto& fh = *(ip6::Fragment_header*) packet->data_end();
+  fh.next_header = static_cast<uint8_t>(Protocol::UDP);
+  fh.reserved    = 0;
+  fh.offs_flags  = htons(offset | (more ? 1 : 0));
+  fh.id          = htonl(0x1234);
+  packet->increment_data_end(sizeof(ip6::Fragment_header));
+
+  auto data = data_at(offset, length);
+  std::memcpy(packet->data_end(), data.data(), length);
+  packet->increment_data_end(length);
+  packet->set_ip_payload_length(packet->size() - sizeof(ip6::Header));
+  return packet;
+}
+
+CASE("IPv6 fragments are reassembled without the fragment header")
+{
+  systime_override = get_time;
+  Nic_mock nic;
+  Inet inet{nic};
+  auto& ip6 = inet.ip6_obj();
+
+  EXPECT(ip6.reassemble(ip6_fragment(inet, 1200, 500, false)) == nullptr);
+  auto datagram = ip6.reassemble(ip6_fragment(inet, 0, 1200, true));
+  EXPECT(datagram != nullptr);
+  EXPECT(datagram->next_protocol() == Protocol::UDP);
+  EXPECT(datagram->payload_length() == 1700);
+  EXPECT(datagram->size() == (int) sizeof(ip6::Header) + 1700);
+  EXPECT(is_data(datagram->layer_begin() + sizeof(ip6::Header), 1700));
+
+  // atomic fragments only lose the fragment header
+  auto atomic = ip6.reassemble(ip6_fragment(inet, 0, 100, false));
+  EXPECT(atomic != nullptr);
+  EXPECT(atomic->next_protocol() == Protocol::UDP);
+  EXPECT(atomic->payload_length() == 100);
+}
+
+CASE("IPv6 drops fragments of bad length, counting them")
+{
+  systime_override = get_time;
+  Nic_mock nic;
+  Inet inet{nic};
+  auto& ip6 = inet.ip6_obj();
+
+  int dropped = 0;
+  ip6.set_drop_handler([&dropped] (auto, auto, auto reason) {
+    if (reason == IP6::Drop_reason::Bad_length) dropped++;
+  });
+  // non-last fragments must be a multiple of 8
+  EXPECT(ip6.reassemble(ip6_fragment(inet, 0, 1201, true)) == nullptr);
+  EXPECT(dropped == 1);
+
+  // larger than the payload length can tell
+  EXPECT(ip6.reassemble(ip6_fragment(inet, 65528, 16, false)) == nullptr);
+  EXPECT(dropped == 2);
+}
+
+CASE("IPv6 drops fragments when out of reassembly buffers")
+{
+  systime_override = get_time;
+  Nic_mock nic;
+  Inet inet{nic};
+  auto& ip6 = inet.ip6_obj();
+
+  auto config = ip6.reassembly_config();
+  config.max_datagram = 4096;
+  config.byte_budget = config.buffer_size();
+  ip6.set_reassembly_config(config);
+
+  int no_buffers = 0;
+  ip6.set_drop_handler([&no_buffers] (auto, auto, auto reason) {
+    if (reason == IP6::Drop_reason::No_buffers) no_buffers++;
+  });
+  EXPECT(ip6.reassemble(ip6_fragment(inet, 1200, 500, false)) == nullptr);
+  auto datagram = ip6.reassemble(ip6_fragment(inet, 0, 1200, true));
+  EXPECT(datagram != nullptr);
+  EXPECT(ip6.reassemble(ip6_fragment(inet, 0, 1200, true)) == nullptr);
+  EXPECT(no_buffers == 1);
+}
@@ -0,0 +1,118 @@
+
+#include <common.cxx>
+#include <nic_mock.hpp>
+#include <net/vlan_manager.hpp>
+
+using namespace net;
+
+static BufferStore store{16, 2048};
+
+// frame with @tags (TPID, VID) in front of an IPv4 payload byte
+static Packet_ptr frame(std::vector<std::pair<uint16_t, int>> tags)
+{
+  auto* ptr = (Packet*) store.get_buffer();
+  new (ptr) Packet(0, 0, 2048 - sizeof(Packet), &store);
+  Packet_ptr pkt{ptr};
+
+  auto* data = pkt->layer_begin();
+  std::memset(data, 0xff, 12); // broadcast from broadcast
+  int off = 12;
+  for (auto& tag : tags) {
+    *(uint16_t*) (data + off) = htons(tag.first);
+    *(uint16_t*) (data + off + 2) = htons(tag.second);
+    off += 4;
+  }
+  *(uint16_t*) (data + off) = htons(0x0800);
+  data[off + 2] = 0x45;
+  pkt->set_data_end(off + 3);
+  return pkt;
+}
+
+struct Counter {
+  int received = 0;
+  bool at_ip = false;
+  upstream_ip upstream() {
+    return [this] (Packet_ptr pkt, bool) {
+      received++;
+      at_ip = *pkt->layer_begin() == 0x45;
+    };
+  }
+};
+
+CASE("VLAN manager demuxes tagged frames by VID")
+{
+  Nic_mock nic;
+  auto& manager = VLAN_manager::get(10);
+  auto& vlan10   = manager.add(nic, 10);
+  auto& vlan4000 = manager.add(nic, 4000);
+  EXPECT(manager.find(10) == &vlan10);
+  EXPECT(manager.find(4000) == &vlan4000);
+  EXPECT(manager.find(20) == nullptr);
+
+  Counter c10, c4000;
+  vlan10.set_ip4_upstream(c10.upstream());
+  vlan4000.set_ip4_upstream(c4000.upstream());
+
+  nic.receive_vlan(frame({{0x8100, 10}}));
+  nic.receive_vlan(frame({{0x8100, 4000}}));
+  nic.receive_vlan(frame({{0x8100, 4000}}));
+  nic.receive_vlan(frame({{0x8100, 20}}));
+  EXPECT(c10.received == 1);
+  EXPECT(c4000.received == 2);
+  EXPECT(c10.at_ip);
+  EXPECT(store.available() == store.total_buffers());
+}
+
+CASE("VLAN manager demuxes QinQ frames by S-VID and C-VID")
+{
+  Nic_mock nic;
+  auto& manager = VLAN_manager::get(11);
+  auto& single = manager.add(nic, 10);
+  auto& qinq   = manager.add(nic, 100, 10);
+  EXPECT(manager.find(10, 100) == &qinq);
+  EXPECT(manager.find(10) == &single);
+  EXPECT(manager.find(11, 100) == nullptr);
+  EXPECT(manager.find(10, 101) == nullptr);
+
+  Counter c_single, c_qinq;
+  single.set_ip4_upstream(c_single.upstream());
+  qinq.set_ip4_upstream(c_qinq.upstream());
+
+  nic.receive_vlan(frame({{0x88a8, 100}, {0x8100, 10}}));
+  EXPECT(c_qinq.received == 1);
+  EXPECT(c_qinq.at_ip);
+  EXPECT(c_single.received == 0);
+
+  // unknown C-VID, and an S-tag not followed by a C-tag
+  nic.receive_vlan(frame({{0x88a8, 100}, {0x8100, 11}}));
+  nic.receive_vlan(frame({{0x88a8, 100}, {0x88a8, 10}}));
+  EXPECT(c_qinq.received == 1);
+  EXPECT(c_single.received == 0);
+}
+
+CASE("VLAN interfaces reserve and write only the tags they use")
+{
+  Nic_mock nic;
+  auto& manager = VLAN_manager::get(12);
+  auto& single = manager.add(nic, 10);
+  auto& qinq   = manager.add(nic, 200, 20);
+  EXPECT(single.frame_offset_link() == sizeof(ethernet::VLAN_header));
+  EXPECT(qinq.frame_offset_link() == sizeof(ethernet::QinQ_header));
+
+  Packet_ptr sent;
+  qinq.set_physical_downstream([&sent] (Packet_ptr pkt) { sent = std::move(pkt); });
+
+  auto* ptr = (Packet*) store.get_buffer();
+  new (ptr) Packet(qinq.frame_offset_link(), 0, 2048 - sizeof(Packet), &store);
+  Packet_ptr pkt{ptr};
+  qinq.create_link_downstream()(std::move(pkt), MAC::BROADCAST, Ethertype::IP4);
+
+  EXPECT(sent != nullptr);
+  EXPECT(sent->layer_begin() == sent->buf());
+  auto& hdr = *(const ethernet::QinQ_header*) sent->layer_begin();
+  EXPECT(ntohs(hdr.s_tpid) == 0x88a8);
+  EXPECT(hdr.svid() == 200);
+  EXPECT(ntohs(hdr.c_tpid) == 0x8100);
+  EXPECT(hdr.cvid() == 20);
+  EXPECT(hdr.type == Ethertype::IP4);
+}
@@ -101,6 +101,132 @@ static void websocket_do_thing(do_thing_t callback)
   }
 }
 
+CASE("WebSocket masking matches the byte by byte algorithm")
+{
+  const char key[4] {'\x12', '\x34', '\x56', '\x78'};
+  std::vector<char> data(200), expected;
+  for (size_t i = 0; i < data.size(); i++) data[i] = i * 7;
+
+  for (size_t offset = 0; offset < 4; offset++)
+  for (size_t len = 0; len < 100; len++)
+  {
+    expected = data;
+    for (size_t i = 0; i < len; i++)
+      expected[1 + i] ^= key[(offset + i) & 3];
+    auto masked = data;
+    // unaligned on purpose
+    net::ws_header::apply_mask(&masked[1], len, key, offset);
+    EXPECT(masked == expected);
+  }
+}
+
+CASE("WebSocket message is unmasked as it arrives in pieces")
+{
+  const std::string text(300, 'x');
+  // a masked (client) frame with a 16-bit length
+  std::vector<uint8_t> frame(4 + 4 + text.size());
+  auto& hdr = *(new (frame.data()) net::ws_header);
+  hdr.bits = 0;
+  hdr.set_final();
+  hdr.set_payload(text.size());
+  hdr.set_opcode(net::op_code::TEXT);
+  hdr.set_masked(0xdeadbeef);
+  EXPECT(hdr.header_length() == 8);
+  memcpy(hdr.data(), text.data(), text.size());
+  hdr.masking_algorithm(hdr.data());
+  EXPECT(std::string(hdr.data(), text.size()) != text);
+
+  // header split, and the payload at odd offsets
+  net::WebSocket::Message msg(frame.data(), 3);
+  size_t pos = 3;
+  for (size_t step : {2, 5, 1, 250, 100})
+  {
+    const size_t len = std::min(step, frame.size() - pos);
+    EXPECT(msg.append(&frame[pos], len) == len);
+    pos += len;
+  }
+  EXPECT(pos == frame.size());
+  EXPECT(msg.is_complete());
+  EXPECT(msg.to_string() == text);
+}
+
+// a masked (client) frame carrying @text
+static std::vector<uint8_t> client_frame(const std::string& text)
+{
+  std::vector<uint8_t> frame(14 + text.size());
+  auto& hdr = *(new (frame.data()) net::ws_header);
+  hdr.bits = 0;
+  hdr.set_final();
+  hdr.set_payload(text.size());
+  hdr.set_opcode(net::op_code::TEXT);
+  hdr.set_masked(0xdeadbeef);
+  memcpy(hdr.data(), text.data(), text.size());
+  hdr.masking_algorithm(hdr.data());
+  frame.resize(hdr.header_length() + text.size());
+  return frame;
+}
+
+///
+/// A stream handing the reads of the test to the WebSocket
+///
+struct Test_stream : public net::Stream {
+  ReadCallback read_cb;
+
+  void on_connect(ConnectCallback) override {}
+  void on_read(size_t, ReadCallback cb) override { read_cb = std::move(cb); }
+  void on_data(DataCallback) override {}
+  size_t next_size() override { return 0; }
+  buffer_t read_next() override { return nullptr; }
+  void on_close(CloseCallback) override {}
+  void on_write(WriteCallback) override {}
+  void write(const void*, size_t) override {}
+  void write(buffer_t) override {}
+  void write(const std::string&) override {}
+  void close() override {}
+  void reset_callbacks() override { read_cb.reset(); }
+  net::Socket local() const override { return {}; }
+  net::Socket remote() const override { return {}; }
+  std::string to_string() const override { return "Test_stream"; }
+  bool is_connected() const noexcept override { return true; }
+  bool is_writable() const noexcept override { return true; }
+  bool is_readable() const noexcept override { return true; }
+  bool is_closing() const noexcept override { return false; }
+  bool is_closed() const noexcept override { return false; }
+  int get_cpuid() const noexcept override { return 0; }
+  net::Stream* transport() noexcept override { return nullptr; }
+};
+
+CASE("WebSocket reads every frame in a buffer")
+{
+  auto stream = std::make_unique<Test_stream>();
+  auto& test = *stream;
+  net::WebSocket ws{std::move(stream), false};
+
+  std::vector<net::WebSocket::Message_ptr> messages;
+  ws.on_read = [&messages] (auto msg) { messages.push_back(std::move(msg)); };
+
+  const std::string third(200, 'z');
+  auto first  = client_frame("first");
+  auto second = client_frame(std::string(300, 'y'));
+  auto last   = client_frame(third);
+
+  // two whole frames, and the start of a third
+  auto buf = net::Stream::construct_buffer(first.begin(), first.end());
+  buf->insert(buf->end(), second.begin(), second.end());
+  buf->insert(buf->end(), last.begin(), last.begin() + 10);
+  test.read_cb(buf);
+  EXPECT(messages.size() == 2u);
+  EXPECT(messages[0]->to_string() == "first");
+  EXPECT(messages[1]->to_string() == std::string(300, 'y'));
+  // whole frames are read where they arrived
+  EXPECT((const uint8_t*) messages[1]->data() == buf->data() + first.size() + 4 + 4);
+
+  test.read_cb(net::Stream::construct_buffer(last.begin() + 10, last.end()));
+  EXPECT(messages.size() == 3u);
+  EXPECT(messages[2]->to_string() == third);
+  EXPECT(messages[0]->extract_vector().size() == 5u);
+}
+
 CASE("Setup websocket server")
 {
   Timers::init(
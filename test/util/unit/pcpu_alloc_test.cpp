@@ -0,0 +1,214 @@
+
+#include <common.cxx>
+#include <util/alloc_pcpu.hpp>
+#include <util/alloc_buddy.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace os::mem;
+using namespace util::literals;
+
+/** A buddy allocator behind a lock, as the kernel heap */
+struct Source {
+  using Buddy = buddy::Alloc<false>;
+
+  Source(size_t size) {
+    auto sz = Buddy::max_bufsize(size);
+    Expects(posix_memalign(&addr, Buddy::min_size, sz) == 0);
+    buddy = Buddy::create(addr, sz);
+  }
+  ~Source() { free(addr); }
+
+  void* allocate(size_t size) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return buddy->allocate(size);
+  }
+  void deallocate(void* ptr, size_t size) {
+    std::lock_guard<std::mutex> lock(mtx);
+    buddy->deallocate(ptr, size);
+  }
+  uintptr_t addr_begin() const { return buddy->addr_begin(); }
+  uintptr_t addr_end() const { return buddy->addr_end(); }
+
+  size_t bytes_used() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return buddy->bytes_used();
+  }
+
+  std::mutex mtx;
+  Buddy* buddy = nullptr;
+  void*  addr  = nullptr;
+};
+
+using Alloc = pcpu::Alloc<Source, 4>;
+
+struct Barrier {
+  Barrier(int n) : count{n} {}
+  void wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    const int gen = generation;
+    if (++waiting == count) {
+      waiting = 0;
+      generation++;
+      cv.notify_all();
+    }
+    else cv.wait(lock, [&] { return gen != generation; });
+  }
+  std::mutex mtx;
+  std::condition_variable cv;
+  const int count;
+  int waiting = 0, generation = 0;
+};
+
+CASE("pcpu::size_class maps sizes to the smallest class holding them")
+{
+  EXPECT(pcpu::size_class(0) == 0);
+  EXPECT(pcpu::size_class(1) == 0);
+  EXPECT(pcpu::size_class(16) == 0);
+  EXPECT(pcpu::size_class(17) == 1);
+  EXPECT(pcpu::size_class(128) == 7);
+  EXPECT(pcpu::size_class(129) == 8);
+  EXPECT(pcpu::class_size(8) == 160u);
+  EXPECT(pcpu::size_class(256) == 11);
+  EXPECT(pcpu::size_class(257) == 12);
+
+  for (size_t size = 1; size <= pcpu::max_small; size++)
+  {
+    const int cls = pcpu::size_class(size);
+    EXPECT(pcpu::class_size(cls) >= size);
+    EXPECT(pcpu::class_size(cls) % pcpu::min_align == 0u);
+    if (cls > 0) EXPECT(pcpu::class_size(cls - 1) < size);
+  }
+}
+
+CASE("pcpu::Alloc hands out objects of a CPU's spans, and returns empty spans")
+{
+  Source src(16_MiB);
+  const auto map_used = src.bytes_used();
+  Alloc alloc{src};
+
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 1000; i++)
+  {
+    auto* ptr = alloc.allocate(100, 0);
+    EXPECT(ptr != nullptr);
+    EXPECT((uintptr_t) ptr % pcpu::min_align == 0u);
+    EXPECT(alloc.usable_size(ptr) == 112u);
+    memset(ptr, i, 100);
+    ptrs.push_back(ptr);
+  }
+  EXPECT(alloc.bytes_used() == 1000u * 112);
+  EXPECT(alloc.span_count(0) == 2u);
+  EXPECT(alloc.span_count(1) == 0u);
+
+  // freed objects are reused first
+  alloc.deallocate(ptrs.back(), 0);
+  EXPECT(alloc.allocate(112, 0) == ptrs.back());
+
+  for (auto* ptr : ptrs)
+    alloc.deallocate(ptr, 0);
+  EXPECT(alloc.bytes_used() == 0u);
+  // keeping the current span
+  EXPECT(alloc.span_count(0) == 1u);
+
+  // large, and aligned
+  auto* large = alloc.allocate(100000, 1);
+  EXPECT(alloc.usable_size(large) >= 100000u);
+  auto* aligned = alloc.allocate_aligned(4096, 5000, 1);
+  EXPECT((uintptr_t) aligned % 4096 == 0u);
+  auto* small_aligned = alloc.allocate_aligned(64, 40, 1);
+  EXPECT((uintptr_t) small_aligned % 64 == 0u);
+  EXPECT(alloc.usable_size(small_aligned) % 64 == 0u);
+  alloc.deallocate(large, 1);
+  alloc.deallocate(aligned, 1);
+  alloc.deallocate(small_aligned, 1);
+  EXPECT(alloc.bytes_used() == 0u);
+  EXPECT(alloc.bytes_reserved() == 2 * pcpu::span_size);
+  EXPECT(src.bytes_used() - map_used > 0u);
+}
+
+CASE("pcpu::Alloc takes no more than a power of two for large allocations")
+{
+  Source src(16_MiB);
+  Alloc alloc{src};
+
+  // a header in the block would double these
+  auto* large = alloc.allocate(64_KiB, 0);
+  EXPECT(alloc.bytes_reserved() == 64_KiB);
+  EXPECT(alloc.usable_size(large) == 64_KiB);
+  auto* aligned = alloc.allocate_aligned(4_KiB, 32_KiB, 2);
+  EXPECT((uintptr_t) aligned % 4_KiB == 0u);
+  EXPECT(alloc.bytes_reserved() == 96_KiB);
+  EXPECT(alloc.bytes_used() == 96_KiB);
+
+  // aligned past a page, whatever the alignment of the source
+  auto* page_aligned = alloc.allocate_aligned(64_KiB, 20000, 1);
+  EXPECT((uintptr_t) page_aligned % 64_KiB == 0u);
+  EXPECT(alloc.usable_size(page_aligned) >= 20000u);
+  alloc.deallocate(page_aligned, 1);
+
+  // freed from another CPU
+  alloc.deallocate(large, 3);
+  alloc.deallocate(aligned, 0);
+  EXPECT(alloc.bytes_used() == 0u);
+  EXPECT(alloc.bytes_reserved() == 0u);
+}
+
+CASE("pcpu::Alloc takes back objects freed by other CPUs")
+{
+  Source src(64_MiB);
+  Alloc alloc{src};
+  static constexpr int CPUS = 4;
+  static constexpr int ROUNDS = 200;
+  static constexpr int COUNT = 500;
+
+  // every CPU frees what its neighbour allocated
+  std::vector<std::vector<void*>> handed(CPUS);
+  std::mutex mtx;
+  Barrier barrier{CPUS};
+  auto worker = [&] (int cpu) {
+    for (int r = 0; r < ROUNDS; r++)
+    {
+      std::vector<void*> mine;
+      for (int i = 0; i < COUNT; i++) {
+        const size_t size = 16 + (i * 37 + r) % 2000;
+        auto* ptr = (char*) alloc.allocate(size, cpu);
+        Expects(ptr != nullptr);
+        ptr[0] = cpu; ptr[size - 1] = cpu;
+        mine.push_back(ptr);
+      }
+      barrier.wait();
+      std::vector<void*> theirs;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        theirs.swap(handed[cpu]);
+        handed[(cpu + 1) % CPUS].insert(handed[(cpu + 1) % CPUS].end(),
+                                        mine.begin(), mine.end());
+      }
+      for (auto* ptr : theirs) {
+        Expects(*(char*) ptr == (cpu + CPUS - 1) % CPUS);
+        alloc.deallocate(ptr, cpu);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int cpu = 0; cpu < CPUS; cpu++)
+    threads.emplace_back(worker, cpu);
+  for (auto& t : threads)
+    t.join();
+
+  for (int cpu = 0; cpu < CPUS; cpu++)
+    for (auto* ptr : handed[cpu])
+      alloc.deallocate(ptr, cpu);
+
+  EXPECT(alloc.bytes_used() == 0u);
+  // the spans were reused, not leaked
+  size_t spans = 0;
+  for (int cpu = 0; cpu < CPUS; cpu++)
+    spans += alloc.span_count(cpu);
+  EXPECT(spans * pcpu::span_size == alloc.bytes_reserved());
+  EXPECT(alloc.bytes_reserved() < 16_MiB);
+}
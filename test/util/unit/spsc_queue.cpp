@@ -0,0 +1,74 @@
+
+#include <common.cxx>
+#include <util/spsc_queue.hpp>
+#include <memory>
+#include <thread>
+
+using util::spsc_queue;
+
+CASE("spsc_queue keeps items in order, up to its capacity")
+{
+  spsc_queue<int, 4> queue;
+  int item = 0;
+  EXPECT(queue.empty());
+  EXPECT(not queue.pop(item));
+
+  for (int i = 0; i < 4; i++)
+    EXPECT(queue.push(i));
+  EXPECT(not queue.push(4));
+  EXPECT(queue.size() == 4u);
+
+  EXPECT(queue.pop(item));
+  EXPECT(item == 0);
+  EXPECT(queue.push(4));
+
+  int expected = 1;
+  const auto count = queue.consume_all([&] (int& i) { EXPECT(i == expected++); });
+  EXPECT(count == 4u);
+  EXPECT(queue.empty());
+  EXPECT(queue.consume_all([] (int&) {}) == 0u);
+}
+
+CASE("spsc_queue moves items, and destroys the ones left")
+{
+  auto shared = std::make_shared<int>(1);
+  {
+    spsc_queue<std::shared_ptr<int>, 8> queue;
+    EXPECT(queue.emplace(shared));
+    EXPECT(queue.emplace(shared));
+    EXPECT(shared.use_count() == 3);
+
+    std::shared_ptr<int> item;
+    EXPECT(queue.pop(item));
+    EXPECT(item == shared);
+    item.reset();
+    EXPECT(shared.use_count() == 2);
+  }
+  EXPECT(shared.use_count() == 1);
+
+  spsc_queue<std::unique_ptr<int>, 2> queue;
+  EXPECT(queue.push(std::make_unique<int>(5)));
+  std::unique_ptr<int> ptr;
+  EXPECT(queue.pop(ptr));
+  EXPECT(*ptr == 5);
+}
+
+CASE("spsc_queue passes every item from one thread to another")
+{
+  static constexpr int ITEMS = 1000000;
+  spsc_queue<int, 256> queue;
+
+  std::thread producer([&queue] {
+    for (int i = 0; i < ITEMS; i++)
+      while (not queue.push(i));
+  });
+
+  int expected = 0;
+  bool in_order = true;
+  while (expected < ITEMS)
+    queue.consume_all([&] (int& i) { in_order &= (i == expected++); });
+  producer.join();
+
+  EXPECT(in_order);
+  EXPECT(queue.empty());
+}
@@ -0,0 +1,81 @@
+
+#include <common.cxx>
+#include <util/work_deque.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using util::work_deque;
+
+CASE("work_deque pops newest first, and steals oldest first")
+{
+  work_deque<int, 4> deque;
+  int item = 0;
+  EXPECT(deque.empty());
+  EXPECT(not deque.pop(item));
+  EXPECT(not deque.steal(item));
+
+  for (int i = 1; i <= 4; i++)
+    EXPECT(deque.push(i));
+  EXPECT(not deque.push(5));
+  EXPECT(deque.size() == 4u);
+
+  EXPECT(deque.pop(item));
+  EXPECT(item == 4);
+  EXPECT(deque.steal(item));
+  EXPECT(item == 1);
+  EXPECT(deque.push(5));
+  EXPECT(deque.pop(item));
+  EXPECT(item == 5);
+  EXPECT(deque.pop(item));
+  EXPECT(item == 3);
+  EXPECT(deque.steal(item));
+  EXPECT(item == 2);
+  EXPECT(deque.empty());
+
+  // wrapping around
+  for (int i = 0; i < 10; i++) {
+    EXPECT(deque.push(i));
+    EXPECT(deque.steal(item));
+    EXPECT(item == i);
+  }
+}
+
+CASE("work_deque hands out every item once, with thieves racing the owner")
+{
+  static constexpr int ITEMS   = 200000;
+  static constexpr int THIEVES = 3;
+  work_deque<int, 256> deque;
+  std::vector<std::atomic<int>> taken(ITEMS);
+  std::atomic<bool> finished {false};
+
+  auto thief = [&] {
+    int item;
+    while (not finished.load())
+      if (deque.steal(item)) taken[item]++;
+  };
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < THIEVES; i++)
+    thieves.emplace_back(thief);
+
+  int item;
+  for (int i = 0; i < ITEMS; i++)
+  {
+    while (not deque.push(i))
+      if (deque.pop(item)) taken[item]++;
+    // the owner takes some back
+    if (i % 3 == 0 and deque.pop(item)) taken[item]++;
+  }
+  while (deque.pop(item)) taken[item]++;
+  finished = true;
+  for (auto& t : thieves)
+    t.join();
+
+  int missing = 0, twice = 0;
+  for (auto& count : taken) {
+    if (count == 0) missing++;
+    if (count > 1) twice++;
+  }
+  EXPECT(missing == 0);
+  EXPECT(twice == 0);
+}